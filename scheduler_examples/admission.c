@@ -0,0 +1,127 @@
+#include "admission.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "msg.h"
+
+int admission_parse_config(const char *spec, admission_config_t *config) {
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    memset(config, 0, sizeof(admission_config_t));
+
+    uint32_t *fields[] = {&config->max_ready, &config->max_work_ms, &config->rate, &config->burst,
+                          &config->max_accepts};
+    uint32_t num_fields = sizeof(fields) / sizeof(fields[0]);
+    uint32_t parsed = 0;
+    int has_burst = 0;
+    int status = 0;
+    char *endptr;
+    for (char *token = strtok(copy, ","); token && status == 0; token = strtok(NULL, ",")) {
+        long value = strtol(token, &endptr, 10);
+        if (parsed >= num_fields || *endptr != '\0' || value < 0 || value > INT32_MAX) {
+            status = -1;
+        } else {
+            has_burst |= fields[parsed] == &config->burst;
+            *fields[parsed++] = (uint32_t) value;
+        }
+    }
+    if (status == 0 && parsed == 0) status = -1;
+    if (status == 0 && !has_burst) config->burst = config->rate;
+    // A bucket that cannot hold a token would never admit anything
+    if (status == 0 && config->rate > 0 && config->burst == 0) status = -1;
+    if (status < 0) {
+        fprintf(stderr, "Invalid admission configuration: %s "
+                        "(expected max_ready[,max_work_ms[,rate[,burst[,max_accepts]]]], 0 for no limit)\n", spec);
+    }
+    free(copy);
+    return status;
+}
+
+void admission_connect(const admission_t *adm, pcb_t *conn, uint64_t current_time_ns) {
+    conn->cold->tokens = (uint64_t) adm->config.burst * NS_PER_S;
+    conn->cold->tokens_ns = current_time_ns;
+}
+
+/**
+ * @brief Add the tokens earned since the last refill, up to the size of the bucket
+ *
+ * A token is NS_PER_S units, so a rate of r tokens per second adds r units per nanosecond.
+ */
+static void refill(const admission_config_t *config, pcb_cold_t *cold, uint64_t current_time_ns) {
+    uint64_t full = (uint64_t) config->burst * NS_PER_S;
+    uint64_t elapsed = current_time_ns - cold->tokens_ns;
+    cold->tokens_ns = current_time_ns;
+    if (cold->tokens >= full) return;
+    if (elapsed >= (full - cold->tokens) / config->rate + 1) {
+        cold->tokens = full;
+    } else {
+        cold->tokens += elapsed * config->rate;
+        if (cold->tokens > full) cold->tokens = full;
+    }
+}
+
+admission_verdict_en admission_admit(admission_t *adm, pcb_t *task, pcb_t *client, uint64_t work_ns,
+                                     uint32_t ready, uint64_t current_time_ns) {
+    const admission_config_t *config = &adm->config;
+    if (work_ns > 0) {
+        uint64_t max_work_ns = (uint64_t) config->max_work_ms * NS_PER_MS;
+        if ((config->max_ready > 0 && ready >= config->max_ready) ||
+            (max_work_ns > 0 && adm->outstanding_ns > 0 && adm->outstanding_ns + work_ns > max_work_ns)) {
+            adm->stats.overloaded++;
+            return ADMISSION_OVERLOADED;
+        }
+    }
+    if (config->rate > 0 && client) {
+        refill(config, client->cold, current_time_ns);
+        if (client->cold->tokens < NS_PER_S) {
+            adm->stats.throttled++;
+            return ADMISSION_THROTTLED;
+        }
+        client->cold->tokens -= NS_PER_S;
+    }
+    adm->stats.admitted++;
+    adm->outstanding_ns += work_ns;
+    task->cold->admitted_ns += work_ns;
+    if (adm->outstanding_ns > adm->stats.max_outstanding_ns) adm->stats.max_outstanding_ns = adm->outstanding_ns;
+    return ADMISSION_OK;
+}
+
+void admission_deferred(admission_t *adm, uint64_t waited_ns) {
+    adm->stats.deferred++;
+    adm->stats.deferred_ns += waited_ns;
+    if (waited_ns > adm->stats.max_deferred_ns) adm->stats.max_deferred_ns = waited_ns;
+}
+
+void admission_release(admission_t *adm, pcb_t *task, uint64_t work_ns) {
+    if (work_ns > task->cold->admitted_ns) work_ns = task->cold->admitted_ns;
+    task->cold->admitted_ns -= work_ns;
+    adm->outstanding_ns -= work_ns;
+}
+
+int admission_accept(admission_t *adm, uint32_t accepted, uint32_t ready, uint32_t waiting) {
+    const admission_config_t *config = &adm->config;
+    uint64_t max_work_ns = (uint64_t) config->max_work_ms * NS_PER_MS;
+    int held = (config->max_accepts > 0 && accepted >= config->max_accepts) ||
+               (config->max_ready > 0 && ready >= config->max_ready) ||
+               (max_work_ns > 0 && adm->outstanding_ns >= max_work_ns) ||
+               waiting > 0;
+    // Accepting stops at the first connection held, so this counts ticks
+    if (held) adm->stats.held_ticks++;
+    return !held;
+}
+
+void admission_print_stats(const admission_t *adm, FILE *out) {
+    const admission_config_t *config = &adm->config;
+    const admission_stats_t *stats = &adm->stats;
+    if (!config->max_ready && !config->max_work_ms && !config->rate && !config->max_accepts) return;
+    fprintf(out, "Admission (max ready=%u, max work=%u ms, rate=%u/s, burst=%u, max accepts=%u/tick): "
+                 "admitted=%llu, deferred=%llu, overloaded=%llu, throttled=%llu\n",
+            config->max_ready, config->max_work_ms, config->rate, config->burst, config->max_accepts,
+            (unsigned long long) stats->admitted, (unsigned long long) stats->deferred,
+            (unsigned long long) stats->overloaded, (unsigned long long) stats->throttled);
+    fprintf(out, "Admission delay: avg=%.3fs, max=%.3fs, max outstanding work=%.3fs, ticks with connections held=%llu\n",
+            stats->deferred ? (double) stats->deferred_ns / 1e9 / (double) stats->deferred : 0.0,
+            (double) stats->max_deferred_ns / 1e9, (double) stats->max_outstanding_ns / 1e9,
+            (unsigned long long) stats->held_ticks);
+}
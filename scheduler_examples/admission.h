@@ -0,0 +1,143 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+
+/*
+ * Admission control.
+ *
+ * Without it, every connection is accepted and every RUN request is acknowledged
+ * on arrival, however long the ready queue(s) already are. Under overload the
+ * simulator then holds more and more work, every task waits longer, and a storm of
+ * connections costs a pcb and a read per connection per tick.
+ *
+ * With admission control, a RUN or BLOCK request is only acknowledged (and
+ * started) if:
+ * - the ready queue(s) hold fewer tasks than max_ready (requests with CPU work),
+ * - the CPU work admitted and not done yet plus the request stays within
+ *   max_work_ms (requests with CPU work; a request is always admitted when
+ *   nothing is outstanding, however large),
+ * - the client has a token in its bucket, refilled at rate tokens per simulated
+ *   second up to burst tokens (all the virtual processes of a load generator
+ *   share the bucket of their connection).
+ * Otherwise the ACK is deferred: the request waits, and is admitted in a later
+ * tick. The application waits for its ACK meanwhile, which is the backpressure.
+ *
+ * While the ready queue(s) or the outstanding work are over their limits, or
+ * requests wait for admission, no new connection is accepted, they wait in the
+ * listen backlog of the server socket. At most max_accepts connections are
+ * accepted per tick.
+ *
+ * Every limit is off when 0. Admission depends on the simulated state only, so
+ * a recorded run replays the same way.
+ */
+
+// Define the admission limits (0: no limit)
+typedef struct {
+    uint32_t max_ready;         // Tasks in the ready queue(s)
+    uint32_t max_work_ms;       // CPU work admitted and not done yet
+    uint32_t rate;              // Requests per simulated second of a client (token bucket)
+    uint32_t burst;             // Tokens a client can save up
+    uint32_t max_accepts;       // Connections accepted per tick
+} admission_config_t;
+
+// Define why a request was not admitted
+typedef enum {
+    ADMISSION_OK = 0,
+    ADMISSION_OVERLOADED,       // Ready queue(s) or outstanding work over the limit
+    ADMISSION_THROTTLED,        // The client has no token
+} admission_verdict_en;
+
+// Define the admission counters
+typedef struct {
+    uint64_t admitted;          // Requests acknowledged
+    uint64_t deferred;          // Requests whose ACK was deferred
+    uint64_t overloaded;        // Checks that failed on the ready queue(s) or the outstanding work
+    uint64_t throttled;         // Checks that failed on the token bucket
+    uint64_t deferred_ns;       // Time the deferred requests waited for their ACK
+    uint64_t max_deferred_ns;
+    uint64_t held_ticks;        // Ticks in which accepting was held back
+    uint64_t max_outstanding_ns;
+} admission_stats_t;
+
+// Define the admission state
+typedef struct {
+    admission_config_t config;
+    uint64_t outstanding_ns;    // CPU work admitted and not done yet
+    admission_stats_t stats;
+} admission_t;
+
+/**
+ * @brief Parse a configuration like "32" or "32,500,20,5,64"
+ *
+ * The fields are: max ready tasks, max outstanding work in ms, token rate per
+ * second, bucket size, and max connections accepted per tick; 0 for no limit.
+ * The bucket size defaults to the rate (one second of tokens).
+ *
+ * @param spec The configuration string
+ * @param config Where to store the configuration
+ * @return 0 on success, -1 if the configuration is invalid
+ */
+int admission_parse_config(const char *spec, admission_config_t *config);
+
+/**
+ * @brief Give a new connection a full bucket
+ *
+ * @param adm The admission state
+ * @param conn The pcb of the connection
+ * @param current_time_ns The current time in nanoseconds
+ */
+void admission_connect(const admission_t *adm, pcb_t *conn, uint64_t current_time_ns);
+
+/**
+ * @brief Decide whether a request is admitted, and charge it if it is
+ *
+ * An admitted request takes a token from the client and adds its CPU work to the
+ * outstanding work, charged to the task until admission_release.
+ *
+ * @param adm The admission state
+ * @param task The task of the request
+ * @param client The pcb of the connection the request came on (its bucket is used)
+ * @param work_ns The CPU time of the request (0 for BLOCK)
+ * @param ready The tasks in the ready queue(s)
+ * @param current_time_ns The current time in nanoseconds
+ * @return ADMISSION_OK if admitted, otherwise why not
+ */
+admission_verdict_en admission_admit(admission_t *adm, pcb_t *task, pcb_t *client, uint64_t work_ns,
+                                     uint32_t ready, uint64_t current_time_ns);
+
+/**
+ * @brief Count a request whose ACK was deferred, once it is admitted
+ *
+ * @param adm The admission state
+ * @param waited_ns How long the request waited for admission
+ */
+void admission_deferred(admission_t *adm, uint64_t waited_ns);
+
+/**
+ * @brief Release CPU work charged to a task (UINT64_MAX: all of it)
+ */
+void admission_release(admission_t *adm, pcb_t *task, uint64_t work_ns);
+
+/**
+ * @brief Decide whether one more connection is accepted in this tick
+ *
+ * Called before each accept, accepting stops at the first connection held.
+ *
+ * @param adm The admission state
+ * @param accepted Connections accepted so far in this tick
+ * @param ready The tasks in the ready queue(s)
+ * @param waiting Requests waiting for admission
+ * @return 1 if the connection is accepted, 0 if it stays in the listen backlog
+ */
+int admission_accept(admission_t *adm, uint32_t accepted, uint32_t ready, uint32_t waiting);
+
+/**
+ * @brief Print the configuration and the counters (nothing if no limit is set)
+ */
+void admission_print_stats(const admission_t *adm, FILE *out);
+
+#endif //ADMISSION_H
@@ -4,6 +4,9 @@
 #include <sys/un.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 
@@ -11,26 +14,7 @@
 
 #include "msg.h"
 #include "burst_queue.h"
-
-/**
- * Extracts the basename of a file without its extension.
- * The basename is the last part of the path after the last '/'.
- * If there is a '.' in the basename, it will be removed.
- *
- * @param path The full path to the file.
- * @return Newly allocated string containing the basename without extension.
- */
-char *get_basename_no_ext(const char* path) {
-    const char* slash = strrchr(path, '/');
-    const char* base = slash ? slash + 1 : path;
-
-    const char* dot = strrchr(base, '.');
-    size_t len = dot ? (size_t)(dot - base) : strlen(base);
-    char *result = malloc(len + 1);
-    strncpy(result, base, len);
-    result[len] = '\0';
-    return result;
-}
+#include "shm_channel.h"
 
 typedef enum {
     process_error = 0,
@@ -38,39 +22,142 @@ typedef enum {
     process_terminated
 } process_status_en;
 
-process_status_en handle_process_requests(int sockfd, const pid_t pid, const char *app_name, burst_t *burst, process_request_t request, uint32_t *sim_start_time_ms, uint32_t *sim_clock_ms) {
+// Spins between two checks for the reply when burning CPU (tens of microseconds)
+#define BURN_CHECK_ITERATIONS 100000
+
+// Define the connection to the scheduler
+typedef struct {
+    int sockfd;
+    shm_channel_t *channel;     // Shared-memory rings (NULL if the messages go over the socket)
+    int burn;                   // Burn real CPU until the DONE of a RUN (real-process mode, ossim -X)
+} connection_t;
+
+static int send_request(const connection_t *conn, const msg_t *msg) {
+    if (conn->channel) {
+        // At most one request is in flight, the ring cannot be full
+        return shm_ring_push(&conn->channel->requests, msg);
+    }
+    if (write(conn->sockfd, msg, sizeof(msg_t)) != sizeof(msg_t)) {
+        perror("write");
+        return -1;
+    }
+    return 0;
+}
+
+// Send several requests at once (in one write over the socket)
+static int send_requests(const connection_t *conn, const msg_t *msgs, uint32_t count) {
+    if (conn->channel) {
+        // The ring has room for a whole script
+        for (uint32_t i = 0; i < count; i++) {
+            if (shm_ring_push(&conn->channel->requests, &msgs[i]) < 0) return -1;
+        }
+        return 0;
+    }
+    if (write(conn->sockfd, msgs, count * sizeof(msg_t)) != (ssize_t) (count * sizeof(msg_t))) {
+        perror("write");
+        return -1;
+    }
+    return 0;
+}
+
+static int receive_reply(const connection_t *conn, msg_t *msg) {
+    if (conn->channel) {
+        // Wake up every second to check that the scheduler is still there
+        while (!shm_ring_wait(&conn->channel->responses, msg, 1000)) {
+            char byte;
+            if (recv(conn->sockfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+                fprintf(stderr, "Scheduler closed the connection\n");
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if (read(conn->sockfd, msg, sizeof(msg_t)) != sizeof(msg_t)) {
+        perror("read");
+        return -1;
+    }
+    return 0;
+}
+
+// Read the payload that follows a reply (the shared-memory rings publish it with the reply)
+static int receive_payload(const connection_t *conn, void *payload, uint32_t len) {
+    if (conn->channel) {
+        if (shm_ring_pop_payload(&conn->channel->responses, payload, len)) return 0;
+        fprintf(stderr, "Missing payload of %u bytes after the reply\n", len);
+        return -1;
+    }
+    for (uint32_t done = 0; done < len; ) {
+        ssize_t n = read(conn->sockfd, (uint8_t *) payload + done, len - done);
+        if (n <= 0) {
+            perror("read");
+            return -1;
+        }
+        done += (uint32_t) n;
+    }
+    return 0;
+}
+
+// Burn CPU until the reply arrives, the scheduler stops and continues the process to enforce its decisions
+static int burn_until_reply(const connection_t *conn, msg_t *msg) {
+    struct pollfd pfd = {.fd = conn->sockfd, .events = POLLIN};
+    volatile uint64_t sink = 0;
+    for (;;) {
+        for (uint32_t i = 0; i < BURN_CHECK_ITERATIONS; i++) sink += i;
+        if (conn->channel && shm_ring_pop(&conn->channel->responses, msg)) return 0;
+        // With the rings, the socket is only readable once the scheduler closed it
+        if (poll(&pfd, 1, 0) > 0) return receive_reply(conn, msg);
+    }
+}
+
+// Wait for the DONE of requests, burning CPU in the meantime if they run on the CPU
+static int receive_done(const connection_t *conn, msg_t *msg, int runs) {
+    return conn->burn && runs ? burn_until_reply(conn, msg) : receive_reply(conn, msg);
+}
+
+// Build the RUN or BLOCK request of a burst, or the LOCK or UNLOCK of a mutex line
+static msg_t make_request(const pid_t pid, const burst_t *burst, process_request_t request) {
     msg_t msg = {
         .pid = pid,
         .request = request,
-        .time_ms = (request == PROCESS_REQUEST_RUN)?burst->burst_time_ms:burst->block_time_ms
+        .time_ns = ((request == PROCESS_REQUEST_RUN)?burst->burst_time_ms:burst->block_time_ms) * NS_PER_MS,
+        .block = BLOCK_ADDRESS_NONE
     };
+    if (request == PROCESS_REQUEST_RUN) {
+        msg.pages = burst->pages;       // Pages referenced by the burst
+        msg.nice = burst->nice;
+    } else if (request == PROCESS_REQUEST_BLOCK) {
+        msg.device = burst->device;     // Device and block of the I/O
+        msg.block = burst->block;
+    } else {
+        msg.time_ns = 0;
+        memcpy(msg.mutex, burst->mutex, MUTEX_NAME_LEN);
+    }
+    return msg;
+}
+
+process_status_en handle_process_requests(const connection_t *conn, const pid_t pid, const char *app_name, burst_t *burst, process_request_t request, uint64_t *sim_start_time_ns, uint64_t *sim_clock_ns) {
+    msg_t msg = make_request(pid, burst, request);
     // Send request
-    if (write(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-        perror("write");
-        close(sockfd);
+    if (send_request(conn, &msg) < 0) {
         return process_error;
     }
-    DBG("Application %s (PID %d) sent %s request for %u ms",
-           app_name, pid, PROCESS_REQUEST_STRINGS[request], msg.time_ms);
+    DBG("Application %s (PID %d) sent %s request for %.3f ms",
+           app_name, pid, PROCESS_REQUEST_STRINGS[request], msg.time_ns/1e6);
     // Wait for ACK and the internal simulation time
-    if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-        perror("read");
-        close(sockfd);
+    if (receive_reply(conn, &msg) < 0) {
         return process_error;
     }
     if (msg.request != PROCESS_REQUEST_ACK) {
         printf("Received invalid request. Expected ACK, received %s\n", PROCESS_REQUEST_STRINGS[msg.request]);
         return process_error;
     }
-    *sim_clock_ms = msg.time_ms;
-    if (*sim_start_time_ms == 0) *sim_start_time_ms = *sim_clock_ms; // First burst, set the start time
-    DBG("Received %s from scheduler for application %s (PID %d) at time %u ms\n",
-           PROCESS_REQUEST_STRINGS[msg.request], app_name, pid, *sim_clock_ms);
+    *sim_clock_ns = msg.time_ns;
+    if (*sim_start_time_ns == 0) *sim_start_time_ns = *sim_clock_ns; // First burst, set the start time
+    DBG("Received %s from scheduler for application %s (PID %d) at time %.3f ms\n",
+           PROCESS_REQUEST_STRINGS[msg.request], app_name, pid, *sim_clock_ns/1e6);
 
     // Wait for DONE and the internal simulation time
-    if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-        perror("read");
-        close(sockfd);
+    if (receive_done(conn, &msg, request == PROCESS_REQUEST_RUN) < 0) {
         return process_error;
     }
 
@@ -78,24 +165,112 @@ process_status_en handle_process_requests(int sockfd, const pid_t pid, const cha
         printf("Received invalid request. Expected DONE, received %s\n", PROCESS_REQUEST_STRINGS[msg.request]);
         return process_error;
     }
-    *sim_clock_ms = msg.time_ms;
-    DBG("Received %s from scheduler for application %s (PID %d) at time %u ms\n",
-           PROCESS_REQUEST_STRINGS[msg.request], app_name, pid, *sim_clock_ms);
+    *sim_clock_ns = msg.time_ns;
+    DBG("Received %s from scheduler for application %s (PID %d) at time %.3f ms\n",
+           PROCESS_REQUEST_STRINGS[msg.request], app_name, pid, *sim_clock_ns/1e6);
+
+    return process_success;
+}
+
+/*
+ * Upload a window of requests as a script: the scheduler runs them back to back
+ * and only replies with an ACK when the first one starts and a DONE followed by
+ * the end time of every request when the last one finishes.
+ */
+process_status_en handle_script(const connection_t *conn, const pid_t pid, const char *app_name, const msg_t *requests, uint32_t count, uint64_t *sim_start_time_ns, uint64_t *sim_clock_ns) {
+    msg_t script[SCRIPT_MAX_REQUESTS + 1] = {{
+        .pid = pid,
+        .request = PROCESS_REQUEST_SCRIPT,
+        .time_ns = count,
+        .block = BLOCK_ADDRESS_NONE
+    }};
+    memcpy(&script[1], requests, count * sizeof(msg_t));
+    if (send_requests(conn, script, count + 1) < 0) {
+        return process_error;
+    }
+    DBG("Application %s (PID %d) sent a script of %u requests\n", app_name, pid, count);
+
+    msg_t msg;
+    if (receive_reply(conn, &msg) < 0) {
+        return process_error;
+    }
+    if (msg.request != PROCESS_REQUEST_ACK) {
+        printf("Received invalid request. Expected ACK, received %s\n", PROCESS_REQUEST_STRINGS[msg.request]);
+        return process_error;
+    }
+    *sim_clock_ns = msg.time_ns;
+    if (*sim_start_time_ns == 0) *sim_start_time_ns = *sim_clock_ns; // First burst, set the start time
 
+    // The scheduler stops the process while the script is not on a CPU (real-process mode)
+    int runs = 0;
+    for (uint32_t i = 0; i < count; i++) runs |= requests[i].request == PROCESS_REQUEST_RUN;
+    if (receive_done(conn, &msg, runs) < 0) {
+        return process_error;
+    }
+    if (msg.request != PROCESS_REQUEST_DONE || msg.script_len != count) {
+        printf("Received invalid request. Expected DONE of %u requests, received %s\n",
+               count, PROCESS_REQUEST_STRINGS[msg.request]);
+        return process_error;
+    }
+    script_times_t times;
+    if (receive_payload(conn, times.end_ns, SCRIPT_TIMES_SIZE(count)) < 0) {
+        return process_error;
+    }
+    *sim_clock_ns = msg.time_ns;
+    for (uint32_t i = 0; i < count; i++) {
+        DBG("Application %s (PID %d) %s of %.3f ms finished at time %.3f ms\n",
+            app_name, pid, PROCESS_REQUEST_STRINGS[requests[i].request], requests[i].time_ns/1e6, times.end_ns[i]/1e6);
+    }
     return process_success;
 }
 
+static void usage(const char *prog) {
+    printf("Usage: %s [-T socket|shm] [-w requests] [-X] <burst-file.csv>\n", prog);
+    printf("-w: upload up to this many requests at once as a script (1 to %d)\n", SCRIPT_MAX_REQUESTS);
+    printf("-X: burn real CPU during the RUN requests (for ossim -X)\n");
+}
+
+static double elapsed_s(clockid_t clock, const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
 /*
- * Run like: ./app-pre <burst-file.csv>
+ * Run like: ./app-io [-T socket|shm] [-w requests] [-X] <burst-file.csv>
  */
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <burst-file.csv>\n", argv[0]);
+    int use_shm = 0;
+    uint32_t window = 0;                    // Requests per script (0: one request at a time)
+    int burn = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "T:w:X")) != -1) {
+        if (opt == 'T' && strcmp(optarg, "shm") == 0) {
+            use_shm = 1;
+        } else if (opt == 'T' && strcmp(optarg, "socket") == 0) {
+            use_shm = 0;
+        } else if (opt == 'w') {
+            char *endptr;
+            long val = strtol(optarg, &endptr, 10);
+            if (*endptr != '\0' || val < 1 || val > SCRIPT_MAX_REQUESTS) {
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            window = (uint32_t) val;
+        } else if (opt == 'X') {
+            burn = 1;
+        } else {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
         exit(EXIT_FAILURE);
     }
 
     // Parse arguments
-    const char *burstfile_name = argv[1];
+    const char *burstfile_name = argv[optind];
     char *app_name = get_basename_no_ext(burstfile_name);
 
     burst_queue_t bursts = {.head = NULL, .tail = NULL};
@@ -123,34 +298,96 @@ int main(int argc, char *argv[]) {
     }
 
     pid_t pid = getpid();
-    uint32_t sim_clock_ms = 0;              // Clock of the scheduler
+    connection_t conn = {.sockfd = sockfd, .channel = NULL, .burn = burn};
+    // Measured times, to compare with the ones of the simulator in real-process mode
+    struct timespec wall_start, cpu_start;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    if (use_shm) {
+        // Hand the rings to the scheduler, the socket is only kept to notice disconnects
+        int shm_fd;
+        conn.channel = shm_channel_create(&shm_fd);
+        if (!conn.channel || shm_channel_send(sockfd, pid, shm_fd) < 0) {
+            close(sockfd);
+            return EXIT_FAILURE;
+        }
+        close(shm_fd);
+    }
+    uint64_t sim_clock_ns = 0;              // Clock of the scheduler
 
-    uint32_t start_time_ms = 0;             // Start time of the app
+    uint64_t start_time_ns = 0;             // Start time of the app
     uint32_t cpu_duration_ms = 0;           // duration of the app (bursts and blocks)
     uint32_t block_duration_ms = 0;         // duration of the app in blocked state
 
     burst_t *active_burst;
 
-    while ((active_burst = dequeue_burst(&bursts)) != NULL) {
-        if (handle_process_requests(sockfd, pid, app_name, active_burst, PROCESS_REQUEST_RUN, &start_time_ms, &sim_clock_ms) == process_error)
+    // Script mode: collect the requests of the bursts and send them a window at a time
+    msg_t requests[SCRIPT_MAX_REQUESTS];
+    uint32_t count = 0;
+    while (window > 0 && (active_burst = dequeue_burst(&bursts)) != NULL) {
+        if (active_burst->request != PROCESS_REQUEST_RUN) {
+            // LOCK or UNLOCK
+            requests[count++] = make_request(pid, active_burst, active_burst->request);
+            if (count == window || (bursts.head == NULL && count > 0)) {
+                if (handle_script(&conn, pid, app_name, requests, count, &start_time_ns, &sim_clock_ns) == process_error)
+                    break;
+                count = 0;
+            }
+            continue;
+        }
+        requests[count++] = make_request(pid, active_burst, PROCESS_REQUEST_RUN);
+        cpu_duration_ms += active_burst->burst_time_ms;
+        int blocks = active_burst->block_time_ms > 0;
+        if (blocks && count == window) {
+            if (handle_script(&conn, pid, app_name, requests, count, &start_time_ns, &sim_clock_ns) == process_error)
+                break;
+            count = 0;
+        }
+        if (blocks) {
+            requests[count++] = make_request(pid, active_burst, PROCESS_REQUEST_BLOCK);
+            block_duration_ms += active_burst->block_time_ms;
+        }
+        if (count == window || (bursts.head == NULL && count > 0)) {
+            if (handle_script(&conn, pid, app_name, requests, count, &start_time_ns, &sim_clock_ns) == process_error)
+                break;
+            count = 0;
+        }
+    }
+
+    while (window == 0 && (active_burst = dequeue_burst(&bursts)) != NULL) {
+        if (active_burst->request != PROCESS_REQUEST_RUN) {
+            // LOCK or UNLOCK, DONE once the mutex was taken or given back
+            if (handle_process_requests(&conn, pid, app_name, active_burst, active_burst->request, &start_time_ns, &sim_clock_ns) == process_error)
+                break;
+            continue;
+        }
+        if (handle_process_requests(&conn, pid, app_name, active_burst, PROCESS_REQUEST_RUN, &start_time_ns, &sim_clock_ns) == process_error)
             break;
         cpu_duration_ms += active_burst->burst_time_ms;
 
         if (active_burst->block_time_ms > 0) {
-            if (handle_process_requests(sockfd, pid, app_name, active_burst, PROCESS_REQUEST_BLOCK, &start_time_ms, &sim_clock_ms) == process_error)
+            if (handle_process_requests(&conn, pid, app_name, active_burst, PROCESS_REQUEST_BLOCK, &start_time_ns, &sim_clock_ns) == process_error)
                 break;
             block_duration_ms += active_burst->block_time_ms;
         }
     }
 
     // Received EXIT, print stats
-    double real = (sim_clock_ms - start_time_ms)/1000.0;
+    double real = (double)(sim_clock_ns - start_time_ns)/1e9;
     double user = (double)cpu_duration_ms/1000.0;
     double sys = (double)block_duration_ms/1000.0;
 
-    printf("Application %s (PID %d) finished at time %d ms, Elapsed: %.03f seconds, CPU: %.03f seconds, BLOCKED: %.03f seconds\n",
-           app_name, pid, sim_clock_ms, real, user, sys);
+    printf("Application %s (PID %d) finished at time %.3f ms, Elapsed: %.03f seconds, CPU: %.03f seconds, BLOCKED: %.03f seconds\n",
+           app_name, pid, sim_clock_ns/1e6, real, user, sys);
+    if (burn) {
+        printf("Application %s (PID %d) measured: Elapsed: %.03f seconds, CPU: %.03f seconds\n",
+               app_name, pid, elapsed_s(CLOCK_MONOTONIC, &wall_start), elapsed_s(CLOCK_PROCESS_CPUTIME_ID, &cpu_start));
+    }
 
+    if (conn.channel) {
+        atomic_store(&conn.channel->closed, 1);
+        shm_channel_detach(conn.channel);
+    }
     close(sockfd);
     free(app_name);
     return EXIT_SUCCESS;
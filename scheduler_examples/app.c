@@ -4,6 +4,9 @@
 #include <sys/un.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/errno.h>
 
@@ -11,26 +14,47 @@
 
 #include "msg.h"
 
+// Spins between two checks for the reply when burning CPU (tens of microseconds)
+#define BURN_CHECK_ITERATIONS 100000
+
+// Burn CPU until a reply can be read, the scheduler stops and continues the process to enforce its decisions
+static void burn_until_readable(int sockfd) {
+    struct pollfd pfd = {.fd = sockfd, .events = POLLIN};
+    volatile uint64_t sink = 0;
+    do {
+        for (uint32_t i = 0; i < BURN_CHECK_ITERATIONS; i++) sink += i;
+    } while (poll(&pfd, 1, 0) == 0);
+}
+
+static double elapsed_s(clockid_t clock, const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
 /*
- * Run like: ./app <name> <time_s>
+ * Run like: ./app [-X] <name> <time_s>
+ *
+ * With -X the application really uses the CPU while it runs (for ossim -X).
  */
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <name> <time_s>\n", argv[0]);
+    int burn = argc == 4 && strcmp(argv[1], "-X") == 0;
+    if (argc != 3 + burn) {
+        printf("Usage: %s [-X] <name> <time_s>\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
     // Parse arguments
-    const char *app_name = argv[1];
+    const char *app_name = argv[1 + burn];
     char *endptr;
     errno = 0;
-    long val = strtol(argv[2], &endptr, 10);
+    long val = strtol(argv[2 + burn], &endptr, 10);
     if (errno != 0) {
         perror("strtol");  // conversion error (overflow, etc.)
         return 1;
     }
     if (*endptr != '\0') {
-        fprintf(stderr, "Invalid number: %s\n", argv[2]);
+        fprintf(stderr, "Invalid number: %s\n", argv[2 + burn]);
         return 1;
     }
     if (val < 0 || val > INT_MAX) {  // optional range check
@@ -64,15 +88,16 @@ int main(int argc, char *argv[]) {
     msg_t msg = {
         .pid = pid,
         .request = PROCESS_REQUEST_RUN,
-        .time_ms = time_s * 1000
+        .time_ns = time_s * NS_PER_S,
+        .block = BLOCK_ADDRESS_NONE
     };
     if (write(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
         perror("write");
         close(sockfd);
         return EXIT_FAILURE;
     }
-    DBG("Application %s (PID %d) sent RUN request for %d ms",
-           app_name, pid, msg.time_ms);
+    DBG("Application %s (PID %d) sent RUN request for %d s",
+           app_name, pid, time_s);
     // Wait for ACK and the internal simulation time
     if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
         perror("read");
@@ -85,8 +110,14 @@ int main(int argc, char *argv[]) {
     }
 
     // Received ACK
-    uint32_t start_time_ms = msg.time_ms;
-//    printf("Application %s (PID %d) started running at time %d ms\n", app_name, pid, start_time_ms);
+    uint64_t start_time_ns = msg.time_ns;
+    struct timespec wall_start, cpu_start;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    if (burn) {
+        burn_until_readable(sockfd);
+    }
+//    printf("Application %s (PID %d) started running at time %.3f ms\n", app_name, pid, start_time_ns / 1e6);
 
     // Wait for the EXIT message
     if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
@@ -99,12 +130,16 @@ int main(int argc, char *argv[]) {
     }
 
     // Received EXIT, print stats
-    double real = (msg.time_ms - start_time_ms)/1000.0;
+    double real = (double)(msg.time_ns - start_time_ns)/1e9;
     double user = (double)time_s;
     double sys = real - time_s;
 
-    printf("Application %s (PID %d) finished at time %d ms, Elapsed: %.03f seconds, CPU: %.03f seconds\n",
-           app_name, pid, msg.time_ms, real, user);
+    printf("Application %s (PID %d) finished at time %.3f ms, Elapsed: %.03f seconds, CPU: %.03f seconds\n",
+           app_name, pid, (double)msg.time_ns/1e6, real, user);
+    if (burn) {
+        printf("Application %s (PID %d) measured: Elapsed: %.03f seconds, CPU: %.03f seconds\n",
+               app_name, pid, elapsed_s(CLOCK_MONOTONIC, &wall_start), elapsed_s(CLOCK_PROCESS_CPUTIME_ID, &cpu_start));
+    }
 
     close(sockfd);
     return EXIT_SUCCESS;
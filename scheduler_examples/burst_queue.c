@@ -10,9 +10,40 @@
 
 #define MAX_LINE_LEN 1024
 
+/**
+ * @brief Parse a mutex line, like "LOCK,db" or "UNLOCK,db"
+ *
+ * @return 1 if the line is a mutex line, 0 if it is not, -1 if it is malformed
+ */
+static int parse_mutex_line(const char* line, burst_t* burst) {
+    const char* name;
+    if (strncmp(line, "LOCK,", 5) == 0) {
+        burst->request = PROCESS_REQUEST_LOCK;
+        name = line + 5;
+    } else if (strncmp(line, "UNLOCK,", 7) == 0) {
+        burst->request = PROCESS_REQUEST_UNLOCK;
+        name = line + 7;
+    } else {
+        return 0;
+    }
+    size_t len = strcspn(name, " \t\r\n");
+    if (len == 0 || len >= MUTEX_NAME_LEN) {
+        fprintf(stderr, "Invalid mutex name (1 to %d characters): %s\n", MUTEX_NAME_LEN - 1, name);
+        return -1;
+    }
+    memcpy(burst->mutex, name, len);
+    burst->mutex[len] = '\0';
+    burst->block = BLOCK_ADDRESS_NONE;
+    return 1;
+}
+
 int parse_burst_line(const char* line, burst_t* burst) {
     if (!line || !burst) return -1;
 
+    int mutex_line = parse_mutex_line(line, burst);
+    if (mutex_line != 0) return mutex_line < 0 ? -1 : 0;
+    burst->request = PROCESS_REQUEST_RUN;
+
     char* line_copy = strdup(line);
     if (!line_copy) return -1;
 
@@ -55,16 +86,26 @@ int parse_burst_line(const char* line, burst_t* burst) {
             free(line_copy);
             return -1;
         }
-        burst->nice = (int)nice_value;
+        // Levels start at 0 (the highest), a negative nice asks for the highest
+        burst->nice = nice_value < 0 ? 1 : (uint32_t) nice_value + 1;
     }
 
 
-    // Optional: parse pages list
+    // Optional: pages list, like [1,2,3], and I/O device with optional block address, like 1:5000
     burst->pages.count = 0;
-    token = strtok(NULL, "[");
-    if (token) token = strtok(NULL, "]");
-    if (token) {
-        char* page_token = strtok(token, ",");
+    burst->device = 0;
+    burst->block = BLOCK_ADDRESS_NONE;
+    char* rest = strtok(NULL, "\r\n");
+    while (rest && isspace((unsigned char) *rest)) rest++;
+    if (rest && *rest == '[') {
+        char* end = strchr(rest, ']');
+        if (!end) {
+            fprintf(stderr, "Unterminated page list: %s\n", rest);
+            free(line_copy);
+            return -1;
+        }
+        *end = '\0';
+        char* page_token = strtok(rest + 1, ",");
         while (page_token &&  burst->pages.count< MAX_PAGES) {
             long page = strtol(page_token, &endptr, 10);
             if (*endptr != '\0' || page < 0 || page > INT_MAX) {
@@ -75,6 +116,24 @@ int parse_burst_line(const char* line, burst_t* burst) {
             burst->pages.ids[burst->pages.count++] = (int)page;
             page_token = strtok(NULL, ",");
         }
+        rest = end + 1;
+        if (*rest == ',') rest++;
+    }
+    if (rest && *rest != '\0') {
+        long device = strtol(rest, &endptr, 10);
+        long block = BLOCK_ADDRESS_NONE;
+        if (endptr != rest && *endptr == ':') {
+            char* block_str = endptr + 1;
+            block = strtol(block_str, &endptr, 10);
+            if (endptr == block_str) block = -1;
+        }
+        if (endptr == rest || *endptr != '\0' || device < 0 || device > INT_MAX || block < 0 || block > UINT32_MAX) {
+            fprintf(stderr, "Invalid device (expected device[:block]): %s\n", rest);
+            free(line_copy);
+            return -1;
+        }
+        burst->device = (uint32_t) device;
+        burst->block = (uint32_t) block;
     }
 
     free(line_copy);
@@ -154,3 +213,16 @@ burst_t* dequeue_burst(burst_queue_t* q) {
     free(node);
     return result;
 }
+
+char *get_basename_no_ext(const char* path) {
+    const char* slash = strrchr(path, '/');
+    const char* base = slash ? slash + 1 : path;
+
+    const char* dot = strrchr(base, '.');
+    size_t len = dot ? (size_t)(dot - base) : strlen(base);
+    char *result = malloc(len + 1);
+    if (!result) return NULL;
+    strncpy(result, base, len);
+    result[len] = '\0';
+    return result;
+}
@@ -6,8 +6,12 @@
 typedef struct {
     uint32_t burst_time_ms;         // Burst time in milliseconds
     uint32_t block_time_ms;         // Burst time in milliseconds
-    int nice;                       // Nice value (priority)
+    uint32_t nice;                  // Priority level plus one, as sent with RUN (0 if the line gives none)
     page_info_t pages;
+    uint32_t device;                // Device of the I/O (BLOCK) after the burst
+    uint32_t block;                 // Block address of the I/O (BLOCK_ADDRESS_NONE if none)
+    process_request_t request;      // RUN for a CPU burst (and its BLOCK), or LOCK/UNLOCK of a mutex
+    char mutex[MUTEX_NAME_LEN];     // Name of the mutex of a LOCK/UNLOCK line
 } burst_t;
 
 
@@ -25,5 +29,15 @@ int read_queue_from_file(burst_queue_t* queue, const char* filename);
 int enqueue_burst(burst_queue_t* q, const burst_t* burst);
 burst_t* dequeue_burst(burst_queue_t* q);
 
+/**
+ * Extracts the basename of a file without its extension.
+ * The basename is the last part of the path after the last '/'.
+ * If there is a '.' in the basename, it will be removed.
+ *
+ * @param path The full path to the file.
+ * @return Newly allocated string containing the basename without extension.
+ */
+char *get_basename_no_ext(const char* path);
+
 
 #endif //BURST_QUEUE_H
@@ -0,0 +1,166 @@
+#include "cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_INVALID UINT64_MAX
+
+static int array_init(cache_array_t *array, uint32_t entries, uint32_t ways) {
+    array->ways = ways;
+    array->sets = entries / ways;
+    array->clock = 0;
+    array->tags = malloc((size_t) entries * sizeof(uint64_t));
+    array->stamps = calloc(entries, sizeof(uint32_t));
+    if (!array->tags || !array->stamps) {
+        free(array->tags);
+        free(array->stamps);
+        return -1;
+    }
+    memset(array->tags, 0xFF, (size_t) entries * sizeof(uint64_t));
+    return 0;
+}
+
+static void array_flush(cache_array_t *array) {
+    memset(array->tags, 0xFF, (size_t) array->sets * array->ways * sizeof(uint64_t));
+}
+
+// Returns 1 on a hit, 0 on a miss (the tag is then loaded, replacing the LRU way)
+static int array_access(cache_array_t *array, uint64_t tag) {
+    uint32_t set = (uint32_t) ((tag * 0x9E3779B97F4A7C15ull) >> 32) % array->sets;
+    uint64_t *tags = &array->tags[set * array->ways];
+    uint32_t *stamps = &array->stamps[set * array->ways];
+    uint32_t victim = 0;
+    array->clock++;
+    for (uint32_t way = 0; way < array->ways; way++) {
+        if (tags[way] == tag) {
+            stamps[way] = array->clock;
+            return 1;
+        }
+        if (tags[victim] != CACHE_INVALID &&
+            (tags[way] == CACHE_INVALID || stamps[way] < stamps[victim])) {
+            victim = way;
+        }
+    }
+    tags[victim] = tag;
+    stamps[victim] = array->clock;
+    return 0;
+}
+
+int cache_parse_config(const char *spec, cache_config_t *config) {
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    memset(config, 0, sizeof(cache_config_t));
+    config->tlb_miss_us = 50;
+    config->llc_miss_us = 200;
+
+    uint32_t *fields[] = {&config->tlb_entries, &config->tlb_ways, &config->llc_pages, &config->llc_ways,
+                          &config->tlb_miss_us, &config->llc_miss_us};
+    uint32_t num_fields = sizeof(fields) / sizeof(fields[0]);
+    uint32_t parsed = 0;
+    int status = 0;
+    char *endptr;
+    for (char *token = strtok(copy, ","); token && status == 0; token = strtok(NULL, ",")) {
+        if (parsed == num_fields && strcmp(token, "ASID") == 0) {
+            config->asid = 1;
+            parsed++;
+            continue;
+        }
+        long value = strtol(token, &endptr, 10);
+        if (parsed >= num_fields || *endptr != '\0' || value < 0 || value > INT32_MAX) {
+            status = -1;
+        } else {
+            *fields[parsed++] = (uint32_t) value;
+        }
+    }
+    // Sizes must be a whole number of sets
+    if (status == 0 && (parsed < 4 ||
+                        config->tlb_ways == 0 || config->tlb_entries == 0 || config->tlb_entries % config->tlb_ways != 0 ||
+                        config->llc_ways == 0 || config->llc_pages == 0 || config->llc_pages % config->llc_ways != 0)) {
+        status = -1;
+    }
+    if (status < 0) {
+        fprintf(stderr, "Invalid cache configuration: %s "
+                        "(expected tlb_entries,tlb_ways,llc_pages,llc_ways[,tlb_miss_us[,llc_miss_us[,ASID]]])\n", spec);
+    }
+    free(copy);
+    return status;
+}
+
+cache_t *cache_create(const cache_config_t *config) {
+    cache_t *cache = calloc(1, sizeof(cache_t));
+    if (!cache) return NULL;
+    cache->config = *config;
+    if (array_init(&cache->tlb, config->tlb_entries, config->tlb_ways) < 0) {
+        free(cache);
+        return NULL;
+    }
+    if (array_init(&cache->llc, config->llc_pages, config->llc_ways) < 0) {
+        free(cache->tlb.tags);
+        free(cache->tlb.stamps);
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void cache_destroy(cache_t *cache) {
+    if (!cache) return;
+    free(cache->tlb.tags);
+    free(cache->tlb.stamps);
+    free(cache->llc.tags);
+    free(cache->llc.stamps);
+    free(cache);
+}
+
+uint32_t cache_dispatch(cache_t *cache, const pcb_t *task) {
+    if (!cache->config.asid && task->pid != cache->last_pid) {
+        // The new address space invalidates every translation
+        array_flush(&cache->tlb);
+        cache->stats.tlb_flushes++;
+    }
+    cache->last_pid = task->pid;
+
+    uint32_t tlb_misses = 0, llc_misses = 0;
+    for (uint32_t i = 0; i < task->cold->pages.count && i < MAX_PAGES; i++) {
+        uint64_t tag = ((uint64_t) (uint32_t) task->pid << 32) | task->cold->pages.ids[i];
+        if (!array_access(&cache->tlb, tag)) tlb_misses++;
+        if (!array_access(&cache->llc, tag)) llc_misses++;
+    }
+    uint32_t refill_us = tlb_misses * cache->config.tlb_miss_us + llc_misses * cache->config.llc_miss_us;
+    cache->stats.tlb_misses += tlb_misses;
+    cache->stats.tlb_hits += task->cold->pages.count - tlb_misses;
+    cache->stats.llc_misses += llc_misses;
+    cache->stats.llc_hits += task->cold->pages.count - llc_misses;
+    cache->stats.refill_us += refill_us;
+    return refill_us;
+}
+
+void cache_stats_add(cache_stats_t *total, const cache_stats_t *stats) {
+    total->tlb_hits += stats->tlb_hits;
+    total->tlb_misses += stats->tlb_misses;
+    total->tlb_flushes += stats->tlb_flushes;
+    total->llc_hits += stats->llc_hits;
+    total->llc_misses += stats->llc_misses;
+    total->refill_us += stats->refill_us;
+}
+
+void cache_print_stats(FILE *out, const char *scheduler_name, const cache_config_t *config,
+                       const cache_stats_t *stats) {
+    uint64_t tlb_refs = stats->tlb_hits + stats->tlb_misses;
+    uint64_t llc_refs = stats->llc_hits + stats->llc_misses;
+    fprintf(out, "%s caches: TLB %u entries %u-way%s, LLC %u pages %u-way, miss %u/%u us\n",
+            scheduler_name, config->tlb_entries, config->tlb_ways, config->asid ? " with ASIDs" : "",
+            config->llc_pages, config->llc_ways, config->tlb_miss_us, config->llc_miss_us);
+    fprintf(out, "%s TLB: hits=%llu, misses=%llu (%.2f%%), flushes=%llu\n",
+            scheduler_name,
+            (unsigned long long) stats->tlb_hits,
+            (unsigned long long) stats->tlb_misses,
+            tlb_refs ? 100.0 * (double) stats->tlb_misses / (double) tlb_refs : 0.0,
+            (unsigned long long) stats->tlb_flushes);
+    fprintf(out, "%s LLC: hits=%llu, misses=%llu (%.2f%%), refill time=%.3fs\n",
+            scheduler_name,
+            (unsigned long long) stats->llc_hits,
+            (unsigned long long) stats->llc_misses,
+            llc_refs ? 100.0 * (double) stats->llc_misses / (double) llc_refs : 0.0,
+            stats->refill_us / 1e6);
+}
@@ -0,0 +1,107 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+
+/*
+ * Per-CPU TLB and last-level cache model.
+ *
+ * Every simulated CPU has a set-associative TLB and a set-associative LLC, both
+ * tracked at page granularity and tagged with the pid, with LRU replacement inside
+ * a set. When a task is put on a CPU it references the pages of its burst: a TLB
+ * miss costs a page walk and an LLC miss costs the refill of the page's lines.
+ * The refill time is consumed on the CPU before the task makes progress, so it
+ * extends the burst.
+ *
+ * Without ASIDs the TLB is flushed on every context switch. The LLC is never
+ * flushed, other tasks evict the lines of a task while it is off the CPU, and a
+ * task that migrates finds its footprint on the CPU it left.
+ */
+
+// Define the cache model configuration
+typedef struct {
+    uint32_t tlb_entries;       // TLB size in entries (0 disables the model)
+    uint32_t tlb_ways;          // TLB associativity
+    uint32_t llc_pages;         // LLC size in pages
+    uint32_t llc_ways;          // LLC associativity
+    uint32_t tlb_miss_us;       // Page walk time of a TLB miss
+    uint32_t llc_miss_us;       // Refill time of a page that is not in the LLC
+    uint32_t asid;              // Non-zero if TLB entries are tagged and survive context switches
+} cache_config_t;
+
+// Define the cache counters of a CPU
+typedef struct {
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+    uint64_t tlb_flushes;
+    uint64_t llc_hits;
+    uint64_t llc_misses;
+    uint64_t refill_us;         // Time spent on misses
+} cache_stats_t;
+
+// Define a set-associative array of page tags
+typedef struct {
+    uint32_t sets;
+    uint32_t ways;
+    uint64_t *tags;             // sets * ways tags (pid << 32 | page), CACHE_INVALID if empty
+    uint32_t *stamps;           // Last use of every way, for LRU
+    uint32_t clock;
+} cache_array_t;
+
+// Define the caches of a CPU
+typedef struct {
+    cache_config_t config;
+    cache_array_t tlb;
+    cache_array_t llc;
+    int32_t last_pid;           // PID whose translations are in the TLB (without ASIDs)
+    cache_stats_t stats;
+} cache_t;
+
+/**
+ * @brief Parse a configuration like "64,4,4096,16" or "64,4,4096,16,50,200,ASID"
+ *
+ * The fields are: TLB entries, TLB ways, LLC pages, LLC ways, TLB miss time in us,
+ * LLC miss time in us and, optionally, ASID to keep the TLB across context switches.
+ *
+ * @param spec The configuration string
+ * @param config Where to store the configuration
+ * @return 0 on success, -1 if the configuration is invalid
+ */
+int cache_parse_config(const char *spec, cache_config_t *config);
+
+/**
+ * @brief Create the caches of a CPU
+ *
+ * @return The caches, or NULL on failure
+ */
+cache_t *cache_create(const cache_config_t *config);
+
+/**
+ * @brief Free the caches of a CPU
+ */
+void cache_destroy(cache_t *cache);
+
+/**
+ * @brief Reference the pages of the current burst of a task being put on the CPU
+ *
+ * @param cache The caches of the CPU
+ * @param task The task being dispatched
+ * @return The refill time of the misses in microseconds
+ */
+uint32_t cache_dispatch(cache_t *cache, const pcb_t *task);
+
+/**
+ * @brief Add the counters of one CPU to a total
+ */
+void cache_stats_add(cache_stats_t *total, const cache_stats_t *stats);
+
+/**
+ * @brief Print the configuration and the counters
+ */
+void cache_print_stats(FILE *out, const char *scheduler_name, const cache_config_t *config,
+                       const cache_stats_t *stats);
+
+#endif //CACHE_H
@@ -0,0 +1,561 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msg.h"
+#include "scheduler.h"
+#include "sim.h"
+
+#define MAX_WORKLOAD_FILES 64
+#define MAX_SCHEDULERS 32
+#define SOCKET_WAIT_S 5.0           // How long ossim may take to create its socket
+
+/*
+ * Run like: ./calibrate [-c cpus] [-T tick_us] [-X all|core,...] [-r runs]
+ *                       -w <burst-file.csv> [-w <burst-file.csv> ...] <scheduler>[:params] ...
+ *
+ * Tells how far the simulated numbers (dados.txt, compare) can be trusted. For
+ * every scheduler the workload is simulated offline, like compare does, and then
+ * run for real: ossim is started in real-process mode (-X) and every burst file is
+ * run by app-io -X, which spins during its CPU bursts and sleeps in read during its
+ * blocks, while ossim stops and continues it. The real processes are measured with
+ * getrusage (through wait4) and, where perf_event_paranoid allows it, with
+ * perf_event_open (context switches and cycles). The report gives, per process,
+ * the predicted and the measured elapsed, CPU and waiting times with their error,
+ * and per scheduler the mean and the worst error. With -r, the measurements are
+ * averaged over several runs.
+ *
+ * scheduler and app-io are taken from the directory of calibrate. A real run takes
+ * as long as the workload, and no other ossim may be listening on SOCKET_PATH.
+ */
+
+// Define the perf counters of a process (-1 if not counted)
+typedef struct {
+    int switches_fd;
+    int cycles_fd;
+} perf_counters_t;
+
+// Define what was measured for a process, summed over the runs
+typedef struct {
+    double elapsed_s;           // Measured by app-io, from its connection to its last DONE
+    double cpu_s;               // User and system time (wait4)
+    uint64_t voluntary;         // Voluntary context switches (wait4)
+    uint64_t involuntary;       // Involuntary context switches (wait4)
+    uint64_t switches;          // Context switches (perf)
+    uint64_t cycles;            // Cycles (perf)
+    uint32_t runs;              // Runs in which the process finished
+} measured_t;
+
+// Define the real runs of a scheduler
+typedef struct {
+    measured_t *procs;          // One per process of the workload
+    double makespan_s;          // From the start of the applications to the exit of the last one, summed
+    double ossim_cpu_s;         // CPU time used by ossim itself, summed
+    uint32_t runs;              // Runs in which every process finished
+} real_result_t;
+
+// Define how the real runs are started
+typedef struct {
+    char scheduler_path[PATH_MAX];
+    char app_path[PATH_MAX];
+    char ncpus[16];
+    char tick_us[16];
+    const char *cores;
+} real_config_t;
+
+// What perf_event_open may count on this host, found on the first process
+static int perf_switches = 1;
+static int perf_cycles = 1;
+static int perf_user_cycles = 0;    // Cycles counted in user mode only (perf_event_paranoid >= 2)
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+static double timeval_s(const struct timeval *tv) {
+    return (double) tv->tv_sec + (double) tv->tv_usec / 1e6;
+}
+
+/**
+ * @brief Count an event of a process that has not called exec yet, from its exec on
+ */
+static int perf_open(pid_t pid, uint32_t type, uint64_t config, int user_only) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = user_only ? 1 : 0;
+    return (int) syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * @brief Open the counters of a process, giving up on a counter for good the first time it is refused
+ *
+ * Context switches happen in the kernel, so they are only counted with the kernel
+ * included; cycles fall back to user mode only.
+ */
+static void perf_attach(pid_t pid, perf_counters_t *counters) {
+    counters->switches_fd = -1;
+    counters->cycles_fd = -1;
+    if (perf_switches) {
+        counters->switches_fd = perf_open(pid, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 0);
+        if (counters->switches_fd < 0) {
+            fprintf(stderr, "perf_event_open: context switches: %s (not counted, see /proc/sys/kernel/perf_event_paranoid)\n",
+                    strerror(errno));
+            perf_switches = 0;
+        }
+    }
+    if (perf_cycles) {
+        counters->cycles_fd = perf_open(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, perf_user_cycles);
+        if (counters->cycles_fd < 0 && !perf_user_cycles && (errno == EACCES || errno == EPERM)) {
+            perf_user_cycles = 1;
+            counters->cycles_fd = perf_open(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1);
+        }
+        if (counters->cycles_fd < 0) {
+            fprintf(stderr, "perf_event_open: cycles: %s (not counted)\n", strerror(errno));
+            perf_cycles = 0;
+        }
+    }
+}
+
+static uint64_t perf_read(int fd) {
+    uint64_t value = 0;
+    if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) value = 0;
+    return value;
+}
+
+static void perf_close(perf_counters_t *counters) {
+    if (counters->switches_fd >= 0) close(counters->switches_fd);
+    if (counters->cycles_fd >= 0) close(counters->cycles_fd);
+    counters->switches_fd = -1;
+    counters->cycles_fd = -1;
+}
+
+/**
+ * @brief Fork and exec a program, with its standard output on out_fd
+ *
+ * If go is not NULL, the child waits until the write end of that pipe is closed
+ * before calling exec, so that it can be measured from its first instruction.
+ */
+static pid_t launch(char *const argv[], const int go[2], int out_fd) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (go) {
+            char c;
+            close(go[1]);
+            while (read(go[0], &c, 1) < 0 && errno == EINTR) {}
+            close(go[0]);
+        }
+        if (out_fd >= 0) {
+            dup2(out_fd, STDOUT_FILENO);
+            close(out_fd);
+        }
+        execv(argv[0], argv);
+        perror("execv");
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * @brief Wait until ossim listens, or fails
+ */
+static int wait_for_ossim(pid_t ossim) {
+    const struct timespec pause = {.tv_sec = 0, .tv_nsec = 10 * NS_PER_MS};
+    double deadline = monotonic_s() + SOCKET_WAIT_S;
+    struct stat st;
+    while (stat(SOCKET_PATH, &st) < 0) {
+        if (waitpid(ossim, NULL, WNOHANG) == ossim) {
+            fprintf(stderr, "ossim exited before listening\n");
+            return -1;
+        }
+        if (monotonic_s() > deadline) {
+            fprintf(stderr, "ossim did not create %s in %.0f s\n", SOCKET_PATH, SOCKET_WAIT_S);
+            return -1;
+        }
+        nanosleep(&pause, NULL);
+    }
+    // The socket file is created by bind, listen follows right away
+    nanosleep(&pause, NULL);
+    return 0;
+}
+
+/**
+ * @brief Read what an application printed and take its measured elapsed time
+ *
+ * @return 0 if app-io printed its measured times, -1 otherwise
+ */
+static int read_measured(int fd, double *elapsed_s) {
+    char buf[4096];
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(buf) - 1 && (n = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) len += (size_t) n;
+    buf[len] = '\0';
+    const char *line = strstr(buf, "measured: Elapsed: ");
+    if (!line || sscanf(line, "measured: Elapsed: %lf", elapsed_s) != 1) return -1;
+    return 0;
+}
+
+/**
+ * @brief Run the workload once for real with a scheduler and add the measurements to result
+ *
+ * @return 0 if every process finished and was measured, -1 otherwise
+ */
+static int run_real(const real_config_t *config, const char *scheduler, char *const files[], uint32_t num_files,
+                    real_result_t *result) {
+    char *ossim_argv[] = {(char *) config->scheduler_path, "-c", (char *) config->ncpus, "-T", (char *) config->tick_us,
+                          "-X", (char *) config->cores, (char *) scheduler, NULL};
+    int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devnull < 0) {
+        perror("open: /dev/null");
+        return -1;
+    }
+    unlink(SOCKET_PATH);
+    pid_t ossim = launch(ossim_argv, NULL, devnull);
+    close(devnull);
+    if (ossim < 0) return -1;
+    if (wait_for_ossim(ossim) < 0) {
+        kill(ossim, SIGKILL);
+        waitpid(ossim, NULL, 0);
+        return -1;
+    }
+
+    pid_t pids[MAX_WORKLOAD_FILES];
+    int out_fds[MAX_WORKLOAD_FILES];
+    perf_counters_t counters[MAX_WORKLOAD_FILES];
+    int go[2];
+    if (pipe2(go, O_CLOEXEC) < 0) {
+        perror("pipe");
+        kill(ossim, SIGINT);
+        waitpid(ossim, NULL, 0);
+        return -1;
+    }
+    uint32_t started = 0;
+    for (; started < num_files; started++) {
+        int out[2];
+        if (pipe2(out, O_CLOEXEC) < 0) {
+            perror("pipe");
+            break;
+        }
+        char *app_argv[] = {(char *) config->app_path, "-X", files[started], NULL};
+        pids[started] = launch(app_argv, go, out[1]);
+        close(out[1]);
+        if (pids[started] < 0) {
+            close(out[0]);
+            break;
+        }
+        out_fds[started] = out[0];
+        perf_attach(pids[started], &counters[started]);
+    }
+    // Every application starts now, like the run_appsio scripts
+    close(go[0]);
+    close(go[1]);
+    double start_s = monotonic_s();
+
+    int status = started == num_files ? 0 : -1;
+    double last_exit_s = start_s;
+    double measured_s[MAX_WORKLOAD_FILES];
+    struct rusage usage[MAX_WORKLOAD_FILES];
+    int finished[MAX_WORKLOAD_FILES] = {0};
+    for (uint32_t reaped = 0; reaped < started;) {
+        struct rusage ru;
+        int wstatus;
+        pid_t pid = wait4(-1, &wstatus, 0, &ru);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            perror("wait4");
+            status = -1;
+            break;
+        }
+        if (pid == ossim) {
+            // The applications see the connection close and exit
+            fprintf(stderr, "ossim exited during the run of %s\n", scheduler);
+            ossim = -1;
+            status = -1;
+            continue;
+        }
+        for (uint32_t i = 0; i < started; i++) {
+            if (pids[i] != pid) continue;
+            reaped++;
+            last_exit_s = monotonic_s();
+            usage[i] = ru;
+            finished[i] = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0 &&
+                          read_measured(out_fds[i], &measured_s[i]) == 0;
+            if (!finished[i]) {
+                fprintf(stderr, "%s did not finish with %s\n", files[i], scheduler);
+                status = -1;
+            }
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < started; i++) {
+        if (finished[i]) {
+            measured_t *m = &result->procs[i];
+            m->elapsed_s += measured_s[i];
+            m->cpu_s += timeval_s(&usage[i].ru_utime) + timeval_s(&usage[i].ru_stime);
+            m->voluntary += (uint64_t) usage[i].ru_nvcsw;
+            m->involuntary += (uint64_t) usage[i].ru_nivcsw;
+            m->switches += perf_read(counters[i].switches_fd);
+            m->cycles += perf_read(counters[i].cycles_fd);
+            m->runs++;
+        }
+        perf_close(&counters[i]);
+        close(out_fds[i]);
+    }
+    if (ossim > 0) {
+        struct rusage ru;
+        kill(ossim, SIGINT);
+        if (wait4(ossim, NULL, 0, &ru) == ossim) {
+            result->ossim_cpu_s += timeval_s(&ru.ru_utime) + timeval_s(&ru.ru_stime);
+        }
+    }
+    if (status == 0) {
+        result->makespan_s += last_exit_s - start_s;
+        result->runs++;
+    }
+    return status;
+}
+
+/**
+ * @brief Relative error of a prediction in percent (0 if nothing was measured)
+ */
+static double relative_error(double predicted, double measured) {
+    return measured > 0 ? 100.0 * (predicted - measured) / measured : 0.0;
+}
+
+// Define the errors of a scheduler, for the summary
+typedef struct {
+    double elapsed_mean;        // Mean absolute relative error of the elapsed times (%)
+    double elapsed_max;
+    double cpu_mean;            // Mean absolute relative error of the CPU times (%)
+    double wait_mean;           // Mean absolute error of the waiting times (s)
+    double makespan;            // Relative error of the makespan (%)
+    uint32_t measured;          // Processes measured at least once
+} errors_t;
+
+static void print_scheduler(const sim_workload_t *wl, const sim_result_t *sim, const real_result_t *real,
+                            const char *scheduler, uint32_t runs, errors_t *errors) {
+    memset(errors, 0, sizeof(errors_t));
+    printf("\n%s (%u of %u runs complete):\n", scheduler, real->runs, runs);
+    printf("%-16s %26s %26s %26s %29s %10s\n", "", "Elapsed(s)", "CPU(s)", "Waiting(s)",
+           "Context switches", "Cycles");
+    printf("%-16s %8s %8s %8s %8s %8s %8s %8s %8s %8s %9s %9s %9s %10s\n", "Process",
+           "sim", "real", "err%", "sim", "real", "err%", "sim", "real", "err", "vol", "invol", "perf",
+           perf_user_cycles ? "user GHz" : "GHz");
+    uint64_t sim_cpu_ns = 0;
+    for (uint32_t p = 0; p < wl->num_procs; p++) {
+        const sim_proc_result_t *r = &sim->procs[p];
+        const measured_t *m = &real->procs[p];
+        double elapsed = (double) (r->finish_time_ns - r->start_time_ns) / 1e9;
+        double cpu = (double) r->cpu_ns / 1e9;
+        double blocked = (double) r->blocked_ns / 1e9;
+        double wait = elapsed - cpu - blocked;
+        sim_cpu_ns += r->cpu_ns;
+        printf("%-16s %8.3f", wl->procs[p].name, elapsed);
+        if (m->runs == 0) {
+            printf(" %8s %8s %8.3f %8s %8s %8.3f\n", "-", "-", cpu, "-", "-", wait);
+            continue;
+        }
+        double real_elapsed = m->elapsed_s / m->runs;
+        double real_cpu = m->cpu_s / m->runs;
+        // The blocks are sleeps in read, their length is the one requested
+        double real_wait = real_elapsed - real_cpu - blocked;
+        double elapsed_err = relative_error(elapsed, real_elapsed);
+        double cpu_err = relative_error(cpu, real_cpu);
+        printf(" %8.3f %+8.1f %8.3f %8.3f %+8.1f %8.3f %8.3f %+8.3f %9llu %9llu", real_elapsed, elapsed_err,
+               cpu, real_cpu, cpu_err, wait, real_wait, wait - real_wait,
+               (unsigned long long) (m->voluntary / m->runs), (unsigned long long) (m->involuntary / m->runs));
+        if (perf_switches) printf(" %9llu", (unsigned long long) (m->switches / m->runs));
+        else printf(" %9s", "n/a");
+        if (perf_cycles && m->cpu_s > 0) printf(" %10.2f", (double) m->cycles / m->cpu_s / 1e9);
+        else printf(" %10s", "n/a");
+        printf("\n");
+
+        errors->elapsed_mean += elapsed_err < 0 ? -elapsed_err : elapsed_err;
+        errors->cpu_mean += cpu_err < 0 ? -cpu_err : cpu_err;
+        errors->wait_mean += wait > real_wait ? wait - real_wait : real_wait - wait;
+        if (elapsed_err > errors->elapsed_max || -elapsed_err > errors->elapsed_max) {
+            errors->elapsed_max = elapsed_err < 0 ? -elapsed_err : elapsed_err;
+        }
+        errors->measured++;
+    }
+    if (errors->measured > 0) {
+        errors->elapsed_mean /= errors->measured;
+        errors->cpu_mean /= errors->measured;
+        errors->wait_mean /= errors->measured;
+    }
+    double sim_makespan = (double) sim->end_time_ns / 1e9;
+    if (real->runs > 0) {
+        double real_makespan = real->makespan_s / real->runs;
+        errors->makespan = relative_error(sim_makespan, real_makespan);
+        printf("Makespan: %.3f s simulated, %.3f s measured (%+.1f%%); ossim used %.3f s of CPU per run\n",
+               sim_makespan, real_makespan, errors->makespan, real->ossim_cpu_s / real->runs);
+    }
+    printf("Dispatches simulated: %llu (%.3f s of CPU)\n", (unsigned long long) sim->cswitch.dispatches,
+           (double) sim_cpu_ns / 1e9);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-c cpus] [-T tick_us] [-X all|core,...] [-r runs]\n"
+           "          -w <burst-file.csv> [-w <burst-file.csv> ...] <scheduler>[:params] ...\n"
+           "-X: host cores of the simulated CPUs, passed to ossim -X (default all)\n"
+           "-r: real runs per scheduler, the measurements are averaged (default 1)\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    char *files[MAX_WORKLOAD_FILES];
+    uint32_t num_files = 0;
+    uint32_t ncpus = 1;
+    uint32_t tick_us = (uint32_t) (DEFAULT_TICK_NS / NS_PER_US);
+    uint32_t runs = 1;
+    real_config_t real_config = {.cores = "all"};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:T:X:r:w:")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (parse_uint(optarg, &ncpus) < 0) exit(EXIT_FAILURE);
+                if (ncpus > MAX_CPUS) {
+                    fprintf(stderr, "Too many CPUs: %u (max %d)\n", ncpus, MAX_CPUS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'T':
+                if (parse_uint(optarg, &tick_us) < 0) exit(EXIT_FAILURE);
+                if (tick_us < MIN_TICK_NS / NS_PER_US) {
+                    fprintf(stderr, "Tick too short: %u us (min %llu us)\n", tick_us, MIN_TICK_NS / NS_PER_US);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'X':
+                real_config.cores = optarg;
+                break;
+            case 'r':
+                if (parse_uint(optarg, &runs) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'w':
+                if (num_files == MAX_WORKLOAD_FILES) {
+                    fprintf(stderr, "Too many burst files (max %d)\n", MAX_WORKLOAD_FILES);
+                    exit(EXIT_FAILURE);
+                }
+                files[num_files++] = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    uint32_t num_schedulers = (uint32_t) (argc - optind);
+    if (num_files == 0 || num_schedulers == 0 || num_schedulers > MAX_SCHEDULERS) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // scheduler and app-io are built next to calibrate
+    const char *slash = strrchr(argv[0], '/');
+    int dir_len = slash ? (int) (slash - argv[0]) : 1;
+    const char *dir = slash ? argv[0] : ".";
+    snprintf(real_config.scheduler_path, sizeof(real_config.scheduler_path), "%.*s/scheduler", dir_len, dir);
+    snprintf(real_config.app_path, sizeof(real_config.app_path), "%.*s/app-io", dir_len, dir);
+    if (access(real_config.scheduler_path, X_OK) < 0 || access(real_config.app_path, X_OK) < 0) {
+        fprintf(stderr, "%s and %s must be built next to calibrate\n", real_config.scheduler_path, real_config.app_path);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(real_config.ncpus, sizeof(real_config.ncpus), "%u", ncpus);
+    snprintf(real_config.tick_us, sizeof(real_config.tick_us), "%u", tick_us);
+
+    sim_workload_t wl;
+    if (sim_load_workload(&wl, files, num_files) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    printf("Workload:");
+    for (uint32_t p = 0; p < wl.num_procs; p++) {
+        printf(" %s", wl.procs[p].name);
+    }
+    printf(" (%u processes, %u CPU(s), host cores %s, %u run(s) per scheduler)\n", wl.num_procs, ncpus,
+           real_config.cores, runs);
+
+    errors_t errors[MAX_SCHEDULERS];
+    int complete[MAX_SCHEDULERS] = {0};
+    int status = EXIT_SUCCESS;
+    for (uint32_t i = 0; i < num_schedulers; i++) {
+        const char *scheduler = argv[optind + i];
+        sim_config_t config = {
+            .scheduler = scheduler,
+            .ncpus = ncpus,
+            .tick_ns = (uint64_t) tick_us * NS_PER_US,
+            .cswitch = {.switch_cost_us = 0, .migration_cost_us = 0},
+        };
+        sim_result_t sim;
+        if (sim_run(&wl, &config, &sim) < 0) {
+            fprintf(stderr, "Simulation with %s failed\n", scheduler);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        real_result_t real = {.procs = calloc(wl.num_procs, sizeof(measured_t))};
+        if (!real.procs) {
+            perror("calloc");
+            sim_free_result(&sim);
+            status = EXIT_FAILURE;
+            break;
+        }
+        for (uint32_t run = 0; run < runs; run++) {
+            fprintf(stderr, "%s: run %u/%u\n", scheduler, run + 1, runs);
+            if (run_real(&real_config, scheduler, files, num_files, &real) < 0) status = EXIT_FAILURE;
+        }
+        print_scheduler(&wl, &sim, &real, scheduler, runs, &errors[i]);
+        complete[i] = errors[i].measured > 0;
+        free(real.procs);
+        sim_free_result(&sim);
+    }
+    unlink(SOCKET_PATH);
+
+    printf("\nError of the simulator (prediction - measurement):\n");
+    printf("%-24s %12s %18s %18s %14s %16s\n", "Scheduler", "Makespan", "Mean |elapsed|", "Max |elapsed|",
+           "Mean |CPU|", "Mean |waiting|");
+    for (uint32_t i = 0; i < num_schedulers; i++) {
+        if (!complete[i]) {
+            printf("%-24s %12s\n", argv[optind + i], "failed");
+            continue;
+        }
+        printf("%-24s %+11.1f%% %17.1f%% %17.1f%% %13.1f%% %15.3fs\n", argv[optind + i], errors[i].makespan,
+               errors[i].elapsed_mean, errors[i].elapsed_max, errors[i].cpu_mean, errors[i].wait_mean);
+    }
+    sim_free_workload(&wl);
+    return status;
+}
@@ -0,0 +1,298 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define MAX_WORKLOAD_FILES 256
+
+/*
+ * Run like: ./compare [-j threads] [-P host_threads] [-c cpus] [-s switch_cost_us] [-m migration_cost_us]
+ *                     -w <burst-file.csv> [-w <burst-file.csv> ...] <scheduler>[:params] ...
+ *
+ * Simulates the same workload with every scheduler given on the command line, each
+ * simulation in its own worker thread, and prints a single report. A parameter sweep
+ * is just a list of schedulers, e.g. with bash: ./compare -w A-5.csv RR:{100..1000..100}
+ * With -P, every CPU of each simulation has its own run queue, and the CPUs are advanced on
+ * that many host threads.
+ */
+
+// Define one simulation to run
+typedef struct {
+    sim_config_t config;
+    sim_result_t result;
+    int status;                 // Return value of sim_run
+    double host_time_s;         // Host time the simulation took
+} job_t;
+
+// Define the work shared by the worker threads
+typedef struct {
+    const sim_workload_t *wl;
+    job_t *jobs;
+    uint32_t num_jobs;
+    atomic_uint next_job;       // Index of the next job to be taken by a worker
+} job_pool_t;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void *worker(void *arg) {
+    job_pool_t *pool = arg;
+    uint32_t i;
+    // Simulations are independent, the only shared state is the job counter
+    while ((i = atomic_fetch_add(&pool->next_job, 1)) < pool->num_jobs) {
+        job_t *job = &pool->jobs[i];
+        double start = monotonic_s();
+        job->status = sim_run(pool->wl, &job->config, &job->result);
+        job->host_time_s = monotonic_s() - start;
+    }
+    return NULL;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val < 0 || val > UINT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+static void print_report(const sim_workload_t *wl, const job_t *jobs, uint32_t num_jobs) {
+    printf("Workload:");
+    for (uint32_t p = 0; p < wl->num_procs; p++) {
+        printf(" %s", wl->procs[p].name);
+    }
+    printf(" (%u processes)\n\n", wl->num_procs);
+
+    int with_vm = num_jobs > 0 && jobs[0].config.vm != NULL;
+    int with_caches = num_jobs > 0 && jobs[0].config.caches != NULL;
+    int with_swap = num_jobs > 0 && jobs[0].config.swap != NULL;
+    printf("%-24s %5s %12s %16s %14s %10s",
+           "Scheduler", "CPUs", "Makespan(s)", "Avg elapsed(s)", "Avg wait(s)", "Switching");
+    if (with_caches) printf(" %10s", "Refill");
+    if (with_vm) printf(" %12s", "Page faults");
+    if (with_swap) printf(" %10s", "Swap outs");
+    printf("\n");
+    for (uint32_t i = 0; i < num_jobs; i++) {
+        const job_t *job = &jobs[i];
+        if (job->status != 0) {
+            printf("%-24s %5u %s\n", job->config.scheduler, job->config.ncpus, "failed");
+            continue;
+        }
+        double elapsed = 0, wait = 0;
+        for (uint32_t p = 0; p < job->result.num_procs; p++) {
+            const sim_proc_result_t *r = &job->result.procs[p];
+            uint64_t proc_elapsed = r->finish_time_ns - r->start_time_ns;
+            elapsed += (double) proc_elapsed / 1e9;
+            wait += (double) ((int64_t) (proc_elapsed - r->cpu_ns - r->blocked_ns)) / 1e9;
+        }
+        const cswitch_stats_t *cs = &job->result.cswitch;
+        uint64_t used_ns = cs->busy_ns + cs->overhead_ns + cs->refill_ns;
+        printf("%-24s %5u %12.3f %16.3f %14.3f %9.2f%%",
+               job->config.scheduler, job->config.ncpus,
+               (double) job->result.end_time_ns / 1e9,
+               elapsed / job->result.num_procs,
+               wait / job->result.num_procs,
+               used_ns ? 100.0 * (double) cs->overhead_ns / (double) used_ns : 0.0);
+        if (with_caches) {
+            printf(" %9.2f%%", used_ns ? 100.0 * (double) cs->refill_ns / (double) used_ns : 0.0);
+        }
+        if (with_vm) {
+            printf(" %12llu", (unsigned long long) job->result.vm.faults);
+        }
+        if (with_swap) {
+            printf(" %10llu", (unsigned long long) job->result.swap.swap_outs);
+        }
+        printf("\n");
+    }
+
+    for (uint32_t i = 0; i < num_jobs; i++) {
+        const job_t *job = &jobs[i];
+        if (job->status != 0) continue;
+        printf("\n%s:\n", job->config.scheduler);
+        for (uint32_t p = 0; p < job->result.num_procs; p++) {
+            const sim_proc_result_t *r = &job->result.procs[p];
+            uint64_t proc_elapsed = r->finish_time_ns - r->start_time_ns;
+            printf("%s: Elapsed=%.3fs, CPU=%.3fs, Blocked=%.3fs, Waiting=%.3fs\n",
+                   wl->procs[p].name, (double) proc_elapsed / 1e9, (double) r->cpu_ns / 1e9,
+                   (double) r->blocked_ns / 1e9, (double) ((int64_t) (proc_elapsed - r->cpu_ns - r->blocked_ns)) / 1e9);
+        }
+        fputs(job->result.stats ? job->result.stats : "", stdout);
+    }
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-j threads] [-P host_threads] [-c cpus] [-T tick_us] [-s switch_cost_us] [-m migration_cost_us]\n"
+           "          [-v frames[,FIFO|LRU|CLOCK|WS[,fault_ms[,ws_window_ms]]]]\n"
+           "          [-k tlb_entries,tlb_ways,llc_pages,llc_ways[,tlb_miss_us[,llc_miss_us[,ASID]]]]\n"
+           "          [-S LARGEST|LRU|OLDEST[,page_ms]]\n"
+           "          [-d name[,FCFS|SSTF|SCAN|C-LOOK[,servers[,seek_ms_per_1000_blocks]]] ...] [-I]\n"
+           "          -w <burst-file.csv> [-w <burst-file.csv> ...] <scheduler>[:params] ...\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    char *files[MAX_WORKLOAD_FILES];
+    uint32_t num_files = 0;
+    uint32_t num_threads = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t host_threads = 0;
+    uint32_t ncpus = 1;
+    uint32_t tick_us = (uint32_t) (DEFAULT_TICK_NS / NS_PER_US);
+    cswitch_config_t cswitch_config = {.switch_cost_us = 0, .migration_cost_us = 0};
+    vm_config_t vm_config;
+    int with_vm = 0;
+    cache_config_t cache_config;
+    int with_caches = 0;
+    swap_config_t swap_config;
+    int with_swap = 0;
+    io_device_config_t devices[IO_MAX_DEVICES];
+    uint32_t num_devices = 0;
+    int priority_inheritance = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:P:c:T:s:m:v:k:S:d:Iw:")) != -1) {
+        switch (opt) {
+            case 'j':
+                if (parse_uint(optarg, &num_threads) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'P':
+                if (parse_uint(optarg, &host_threads) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'c':
+                if (parse_uint(optarg, &ncpus) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'T':
+                if (parse_uint(optarg, &tick_us) < 0) exit(EXIT_FAILURE);
+                if (tick_us < MIN_TICK_NS / NS_PER_US) {
+                    fprintf(stderr, "Tick too short: %u us (min %llu us)\n", tick_us, MIN_TICK_NS / NS_PER_US);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 's':
+                if (parse_uint(optarg, &cswitch_config.switch_cost_us) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'm':
+                if (parse_uint(optarg, &cswitch_config.migration_cost_us) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'v':
+                if (vm_parse_config(optarg, &vm_config) < 0) exit(EXIT_FAILURE);
+                with_vm = 1;
+                break;
+            case 'k':
+                if (cache_parse_config(optarg, &cache_config) < 0) exit(EXIT_FAILURE);
+                with_caches = 1;
+                break;
+            case 'S':
+                if (swap_parse_config(optarg, &swap_config) < 0) exit(EXIT_FAILURE);
+                with_swap = 1;
+                break;
+            case 'd':
+                if (num_devices == IO_MAX_DEVICES) {
+                    fprintf(stderr, "Too many devices (max %d)\n", IO_MAX_DEVICES);
+                    exit(EXIT_FAILURE);
+                }
+                if (io_parse_device(optarg, &devices[num_devices++]) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'I':
+                priority_inheritance = 1;
+                break;
+            case 'w':
+                if (num_files == MAX_WORKLOAD_FILES) {
+                    fprintf(stderr, "Too many burst files (max %d)\n", MAX_WORKLOAD_FILES);
+                    exit(EXIT_FAILURE);
+                }
+                files[num_files++] = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (num_files == 0 || optind == argc) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (num_threads == 0) num_threads = 1;
+
+    sim_workload_t wl;
+    if (sim_load_workload(&wl, files, num_files) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    job_pool_t pool = {.wl = &wl, .num_jobs = (uint32_t) (argc - optind)};
+    atomic_init(&pool.next_job, 0);
+    pool.jobs = calloc(pool.num_jobs, sizeof(job_t));
+    if (!pool.jobs) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < pool.num_jobs; i++) {
+        pool.jobs[i].config.scheduler = argv[optind + i];
+        pool.jobs[i].config.ncpus = ncpus;
+        pool.jobs[i].config.tick_ns = tick_us * NS_PER_US;
+        pool.jobs[i].config.host_threads = host_threads;
+        pool.jobs[i].config.cswitch = cswitch_config;
+        pool.jobs[i].config.vm = with_vm ? &vm_config : NULL;
+        pool.jobs[i].config.caches = with_caches ? &cache_config : NULL;
+        pool.jobs[i].config.swap = with_swap ? &swap_config : NULL;
+        pool.jobs[i].config.devices = devices;
+        pool.jobs[i].config.num_devices = num_devices;
+        pool.jobs[i].config.priority_inheritance = priority_inheritance;
+        pool.jobs[i].status = -1;
+    }
+    if (num_threads > pool.num_jobs) num_threads = pool.num_jobs;
+
+    pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+    if (!threads) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    double start = monotonic_s();
+    uint32_t started = 0;
+    for (; started < num_threads; started++) {
+        int err = pthread_create(&threads[started], NULL, worker, &pool);
+        if (err != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            break;
+        }
+    }
+    if (started == 0) {
+        // No worker could be started, run the simulations here
+        worker(&pool);
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double total_s = monotonic_s() - start;
+
+    // Results are printed in the order of the command line, whatever order they finished in
+    print_report(&wl, pool.jobs, pool.num_jobs);
+
+    double sum_s = 0;
+    for (uint32_t i = 0; i < pool.num_jobs; i++) {
+        sum_s += pool.jobs[i].host_time_s;
+    }
+    printf("\n%u simulations on %u threads in %.3f s (%.3f s of simulation work, %.2fx)\n",
+           pool.num_jobs, started ? started : 1, total_s, sum_s, total_s > 0 ? sum_s / total_s : 0.0);
+
+    int status = EXIT_SUCCESS;
+    for (uint32_t i = 0; i < pool.num_jobs; i++) {
+        if (pool.jobs[i].status != 0) status = EXIT_FAILURE;
+        sim_free_result(&pool.jobs[i].result);
+    }
+    free(pool.jobs);
+    free(threads);
+    sim_free_workload(&wl);
+    return status;
+}
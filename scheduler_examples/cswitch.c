@@ -0,0 +1,80 @@
+#include "cswitch.h"
+
+#include <string.h>
+
+#include "msg.h"
+
+void cswitch_init(cswitch_t *cs, const cswitch_config_t *config) {
+    memset(cs, 0, sizeof(cswitch_t));
+    cs->config = *config;
+}
+
+void cswitch_dispatch(cswitch_t *cs, pcb_t *task, int32_t cpu) {
+    cs->stats.dispatches++;
+    if (task->pid != cs->last_pid) {
+        cs->pending_overhead_ns += (uint64_t) cs->config.switch_cost_us * NS_PER_US;
+        cs->last_pid = task->pid;
+    }
+    // A task that never ran has no cache footprint anywhere, so it does not migrate
+    if (task->last_cpu >= 0 && task->last_cpu != cpu) {
+        cs->pending_overhead_ns += (uint64_t) cs->config.migration_cost_us * NS_PER_US;
+        cs->stats.migrations++;
+    }
+    task->last_cpu = cpu;
+}
+
+void cswitch_charge_refill(cswitch_t *cs, uint32_t refill_us) {
+    cs->pending_refill_ns += refill_us * NS_PER_US;
+}
+
+void cswitch_release(cswitch_t *cs, int voluntary) {
+    if (voluntary) {
+        cs->stats.voluntary++;
+    } else {
+        cs->stats.involuntary++;
+    }
+}
+
+uint64_t cswitch_run_tick(cswitch_t *cs, uint64_t tick_ns) {
+    uint64_t overhead = cs->pending_overhead_ns < tick_ns ? cs->pending_overhead_ns : tick_ns;
+    cs->pending_overhead_ns -= overhead;
+    cs->stats.overhead_ns += overhead;
+    uint64_t refill = cs->pending_refill_ns;
+    if (refill > tick_ns - overhead) refill = tick_ns - overhead;
+    cs->pending_refill_ns -= refill;
+    cs->stats.refill_ns += refill;
+    cs->stats.busy_ns += tick_ns - overhead - refill;
+    return tick_ns - overhead - refill;
+}
+
+void cswitch_idle_tick(cswitch_t *cs, uint64_t tick_ns) {
+    cs->stats.idle_ns += tick_ns;
+}
+
+void cswitch_stats_add(cswitch_stats_t *total, const cswitch_stats_t *stats) {
+    total->dispatches += stats->dispatches;
+    total->voluntary += stats->voluntary;
+    total->involuntary += stats->involuntary;
+    total->migrations += stats->migrations;
+    total->busy_ns += stats->busy_ns;
+    total->overhead_ns += stats->overhead_ns;
+    total->refill_ns += stats->refill_ns;
+    total->idle_ns += stats->idle_ns;
+}
+
+void cswitch_print_stats(FILE *out, const char *scheduler_name, const cswitch_stats_t *stats) {
+    uint64_t used_ns = stats->busy_ns + stats->overhead_ns + stats->refill_ns;
+    uint64_t total_ns = used_ns + stats->idle_ns;
+    fprintf(out, "%s context switches: voluntary=%llu, involuntary=%llu, migrations=%llu\n",
+            scheduler_name,
+            (unsigned long long) stats->voluntary,
+            (unsigned long long) stats->involuntary,
+            (unsigned long long) stats->migrations);
+    fprintf(out, "%s CPU time: busy=%.3fs, switching=%.3fs, refill=%.3fs, idle=%.3fs\n",
+            scheduler_name, stats->busy_ns / 1e9, stats->overhead_ns / 1e9, stats->refill_ns / 1e9,
+            stats->idle_ns / 1e9);
+    fprintf(out, "%s CPU lost to switching: %.2f%% of used time, %.2f%% of total time\n",
+            scheduler_name,
+            used_ns ? 100.0 * (double) stats->overhead_ns / (double) used_ns : 0.0,
+            total_ns ? 100.0 * (double) stats->overhead_ns / (double) total_ns : 0.0);
+}
@@ -0,0 +1,119 @@
+#ifndef CSWITCH_H
+#define CSWITCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+
+/*
+ * Context switch cost model.
+ *
+ * Swapping the task on the CPU is not free: the kernel has to save and restore
+ * registers, and the new task starts with cold caches. The simulator models this
+ * as a fixed amount of CPU time that is consumed before the dispatched task makes
+ * progress. A task that moves to a different CPU than the one it last ran on pays
+ * an extra migration cost on top of the switch cost.
+ */
+
+// Define the cost model configuration (all values in microseconds, a real switch costs a few)
+typedef struct {
+    uint32_t switch_cost_us;        // CPU time lost on every context switch
+    uint32_t migration_cost_us;     // Extra CPU time lost when a task changes CPU
+} cswitch_config_t;
+
+// Define the context switch counters
+typedef struct {
+    uint64_t dispatches;            // Tasks put on the CPU
+    uint64_t voluntary;             // Task left the CPU on its own (burst finished)
+    uint64_t involuntary;           // Task was preempted (time slice expired)
+    uint64_t migrations;            // Task was dispatched on a different CPU
+    uint64_t busy_ns;               // CPU time used by tasks
+    uint64_t overhead_ns;           // CPU time lost switching
+    uint64_t refill_ns;             // CPU time lost refilling the TLB and caches (see cache.h)
+    uint64_t idle_ns;               // CPU time with nothing to run
+} cswitch_stats_t;
+
+// Define the switch state of a single CPU
+typedef struct {
+    cswitch_config_t config;
+    cswitch_stats_t stats;
+    uint64_t pending_overhead_ns;   // Switch overhead still to be paid by the running task
+    uint64_t pending_refill_ns;     // Cache refill time still to be paid by the running task
+    int32_t last_pid;               // PID of the last task that ran on the CPU (0 if none)
+} cswitch_t;
+
+/**
+ * @brief Initialize the switch state of a CPU
+ *
+ * @param cs The switch state to initialize
+ * @param config The switch and migration costs
+ */
+void cswitch_init(cswitch_t *cs, const cswitch_config_t *config);
+
+/**
+ * @brief Account for a task being put on the CPU
+ *
+ * If the task is not the one that last ran on the CPU, the switch cost is charged,
+ * plus the migration cost if the task last ran on another CPU.
+ *
+ * @param cs The switch state of the CPU
+ * @param task The task being dispatched
+ * @param cpu The CPU the task is dispatched on
+ */
+void cswitch_dispatch(cswitch_t *cs, pcb_t *task, int32_t cpu);
+
+/**
+ * @brief Charge cache refill time to the task that was just dispatched
+ *
+ * @param cs The switch state of the CPU
+ * @param refill_us The refill time in microseconds
+ */
+void cswitch_charge_refill(cswitch_t *cs, uint32_t refill_us);
+
+/**
+ * @brief Account for a task leaving the CPU
+ *
+ * @param cs The switch state of the CPU
+ * @param voluntary Non-zero if the task finished its burst, zero if it was preempted
+ */
+void cswitch_release(cswitch_t *cs, int voluntary);
+
+/**
+ * @brief Account for one tick with a task on the CPU
+ *
+ * Pending switch overhead is consumed first, then pending refill time (what does
+ * not fit is carried over), the rest of the tick goes to the task.
+ *
+ * @param cs The switch state of the CPU
+ * @param tick_ns The length of the tick
+ * @return The time in nanoseconds of this tick that the running task made progress
+ */
+uint64_t cswitch_run_tick(cswitch_t *cs, uint64_t tick_ns);
+
+/**
+ * @brief Account for one tick without a task on the CPU
+ *
+ * @param cs The switch state of the CPU
+ * @param tick_ns The length of the tick
+ */
+void cswitch_idle_tick(cswitch_t *cs, uint64_t tick_ns);
+
+/**
+ * @brief Add the counters of one CPU to a total
+ *
+ * @param total The counters to add to
+ * @param stats The counters to be added
+ */
+void cswitch_stats_add(cswitch_stats_t *total, const cswitch_stats_t *stats);
+
+/**
+ * @brief Print the counters and the fraction of CPU lost to switching
+ *
+ * @param out The stream to print to
+ * @param scheduler_name The name of the scheduler the counters belong to
+ * @param stats The counters to print
+ */
+void cswitch_print_stats(FILE *out, const char *scheduler_name, const cswitch_stats_t *stats);
+
+#endif //CSWITCH_H
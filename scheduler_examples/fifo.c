@@ -4,41 +4,58 @@
 #include <stdlib.h>
 
 #include "msg.h"
-#include <unistd.h>
+
+// FIFO only needs a single ready queue
+typedef struct {
+    pcb_ring_t rq;
+} fifo_t;
+
+static void *fifo_init(const char *params) {
+    (void) params;
+    return calloc(1, sizeof(fifo_t));
+}
+
+static void fifo_destroy(void *state) {
+    fifo_t *fifo = state;
+    ring_free(&fifo->rq);
+    free(fifo);
+}
+
+static void fifo_enqueue(void *state, pcb_t *task, sched_enqueue_reason_en reason, uint64_t current_time_ns) {
+    (void) reason;
+    (void) current_time_ns;
+    fifo_t *fifo = state;
+    ring_push(&fifo->rq, task);
+}
+
+static int fifo_remove(void *state, pcb_t *task) {
+    fifo_t *fifo = state;
+    return ring_remove(&fifo->rq, task);
+}
 
 /**
  * @brief First-In-First-Out (FIFO) scheduling algorithm.
  *
- * This function implements the FIFO scheduling algorithm. If the CPU is not idle it
- * checks if the application is ready and frees the CPU.
- * If the CPU is idle, it selects the next task to run based on the order they were added
+ * This function implements the FIFO scheduling algorithm. It is only called when a CPU
+ * is idle, and selects the next task to run based on the order they were added
  * to the ready queue. The task that has been in the queue the longest is selected to run next.
+ * A task runs until its burst is finished, it is never preempted.
  *
- * @param current_time_ms The current time in milliseconds.
- * @param rq Pointer to the ready queue containing tasks that are ready to run.
- * @param cpu_task Double pointer to the currently running task. This will be updated
- *                 to point to the next task to run.
+ * @param state The FIFO instance
+ * @param current_time_ns The current time in nanoseconds.
+ * @return The next task to run, or NULL if the ready queue is empty.
  */
-void fifo_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task) {
-    if (*cpu_task) {
-        (*cpu_task)->ellapsed_time_ms += TICKS_MS;      // Add to the running time of the application/task
-        if ((*cpu_task)->ellapsed_time_ms >= (*cpu_task)->time_ms) {
-            // Task finished
-            // Send msg to application
-            msg_t msg = {
-                .pid = (*cpu_task)->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write((*cpu_task)->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
-            }
-            // Application finished and can be removed (this is FIFO after all)
-            free((*cpu_task));
-            (*cpu_task) = NULL;
-        }
-    }
-    if (*cpu_task == NULL) {            // If CPU is idle
-        *cpu_task = dequeue_pcb(rq);   // Get next task from ready queue (dequeue from head)
-    }
-}
\ No newline at end of file
+static pcb_t *fifo_pick_next(void *state, uint64_t current_time_ns) {
+    (void) current_time_ns;
+    fifo_t *fifo = state;
+    return ring_pop(&fifo->rq);     // Get next task from ready queue (dequeue from head)
+}
+
+const scheduler_ops_t fifo_ops = {
+    .name = "FIFO",
+    .init = fifo_init,
+    .destroy = fifo_destroy,
+    .enqueue = fifo_enqueue,
+    .pick_next = fifo_pick_next,
+    .remove = fifo_remove,
+};
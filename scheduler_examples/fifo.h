@@ -2,10 +2,11 @@
 #define FIFO_H
 
 #include "queue.h"
+#include "scheduler.h"
 
-void fifo_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task);
-void sjf_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task);
-void rr_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task);
-void mlfq_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task, queue_t *command_queue);
+extern const scheduler_ops_t fifo_ops;
+extern const scheduler_ops_t sjf_ops;
+extern const scheduler_ops_t rr_ops;
+extern const scheduler_ops_t mlfq_ops;
 
 #endif // FIFO_H
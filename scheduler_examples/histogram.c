@@ -0,0 +1,48 @@
+#include "histogram.h"
+
+#include <string.h>
+
+static uint32_t bucket_index(uint64_t value) {
+    if (value < 2 * HISTOGRAM_HALF) return (uint32_t) value;
+    // Shift that brings the value in [HALF, 2*HALF)
+    uint32_t shift = 63 - (uint32_t) __builtin_clzll(value) - (HISTOGRAM_SUB_BITS - 1);
+    return HISTOGRAM_HALF * shift + (uint32_t) (value >> shift);
+}
+
+static uint64_t bucket_highest(uint32_t index) {
+    if (index < 2 * HISTOGRAM_HALF) return index;
+    uint32_t shift = index / HISTOGRAM_HALF - 1;
+    uint64_t sub = index % HISTOGRAM_HALF + HISTOGRAM_HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+void histogram_reset(histogram_t *h) {
+    memset(h, 0, sizeof(histogram_t));
+}
+
+void histogram_record(histogram_t *h, uint64_t value) {
+    h->counts[bucket_index(value)]++;
+    if (h->total == 0 || value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+    h->total++;
+    h->sum += value;
+}
+
+uint64_t histogram_percentile(const histogram_t *h, double percentile) {
+    if (h->total == 0) return 0;
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) h->total + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t value = bucket_highest(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+double histogram_mean(const histogram_t *h) {
+    return h->total ? (double) h->sum / (double) h->total : 0.0;
+}
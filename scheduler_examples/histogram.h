@@ -0,0 +1,52 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Log-linear histogram, in the style of HdrHistogram.
+ *
+ * Values below 32 have a bucket each. Above, every power of two is split into 16
+ * buckets, so a value is kept with a relative error below 1/16 (6.25%) over the
+ * whole 64-bit range, in a fixed array. Recording a value is a few instructions
+ * and never allocates, so it can be done on every tick.
+ */
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_HALF (1u << (HISTOGRAM_SUB_BITS - 1))
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_HALF)
+
+// Define a histogram
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;             // Values recorded
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} histogram_t;
+
+/**
+ * @brief Empty a histogram
+ */
+void histogram_reset(histogram_t *h);
+
+/**
+ * @brief Record a value
+ */
+void histogram_record(histogram_t *h, uint64_t value);
+
+/**
+ * @brief Get the value below which a share of the recorded values fall
+ *
+ * @param h The histogram
+ * @param percentile From 0 to 100
+ * @return The highest value of the bucket holding the percentile (0 if the histogram is empty)
+ */
+uint64_t histogram_percentile(const histogram_t *h, double percentile);
+
+/**
+ * @brief Get the mean of the recorded values (0 if the histogram is empty)
+ */
+double histogram_mean(const histogram_t *h);
+
+#endif //HISTOGRAM_H
@@ -0,0 +1,210 @@
+#include "io.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int io_parse_device(const char *spec, io_device_config_t *config) {
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    memset(config, 0, sizeof(io_device_config_t));
+    config->policy = IO_POLICY_FCFS;
+    config->servers = 1;
+    config->seek_ms_per_1k = 1;
+
+    int status = 0;
+    char *endptr;
+    char *token = strtok(copy, ",");
+    if (!token || strlen(token) >= sizeof(config->name)) {
+        status = -1;
+    } else {
+        strcpy(config->name, token);
+    }
+    token = strtok(NULL, ",");
+    if (status == 0 && token) {
+        status = -1;
+        for (int i = 0; i < (int) (sizeof(IO_POLICY_STRINGS) / sizeof(IO_POLICY_STRINGS[0])); i++) {
+            if (strcmp(token, IO_POLICY_STRINGS[i]) == 0) {
+                config->policy = (io_policy_en) i;
+                status = 0;
+            }
+        }
+        token = strtok(NULL, ",");
+    }
+    if (status == 0 && token) {
+        long value = strtol(token, &endptr, 10);
+        if (*endptr != '\0' || value <= 0 || value > 1024) {
+            status = -1;
+        } else {
+            config->servers = (uint32_t) value;
+        }
+        token = strtok(NULL, ",");
+    }
+    if (status == 0 && token) {
+        long value = strtol(token, &endptr, 10);
+        if (*endptr != '\0' || value < 0 || value > INT32_MAX) {
+            status = -1;
+        } else {
+            config->seek_ms_per_1k = (uint32_t) value;
+        }
+        token = strtok(NULL, ",");
+    }
+    if (token) status = -1;
+    if (status < 0) {
+        fprintf(stderr, "Invalid device: %s (expected name[,FCFS|SSTF|SCAN|C-LOOK[,servers[,seek_ms_per_1000_blocks]]])\n",
+                spec);
+    }
+    free(copy);
+    return status;
+}
+
+int io_init(io_t *io, const io_device_config_t *configs, uint32_t num_devices) {
+    memset(io, 0, sizeof(io_t));
+    if (num_devices > IO_MAX_DEVICES) {
+        fprintf(stderr, "Too many devices (max %d)\n", IO_MAX_DEVICES);
+        return -1;
+    }
+    for (uint32_t i = 0; i < num_devices; i++) {
+        io_device_t *dev = &io->devices[i];
+        dev->config = configs[i];
+        dev->direction = 1;
+        dev->in_service = calloc(configs[i].servers, sizeof(pcb_t *));
+        if (!dev->in_service) {
+            io_free(io);
+            return -1;
+        }
+        io->num_devices++;
+    }
+    return 0;
+}
+
+void io_free(io_t *io) {
+    for (uint32_t i = 0; i < io->num_devices; i++) {
+        while (dequeue_pcb(&io->devices[i].queue) != NULL) { }
+        free(io->devices[i].in_service);
+    }
+    io->num_devices = 0;
+}
+
+int io_submit(io_t *io, pcb_t *task, uint64_t current_time_ns) {
+    if (task->cold->io_device >= io->num_devices) return -1;
+    io_device_t *dev = &io->devices[task->cold->io_device];
+    task->cold->io_queued_ns = current_time_ns;
+    enqueue_pcb(&dev->queue, task);
+    dev->queue_len++;
+    if (dev->queue_len > dev->stats.max_queue_len) {
+        dev->stats.max_queue_len = dev->queue_len;
+    }
+    return 0;
+}
+
+// Requests without a block address do not move the head
+static uint32_t request_block(const io_device_t *dev, const pcb_t *task) {
+    return task->cold->io_block == BLOCK_ADDRESS_NONE ? dev->head : task->cold->io_block;
+}
+
+static uint32_t seek_distance(const io_device_t *dev, const pcb_t *task) {
+    uint32_t block = request_block(dev, task);
+    return block > dev->head ? block - dev->head : dev->head - block;
+}
+
+/**
+ * @brief Choose the next request to serve with the disk scheduling policy of the device
+ */
+static pcb_t *choose_request(io_device_t *dev) {
+    queue_elem_t *head = dev->queue.head;
+    if (!head || dev->config.policy == IO_POLICY_FCFS) {
+        return head ? head->pcb : NULL;
+    }
+    pcb_t *best = NULL;
+    if (dev->config.policy == IO_POLICY_SSTF) {
+        for (queue_elem_t *elem = head; elem != NULL; elem = elem->next) {
+            if (!best || seek_distance(dev, elem->pcb) < seek_distance(dev, best)) best = elem->pcb;
+        }
+        return best;
+    }
+    // SCAN and C-LOOK: the nearest request ahead of the head
+    int up = dev->config.policy == IO_POLICY_CLOOK || dev->direction > 0;
+    for (queue_elem_t *elem = head; elem != NULL; elem = elem->next) {
+        uint32_t block = request_block(dev, elem->pcb);
+        int ahead = up ? block >= dev->head : block <= dev->head;
+        if (ahead && (!best || seek_distance(dev, elem->pcb) < seek_distance(dev, best))) best = elem->pcb;
+    }
+    if (best) return best;
+    if (dev->config.policy == IO_POLICY_SCAN) {
+        // Nothing ahead, the elevator turns around
+        dev->direction = -dev->direction;
+        return choose_request(dev);
+    }
+    // C-LOOK jumps back to the lowest request and sweeps up again
+    for (queue_elem_t *elem = head; elem != NULL; elem = elem->next) {
+        if (!best || request_block(dev, elem->pcb) < request_block(dev, best)) best = elem->pcb;
+    }
+    return best;
+}
+
+static void start_request(io_t *io, uint32_t dev_id, uint32_t server, pcb_t *task, uint64_t current_time_ns) {
+    io_device_t *dev = &io->devices[dev_id];
+    remove_pcb(&dev->queue, task);
+    dev->queue_len--;
+
+    uint64_t seek_ns = (uint64_t) seek_distance(dev, task) * dev->config.seek_ms_per_1k * NS_PER_MS / 1000;
+    uint64_t queue_ns = current_time_ns - task->cold->io_queued_ns;
+    dev->head = request_block(dev, task);
+    dev->in_service[server] = task;
+    task->wait_until_ns = current_time_ns + task->time_ns + seek_ns;
+
+    dev->stats.busy_ns += task->time_ns + seek_ns;
+    dev->stats.seek_ns += seek_ns;
+    dev->stats.queue_ns += queue_ns;
+    if (queue_ns > dev->stats.max_queue_ns) {
+        dev->stats.max_queue_ns = queue_ns;
+    }
+    trace_event(io->trace, current_time_ns, TRACE_IO_START, TRACE_NO_CPU, task->pid, dev_id);
+}
+
+void io_tick(io_t *io, uint64_t current_time_ns, io_done_fn done, void *ctx) {
+    for (uint32_t d = 0; d < io->num_devices; d++) {
+        io_device_t *dev = &io->devices[d];
+        for (uint32_t s = 0; s < dev->config.servers; s++) {
+            pcb_t *task = dev->in_service[s];
+            if (task && task->wait_until_ns <= current_time_ns) {
+                dev->in_service[s] = NULL;
+                dev->stats.requests++;
+                done(ctx, task, current_time_ns);
+            }
+            if (!dev->in_service[s]) {
+                pcb_t *next = choose_request(dev);
+                if (next) start_request(io, d, s, next, current_time_ns);
+            }
+        }
+    }
+}
+
+uint32_t io_num_blocked(const io_t *io) {
+    uint32_t blocked = 0;
+    for (uint32_t d = 0; d < io->num_devices; d++) {
+        const io_device_t *dev = &io->devices[d];
+        blocked += dev->queue_len;
+        for (uint32_t i = 0; i < dev->config.servers; i++) {
+            if (dev->in_service[i]) blocked++;
+        }
+    }
+    return blocked;
+}
+
+void io_print_stats(const io_t *io, FILE *out, uint64_t elapsed_ns) {
+    for (uint32_t d = 0; d < io->num_devices; d++) {
+        const io_device_t *dev = &io->devices[d];
+        const io_stats_t *stats = &dev->stats;
+        uint64_t capacity_ns = elapsed_ns * dev->config.servers;
+        fprintf(out, "Device %u (%s, %s, %u server(s)): requests=%llu, utilization=%.2f%%, seek=%.3fs\n",
+                d, dev->config.name, IO_POLICY_STRINGS[dev->config.policy], dev->config.servers,
+                (unsigned long long) stats->requests,
+                capacity_ns ? 100.0 * (double) stats->busy_ns / (double) capacity_ns : 0.0,
+                stats->seek_ns / 1e9);
+        fprintf(out, "Device %u (%s) queueing delay: avg=%.3fs, max=%.3fs, max queue length=%u\n",
+                d, dev->config.name,
+                stats->requests ? stats->queue_ns / 1e9 / (double) stats->requests : 0.0,
+                stats->max_queue_ns / 1e9, stats->max_queue_len);
+    }
+}
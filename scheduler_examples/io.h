@@ -0,0 +1,141 @@
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+#include "trace.h"
+
+/*
+ * I/O subsystem.
+ *
+ * Without devices, every BLOCK request is an independent timer: any number of
+ * processes can do I/O at the same time. With devices, a BLOCK request goes to
+ * the device named by the message. A device serves a bounded number of requests
+ * at a time (its servers), the other requests wait in the device queue and the
+ * disk scheduling policy chooses which one is served next. The service time of
+ * a request is the requested time plus the seek time from the current head
+ * position to the block address of the request.
+ */
+
+#define IO_MAX_DEVICES 8
+
+// Define the disk scheduling policies
+typedef enum {
+    IO_POLICY_FCFS = 0,         // First come, first served
+    IO_POLICY_SSTF,             // Shortest seek time first
+    IO_POLICY_SCAN,             // Elevator: sweep up and down, serving the requests on the way
+    IO_POLICY_CLOOK,            // Sweep up only, then jump back to the lowest request
+} io_policy_en;
+
+static const char IO_POLICY_STRINGS[][8] = {
+    "FCFS",
+    "SSTF",
+    "SCAN",
+    "C-LOOK"
+};
+
+// Define the configuration of a device
+typedef struct {
+    char name[16];
+    io_policy_en policy;
+    uint32_t servers;           // Requests served at the same time
+    uint32_t seek_ms_per_1k;    // Seek time per 1000 blocks of head movement
+} io_device_config_t;
+
+// Define the counters of a device
+typedef struct {
+    uint64_t requests;          // Requests completed
+    uint64_t busy_ns;           // Sum of the service times (all servers)
+    uint64_t seek_ns;           // Part of the service time spent seeking
+    uint64_t queue_ns;          // Sum of the times requests waited in the queue
+    uint64_t max_queue_ns;      // Longest time a request waited in the queue
+    uint32_t max_queue_len;     // Longest queue
+} io_stats_t;
+
+// Define a device
+typedef struct {
+    io_device_config_t config;
+    queue_t queue;              // Requests waiting for a server
+    uint32_t queue_len;
+    pcb_t **in_service;         // Requests being served, one per server (NULL if the server is free)
+    uint32_t head;              // Block address of the head
+    int direction;              // Head direction for SCAN (1 up, -1 down)
+    io_stats_t stats;
+} io_device_t;
+
+// Called when the I/O of a task finished
+typedef void (*io_done_fn)(void *ctx, pcb_t *task, uint64_t current_time_ns);
+
+// Define the I/O subsystem
+typedef struct {
+    io_device_t devices[IO_MAX_DEVICES];
+    uint32_t num_devices;
+    trace_t *trace;             // Event tracer (NULL if not tracing)
+} io_t;
+
+/**
+ * @brief Parse a device configuration like "disk" or "disk,SCAN,1,5"
+ *
+ * The fields are: device name, disk scheduling policy, number of servers and seek
+ * time in ms per 1000 blocks.
+ *
+ * @param spec The configuration string
+ * @param config Where to store the configuration
+ * @return 0 on success, -1 if the configuration is invalid
+ */
+int io_parse_device(const char *spec, io_device_config_t *config);
+
+/**
+ * @brief Initialize the I/O subsystem
+ *
+ * @param io The I/O subsystem
+ * @param configs The configuration of every device (the device id is the index)
+ * @param num_devices Number of devices (0 for independent timers)
+ * @return 0 on success, -1 on failure
+ */
+int io_init(io_t *io, const io_device_config_t *configs, uint32_t num_devices);
+
+/**
+ * @brief Free the I/O subsystem (the tasks are not freed)
+ */
+void io_free(io_t *io);
+
+/**
+ * @brief Submit the BLOCK request of a task
+ *
+ * The task must have time_ns, io_device and io_block set.
+ *
+ * @param io The I/O subsystem
+ * @param task The task
+ * @param current_time_ns The current time in nanoseconds
+ * @return 0 if the request was queued on a device, -1 if there is no such device
+ */
+int io_submit(io_t *io, pcb_t *task, uint64_t current_time_ns);
+
+/**
+ * @brief Complete the finished requests and start new ones
+ *
+ * @param io The I/O subsystem
+ * @param current_time_ns The current time in nanoseconds
+ * @param done Called for every request that finished
+ * @param ctx Context passed to the callback
+ */
+void io_tick(io_t *io, uint64_t current_time_ns, io_done_fn done, void *ctx);
+
+/**
+ * @brief Count the tasks queued or in service on the devices
+ */
+uint32_t io_num_blocked(const io_t *io);
+
+/**
+ * @brief Print the counters of every device
+ *
+ * @param io The I/O subsystem
+ * @param out The stream to print to
+ * @param elapsed_ns The simulated time, for utilization
+ */
+void io_print_stats(const io_t *io, FILE *out, uint64_t elapsed_ns);
+
+#endif //IO_H
@@ -0,0 +1,354 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "burst_queue.h"
+#include "msg.h"
+
+#define MAX_WORKLOAD_FILES 256
+#define MAX_CONNECTIONS 64
+#define READ_CHUNK (64 * sizeof(msg_t))
+
+/*
+ * Run like: ./loadgen [-c connections] [-n copies] <burst-file.csv> [<burst-file.csv> ...]
+ *
+ * Runs copies of the applications described by the burst files as virtual
+ * processes, the way app-io runs one, but all of them from a single thread over a
+ * few multiplexed connections (see mux.h). An epoll loop reads the replies of the
+ * simulator, and every DONE sends the next request of its virtual process.
+ */
+
+// Define the bursts of a burst file
+typedef struct {
+    char *name;
+    burst_t *bursts;
+    uint32_t num_bursts;
+    uint32_t copies_done;
+    uint64_t elapsed_ns;        // Sum over the finished copies
+} workload_t;
+
+// Define a virtual process
+typedef struct {
+    pid_t pid;
+    workload_t *wl;
+    uint32_t conn;
+    uint32_t next_burst;        // Burst of the current (or next) request
+    process_request_t request;  // Request in flight
+    uint64_t start_ns;          // Simulated time of the first ACK
+    int started;
+} vproc_t;
+
+// Define a connection to the simulator
+typedef struct {
+    int fd;
+    int writing;                // Waiting for EPOLLOUT
+    uint8_t in[READ_CHUNK + sizeof(msg_t)];
+    uint32_t in_len;
+    uint8_t *out;
+    uint32_t out_len;
+    uint32_t out_capacity;
+} lg_conn_t;
+
+static lg_conn_t conns[MAX_CONNECTIONS];
+static int epfd = -1;
+static uint64_t messages = 0;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int set_events(lg_conn_t *conn, uint32_t events) {
+    struct epoll_event ev = {.events = events, .data.ptr = conn};
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+// Write what we can, the rest goes when the socket is writable again
+static int flush_conn(lg_conn_t *conn) {
+    uint32_t sent = 0;
+    while (sent < conn->out_len) {
+        ssize_t n = write(conn->fd, conn->out + sent, conn->out_len - sent);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("write");
+            return -1;
+        }
+        sent += (uint32_t) n;
+    }
+    memmove(conn->out, conn->out + sent, conn->out_len - sent);
+    conn->out_len -= sent;
+    int writing = conn->out_len > 0;
+    if (writing != conn->writing) {
+        conn->writing = writing;
+        return set_events(conn, EPOLLIN | (writing ? EPOLLOUT : 0));
+    }
+    return 0;
+}
+
+static int queue_msg(lg_conn_t *conn, const msg_t *msg) {
+    if (conn->out_len + sizeof(msg_t) > conn->out_capacity) {
+        uint32_t capacity = conn->out_capacity ? 2 * conn->out_capacity : 64 * sizeof(msg_t);
+        uint8_t *out = realloc(conn->out, capacity);
+        if (!out) return -1;
+        conn->out = out;
+        conn->out_capacity = capacity;
+    }
+    memcpy(conn->out + conn->out_len, msg, sizeof(msg_t));
+    conn->out_len += sizeof(msg_t);
+    messages++;
+    return 0;
+}
+
+static int send_request(vproc_t *vp, process_request_t request) {
+    const burst_t *burst = &vp->wl->bursts[vp->next_burst];
+    msg_t msg = {
+        .pid = vp->pid,
+        .request = request,
+        .time_ns = (request == PROCESS_REQUEST_RUN ? burst->burst_time_ms : burst->block_time_ms) * NS_PER_MS,
+        .block = BLOCK_ADDRESS_NONE
+    };
+    if (request == PROCESS_REQUEST_RUN) {
+        msg.pages = burst->pages;
+        msg.nice = burst->nice;
+    } else if (request == PROCESS_REQUEST_BLOCK) {
+        msg.device = burst->device;
+        msg.block = burst->block;
+    } else {
+        // LOCK or UNLOCK of a mutex line
+        msg.time_ns = 0;
+        memcpy(msg.mutex, burst->mutex, MUTEX_NAME_LEN);
+    }
+    vp->request = request;
+    return queue_msg(&conns[vp->conn], &msg);
+}
+
+/**
+ * @brief Handle a reply of the simulator
+ *
+ * @return 1 if the virtual process finished, 0 if it goes on, -1 on error
+ */
+static int handle_reply(vproc_t *vp, const msg_t *msg) {
+    if (msg->request == PROCESS_REQUEST_ACK) {
+        if (!vp->started) {
+            vp->start_ns = msg->time_ns;
+            vp->started = 1;
+        }
+        return 0;
+    }
+    if (msg->request == PROCESS_REQUEST_NACK) {
+        // Killed by a control request (or a LOCK/UNLOCK it cannot do), it does not count as a finished copy
+        printf("Virtual process %d was killed, or its %s was refused\n", vp->pid, PROCESS_REQUEST_STRINGS[vp->request]);
+        return 1;
+    }
+    if (msg->request != PROCESS_REQUEST_DONE) {
+        printf("Received invalid request for virtual process %d: %s\n", vp->pid, PROCESS_REQUEST_STRINGS[msg->request]);
+        return -1;
+    }
+    const burst_t *burst = &vp->wl->bursts[vp->next_burst];
+    if (vp->request == PROCESS_REQUEST_RUN && burst->block_time_ms > 0) {
+        return send_request(vp, PROCESS_REQUEST_BLOCK);
+    }
+    if (++vp->next_burst < vp->wl->num_bursts) {
+        return send_request(vp, vp->wl->bursts[vp->next_burst].request);
+    }
+    vp->wl->copies_done++;
+    vp->wl->elapsed_ns += msg->time_ns - vp->start_ns;
+    return 1;
+}
+
+static int load_workload(const char *path, workload_t *wl) {
+    burst_queue_t queue = {.head = NULL, .tail = NULL};
+    if (read_queue_from_file(&queue, path) <= 0) {
+        fprintf(stderr, "Failed to read burst file %s\n", path);
+        return -1;
+    }
+    memset(wl, 0, sizeof(workload_t));
+    wl->name = get_basename_no_ext(path);
+    for (burst_node_t *node = queue.head; node != NULL; node = node->next) wl->num_bursts++;
+    wl->bursts = malloc(wl->num_bursts * sizeof(burst_t));
+    if (!wl->bursts) return -1;
+    burst_t *burst;
+    for (uint32_t i = 0; (burst = dequeue_burst(&queue)) != NULL; i++) {
+        wl->bursts[i] = *burst;
+        free(burst);
+    }
+    return 0;
+}
+
+static int connect_scheduler(lg_conn_t *conn) {
+    conn->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    if (connect(conn->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return -1;
+    }
+    int flags = fcntl(conn->fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(conn->fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        perror("fcntl: set non-blocking");
+        return -1;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = conn};
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    // Tell the simulator that the pid of every message is a virtual process
+    msg_t msg = {.pid = getpid(), .request = PROCESS_REQUEST_MUX, .block = BLOCK_ADDRESS_NONE};
+    return queue_msg(conn, &msg);
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-c connections] [-n copies] <burst-file.csv> [<burst-file.csv> ...]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t num_conns = 1;
+    uint32_t copies = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (parse_uint(optarg, &num_conns) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'n':
+                if (parse_uint(optarg, &copies) < 0) exit(EXIT_FAILURE);
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    uint32_t num_workloads = (uint32_t) (argc - optind);
+    if (num_workloads == 0 || num_workloads > MAX_WORKLOAD_FILES || num_conns > MAX_CONNECTIONS) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    workload_t workloads[MAX_WORKLOAD_FILES];
+    for (uint32_t i = 0; i < num_workloads; i++) {
+        if (load_workload(argv[optind + i], &workloads[i]) < 0) return EXIT_FAILURE;
+    }
+    uint64_t total = (uint64_t) num_workloads * copies;
+    if (total > INT32_MAX) {
+        fprintf(stderr, "Too many virtual processes\n");
+        return EXIT_FAILURE;
+    }
+    uint32_t num_vprocs = (uint32_t) total;
+    vproc_t *vprocs = calloc(num_vprocs, sizeof(vproc_t));
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!vprocs || epfd < 0) {
+        perror("epoll_create1");
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < num_conns; i++) {
+        if (connect_scheduler(&conns[i]) < 0) return EXIT_FAILURE;
+    }
+
+    // Virtual pids are 1..N, spread over the connections
+    double start = monotonic_s();
+    for (uint32_t i = 0; i < num_vprocs; i++) {
+        vproc_t *vp = &vprocs[i];
+        vp->pid = (pid_t) (i + 1);
+        vp->wl = &workloads[i % num_workloads];
+        vp->conn = i % num_conns;
+        if (send_request(vp, vp->wl->bursts[0].request) < 0) return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < num_conns; i++) {
+        if (flush_conn(&conns[i]) < 0) return EXIT_FAILURE;
+    }
+
+    uint32_t finished = 0;
+    uint64_t sim_clock_ns = 0;
+    struct epoll_event events[MAX_CONNECTIONS];
+    while (finished < num_vprocs) {
+        int n = epoll_wait(epfd, events, MAX_CONNECTIONS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return EXIT_FAILURE;
+        }
+        for (int e = 0; e < n; e++) {
+            lg_conn_t *conn = events[e].data.ptr;
+            if (events[e].events & EPOLLIN) {
+                ssize_t len = read(conn->fd, conn->in + conn->in_len, READ_CHUNK);
+                if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+                    fprintf(stderr, "Scheduler closed the connection\n");
+                    return EXIT_FAILURE;
+                }
+                if (len > 0) conn->in_len += (uint32_t) len;
+                // Handle every complete message, keep the partial one for the next read
+                uint32_t used = 0;
+                for (; conn->in_len - used >= sizeof(msg_t); used += sizeof(msg_t)) {
+                    msg_t msg;
+                    memcpy(&msg, conn->in + used, sizeof(msg_t));
+                    messages++;
+                    if (msg.pid < 1 || (uint32_t) msg.pid > num_vprocs) {
+                        fprintf(stderr, "Reply for unknown virtual process %d\n", msg.pid);
+                        continue;
+                    }
+                    int status = handle_reply(&vprocs[msg.pid - 1], &msg);
+                    if (status < 0) return EXIT_FAILURE;
+                    finished += (uint32_t) status;
+                    sim_clock_ns = msg.time_ns;
+                }
+                memmove(conn->in, conn->in + used, conn->in_len - used);
+                conn->in_len -= used;
+            }
+        }
+        // Send the requests queued by the replies, batched per connection
+        for (uint32_t i = 0; i < num_conns; i++) {
+            if (conns[i].out_len > 0 && flush_conn(&conns[i]) < 0) return EXIT_FAILURE;
+        }
+    }
+    double host_s = monotonic_s() - start;
+
+    for (uint32_t i = 0; i < num_workloads; i++) {
+        workload_t *wl = &workloads[i];
+        printf("%s: %u virtual processes, avg elapsed %.3f seconds\n", wl->name, wl->copies_done,
+               wl->copies_done ? (double) wl->elapsed_ns / 1e9 / wl->copies_done : 0.0);
+        free(wl->name);
+        free(wl->bursts);
+    }
+    printf("%u virtual processes over %u connection(s) finished at time %.3f ms: "
+           "%llu messages in %.3f s (%.0f messages/s)\n",
+           num_vprocs, num_conns, (double) sim_clock_ns / 1e6, (unsigned long long) messages, host_s,
+           host_s > 0 ? (double) messages / host_s : 0.0);
+    for (uint32_t i = 0; i < num_conns; i++) {
+        close(conns[i].fd);
+        free(conns[i].out);
+    }
+    close(epfd);
+    free(vprocs);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,274 @@
+#include "locks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scheduler.h"
+
+int locks_init(locks_t *locks, struct scheduler_st *scheduler, int inherit) {
+    memset(locks, 0, sizeof(locks_t));
+    locks->scheduler = scheduler;
+    locks->inherit = inherit;
+    if (inherit && !scheduler->ops->renice) {
+        fprintf(stderr, "Priority inheritance needs a policy with priorities (MLFQ), not %s\n", scheduler->label);
+        return -1;
+    }
+    return 0;
+}
+
+void locks_free(locks_t *locks) {
+    for (uint32_t i = 0; i < locks->count; i++) {
+        while (dequeue_pcb(&locks->mutexes[i].waiters) != NULL) { }
+    }
+    free(locks->mutexes);
+    memset(locks, 0, sizeof(locks_t));
+}
+
+static mutex_t *find_mutex(const locks_t *locks, const char *name) {
+    for (uint32_t i = 0; i < locks->count; i++) {
+        if (strncmp(locks->mutexes[i].name, name, MUTEX_NAME_LEN) == 0) return &locks->mutexes[i];
+    }
+    return NULL;
+}
+
+static mutex_t *find_or_create_mutex(locks_t *locks, const char *name) {
+    mutex_t *m = find_mutex(locks, name);
+    if (m) return m;
+    if (locks->count == locks->capacity) {
+        uint32_t capacity = locks->capacity ? 2 * locks->capacity : 16;
+        mutex_t *mutexes = realloc(locks->mutexes, capacity * sizeof(mutex_t));
+        if (!mutexes) return NULL;
+        locks->mutexes = mutexes;
+        locks->capacity = capacity;
+    }
+    m = &locks->mutexes[locks->count++];
+    memset(m, 0, sizeof(mutex_t));
+    strncpy(m->name, name, MUTEX_NAME_LEN - 1);
+    return m;
+}
+
+/**
+ * @brief Get the priority of the highest waiter of a mutex (UINT32_MAX if none)
+ */
+static uint32_t top_priority(const locks_t *locks, const mutex_t *m) {
+    uint32_t priority = UINT32_MAX;
+    for (const queue_elem_t *elem = m->waiters.head; elem != NULL; elem = elem->next) {
+        uint32_t p = scheduler_priority(locks->scheduler, elem->pcb);
+        if (p < priority) priority = p;
+    }
+    return priority;
+}
+
+/**
+ * @brief Start or end a priority inversion: a waiter with a higher priority than the level the holder runs at
+ */
+static void check_inversion(const locks_t *locks, mutex_t *m, uint64_t current_time_ns) {
+    int inverted = m->holder != NULL && top_priority(locks, m) < scheduler_priority(locks->scheduler, m->holder);
+    if (inverted && !m->inverted) {
+        m->inverted = 1;
+        m->inverted_ns = current_time_ns;
+        m->stats.inversions++;
+    } else if (!inverted && m->inverted) {
+        uint64_t duration = current_time_ns - m->inverted_ns;
+        m->inverted = 0;
+        m->stats.inversion_ns += duration;
+        if (duration > m->stats.max_inversion_ns) m->stats.max_inversion_ns = duration;
+    }
+}
+
+/**
+ * @brief Set the priority a task inherits from the waiters of its mutexes
+ *
+ * If the task waits for a mutex itself, its holder inherits in turn. The chain
+ * is at most as long as there are mutexes (longer only in a deadlock).
+ */
+static void inherit(locks_t *locks, pcb_t *task) {
+    for (uint32_t depth = 0; task != NULL && depth <= locks->count; depth++) {
+        uint32_t level = UINT32_MAX;
+        for (uint32_t i = 0; i < locks->count; i++) {
+            if (locks->mutexes[i].holder != task) continue;
+            uint32_t p = top_priority(locks, &locks->mutexes[i]);
+            if (p < level) level = p;
+        }
+        if (level == task->cold->inherited) return;
+        scheduler_inherit(locks->scheduler, task, level);
+        if (task->cold->waiting_mutex == 0) return;
+        task = locks->mutexes[task->cold->waiting_mutex - 1].holder;
+    }
+}
+
+static void take(mutex_t *m, pcb_t *task, uint64_t current_time_ns, queue_t *done) {
+    m->holder = task;
+    m->acquired_ns = current_time_ns;
+    m->stats.acquisitions++;
+    enqueue_pcb(done, task);
+}
+
+/**
+ * @brief Remove a waiter from the wait queue of its mutex
+ */
+static void remove_waiter(locks_t *locks, mutex_t *m, queue_elem_t *elem) {
+    remove_queue_elem(&m->waiters, elem);
+    elem->pcb->cold->waiting_mutex = 0;
+    free(elem);
+    m->num_waiters--;
+    locks->num_waiting--;
+}
+
+/**
+ * @brief Give a mutex back and hand it to the next waiter
+ *
+ * The next waiter is the first one, or the first of the highest priority with
+ * priority inheritance. The inherited priorities are not updated.
+ */
+static void release(locks_t *locks, mutex_t *m, uint64_t current_time_ns, queue_t *done) {
+    m->stats.hold_ns += current_time_ns - m->acquired_ns;
+    m->holder = NULL;
+    if (m->num_waiters > 0) {
+        queue_elem_t *next = m->waiters.head;
+        for (queue_elem_t *elem = next->next; locks->inherit && elem != NULL; elem = elem->next) {
+            if (scheduler_priority(locks->scheduler, elem->pcb) < scheduler_priority(locks->scheduler, next->pcb)) {
+                next = elem;
+            }
+        }
+        pcb_t *task = next->pcb;
+        remove_waiter(locks, m, next);
+        uint64_t wait_ns = current_time_ns - task->cold->mutex_wait_ns;
+        m->stats.contended++;
+        m->stats.wait_ns += wait_ns;
+        if (wait_ns > m->stats.max_wait_ns) m->stats.max_wait_ns = wait_ns;
+        m->stats.handoffs++;
+        m->stats.convoy_sum += m->num_waiters;
+        take(m, task, current_time_ns, done);
+    }
+    check_inversion(locks, m, current_time_ns);
+}
+
+int locks_lock(locks_t *locks, pcb_t *task, const char *name, uint64_t current_time_ns, queue_t *done) {
+    mutex_t *m = find_or_create_mutex(locks, name);
+    if (!m || m->holder == task) return -1;
+    if (!m->holder) {
+        take(m, task, current_time_ns, done);
+        return 0;
+    }
+    if (!enqueue_pcb(&m->waiters, task)) return -1;
+    task->cold->waiting_mutex = (uint32_t) (m - locks->mutexes) + 1;
+    task->cold->mutex_wait_ns = current_time_ns;
+    if (++m->num_waiters > m->stats.max_convoy) m->stats.max_convoy = m->num_waiters;
+    locks->num_waiting++;
+    if (locks->inherit) {
+        // The holder runs at the level of its highest waiter from now on, even if it is not lower yet
+        if (scheduler_priority(locks->scheduler, task) < scheduler_priority(locks->scheduler, m->holder)) {
+            m->stats.boosts++;
+        }
+        inherit(locks, m->holder);
+    }
+    check_inversion(locks, m, current_time_ns);
+    return 0;
+}
+
+int locks_unlock(locks_t *locks, pcb_t *task, const char *name, uint64_t current_time_ns, queue_t *done) {
+    mutex_t *m = find_mutex(locks, name);
+    if (!m || m->holder != task) return -1;
+    enqueue_pcb(done, task);
+    release(locks, m, current_time_ns, done);
+    if (locks->inherit) {
+        // The task no longer inherits from these waiters, the new holder does
+        inherit(locks, task);
+        inherit(locks, m->holder);
+    }
+    return 0;
+}
+
+/**
+ * @brief Take a task out of the wait queue of its mutex
+ *
+ * @return 1 if it was waiting, 0 if not
+ */
+static int stop_waiting(locks_t *locks, pcb_t *task, uint64_t current_time_ns) {
+    if (task->cold->waiting_mutex == 0) return 0;
+    mutex_t *m = &locks->mutexes[task->cold->waiting_mutex - 1];
+    for (queue_elem_t *elem = m->waiters.head; elem != NULL; elem = elem->next) {
+        if (elem->pcb == task) {
+            remove_waiter(locks, m, elem);
+            break;
+        }
+    }
+    if (locks->inherit) inherit(locks, m->holder);
+    check_inversion(locks, m, current_time_ns);
+    return 1;
+}
+
+void locks_cancel(locks_t *locks, pcb_t *task, uint64_t current_time_ns, queue_t *done) {
+    if (stop_waiting(locks, task, current_time_ns)) {
+        enqueue_pcb(done, task);
+    }
+}
+
+void locks_exit(locks_t *locks, pcb_t *task, uint64_t current_time_ns, queue_t *done) {
+    stop_waiting(locks, task, current_time_ns);
+    for (uint32_t i = 0; i < locks->count; i++) {
+        mutex_t *m = &locks->mutexes[i];
+        if (m->holder != task) continue;
+        release(locks, m, current_time_ns, done);
+        if (locks->inherit) inherit(locks, m->holder);
+    }
+}
+
+void locks_check_inversions(locks_t *locks, uint64_t current_time_ns) {
+    for (uint32_t i = 0; i < locks->count; i++) {
+        mutex_t *m = &locks->mutexes[i];
+        if (!m->holder || (m->num_waiters == 0 && !m->inverted)) continue;
+        check_inversion(locks, m, current_time_ns);
+        if (m->inverted && locks->inherit) {
+            // A waiter was reniced above the level the holder inherited
+            m->stats.boosts++;
+            inherit(locks, m->holder);
+            check_inversion(locks, m, current_time_ns);
+        }
+    }
+}
+
+// Get the holder of the mutex a task waits for (NULL if it does not wait)
+static const pcb_t *waits_for(const locks_t *locks, const pcb_t *task) {
+    return task->cold->waiting_mutex ? locks->mutexes[task->cold->waiting_mutex - 1].holder : NULL;
+}
+
+void locks_print_deadlock(const locks_t *locks, const pcb_t *task, FILE *out) {
+    // Every task waits for a different mutex until the walk comes back, so the cycle is reached in count steps
+    for (uint32_t i = 0; i < locks->count && task != NULL; i++) {
+        task = waits_for(locks, task);
+    }
+    if (task == NULL) {
+        fprintf(out, "no cycle of waiting tasks\n");
+        return;
+    }
+    const pcb_t *start = task;
+    do {
+        const pcb_t *holder = waits_for(locks, task);
+        fprintf(out, "%sprocess %d waits for %.*s held by process %d", task == start ? "" : ", ", task->pid,
+                MUTEX_NAME_LEN, locks->mutexes[task->cold->waiting_mutex - 1].name, holder->pid);
+        task = holder;
+    } while (task != start);
+    fprintf(out, "\n");
+}
+
+void locks_print_stats(const locks_t *locks, FILE *out, uint64_t current_time_ns) {
+    for (uint32_t i = 0; i < locks->count; i++) {
+        const mutex_t *m = &locks->mutexes[i];
+        const mutex_stats_t *stats = &m->stats;
+        // A mutex still held, or still inverted, counts until now
+        uint64_t hold_ns = stats->hold_ns + (m->holder ? current_time_ns - m->acquired_ns : 0);
+        uint64_t inversion_ns = stats->inversion_ns + (m->inverted ? current_time_ns - m->inverted_ns : 0);
+        fprintf(out, "Mutex %s: acquisitions=%llu, contended=%llu, contention=%.3fs (avg=%.3fs, max=%.3fs), held=%.3fs\n",
+                m->name, (unsigned long long) stats->acquisitions, (unsigned long long) stats->contended,
+                stats->wait_ns / 1e9, stats->contended ? stats->wait_ns / 1e9 / (double) stats->contended : 0.0,
+                stats->max_wait_ns / 1e9, hold_ns / 1e9);
+        fprintf(out, "Mutex %s convoy: max=%u, avg=%.2f waiters left at a handoff; "
+                     "priority inversion: %llu times, %.3fs (max=%.3fs), %llu boosts\n",
+                m->name, stats->max_convoy,
+                stats->handoffs ? (double) stats->convoy_sum / (double) stats->handoffs : 0.0,
+                (unsigned long long) stats->inversions, inversion_ns / 1e9, stats->max_inversion_ns / 1e9,
+                (unsigned long long) stats->boosts);
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "msg.h"
+#include "queue.h"
+
+struct scheduler_st;
+
+/*
+ * Named mutexes.
+ *
+ * A task takes a mutex with a LOCK request and gives it back with UNLOCK. A mutex
+ * is created the first time it is named. While another task holds it, the task
+ * waits in the wait queue of the mutex, blocked: it uses no CPU, and every task
+ * behind it in the queue waits for it too (a convoy). UNLOCK hands the mutex to
+ * the first waiter.
+ *
+ * A task that holds a mutex can be preempted, block on I/O, or wait for its
+ * application like any other, so a task with a high priority can wait behind a
+ * holder with a low priority, which tasks of medium priority keep off the CPU
+ * (priority inversion). With priority inheritance the holder runs at the
+ * priority of its highest waiter until it gives the mutex back (transitively, if
+ * the holder itself waits on a mutex), and the highest waiter is served first.
+ * Priorities are the levels the tasks run at in MLFQ (0 is the highest, see
+ * scheduler_priority): the level of their nice (RENICE, or the nice of their
+ * bursts), lowered as they use up time slices. The other policies have none.
+ *
+ * A task that leaves the simulation gives its mutexes back. A killed task stops
+ * waiting. Tasks that wait for mutexes held by each other wait forever (deadlock).
+ *
+ * The mutexes are looked up by name in an array: workloads name a few mutexes,
+ * and their counters are reported per mutex.
+ */
+
+// Define the counters of a mutex
+typedef struct {
+    uint64_t acquisitions;
+    uint64_t contended;         // Acquisitions that had to wait
+    uint64_t wait_ns;           // Time the tasks waited for the mutex (contention time)
+    uint64_t max_wait_ns;
+    uint64_t hold_ns;           // Time the mutex was held
+    uint64_t convoy_sum;        // Sum of the waiters left behind at every handoff
+    uint64_t handoffs;          // Releases that handed the mutex to a waiter
+    uint32_t max_convoy;        // Longest wait queue
+    uint64_t inversions;        // Times a waiter had a higher priority than the holder
+    uint64_t inversion_ns;      // Time a waiter had a higher priority than the holder
+    uint64_t max_inversion_ns;
+    uint64_t boosts;            // Times the holder inherited a priority from a waiter
+} mutex_stats_t;
+
+// Define a mutex
+typedef struct {
+    char name[MUTEX_NAME_LEN];
+    pcb_t *holder;              // NULL if the mutex is free
+    uint64_t acquired_ns;       // Time the holder took it
+    queue_t waiters;            // Tasks waiting for the mutex, in arrival order
+    uint32_t num_waiters;
+    int inverted;               // A waiter has a higher priority than the holder
+    uint64_t inverted_ns;       // Since when
+    mutex_stats_t stats;
+} mutex_t;
+
+// Define the mutexes of a simulation
+typedef struct {
+    mutex_t *mutexes;           // In the order they were first named
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t num_waiting;       // Tasks waiting for any mutex
+    int inherit;                // Priority inheritance
+    struct scheduler_st *scheduler; // Applies the inherited priorities
+} locks_t;
+
+/**
+ * @brief Initialize the mutexes of a simulation
+ *
+ * @param locks The mutexes
+ * @param scheduler The scheduler the tasks run on
+ * @param inherit Non-zero for priority inheritance
+ * @return 0 on success, -1 if priority inheritance is asked and the policy has no priorities
+ */
+int locks_init(locks_t *locks, struct scheduler_st *scheduler, int inherit);
+
+/**
+ * @brief Free the mutexes (the tasks are not freed)
+ */
+void locks_free(locks_t *locks);
+
+/**
+ * @brief Take a mutex (LOCK request)
+ *
+ * @param locks The mutexes
+ * @param task The task
+ * @param name The name of the mutex
+ * @param current_time_ns The current time in nanoseconds
+ * @param done Where the task goes once it holds the mutex (right away if it is free)
+ * @return 0 on success, -1 if the task already holds the mutex or there is no memory
+ */
+int locks_lock(locks_t *locks, pcb_t *task, const char *name, uint64_t current_time_ns, queue_t *done);
+
+/**
+ * @brief Give back a mutex (UNLOCK request)
+ *
+ * @param locks The mutexes
+ * @param task The task
+ * @param name The name of the mutex
+ * @param current_time_ns The current time in nanoseconds
+ * @param done Where the task goes, and the waiter that takes the mutex
+ * @return 0 on success, -1 if the task does not hold the mutex
+ */
+int locks_unlock(locks_t *locks, pcb_t *task, const char *name, uint64_t current_time_ns, queue_t *done);
+
+/**
+ * @brief Stop the wait of a task for a mutex (e.g. it was killed), nothing is done if it is not waiting
+ *
+ * @param locks The mutexes
+ * @param task The task
+ * @param current_time_ns The current time in nanoseconds
+ * @param done Where the task goes
+ */
+void locks_cancel(locks_t *locks, pcb_t *task, uint64_t current_time_ns, queue_t *done);
+
+/**
+ * @brief Give back every mutex of a task that leaves the simulation, and stop its wait
+ *
+ * @param locks The mutexes
+ * @param task The task
+ * @param current_time_ns The current time in nanoseconds
+ * @param done Where the waiters that take the mutexes go
+ */
+void locks_exit(locks_t *locks, pcb_t *task, uint64_t current_time_ns, queue_t *done);
+
+/**
+ * @brief Start or end the priority inversions that began or ended without a LOCK or UNLOCK, once per tick
+ *
+ * The level of a task changes as it runs (MLFQ demotes a holder that uses up
+ * its time slices) and with RENICE. With priority inheritance, a holder below
+ * its highest waiter inherits again.
+ *
+ * @param locks The mutexes
+ * @param current_time_ns The current time in nanoseconds
+ */
+void locks_check_inversions(locks_t *locks, uint64_t current_time_ns);
+
+/**
+ * @brief Print the cycle of tasks that wait for mutexes held by each other
+ *
+ * Follows the holder of the mutex the task waits for, then the holder of the
+ * mutex that one waits for, and so on until a task comes back.
+ *
+ * @param locks The mutexes
+ * @param task A task waiting for a mutex, on the cycle or waiting for a task on it
+ * @param out The stream to print to
+ */
+void locks_print_deadlock(const locks_t *locks, const pcb_t *task, FILE *out);
+
+/**
+ * @brief Print the counters of every mutex
+ *
+ * @param locks The mutexes
+ * @param out The stream to print to
+ * @param current_time_ns The current time, for the mutexes still held
+ */
+void locks_print_stats(const locks_t *locks, FILE *out, uint64_t current_time_ns);
+
+#endif //LOCKS_H
@@ -0,0 +1,230 @@
+#include "metrics.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define METRICS_PAGE_SIZE 8192
+
+static void store(_Atomic uint64_t *value, uint64_t v) {
+    atomic_store_explicit(value, v, memory_order_relaxed);
+}
+
+static uint64_t load(_Atomic uint64_t *value) {
+    return atomic_load_explicit(value, memory_order_relaxed);
+}
+
+static uint64_t queue_length(const queue_t *q) {
+    uint64_t n = 0;
+    for (const queue_elem_t *elem = q->head; elem != NULL; elem = elem->next) n++;
+    return n;
+}
+
+void metrics_update(metrics_t *metrics, const scheduler_t *s, const queue_t *command_queue,
+                    const timer_set_t *blocked_timers, const io_t *io, uint64_t current_time_ns) {
+    metrics_values_t *v = &metrics->values;
+    cswitch_stats_t total = {0};
+    uint64_t running = 0;
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        cswitch_stats_add(&total, &s->cpus[i].cswitch.stats);
+        if (s->cpus[i].task) running++;
+    }
+    uint64_t blocked = blocked_timers->count + io_num_blocked(io);
+    store(&v->time_ms, current_time_ns / NS_PER_MS);
+    store(&v->ncpus, s->ncpus);
+    store(&v->command_tasks, queue_length(command_queue));
+    store(&v->ready_tasks, s->ready);
+    store(&v->running_tasks, running);
+    store(&v->blocked_tasks, blocked);
+    store(&v->busy_ms, total.busy_ns / NS_PER_MS);
+    store(&v->switch_ms, total.overhead_ns / NS_PER_MS);
+    store(&v->refill_ms, total.refill_ns / NS_PER_MS);
+    store(&v->idle_ms, total.idle_ns / NS_PER_MS);
+    store(&v->dispatches, s->dispatches);
+    store(&v->voluntary, total.voluntary);
+    store(&v->involuntary, total.involuntary);
+    store(&v->migrations, total.migrations);
+}
+
+void metrics_observe(metrics_t *metrics, process_request_t request, uint64_t latency_ns) {
+    uint64_t latency_ms = latency_ns / NS_PER_MS;
+    metrics_histogram_t *h = &metrics->values.latency[request == PROCESS_REQUEST_BLOCK];
+    uint32_t b = 0;
+    while (b < METRICS_LATENCY_BUCKETS - 1 && latency_ms > METRICS_LATENCY_BOUNDS_MS[b]) b++;
+    // Single writer: a load and a store, no locked instruction
+    store(&h->buckets[b], load(&h->buckets[b]) + 1);
+    store(&h->sum_ms, load(&h->sum_ms) + latency_ms);
+}
+
+// Append to the page, ignoring what does not fit
+__attribute__((format(printf, 3, 4)))
+static void append(char *page, size_t *len, const char *fmt, ...) {
+    if (*len >= METRICS_PAGE_SIZE) return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(page + *len, METRICS_PAGE_SIZE - *len, fmt, args);
+    va_end(args);
+    if (n > 0) *len += (size_t) n;
+}
+
+static void append_metric(char *page, size_t *len, const char *name, const char *type, const char *help,
+                          uint64_t value) {
+    append(page, len, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name,
+           (unsigned long long) value);
+}
+
+/**
+ * @brief Format the metrics in the Prometheus text exposition format
+ *
+ * @return The length of the page
+ */
+static size_t format_metrics(metrics_t *metrics, char *page) {
+    metrics_values_t *v = &metrics->values;
+    size_t len = 0;
+    append_metric(page, &len, "ossim_time_ms", "gauge", "Simulated time.", load(&v->time_ms));
+    append_metric(page, &len, "ossim_cpus", "gauge", "Simulated CPUs.", load(&v->ncpus));
+
+    append(page, &len, "# HELP ossim_tasks Tasks by state.\n# TYPE ossim_tasks gauge\n");
+    append(page, &len, "ossim_tasks{state=\"command\"} %llu\n", (unsigned long long) load(&v->command_tasks));
+    append(page, &len, "ossim_tasks{state=\"ready\"} %llu\n", (unsigned long long) load(&v->ready_tasks));
+    append(page, &len, "ossim_tasks{state=\"running\"} %llu\n", (unsigned long long) load(&v->running_tasks));
+    append(page, &len, "ossim_tasks{state=\"blocked\"} %llu\n", (unsigned long long) load(&v->blocked_tasks));
+
+    uint64_t busy = load(&v->busy_ms);
+    uint64_t capacity = load(&v->time_ms) * load(&v->ncpus);
+    append(page, &len, "# HELP ossim_cpu_ms_total Simulated CPU time by use.\n# TYPE ossim_cpu_ms_total counter\n");
+    append(page, &len, "ossim_cpu_ms_total{mode=\"busy\"} %llu\n", (unsigned long long) busy);
+    append(page, &len, "ossim_cpu_ms_total{mode=\"switch\"} %llu\n", (unsigned long long) load(&v->switch_ms));
+    append(page, &len, "ossim_cpu_ms_total{mode=\"refill\"} %llu\n", (unsigned long long) load(&v->refill_ms));
+    append(page, &len, "ossim_cpu_ms_total{mode=\"idle\"} %llu\n", (unsigned long long) load(&v->idle_ms));
+    append(page, &len, "# HELP ossim_cpu_utilization Share of the CPU time used by tasks since the start.\n"
+                       "# TYPE ossim_cpu_utilization gauge\nossim_cpu_utilization %.4f\n",
+           capacity ? (double) busy / (double) capacity : 0.0);
+
+    append_metric(page, &len, "ossim_dispatches_total", "counter", "Tasks put on a CPU.", load(&v->dispatches));
+    append(page, &len, "# HELP ossim_context_switches_total Tasks taken off a CPU.\n"
+                       "# TYPE ossim_context_switches_total counter\n");
+    append(page, &len, "ossim_context_switches_total{kind=\"voluntary\"} %llu\n",
+           (unsigned long long) load(&v->voluntary));
+    append(page, &len, "ossim_context_switches_total{kind=\"involuntary\"} %llu\n",
+           (unsigned long long) load(&v->involuntary));
+    append_metric(page, &len, "ossim_migrations_total", "counter", "Tasks dispatched on a different CPU.",
+                  load(&v->migrations));
+
+    append(page, &len, "# HELP ossim_request_latency_ms Simulated time from the start of a request to its end.\n"
+                       "# TYPE ossim_request_latency_ms histogram\n");
+    const char *requests[] = {"run", "block"};
+    for (int r = 0; r < 2; r++) {
+        metrics_histogram_t *h = &v->latency[r];
+        uint64_t count = 0;
+        for (uint32_t b = 0; b < METRICS_LATENCY_BUCKETS; b++) {
+            count += load(&h->buckets[b]);
+            if (b < METRICS_LATENCY_BUCKETS - 1) {
+                append(page, &len, "ossim_request_latency_ms_bucket{request=\"%s\",le=\"%u\"} %llu\n",
+                       requests[r], METRICS_LATENCY_BOUNDS_MS[b], (unsigned long long) count);
+            } else {
+                append(page, &len, "ossim_request_latency_ms_bucket{request=\"%s\",le=\"+Inf\"} %llu\n",
+                       requests[r], (unsigned long long) count);
+            }
+        }
+        append(page, &len, "ossim_request_latency_ms_sum{request=\"%s\"} %llu\n",
+               requests[r], (unsigned long long) load(&h->sum_ms));
+        append(page, &len, "ossim_request_latency_ms_count{request=\"%s\"} %llu\n",
+               requests[r], (unsigned long long) count);
+    }
+    append_metric(page, &len, "ossim_scrapes_total", "counter", "Scrapes of this endpoint.",
+                  atomic_load(&metrics->scrapes));
+    return len;
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        // A client that went away must not kill the simulator with SIGPIPE
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        buf += n;
+        len -= (size_t) n;
+    }
+}
+
+/**
+ * @brief Answer one client: an HTTP response to an HTTP request, the bare page otherwise
+ */
+static void serve_client(metrics_t *metrics, int fd) {
+    // Wait a little for the request, a client like nc may send nothing
+    char request[1024];
+    ssize_t n = 0;
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    if (poll(&pfd, 1, 100) > 0) {
+        n = read(fd, request, sizeof(request) - 1);
+    }
+    atomic_fetch_add(&metrics->scrapes, 1);
+    char page[METRICS_PAGE_SIZE];
+    size_t len = format_metrics(metrics, page);
+    if (n >= 4 && strncmp(request, "GET ", 4) == 0) {
+        char header[128];
+        int header_len = snprintf(header, sizeof(header),
+                                  "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %zu\r\n\r\n", len);
+        write_all(fd, header, (size_t) header_len);
+    }
+    write_all(fd, page, len);
+}
+
+static void *metrics_thread(void *arg) {
+    metrics_t *metrics = arg;
+    struct pollfd pfd = {.fd = metrics->server_fd, .events = POLLIN};
+    while (!atomic_load(&metrics->stop)) {
+        // Wake up regularly to notice metrics_stop
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int fd = accept(metrics->server_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve_client(metrics, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_start(metrics_t *metrics, const char *path) {
+    memset(metrics, 0, sizeof(metrics_t));
+    struct sockaddr_un addr = {0};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Metrics socket path too long: %s\n", path);
+        return -1;
+    }
+    strncpy(metrics->path, path, sizeof(metrics->path) - 1);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    unlink(path);
+    metrics->server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (metrics->server_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(metrics->server_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(metrics->server_fd, 8) < 0) {
+        perror("metrics socket");
+        close(metrics->server_fd);
+        return -1;
+    }
+    if (pthread_create(&metrics->thread, NULL, metrics_thread, metrics) != 0) {
+        perror("pthread_create");
+        close(metrics->server_fd);
+        unlink(path);
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_stop(metrics_t *metrics) {
+    atomic_store(&metrics->stop, 1);
+    pthread_join(metrics->thread, NULL);
+    close(metrics->server_fd);
+    unlink(metrics->path);
+}
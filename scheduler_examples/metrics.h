@@ -0,0 +1,104 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "io.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "timerset.h"
+
+/*
+ * Live metrics.
+ *
+ * The simulator publishes its counters every tick, and a thread serves them on
+ * an admin Unix socket in the Prometheus text exposition format, to watch a long
+ * simulation while it runs:
+ *
+ *   curl --unix-socket /tmp/scheduler-metrics.sock http://localhost/metrics
+ *
+ * The tick loop is the only writer: it stores the values with relaxed atomics and
+ * never takes a lock, so a scrape (however slow) never delays a tick. A scrape
+ * may see the values of two consecutive ticks mixed, which Prometheus tolerates.
+ */
+
+// Upper bounds (ms) of the latency histogram buckets, the last bucket is +Inf
+#define METRICS_LATENCY_BUCKETS 12
+static const uint32_t METRICS_LATENCY_BOUNDS_MS[METRICS_LATENCY_BUCKETS - 1] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 60000
+};
+
+// Define a latency histogram
+typedef struct {
+    _Atomic uint64_t buckets[METRICS_LATENCY_BUCKETS];  // Not cumulative, summed when served
+    _Atomic uint64_t sum_ms;
+} metrics_histogram_t;
+
+// Define the published values
+typedef struct {
+    _Atomic uint64_t time_ms;               // Simulated time
+    _Atomic uint64_t ncpus;
+    _Atomic uint64_t command_tasks;         // Tasks waiting for a request from their application
+    _Atomic uint64_t ready_tasks;           // Tasks in the ready queue(s)
+    _Atomic uint64_t running_tasks;         // Tasks on a CPU
+    _Atomic uint64_t blocked_tasks;         // Tasks blocked on I/O (timers and device queues)
+    _Atomic uint64_t busy_ms;               // CPU time used by tasks (all CPUs)
+    _Atomic uint64_t switch_ms;             // CPU time lost switching
+    _Atomic uint64_t refill_ms;             // CPU time lost refilling the TLB and caches
+    _Atomic uint64_t idle_ms;               // CPU time with nothing to run
+    _Atomic uint64_t dispatches;
+    _Atomic uint64_t voluntary;             // Context switches at the end of a burst
+    _Atomic uint64_t involuntary;           // Preemptions
+    _Atomic uint64_t migrations;
+    metrics_histogram_t latency[2];         // From the start of a RUN/BLOCK request to its end
+} metrics_values_t;
+
+// Define the metrics endpoint
+typedef struct {
+    metrics_values_t values;
+    int server_fd;
+    char path[108];
+    pthread_t thread;
+    _Atomic int stop;
+    _Atomic uint64_t scrapes;
+} metrics_t;
+
+/**
+ * @brief Create the admin socket and start the thread that serves the metrics
+ *
+ * @param metrics The endpoint to initialize
+ * @param path Path of the Unix socket
+ * @return 0 on success, -1 on failure
+ */
+int metrics_start(metrics_t *metrics, const char *path);
+
+/**
+ * @brief Stop the thread and remove the socket
+ */
+void metrics_stop(metrics_t *metrics);
+
+/**
+ * @brief Publish the state of the simulation at the end of a tick
+ *
+ * @param metrics The endpoint
+ * @param s The scheduler
+ * @param command_queue Tasks waiting for a request
+ * @param blocked_timers Tasks blocked on a timer
+ * @param io The I/O devices
+ * @param current_time_ns The current time in nanoseconds
+ */
+void metrics_update(metrics_t *metrics, const scheduler_t *s, const queue_t *command_queue,
+                    const timer_set_t *blocked_timers, const io_t *io, uint64_t current_time_ns);
+
+/**
+ * @brief Count a finished RUN or BLOCK request in its latency histogram
+ *
+ * @param metrics The endpoint
+ * @param request PROCESS_REQUEST_RUN or PROCESS_REQUEST_BLOCK
+ * @param latency_ns Time from the start of the request to its end
+ */
+void metrics_observe(metrics_t *metrics, process_request_t request, uint64_t latency_ns);
+
+#endif //METRICS_H
@@ -1,91 +1,221 @@
 #include "fifo.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "msg.h"
-#include <unistd.h>
 
 #define NUM_QUEUES 3
-#define TIME_SLICE_MLFQ 500
+#define MAX_QUEUES 8
 
 typedef struct {
-    queue_t queues[NUM_QUEUES];
-    int time_slices[NUM_QUEUES];
+    pcb_ring_t queues[MAX_QUEUES];
+    uint32_t time_slices[MAX_QUEUES];   // In ms
+    uint64_t time_slices_ns[MAX_QUEUES];
+    uint32_t num_queues;
+    uint64_t dispatches[MAX_QUEUES];    // Tasks dispatched from each level
+    uint64_t cpu_ns[MAX_QUEUES];        // CPU time the tasks used at each level
+    // What MLFQ keeps about a task (level_start_ns, own_level) is in its pcb, so the task can move
+    // to the instance of another CPU (per-CPU run queues) with it
 } mlfq_t;
 
-// Track current task slice time and queue level
-static mlfq_t mlfq;
-static uint32_t current_slice_time = 0;
-static int current_queue_level = 0;
+/*
+ * Params: optional comma separated time slices in ms, one per level (e.g. "MLFQ:500,1000,2000")
+ */
+static void *mlfq_init(const char *params) {
+    mlfq_t *mlfq = calloc(1, sizeof(mlfq_t));
+    if (!mlfq) return NULL;
+    if (!params) {
+        mlfq->num_queues = NUM_QUEUES;
+        mlfq->time_slices[0] = 500;
+        mlfq->time_slices[1] = 1000;
+        mlfq->time_slices[2] = 2000;
+        for (uint32_t i = 0; i < mlfq->num_queues; i++) {
+            mlfq->time_slices_ns[i] = mlfq->time_slices[i] * NS_PER_MS;
+        }
+        return mlfq;
+    }
+    const char *p = params;
+    while (*p != '\0') {
+        char *endptr;
+        long slice = strtol(p, &endptr, 10);
+        if (endptr == p || slice <= 0 || slice > UINT32_MAX || mlfq->num_queues == MAX_QUEUES ||
+            (*endptr != ',' && *endptr != '\0')) {
+            free(mlfq);
+            return NULL;
+        }
+        mlfq->time_slices_ns[mlfq->num_queues] = (uint64_t) slice * NS_PER_MS;
+        mlfq->time_slices[mlfq->num_queues++] = (uint32_t) slice;
+        p = (*endptr == ',') ? endptr + 1 : endptr;
+    }
+    if (mlfq->num_queues == 0) {
+        free(mlfq);
+        return NULL;
+    }
+    return mlfq;
+}
 
-void mlfq_init() {
-    for (int i = 0; i < NUM_QUEUES; i++) {
-        mlfq.queues[i].head = NULL;
-        mlfq.queues[i].tail = NULL;
+static void mlfq_destroy(void *state) {
+    mlfq_t *mlfq = state;
+    for (uint32_t i = 0; i < mlfq->num_queues; i++) {
+        ring_free(&mlfq->queues[i]);
     }
-    mlfq.time_slices[0] = 500;
-    mlfq.time_slices[1] = 1000;
-    mlfq.time_slices[2] = 2000;
+    free(mlfq);
 }
 
-void mlfq_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task, queue_t *command_queue) {
-    static int initialized = 0;
-    if (!initialized) {
-        mlfq_init();
-        initialized = 1;
+/**
+ * @brief Charge the CPU time the task used since it reached its level to that level
+ */
+static void account_level(mlfq_t *mlfq, pcb_t *task) {
+    if (task->ellapsed_time_ns > task->cold->level_start_ns) {
+        mlfq->cpu_ns[task->queue_level] += task->ellapsed_time_ns - task->cold->level_start_ns;
     }
+    task->cold->level_start_ns = task->ellapsed_time_ns;
+}
 
-    // Handle currently running task
-    if (*cpu_task) {
-        (*cpu_task)->ellapsed_time_ms += TICKS_MS;
-        current_slice_time += TICKS_MS;
-
-        // Check if task finished
-        if ((*cpu_task)->ellapsed_time_ms >= (*cpu_task)->time_ms) {
-            msg_t msg = {
-                .pid = (*cpu_task)->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write((*cpu_task)->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
-            }
-            // Return to command queue
-            (*cpu_task)->status = TASK_COMMAND;
-            (*cpu_task)->time_ms = 0;
-            (*cpu_task)->ellapsed_time_ms = 0;
-            enqueue_pcb(command_queue, *cpu_task);
-            *cpu_task = NULL;
-            current_slice_time = 0;
-        }
-        // Check if time slice expired
-        else if (current_slice_time >= mlfq.time_slices[current_queue_level]) {
-            // Demote to lower queue if possible
-            // Demote to lower queue if possible
-            int target_queue = current_queue_level;
-            if (current_queue_level < NUM_QUEUES - 1) {
-                target_queue++;
-            }
-            enqueue_pcb(&mlfq.queues[target_queue], *cpu_task);
-            *cpu_task = NULL;
-            current_slice_time = 0;
-        }
+/**
+ * @brief Get the level of a priority, the lowest one if there are fewer queues
+ */
+static uint32_t clamp_level(const mlfq_t *mlfq, uint32_t priority) {
+    return priority < mlfq->num_queues ? priority : mlfq->num_queues - 1;
+}
+
+/**
+ * @brief Get the level of its own a task is at: the one MLFQ gave it from its nice and its CPU use
+ *
+ * While a task inherits, queue_level may be higher, its own level is kept aside.
+ */
+static uint32_t own_level(const pcb_t *task) {
+    return task->cold->own_level != UINT32_MAX ? task->cold->own_level : task->queue_level;
+}
+
+/**
+ * @brief Set the level of its own a task is at, and get the level it runs at
+ *
+ * That is the higher of its own level and the one it inherited (see locks.h).
+ */
+static uint32_t run_level(const mlfq_t *mlfq, pcb_t *task, uint32_t own) {
+    int inherits = task->cold->inherited != UINT32_MAX;
+    task->cold->own_level = inherits ? own : UINT32_MAX;
+    uint32_t inherited = inherits ? clamp_level(mlfq, task->cold->inherited) : UINT32_MAX;
+    return inherited < own ? inherited : own;
+}
+
+/**
+ * @brief Put a task that is not queued at a level
+ */
+static void set_level(mlfq_t *mlfq, pcb_t *task, uint32_t level) {
+    if (level == task->queue_level) return;
+    account_level(mlfq, task);
+    task->queue_level = level;
+}
+
+/**
+ * @brief Put a task at a level, a queued one moves to its new queue right away
+ */
+static void move_level(mlfq_t *mlfq, pcb_t *task, uint32_t level) {
+    int queued = ring_remove(&mlfq->queues[task->queue_level], task);
+    set_level(mlfq, task, level);
+    if (queued) {
+        ring_push(&mlfq->queues[level], task);
     }
+}
 
-    // Move new tasks to Q0
-    while (rq->head != NULL) {
-        pcb_t *new_task = dequeue_pcb(rq);
-        enqueue_pcb(&mlfq.queues[0], new_task);
+static void mlfq_enqueue(void *state, pcb_t *task, sched_enqueue_reason_en reason, uint64_t current_time_ns) {
+    (void) current_time_ns;
+    mlfq_t *mlfq = state;
+    if (reason == SCHED_ENQUEUE_NEW) {
+        // At the level it got when its last burst ended (see mlfq_on_block) or from RENICE
+        task->cold->level_start_ns = task->ellapsed_time_ns;
+    } else if (reason == SCHED_ENQUEUE_PREEMPTED) {
+        // Used its whole time slice: demote to lower queue if possible (not below the level it inherited)
+        uint32_t own = own_level(task);
+        set_level(mlfq, task, run_level(mlfq, task, own < mlfq->num_queues - 1 ? own + 1 : own));
     }
+    ring_push(&mlfq->queues[task->queue_level], task);
+}
 
+static void mlfq_on_block(void *state, pcb_t *task, uint64_t current_time_ns) {
+    (void) current_time_ns;
+    mlfq_t *mlfq = state;
+    // Gave the CPU up before its time slice was over: its next request starts back at the top
+    set_level(mlfq, task, run_level(mlfq, task, clamp_level(mlfq, task->cold->nice)));
+    account_level(mlfq, task);
+    task->cold->level_start_ns = 0;
+}
+
+static void mlfq_on_exit(void *state, pcb_t *task) {
+    (void) state;
+    // The pcb goes to another task
+    task->cold->level_start_ns = 0;
+    task->cold->own_level = UINT32_MAX;
+    task->queue_level = 0;
+}
+
+static int mlfq_remove(void *state, pcb_t *task) {
+    mlfq_t *mlfq = state;
+    return ring_remove(&mlfq->queues[task->queue_level], task);
+}
+
+static void mlfq_renice(void *state, pcb_t *task) {
+    mlfq_t *mlfq = state;
+    // Its own level starts over at its nice
+    move_level(mlfq, task, run_level(mlfq, task, clamp_level(mlfq, task->cold->nice)));
+}
+
+static void mlfq_inherit(void *state, pcb_t *task) {
+    mlfq_t *mlfq = state;
+    // Keeps its own level, demotion included: back to it once it inherits nothing
+    move_level(mlfq, task, run_level(mlfq, task, own_level(task)));
+}
+
+static pcb_t *mlfq_pick_next(void *state, uint64_t current_time_ns) {
+    (void) current_time_ns;
+    mlfq_t *mlfq = state;
     // Find highest priority task
-    if (*cpu_task == NULL) {
-        for (int i = 0; i < NUM_QUEUES; i++) {
-            if (mlfq.queues[i].head != NULL) {
-                *cpu_task = dequeue_pcb(&mlfq.queues[i]);
-                current_queue_level = i;
-                current_slice_time = 0;
-                break;
-            }
+    for (uint32_t i = 0; i < mlfq->num_queues; i++) {
+        if (mlfq->queues[i].count > 0) {
+            mlfq->dispatches[i]++;
+            return ring_pop(&mlfq->queues[i]);
         }
     }
-}
\ No newline at end of file
+    return NULL;
+}
+
+static int mlfq_tick(void *state, pcb_t *task, uint64_t current_time_ns) {
+    mlfq_t *mlfq = state;
+    // Check if time slice expired
+    return current_time_ns - task->slice_start_ns >= mlfq->time_slices_ns[task->queue_level];
+}
+
+static void mlfq_stats_add(void *state, const void *other) {
+    mlfq_t *mlfq = state;
+    const mlfq_t *from = other;
+    for (uint32_t i = 0; i < mlfq->num_queues; i++) {
+        mlfq->dispatches[i] += from->dispatches[i];
+        mlfq->cpu_ns[i] += from->cpu_ns[i];
+    }
+}
+
+static void mlfq_stats(void *state, FILE *out) {
+    mlfq_t *mlfq = state;
+    for (uint32_t i = 0; i < mlfq->num_queues; i++) {
+        fprintf(out, "MLFQ level %u: time slice %u ms, %llu dispatches, %.3f s of CPU\n",
+                i, mlfq->time_slices[i], (unsigned long long) mlfq->dispatches[i], (double) mlfq->cpu_ns[i] / 1e9);
+    }
+}
+
+const scheduler_ops_t mlfq_ops = {
+    .name = "MLFQ",
+    .init = mlfq_init,
+    .destroy = mlfq_destroy,
+    .enqueue = mlfq_enqueue,
+    .pick_next = mlfq_pick_next,
+    .remove = mlfq_remove,
+    .tick = mlfq_tick,
+    .on_block = mlfq_on_block,
+    .on_exit = mlfq_on_exit,
+    .renice = mlfq_renice,
+    .inherit = mlfq_inherit,
+    .stats = mlfq_stats,
+    .stats_add = mlfq_stats_add,
+};
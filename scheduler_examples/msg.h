@@ -4,7 +4,14 @@
 // Not really the correct place, but this file is included where it is necessary,
 // and it did not feel like making a new file just for this was justified.
 
-#define TICKS_MS 10
+// Simulated times are 64-bit nanoseconds, the user still gives times in milliseconds
+#define NS_PER_S 1000000000ULL
+#define NS_PER_MS 1000000ULL
+#define NS_PER_US 1000ULL
+
+// Default length of a tick, the simulator can be run with ticks from MIN_TICK_NS
+#define DEFAULT_TICK_NS (10 * NS_PER_MS)
+#define MIN_TICK_NS (100 * NS_PER_US)
 
 #include <stdint.h>
 #include <sys/types.h>
@@ -13,12 +20,31 @@
 
 #define MAX_PAGES 32
 
+// Maximum number of requests in a script
+#define SCRIPT_MAX_REQUESTS MAX_PAGES
+
+// Block address of a BLOCK request that does not target a specific block
+#define BLOCK_ADDRESS_NONE UINT32_MAX
+
+// Longest name of a mutex, with its terminating 0 (a multiple of 4, see msglog.h)
+#define MUTEX_NAME_LEN 32
+
 // Define process request strings for debugging purposes
 static const char PROCESS_REQUEST_STRINGS[][10] = {
     "RUN",
     "BLOCK",
     "ACK",
-    "DONE"
+    "DONE",
+    "ATTACH",
+    "MUX",
+    "SCRIPT",
+    "KILL",
+    "RENICE",
+    "SUSPEND",
+    "RESUME",
+    "NACK",
+    "LOCK",
+    "UNLOCK"
 };
 
 // Define the types of requests a process can make to the scheduler
@@ -27,21 +53,50 @@ typedef enum  {
     PROCESS_REQUEST_BLOCK,
     PROCESS_REQUEST_ACK,
     PROCESS_REQUEST_DONE,
+    PROCESS_REQUEST_ATTACH,         // Switch to the shared-memory transport (see shm_channel.h)
+    PROCESS_REQUEST_MUX,            // The pid of each message identifies a virtual process (see mux.h)
+    PROCESS_REQUEST_SCRIPT,         // The next time_ns messages are RUN/BLOCK requests to run back to back
+    // Control requests, for the task with the pid of the message (answered with ACK, or NACK if they failed)
+    PROCESS_REQUEST_KILL,           // Remove the task from the simulation (its connection is closed)
+    PROCESS_REQUEST_RENICE,         // Set the priority level of the task to time_ns (0 is the highest)
+    PROCESS_REQUEST_SUSPEND,        // Give the task no CPU until it is resumed
+    PROCESS_REQUEST_RESUME,
+    PROCESS_REQUEST_NACK,           // Reply to a control request that failed, or to a killed virtual process
+    // Mutex requests, answered with ACK and then DONE once the mutex was taken (or given back)
+    PROCESS_REQUEST_LOCK,           // Take the mutex named by the message, waiting while another task holds it
+    PROCESS_REQUEST_UNLOCK,         // Give back a mutex the task holds (NACK if it does not)
 } process_request_t;
 
 // Define the structure for page information
-// Note: Not used until we get to memory management, but defined here for completeness
+// Sent with RUN requests, the simulator references these pages when the burst runs
 typedef struct {
     uint32_t count;            // Number of pages in the burst
     uint32_t ids[MAX_PAGES];      // Array of pages (up to MAX_PAGES)
 } page_info_t;
 
+// Define the completion record of a script
+// Sent as a payload right after the DONE of the last request, only its first script_len end times
+typedef struct {
+    uint64_t end_ns[SCRIPT_MAX_REQUESTS];   // Time each request finished, in script order
+} script_times_t;
+
+// Bytes of the completion record of a script of count requests
+#define SCRIPT_TIMES_SIZE(count) ((uint32_t) (count) * (uint32_t) sizeof(uint64_t))
+
 // Define the message structure for communication between applications and the scheduler
 // This structure is sent over the socket
 typedef struct {
     pid_t pid;                      // Process ID
     process_request_t request;      // Request type
-    uint32_t time_ms;               // Time information
+    uint64_t time_ns;               // Time information (requested time, or simulated time of a reply)
+    union {
+        page_info_t pages;          // Pages referenced by a RUN request (count is 0 otherwise)
+        uint32_t script_len;        // Requests of the script whose end times follow a DONE (0 otherwise)
+        char mutex[MUTEX_NAME_LEN]; // Name of the mutex of a LOCK or UNLOCK request
+    };
+    uint32_t device;                // Device of a BLOCK request
+    uint32_t block;                 // Block address of a BLOCK request (BLOCK_ADDRESS_NONE if none)
+    uint32_t nice;                  // Priority level of a RUN request plus one (0 keeps the level of the task, see RENICE)
 } msg_t;
 
 
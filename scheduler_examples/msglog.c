@@ -0,0 +1,99 @@
+#include "msglog.h"
+
+#include <string.h>
+
+int msglog_create(msglog_t *log, const char *path, const msglog_header_t *header) {
+    memset(log, 0, sizeof(msglog_t));
+    log->file = fopen(path, "wb");
+    if (!log->file) {
+        perror("fopen");
+        return -1;
+    }
+    log->header = *header;
+    memcpy(log->header.magic, MSGLOG_MAGIC, sizeof(log->header.magic));
+    log->header.version = MSGLOG_VERSION;
+    if (fwrite(&log->header, sizeof(msglog_header_t), 1, log->file) != 1) {
+        perror("fwrite");
+        fclose(log->file);
+        log->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// The name of a mutex is stored in the place of the page ids
+_Static_assert(MUTEX_NAME_LEN % sizeof(uint32_t) == 0 && MUTEX_NAME_LEN <= MAX_PAGES * sizeof(uint32_t),
+               "a mutex name must fit in the page ids of a record");
+
+void msglog_write(msglog_t *log, uint64_t time_ns, int32_t conn, msglog_event_en event, const msg_t *msg) {
+    // Only RUN requests carry pages
+    uint32_t num_pages = (msg && msg->request == PROCESS_REQUEST_RUN) ? msg->pages.count : 0;
+    if (num_pages > MAX_PAGES) num_pages = MAX_PAGES;
+    const void *payload = msg ? msg->pages.ids : NULL;
+    if (msg && (msg->request == PROCESS_REQUEST_LOCK || msg->request == PROCESS_REQUEST_UNLOCK)) {
+        num_pages = MUTEX_NAME_LEN / sizeof(uint32_t);
+        payload = msg->mutex;
+    }
+    msglog_record_t record = {
+        .time_ns = time_ns,
+        .conn = conn,
+        .event = (uint8_t) event,
+        .request = msg ? (uint8_t) msg->request : 0,
+        .pid = msg ? msg->pid : 0,
+        .msg_time_ns = msg ? msg->time_ns : 0,
+        .num_pages = (uint8_t) num_pages,
+        .device = msg ? msg->device : 0,
+        .block = msg ? msg->block : BLOCK_ADDRESS_NONE,
+        .nice = msg ? msg->nice : 0,
+    };
+    if (fwrite(&record, sizeof(msglog_record_t), 1, log->file) != 1 ||
+        (num_pages > 0 && fwrite(payload, sizeof(uint32_t), num_pages, log->file) != num_pages)) {
+        perror("fwrite");
+        return;
+    }
+    log->records++;
+}
+
+int msglog_open(msglog_t *log, const char *path) {
+    memset(log, 0, sizeof(msglog_t));
+    log->file = fopen(path, "rb");
+    if (!log->file) {
+        perror("fopen");
+        return -1;
+    }
+    if (fread(&log->header, sizeof(msglog_header_t), 1, log->file) != 1 ||
+        memcmp(log->header.magic, MSGLOG_MAGIC, sizeof(log->header.magic)) != 0 ||
+        log->header.version != MSGLOG_VERSION) {
+        fprintf(stderr, "%s is not a message log (or has an unsupported version)\n", path);
+        fclose(log->file);
+        log->file = NULL;
+        return -1;
+    }
+    log->header.scheduler[sizeof(log->header.scheduler) - 1] = '\0';
+    return 0;
+}
+
+int msglog_read(msglog_t *log, msglog_record_t *record, page_info_t *pages) {
+    if (fread(record, sizeof(msglog_record_t), 1, log->file) != 1) {
+        if (ferror(log->file)) {
+            perror("fread");
+            return -1;
+        }
+        return 0;
+    }
+    pages->count = record->num_pages;
+    if (pages->count > MAX_PAGES ||
+        fread(pages->ids, sizeof(uint32_t), pages->count, log->file) != pages->count) {
+        fprintf(stderr, "Truncated message log\n");
+        return -1;
+    }
+    log->records++;
+    return 1;
+}
+
+void msglog_close(msglog_t *log) {
+    if (log->file) {
+        fclose(log->file);
+        log->file = NULL;
+    }
+}
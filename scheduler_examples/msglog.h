@@ -0,0 +1,123 @@
+#ifndef MSGLOG_H
+#define MSGLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "admission.h"
+#include "cache.h"
+#include "io.h"
+#include "msg.h"
+#include "swap.h"
+#include "vm.h"
+
+/*
+ * Binary log of the messages exchanged between ossim and the applications.
+ *
+ * The log starts with a header holding the simulator configuration, followed by
+ * fixed-size records, one per event, in the order they happened. Every record
+ * carries the simulated time and the connection (socket descriptor) it belongs to.
+ * A record of a message with pages is followed by its num_pages page ids, and the
+ * record of a LOCK or UNLOCK by the name of its mutex (MUTEX_NAME_LEN bytes).
+ * Feeding the inbound records back to ossim at the same simulated times reproduces
+ * the run exactly, without the applications.
+ */
+
+#define MSGLOG_MAGIC "OSML"
+#define MSGLOG_VERSION 11
+
+// Define the events stored in the log
+typedef enum {
+    MSGLOG_CONNECT = 0,         // Application connected
+    MSGLOG_RECV,                // Message received from the application
+    MSGLOG_SEND,                // Message sent to the application
+    MSGLOG_CLOSE,               // Application disconnected
+} msglog_event_en;
+
+// Define the log header
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t tick_ns;
+    uint32_t ncpus;
+    uint32_t switch_cost_us;
+    uint32_t migration_cost_us;
+    char scheduler[64];         // Scheduler name and parameters
+    vm_config_t vm;             // Virtual memory configuration (num_frames is 0 if not simulated)
+    cache_config_t caches;      // Cache configuration (tlb_entries is 0 if not simulated)
+    uint32_t swap_enabled;      // Non-zero if processes are swapped
+    swap_config_t swap;         // Swapping configuration
+    uint32_t num_devices;       // I/O devices (0 for independent timers)
+    io_device_config_t devices[IO_MAX_DEVICES];
+    admission_config_t admission; // Admission limits (all 0 if there is no admission control)
+    uint32_t priority_inheritance;  // Non-zero if the mutexes use priority inheritance
+    uint32_t per_cpu_queues;    // Non-zero if every CPU has its own run queue (-P)
+} msglog_header_t;
+
+// Define a log record (packed, 39 bytes, followed by num_pages uint32_t page ids)
+typedef struct __attribute__((packed)) {
+    uint64_t time_ns;           // Simulated time of the event
+    int32_t conn;               // Connection the event belongs to
+    uint8_t event;              // msglog_event_en
+    uint8_t request;            // process_request_t (RECV/SEND only)
+    int32_t pid;                // Message pid (RECV/SEND only)
+    uint64_t msg_time_ns;       // Message time (RECV/SEND only)
+    uint8_t num_pages;          // Number of page ids after the record (RUN only, or the mutex name of LOCK/UNLOCK)
+    uint32_t device;            // Message device (RECV/SEND only)
+    uint32_t block;             // Message block address (RECV/SEND only)
+    uint32_t nice;              // Message priority level plus one (RECV/SEND only)
+} msglog_record_t;
+
+// Define an open log
+typedef struct {
+    FILE *file;
+    msglog_header_t header;
+    uint64_t records;           // Records written or read so far
+} msglog_t;
+
+/**
+ * @brief Create a log file and write its header
+ *
+ * @param log The log to open
+ * @param path The file to create
+ * @param header The simulator configuration (magic and version are filled in)
+ * @return 0 on success, -1 on failure
+ */
+int msglog_create(msglog_t *log, const char *path, const msglog_header_t *header);
+
+/**
+ * @brief Append a record to the log
+ *
+ * @param log The log
+ * @param time_ns The simulated time of the event
+ * @param conn The connection the event belongs to
+ * @param event The event
+ * @param msg The message (RECV/SEND only, NULL otherwise)
+ */
+void msglog_write(msglog_t *log, uint64_t time_ns, int32_t conn, msglog_event_en event, const msg_t *msg);
+
+/**
+ * @brief Open a log file and read its header
+ *
+ * @param log The log to open
+ * @param path The file to open
+ * @return 0 on success, -1 on failure
+ */
+int msglog_open(msglog_t *log, const char *path);
+
+/**
+ * @brief Read the next record from the log
+ *
+ * @param log The log
+ * @param record Where to store the record
+ * @param pages Where to store the pages of the message
+ * @return 1 if a record was read, 0 at the end of the log, -1 on error
+ */
+int msglog_read(msglog_t *log, msglog_record_t *record, page_info_t *pages);
+
+/**
+ * @brief Close the log
+ */
+void msglog_close(msglog_t *log);
+
+#endif //MSGLOG_H
@@ -0,0 +1,123 @@
+#include "mux.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MUX_INITIAL_CAPACITY 64
+
+static uint32_t pid_hash(pid_t pid) {
+    return (uint32_t) pid * 0x9E3779B1u;
+}
+
+mux_t *mux_create(pcb_t *owner) {
+    mux_t *mux = calloc(1, sizeof(mux_t));
+    if (!mux) return NULL;
+    mux->slots = calloc(MUX_INITIAL_CAPACITY, sizeof(pcb_t *));
+    if (!mux->slots) {
+        free(mux);
+        return NULL;
+    }
+    mux->sockfd = owner->cold->sockfd;
+    mux->owner = owner;
+    mux->capacity = MUX_INITIAL_CAPACITY;
+    return mux;
+}
+
+void mux_destroy(mux_t *mux) {
+    if (!mux) return;
+    free(mux->slots);
+    free(mux->out);
+    free(mux);
+}
+
+pcb_t *mux_find(const mux_t *mux, pid_t pid) {
+    uint32_t mask = mux->capacity - 1;
+    for (uint32_t i = pid_hash(pid) & mask; mux->slots[i] != NULL; i = (i + 1) & mask) {
+        if (mux->slots[i]->pid == pid) return mux->slots[i];
+    }
+    return NULL;
+}
+
+static void insert(pcb_t **slots, uint32_t capacity, pcb_t *pcb) {
+    uint32_t i = pid_hash(pcb->pid) & (capacity - 1);
+    while (slots[i] != NULL) i = (i + 1) & (capacity - 1);
+    slots[i] = pcb;
+}
+
+int mux_add(mux_t *mux, pcb_t *pcb) {
+    // Keep the table at most half full
+    if (2 * (mux->count + 1) > mux->capacity) {
+        uint32_t capacity = 2 * mux->capacity;
+        pcb_t **slots = calloc(capacity, sizeof(pcb_t *));
+        if (!slots) return -1;
+        for (uint32_t i = 0; i < mux->capacity; i++) {
+            if (mux->slots[i]) insert(slots, capacity, mux->slots[i]);
+        }
+        free(mux->slots);
+        mux->slots = slots;
+        mux->capacity = capacity;
+    }
+    insert(mux->slots, mux->capacity, pcb);
+    mux->count++;
+    return 0;
+}
+
+void mux_remove(mux_t *mux, const pcb_t *pcb) {
+    uint32_t mask = mux->capacity - 1;
+    uint32_t i = pid_hash(pcb->pid) & mask;
+    while (mux->slots[i] != NULL && mux->slots[i] != pcb) i = (i + 1) & mask;
+    if (mux->slots[i] == NULL) return;
+    mux->slots[i] = NULL;
+    mux->count--;
+    // Move back the entries of the cluster that would not be found past the hole
+    for (uint32_t j = (i + 1) & mask; mux->slots[j] != NULL; j = (j + 1) & mask) {
+        pcb_t *moved = mux->slots[j];
+        uint32_t home = pid_hash(moved->pid) & mask;
+        // The entry stays if its home lies cyclically in (i, j]
+        if (i <= j ? (home > i && home <= j) : (home > i || home <= j)) continue;
+        mux->slots[i] = moved;
+        mux->slots[j] = NULL;
+        i = j;
+    }
+}
+
+int mux_flush(mux_t *mux) {
+    uint32_t sent = 0;
+    int status = 0;
+    while (sent < mux->out_len) {
+        ssize_t n = write((int) mux->sockfd, mux->out + sent, mux->out_len - sent);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // The peer is gone, the replies are dropped
+                sent = mux->out_len;
+                status = -1;
+            }
+            break;
+        }
+        sent += (uint32_t) n;
+    }
+    memmove(mux->out, mux->out + sent, mux->out_len - sent);
+    mux->out_len -= sent;
+    return status;
+}
+
+int mux_send(mux_t *mux, const msg_t *msg, const void *payload, uint32_t len) {
+    if (mux->out_len + sizeof(msg_t) + len > mux->out_capacity) {
+        uint32_t capacity = mux->out_capacity ? 2 * mux->out_capacity : 64 * sizeof(msg_t);
+        while (mux->out_len + sizeof(msg_t) + len > capacity) capacity *= 2;
+        uint8_t *out = realloc(mux->out, capacity);
+        if (!out) return -1;
+        mux->out = out;
+        mux->out_capacity = capacity;
+    }
+    memcpy(mux->out + mux->out_len, msg, sizeof(msg_t));
+    mux->out_len += sizeof(msg_t);
+    if (len > 0) {
+        memcpy(mux->out + mux->out_len, payload, len);
+        mux->out_len += len;
+    }
+    return mux_flush(mux);
+}
@@ -0,0 +1,89 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <stdint.h>
+
+#include "queue.h"
+
+/*
+ * Multiplexed connections.
+ *
+ * Normally every application is a process with its own connection, and the
+ * connection identifies the process. A load generator instead sends a MUX message
+ * first and then drives many virtual processes over the same connection: the pid
+ * of each message identifies the virtual process. The simulator creates a pcb the
+ * first time it sees a pid on the connection, and the replies carry the pid back.
+ *
+ * The pcbs of a multiplexed connection are owned by the connection. Between
+ * requests they wait in its table instead of the command queue, and when the
+ * connection closes they are freed as soon as the scheduler and the I/O
+ * subsystem are done with them.
+ *
+ * The replies of thousands of processes can fill the socket buffer, so the
+ * replies that do not fit are kept and written when the socket has room again.
+ */
+
+// Define a multiplexed connection
+typedef struct mux_st {
+    uint32_t sockfd;
+    pcb_t *owner;               // pcb of the connection itself, which reads its messages
+    int closed;                 // The load generator disconnected
+    pcb_t **slots;              // Open addressing by pid (NULL: empty slot)
+    uint32_t capacity;          // Power of two
+    uint32_t count;
+    uint8_t *out;               // Replies not written yet
+    uint32_t out_len;
+    uint32_t out_capacity;
+} mux_t;
+
+/**
+ * @brief Create the state of a multiplexed connection
+ *
+ * @param owner The pcb of the connection
+ * @return The state, or NULL on failure
+ */
+mux_t *mux_create(pcb_t *owner);
+
+/**
+ * @brief Free the state of a connection (the pcbs are not freed)
+ */
+void mux_destroy(mux_t *mux);
+
+/**
+ * @brief Find the pcb of a virtual process
+ *
+ * @return The pcb, or NULL if the pid was not seen on this connection
+ */
+pcb_t *mux_find(const mux_t *mux, pid_t pid);
+
+/**
+ * @brief Add the pcb of a new virtual process
+ *
+ * @return 0 on success, -1 on failure
+ */
+int mux_add(mux_t *mux, pcb_t *pcb);
+
+/**
+ * @brief Remove the pcb of a virtual process
+ */
+void mux_remove(mux_t *mux, const pcb_t *pcb);
+
+/**
+ * @brief Write a reply, after the ones that are still waiting for room in the socket
+ *
+ * @param mux The multiplexed connection
+ * @param msg The reply
+ * @param payload Bytes written right after the reply (NULL if none)
+ * @param len Length of the payload
+ * @return 0 on success (the reply may still be waiting), -1 on a write error
+ */
+int mux_send(mux_t *mux, const msg_t *msg, const void *payload, uint32_t len);
+
+/**
+ * @brief Write the replies waiting for room in the socket
+ *
+ * @return 0 on success, -1 on a write error
+ */
+int mux_flush(mux_t *mux);
+
+#endif //MUX_H
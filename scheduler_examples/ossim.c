@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <signal.h>
 
 #include "debug.h"
 
@@ -12,12 +14,311 @@
 #include <stdlib.h>
 #include <sys/errno.h>
 
-#include "fifo.h"
+#include "admission.h"
 #include "msg.h"
+#include "msglog.h"
+#include "mux.h"
+#include "pidindex.h"
 #include "queue.h"
+#include "realproc.h"
+#include "replay.h"
+#include "io.h"
+#include "locks.h"
+#include "metrics.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "shm_channel.h"
+#include "tickclock.h"
+#include "tickstat.h"
+#include "timerset.h"
+#include "trace.h"
+#include "uring.h"
 
 static uint32_t PID = 0;
 
+// PCBs of the connections and of their virtual processes
+static pcb_table_t pcbs;
+
+// The PCBs by pid, for the control requests
+static pid_index_t pids = {.table = &pcbs};
+
+// Admission control of the requests and connections (no limit unless configured)
+static admission_t admission;
+
+// Tasks whose request waits for admission, in arrival order
+static queue_t deferred_queue = {.head = NULL, .tail = NULL};
+static uint32_t num_deferred = 0;
+
+// Length of a tick, the simulated time advances by one tick per iteration of the main loop
+static uint64_t tick_ns = DEFAULT_TICK_NS;
+
+// Define the queues and the scheduler a finished request hands the task to
+typedef struct {
+    queue_t *command_queue;
+    timer_set_t *blocked_timers;
+    scheduler_t *scheduler;
+} ossim_queues_t;
+
+// Define a script: requests uploaded at once and run back to back without a reply in between
+typedef struct script_st {
+    uint32_t expected;                      // Requests announced by the SCRIPT message
+    uint32_t len;                           // Requests received so far
+    uint32_t pos;                           // Request being run
+    msg_t requests[SCRIPT_MAX_REQUESTS];
+    script_times_t times;                   // Completion record, sent after the final DONE
+} script_t;
+
+// Named mutexes of the LOCK and UNLOCK requests
+static locks_t locks;
+
+// Connections multiplexing virtual processes, their pcb is not a task (see mux.h)
+static uint32_t num_mux_owners = 0;
+
+// Tasks whose LOCK or UNLOCK request finished, their DONE is sent with the blocked ones
+static queue_t lock_done_queue = {.head = NULL, .tail = NULL};
+
+// Scheduling events of this run, always recorded
+static trace_t tracer;
+
+// I/O devices of this run (no devices: every BLOCK is an independent timer)
+static io_t io_devices;
+
+// io_uring backend for the client sockets (NULL: one POSIX call per accept, read and write)
+static uring_t *uring = NULL;
+// Syscalls made for the client sockets, to compare the backends
+static uint64_t socket_syscalls = 0;
+
+// Live metrics endpoint (NULL if not serving metrics)
+static metrics_t *metrics = NULL;
+
+// Real processes the decisions are enforced on (NULL if the applications are simulated only)
+static realproc_t *realproc = NULL;
+
+// Log where the messages of this run are recorded (NULL if not recording)
+static msglog_t *recorder = NULL;
+// Recorded run that replaces the applications (NULL if not replaying)
+static replay_t *replay = NULL;
+
+// Timing of the phases of the main loop, always measured
+static tickstat_t tick_stats;
+
+// Cleared by SIGINT/SIGTERM to leave the main loop and print the statistics
+static volatile sig_atomic_t keep_running = 1;
+// Set by SIGUSR1 to print the timing of the main loop without stopping
+static volatile sig_atomic_t report_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void) sig;
+    keep_running = 0;
+}
+
+static void handle_report_signal(int sig) {
+    (void) sig;
+    report_requested = 1;
+}
+
+/**
+ * @brief Parse a non-negative integer value from a command line option.
+ *
+ * @param arg The option argument
+ * @param value Where to store the parsed value
+ * @return 0 on success, -1 if the argument is not a valid number
+ */
+static int parse_uint_option(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val < 0 || val > UINT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+/**
+ * @brief Send a message to the application owning a pcb.
+ *
+ * @param pcb The pcb of the application
+ * @param request The request type (ACK or DONE)
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void send_msg(pcb_t *pcb, process_request_t request, uint64_t current_time_ns) {
+    msg_t msg = {
+        .pid = pcb->pid,
+        .request = request,
+        .time_ns = current_time_ns,
+        .block = BLOCK_ADDRESS_NONE
+    };
+    // The DONE that ends a script is followed by the end time of each of its requests
+    const void *payload = NULL;
+    uint32_t len = 0;
+    if (request == PROCESS_REQUEST_DONE && pcb->cold->script) {
+        msg.script_len = pcb->cold->script->len;
+        payload = pcb->cold->script->times.end_ns;
+        len = SCRIPT_TIMES_SIZE(msg.script_len);
+    }
+    if (request != PROCESS_REQUEST_NACK) {
+        trace_event(&tracer, current_time_ns, request == PROCESS_REQUEST_ACK ? TRACE_ACK : TRACE_DONE,
+                    TRACE_NO_CPU, pcb->pid, 0);
+    }
+    if (recorder) {
+        msglog_write(recorder, current_time_ns, (int32_t) pcb->cold->sockfd, MSGLOG_SEND, &msg);
+    }
+    if (replay) {
+        replay_check_send(replay, current_time_ns, (int32_t) pcb->cold->sockfd, &msg);
+        return;
+    }
+    if (pcb->cold->mux && pcb->cold->mux->closed) {
+        // The load generator is gone (and the fd may belong to another client by now)
+        return;
+    }
+    if (pcb->cold->channel) {
+        if (shm_ring_push_payload(&pcb->cold->channel->responses, &msg, payload, len) < 0) {
+            fprintf(stderr, "Response ring of process %d is full\n", pcb->pid);
+        }
+        return;
+    }
+    if (uring) {
+        // Sent with the other replies of this tick
+        if (uring_send(uring, (int) pcb->cold->sockfd, &msg, payload, len) < 0) {
+            fprintf(stderr, "Failed to queue a message for process %d\n", pcb->pid);
+        }
+        return;
+    }
+    socket_syscalls++;
+    if (pcb->cold->mux) {
+        // The replies of many processes share the socket, what does not fit is written later
+        if (mux_send(pcb->cold->mux, &msg, payload, len) < 0) {
+            perror("write");
+        }
+        return;
+    }
+    struct iovec iov[2] = {
+        {.iov_base = &msg, .iov_len = sizeof(msg_t)},
+        {.iov_base = (void *) payload, .iov_len = len}
+    };
+    if (writev(pcb->cold->sockfd, iov, len > 0 ? 2 : 1) != (ssize_t) (sizeof(msg_t) + len)) {
+        perror("write");
+    }
+}
+
+/**
+ * @brief Accept the next pending client connection.
+ *
+ * The client socket is set to non-blocking and close-on-exec. When replaying,
+ * the connection comes from the log instead of the server socket.
+ *
+ * @param server_fd The server socket file descriptor
+ * @return The client file descriptor, or -1 if there are no more pending connections
+ */
+static int accept_client(int server_fd) {
+    if (replay) {
+        return replay_accept(replay);
+    }
+    if (uring) {
+        // Accepted with SOCK_CLOEXEC by the multishot accept, never read directly
+        return uring_accept(uring);
+    }
+    while (1) {
+        socket_syscalls++;
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                perror("accept: too many fds");
+                return -1;
+            }
+            if (errno == EINTR)        continue;   // interrupted -> retry
+            if (errno == ECONNABORTED) continue;   // aborted handshake -> next
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                perror("accept");
+            }
+            // No more clients to accept right now
+            return -1;
+        }
+        socket_syscalls += 4;
+        int flags = fcntl(client_fd, F_GETFL, 0); // Get current flags
+        if (flags != -1) {
+            if (fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+                perror("fcntl: set non-blocking");
+            }
+        }
+        // Set close-on-exec flag
+        int fdflags = fcntl(client_fd, F_GETFD, 0);
+        if (fdflags != -1) {
+            fcntl(client_fd, F_SETFD, fdflags | FD_CLOEXEC);
+        }
+        return client_fd;
+    }
+}
+
+/**
+ * @brief Read a message from the application owning a pcb.
+ *
+ * Works like read on the non-blocking client socket. When replaying, the message
+ * comes from the log instead of the socket. An application that attached a
+ * shared-memory channel is polled without syscalls; its socket is only checked
+ * once per simulated second, in case the application died without closing the
+ * channel.
+ *
+ * @param pcb The pcb of the application
+ * @param msg Where to store the message
+ * @param current_time_ns The current time in nanoseconds
+ * @return The number of bytes read, 0 if the connection was closed, -1 on error (errno set)
+ */
+static int read_client(pcb_t *pcb, msg_t *msg, uint64_t current_time_ns) {
+    if (replay) {
+        int n = replay_read(replay, (int32_t) pcb->cold->sockfd, msg);
+        if (n < 0) errno = EAGAIN;
+        return n;
+    }
+    if (pcb->cold->channel) {
+        if (shm_ring_pop(&pcb->cold->channel->requests, msg)) return sizeof(msg_t);
+        if (atomic_load(&pcb->cold->channel->closed)) return 0;
+        char byte;
+        // Once per simulated second (the tick that crossed it)
+        if (current_time_ns % NS_PER_S < tick_ns) {
+            socket_syscalls++;
+            if (recv(pcb->cold->sockfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0) return 0;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+    int fd;
+    int n;
+    if (uring) {
+        n = uring_read(uring, (int) pcb->cold->sockfd, msg, &fd);
+    } else {
+        socket_syscalls++;
+        n = shm_channel_recv(pcb->cold->sockfd, msg, &fd);
+    }
+    if (n == sizeof(msg_t) && msg->request == PROCESS_REQUEST_ATTACH) {
+        if (fd < 0 || (pcb->cold->channel = shm_channel_attach(fd)) == NULL) {
+            fprintf(stderr, "ATTACH without a valid shared-memory channel\n");
+            errno = EPROTO;
+            return -1;
+        }
+        DBG("[Scheduler] Client fd=%d switched to shared memory\n", pcb->cold->sockfd);
+        return read_client(pcb, msg, current_time_ns);
+    }
+    return n;
+}
+
+/**
+ * @brief Put a task that finished its request where it waits for the next one.
+ *
+ * The virtual processes of a multiplexed connection wait in the table of the
+ * connection, which reads their messages. The other tasks wait in the command
+ * queue, and so do the virtual processes of a closed connection, to be freed there.
+ *
+ * @param command_queue The command queue
+ * @param pcb The pcb of the task
+ */
+static void wait_for_command(queue_t *command_queue, pcb_t *pcb) {
+    if (pcb->cold->mux && !pcb->cold->mux->closed) return;
+    enqueue_pcb(command_queue, pcb);
+}
+
 
 /**
  * @brief Set up the server socket for the scheduler.
@@ -70,58 +371,516 @@ int setup_server_socket(const char *socket_path) {
 }
 
 /**
- * @brief Check for new client connections and add them to the queue.
+ * @brief Index a pcb by its pid.
  *
- * This function accepts new client connections on the server socket,
- * sets the client sockets to non-blocking mode, and enqueues them
- * into the provided queue.
+ * A pid already used by another task (e.g. by virtual processes of two load
+ * generators) stays with that task: the new pcb is then not reachable by the
+ * control requests, which is reported, and indexing is tried again at its next
+ * request.
  *
- * @param command_queue The queue to which new pcb will be added
- * @param server_fd The server socket file descriptor
+ * @param pcb The pcb
+ * @param report Non-zero to report a failure (the pid changed), zero when trying again
  */
-void check_new_commands(queue_t *command_queue, queue_t *blocked_queue, queue_t *ready_queue, int server_fd, uint32_t current_time_ms) {
-    // Accept new client connections
-    int client_fd;
-    do {
-        client_fd = accept(server_fd, NULL, NULL);
-        if (client_fd < 0) {
-            if (errno == EMFILE || errno == ENFILE) {
-                perror("accept: too many fds");
-                break;
+static void index_pcb(pcb_t *pcb, int report) {
+    if (pid_index_add(&pids, pcb) == 0) {
+        pcb->flags |= PCB_INDEXED;
+    } else if (report) {
+        fprintf(stderr, "Process %d cannot be indexed by its pid: %s\n", pcb->pid,
+                errno == EEXIST ? "the pid belongs to another task" : strerror(errno));
+    }
+}
+
+/**
+ * @brief Change the pid of a task to the one of its request, keeping the index up to date.
+ *
+ * A connection is only indexed once its first request tells the pid of the
+ * application: the id it gets when it connects is not a pid, and could be the
+ * one of a real process.
+ */
+static void set_pid(pcb_t *pcb, pid_t pid) {
+    if (pcb->pid == pid && (pcb->flags & PCB_INDEXED)) return;
+    int changed = pcb->pid != pid;
+    if (pcb->flags & PCB_INDEXED) {
+        pid_index_remove(&pids, pcb);
+        pcb->flags &= (uint16_t) ~PCB_INDEXED;
+    }
+    pcb->pid = pid;
+    index_pcb(pcb, changed);
+}
+
+/**
+ * @brief Return a pcb to the table once the task left the simulation.
+ *
+ * Its mutexes are handed to their next waiters.
+ */
+static void release_pcb(pcb_t *pcb, uint64_t current_time_ns) {
+    if (pcb->flags & PCB_INDEXED) {
+        pid_index_remove(&pids, pcb);
+    }
+    if (realproc) {
+        realproc_release(realproc, pcb);
+    }
+    locks_exit(&locks, pcb, current_time_ns, &lock_done_queue);
+    admission_release(&admission, pcb, UINT64_MAX);
+    free(pcb->cold->deferred);
+    pcb->cold->deferred = NULL;
+    free(pcb->cold->script);
+    free_pcb(&pcbs, pcb);
+}
+
+/**
+ * @brief Tell whether a request is one a task runs (RUN, BLOCK, LOCK or UNLOCK), answered with ACK and DONE.
+ */
+static int is_task_request(process_request_t request) {
+    return request == PROCESS_REQUEST_RUN || request == PROCESS_REQUEST_BLOCK ||
+           request == PROCESS_REQUEST_LOCK || request == PROCESS_REQUEST_UNLOCK;
+}
+
+/**
+ * @brief Start a RUN, BLOCK, LOCK or UNLOCK request of a task.
+ *
+ * RUN requests are handed to the scheduler, BLOCK requests go to their device or the blocked queue.
+ * LOCK and UNLOCK requests go to the mutex; the task is blocked until it holds the mutex (see check_lock_queue).
+ *
+ * @param pcb The pcb of the task
+ * @param msg The request
+ * @param queues Where the task goes
+ * @param current_time_ns The current time in nanoseconds
+ * @return 0 if the request was started, -1 if it is not a task request or the mutex cannot be taken or given back
+ */
+static int start_request(pcb_t *pcb, const msg_t *msg, const ossim_queues_t *queues, uint64_t current_time_ns) {
+    pcb->cold->request_ns = current_time_ns;
+    if (msg->request == PROCESS_REQUEST_RUN) {
+        set_pid(pcb, msg->pid); // Set the pid from the message
+        pcb->time_ns = msg->time_ns;
+        pcb->ellapsed_time_ns = 0;
+        pcb->cold->pages = msg->pages;
+        if (pcb->cold->pages.count > MAX_PAGES) pcb->cold->pages.count = MAX_PAGES;
+        // The nice of the burst, if it gives one (the policies without priorities ignore it)
+        if (msg->nice > 0 && msg->nice - 1 != pcb->cold->nice) {
+            scheduler_renice(queues->scheduler, pcb, msg->nice - 1);
+        }
+        pcb->status = TASK_RUNNING;
+        scheduler_enqueue(queues->scheduler, pcb, current_time_ns);
+        DBG("Process %d requested RUN for %.3f ms\n", pcb->pid, (double) pcb->time_ns / NS_PER_MS);
+    } else if (msg->request == PROCESS_REQUEST_BLOCK) {
+        set_pid(pcb, msg->pid); // Set the pid from the message
+        pcb->time_ns = msg->time_ns;
+        pcb->status = TASK_BLOCKED;
+        pcb->cold->io_device = msg->device;
+        pcb->cold->io_block = msg->block;
+        if (io_submit(&io_devices, pcb, current_time_ns) < 0) {
+            // Not a configured device, the request is an independent timer
+            timer_set_add(queues->blocked_timers, pcb, pcb->time_ns);
+        }
+        trace_event(&tracer, current_time_ns, TRACE_BLOCK, TRACE_NO_CPU, pcb->pid, pcb->time_ns);
+        DBG("Process %d requested BLOCK for %.3f ms\n", pcb->pid, (double) pcb->time_ns / NS_PER_MS);
+    } else if (msg->request == PROCESS_REQUEST_LOCK || msg->request == PROCESS_REQUEST_UNLOCK) {
+        set_pid(pcb, msg->pid); // Set the pid from the message
+        char name[MUTEX_NAME_LEN];
+        memcpy(name, msg->mutex, MUTEX_NAME_LEN);
+        name[MUTEX_NAME_LEN - 1] = '\0';
+        pcb->time_ns = 0;
+        pcb->status = TASK_BLOCKED;
+        int status = msg->request == PROCESS_REQUEST_LOCK ?
+                     locks_lock(&locks, pcb, name, current_time_ns, &lock_done_queue) :
+                     locks_unlock(&locks, pcb, name, current_time_ns, &lock_done_queue);
+        if (status < 0) {
+            pcb->status = TASK_COMMAND;
+            return -1;
+        }
+        DBG("Process %d requested %s of mutex %s\n", pcb->pid, PROCESS_REQUEST_STRINGS[msg->request], name);
+    } else {
+        return -1;
+    }
+    // A real process only runs on a simulated CPU until its request is done
+    if (realproc) {
+        realproc_stop(realproc, pcb);
+    }
+    return 0;
+}
+
+/**
+ * @brief Return the CPU work of a request: its time if it is a RUN, the time of all the RUNs of a script.
+ */
+static uint64_t request_work(const pcb_t *pcb, const msg_t *msg) {
+    const script_t *script = pcb->cold->script;
+    if (!script) return msg->request == PROCESS_REQUEST_RUN ? msg->time_ns : 0;
+    uint64_t work_ns = 0;
+    for (uint32_t i = 0; i < script->len; i++) {
+        if (script->requests[i].request == PROCESS_REQUEST_RUN) work_ns += script->requests[i].time_ns;
+    }
+    return work_ns;
+}
+
+/**
+ * @brief Return the pcb of the connection a task sends its requests on (NULL once a multiplexed connection closed).
+ */
+static pcb_t *client_of(pcb_t *pcb) {
+    return pcb->cold->mux ? pcb->cold->mux->owner : pcb;
+}
+
+/**
+ * @brief Start the request of a task that was admitted and send the ACK.
+ *
+ * A LOCK or UNLOCK the task cannot do (e.g. UNLOCK of a mutex it does not hold)
+ * is answered with NACK, and the task waits for its next request.
+ *
+ * @return 0 if the request was started, -1 if it was refused
+ */
+static int admit_request(pcb_t *pcb, const msg_t *msg, const ossim_queues_t *queues, uint64_t current_time_ns) {
+    if (start_request(pcb, msg, queues, current_time_ns) < 0) {
+        admission_release(&admission, pcb, UINT64_MAX);
+        free(pcb->cold->script);
+        pcb->cold->script = NULL;
+        send_msg(pcb, PROCESS_REQUEST_NACK, current_time_ns);
+        return -1;
+    }
+    // Send ack message
+    send_msg(pcb, PROCESS_REQUEST_ACK, current_time_ns);
+    DBG("Send ACK message to process %d with time %llu ns\n", pcb->pid, (unsigned long long) current_time_ns);
+    return 0;
+}
+
+/**
+ * @brief Handle a message of a task waiting for a command, and send the ACK once its request started.
+ *
+ * A SCRIPT message announces the RUN/BLOCK requests that follow it. They are
+ * collected and acknowledged together, and then run back to back (see request_done).
+ *
+ * A request that is not admitted waits in the deferred queue, without an ACK, and
+ * so does every request that arrives while others wait (see admit_deferred).
+ *
+ * @param pcb The pcb of the task
+ * @param msg The message
+ * @param queues Where the task goes
+ * @param current_time_ns The current time in nanoseconds
+ * @return 1 if a request was started, 2 if it was deferred, 0 if the task waits for the rest of its script, -1 if the message is unexpected
+ */
+static int handle_command(pcb_t *pcb, const msg_t *msg, const ossim_queues_t *queues, uint64_t current_time_ns) {
+    script_t *script = pcb->cold->script;
+    if (!script && msg->request == PROCESS_REQUEST_SCRIPT) {
+        if (msg->time_ns == 0 || msg->time_ns > SCRIPT_MAX_REQUESTS) return -1;
+        if ((pcb->cold->script = calloc(1, sizeof(script_t))) == NULL) {
+            perror("calloc");
+            return -1;
+        }
+        pcb->cold->script->expected = (uint32_t) msg->time_ns;
+        DBG("Process %d uploads a script of %u requests\n", msg->pid, (uint32_t) msg->time_ns);
+        return 0;
+    }
+    if (script) {
+        if (!is_task_request(msg->request)) return -1;
+        script->requests[script->len++] = *msg;
+        if (script->len < script->expected) return 0;
+        msg = &script->requests[0];
+    }
+    if (!is_task_request(msg->request)) return -1;
+    if (num_deferred > 0 ||
+        admission_admit(&admission, pcb, client_of(pcb), request_work(pcb, msg), queues->scheduler->ready,
+                        current_time_ns) != ADMISSION_OK) {
+        // A script keeps its requests, a single request is copied
+        if (!script) {
+            if ((pcb->cold->deferred = malloc(sizeof(msg_t))) == NULL) {
+                perror("malloc");
+                return -1;
             }
-            if (errno == EINTR)        continue;   // interrupted -> retry
-            if (errno == ECONNABORTED) continue;   // aborted handshake -> next
-            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
-                perror("accept");
+            *pcb->cold->deferred = *msg;
+        }
+        pcb->cold->deferred_ns = current_time_ns;
+        pcb->flags |= PCB_DEFERRED;
+        enqueue_pcb(&deferred_queue, pcb);
+        num_deferred++;
+        DBG("Request of process %d deferred\n", msg->pid);
+        return 2;
+    }
+    return admit_request(pcb, msg, queues, current_time_ns) < 0 ? -1 : 1;
+}
+
+/**
+ * @brief Admit the deferred requests that fit now, in the order they arrived.
+ *
+ * The request of a task that was killed, or whose multiplexed connection closed,
+ * is dropped without a reply and the task is freed in the command queue.
+ *
+ * @param queues Where the tasks go
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void admit_deferred(const ossim_queues_t *queues, uint64_t current_time_ns) {
+    queue_elem_t *elem = deferred_queue.head;
+    while (elem != NULL) {
+        pcb_t *pcb = elem->pcb;
+        int gone = (pcb->flags & PCB_KILLED) || (pcb->cold->mux && pcb->cold->mux->closed);
+        const msg_t *msg = pcb->cold->script ? &pcb->cold->script->requests[0] : pcb->cold->deferred;
+        if (!gone && admission_admit(&admission, pcb, client_of(pcb), request_work(pcb, msg),
+                                     queues->scheduler->ready, current_time_ns) != ADMISSION_OK) {
+            elem = elem->next;
+            continue;
+        }
+        remove_queue_elem(&deferred_queue, elem);
+        queue_elem_t *tmp = elem;
+        elem = elem->next;
+        free(tmp);
+        num_deferred--;
+        pcb->flags &= (uint16_t) ~PCB_DEFERRED;
+        if (gone) {
+            free(pcb->cold->script);
+            pcb->cold->script = NULL;
+            enqueue_pcb(queues->command_queue, pcb);
+        } else {
+            admission_deferred(&admission, current_time_ns - pcb->cold->deferred_ns);
+            if (admit_request(pcb, msg, queues, current_time_ns) < 0) {
+                wait_for_command(queues->command_queue, pcb);
             }
-            // No more clients to accept right now
-            break;
         }
-        int flags = fcntl(client_fd, F_GETFL, 0); // Get current flags
-        if (flags != -1) {
-            if (fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-                perror("fcntl: set non-blocking");
+        free(pcb->cold->deferred);
+        pcb->cold->deferred = NULL;
+    }
+}
+
+/**
+ * @brief Called when a task finished a RUN or BLOCK request.
+ *
+ * The next request of a script starts right away. Otherwise DONE is sent to the
+ * application (with the completion record at the end of a script), and the pcb
+ * waits for the next request (or for the application to disconnect).
+ *
+ * @param queues Where the task goes
+ * @param pcb The pcb of the task
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void request_done(const ossim_queues_t *queues, pcb_t *pcb, uint64_t current_time_ns) {
+    if (pcb->flags & PCB_KILLED) {
+        // The request is abandoned without a reply, the task is removed in the command queue
+        admission_release(&admission, pcb, UINT64_MAX);
+        free(pcb->cold->script);
+        pcb->cold->script = NULL;
+        pcb->status = TASK_COMMAND;
+        enqueue_pcb(queues->command_queue, pcb);
+        return;
+    }
+    if (metrics) {
+        metrics_observe(metrics, pcb->status == TASK_BLOCKED ? PROCESS_REQUEST_BLOCK : PROCESS_REQUEST_RUN,
+                        current_time_ns - pcb->cold->request_ns);
+    }
+    script_t *script = pcb->cold->script;
+    if (script) {
+        script->times.end_ns[script->pos++] = current_time_ns;
+        // The rest of the script of a closed multiplexed connection is dropped
+        while (script->pos < script->len && !(pcb->cold->mux && pcb->cold->mux->closed)) {
+            if (start_request(pcb, &script->requests[script->pos], queues, current_time_ns) == 0) return;
+            // A LOCK or UNLOCK the task cannot do is skipped
+            fprintf(stderr, "Process %d cannot %s mutex %.*s\n", pcb->pid,
+                    PROCESS_REQUEST_STRINGS[script->requests[script->pos].request],
+                    MUTEX_NAME_LEN, script->requests[script->pos].mutex);
+            script->times.end_ns[script->pos++] = current_time_ns;
+        }
+    }
+    admission_release(&admission, pcb, UINT64_MAX);
+    if (realproc) {
+        realproc_continue(realproc, pcb);
+    }
+    send_msg(pcb, PROCESS_REQUEST_DONE, current_time_ns);
+    free(script);
+    pcb->cold->script = NULL;
+    pcb->status = TASK_COMMAND;
+    wait_for_command(queues->command_queue, pcb);
+}
+
+/**
+ * @brief Called by the scheduler when a task finished its CPU burst.
+ *
+ * @param ctx The queues (ossim_queues_t)
+ * @param pcb The pcb of the task that finished its burst
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void burst_done(void *ctx, pcb_t *pcb, uint64_t current_time_ns) {
+    DBG("Process %d finished RUN\n", pcb->pid);
+    admission_release(&admission, pcb, pcb->time_ns);
+    pcb->time_ns = 0;
+    pcb->ellapsed_time_ns = 0;
+    request_done(ctx, pcb, current_time_ns);
+}
+
+/**
+ * @brief Handle a control request (KILL, RENICE, SUSPEND or RESUME) and answer it with ACK or NACK.
+ *
+ * The target is found through the pid index. A killed task leaves the CPU or the
+ * ready queue(s) at the next tick, and a blocked one when its wait is over; it is
+ * then removed in the command queue, like a closed connection.
+ *
+ * @param pcb The pcb of the connection that sent the request
+ * @param msg The request, for the task with the pid of the message
+ * @param queues The queues and the scheduler
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void handle_control(pcb_t *pcb, const msg_t *msg, const ossim_queues_t *queues, uint64_t current_time_ns) {
+    pcb_t *target = pid_index_find(&pids, msg->pid);
+    int ok = target != NULL && target != pcb && !(target->flags & PCB_KILLED);
+    if (ok) {
+        switch (msg->request) {
+            case PROCESS_REQUEST_KILL:
+                scheduler_kill(queues->scheduler, target, current_time_ns);
+                // A task waiting for a mutex could wait forever, it stops waiting
+                locks_cancel(&locks, target, current_time_ns, &lock_done_queue);
+                if (target->status == TASK_COMMAND && target->cold->mux && target->cold->mux->owner != target &&
+                    !target->cold->mux->closed && !(target->flags & PCB_DEFERRED)) {
+                    // Idle virtual processes wait in the table of their connection, not in the command queue
+                    // (a deferred one leaves the deferred queue for it, see admit_deferred)
+                    enqueue_pcb(queues->command_queue, target);
+                }
+                break;
+            case PROCESS_REQUEST_RENICE:
+                ok = msg->time_ns <= UINT32_MAX && scheduler_renice(queues->scheduler, target, (uint32_t) msg->time_ns) == 0;
+                break;
+            case PROCESS_REQUEST_SUSPEND:
+                scheduler_suspend(queues->scheduler, target);
+                break;
+            case PROCESS_REQUEST_RESUME:
+                ok = (target->flags & PCB_SUSPENDED) != 0;
+                if (ok) {
+                    scheduler_resume(queues->scheduler, target, current_time_ns);
+                }
+                break;
+            default:
+                ok = 0;
+        }
+    }
+    DBG("%s of process %d %s\n", PROCESS_REQUEST_STRINGS[msg->request], msg->pid, ok ? "done" : "failed");
+    send_msg(pcb, ok ? PROCESS_REQUEST_ACK : PROCESS_REQUEST_NACK, current_time_ns);
+}
+
+/**
+ * @brief Read every available message of a multiplexed connection and hand each one to its virtual process.
+ *
+ * A pid seen for the first time on the connection creates a new virtual process.
+ *
+ * @param conn The pcb of the connection
+ * @param queues Where the virtual processes go
+ * @param current_time_ns The current time in nanoseconds
+ * @return Like read_client: -1 (errno EAGAIN) once no message is left, 0 if the connection was closed
+ */
+static int read_mux(pcb_t *conn, const ossim_queues_t *queues, uint64_t current_time_ns) {
+    if (conn->cold->mux->out_len > 0 && !replay && !uring) {
+        // Replies that did not fit in the socket last time
+        socket_syscalls++;
+        if (mux_flush(conn->cold->mux) < 0) {
+            perror("write");
+        }
+    }
+    msg_t msg;
+    int n;
+    while ((n = read_client(conn, &msg, current_time_ns)) > 0) {
+        if (recorder) {
+            msglog_write(recorder, current_time_ns, (int32_t) conn->cold->sockfd, MSGLOG_RECV, &msg);
+        }
+        pcb_t *pcb = mux_find(conn->cold->mux, msg.pid);
+        if (!pcb) {
+            pcb = new_pcb(&pcbs, msg.pid, conn->cold->sockfd, 0);
+            if (!pcb || mux_add(conn->cold->mux, pcb) < 0) {
+                fprintf(stderr, "No memory for virtual process %d\n", msg.pid);
+                free_pcb(&pcbs, pcb);
+                continue;
             }
+            pcb->cold->mux = conn->cold->mux;
+            index_pcb(pcb, 1);
+            DBG("[Scheduler] New virtual process %d on fd=%d\n", msg.pid, conn->cold->sockfd);
         }
-        // Set close-on-exec flag
-        int fdflags = fcntl(client_fd, F_GETFD, 0);
-        if (fdflags != -1) {
-            fcntl(client_fd, F_SETFD, fdflags | FD_CLOEXEC);
+        if (pcb->status != TASK_COMMAND || handle_command(pcb, &msg, queues, current_time_ns) < 0) {
+            printf("Unexpected message received from virtual process %d\n", msg.pid);
         }
+    }
+    return n;
+}
+
+/**
+ * @brief Mark a multiplexed connection closed and free the virtual processes that are not busy.
+ *
+ * The others are freed when their request finishes (see wait_for_command).
+ *
+ * @param mux The connection
+ * @param command_queue The command queue, where the idle virtual processes are freed
+ */
+static void close_mux(mux_t *mux, queue_t *command_queue) {
+    num_mux_owners--;
+    mux->closed = 1;
+    mux->owner = NULL;
+    if (mux->count == 0) {
+        mux_destroy(mux);
+        return;
+    }
+    for (uint32_t i = 0; i < mux->capacity; i++) {
+        pcb_t *pcb = mux->slots[i];
+        // The deferred ones get there from the deferred queue
+        if (pcb && pcb->status == TASK_COMMAND && !(pcb->flags & PCB_DEFERRED)) {
+            enqueue_pcb(command_queue, pcb);
+        }
+    }
+}
+
+/**
+ * @brief Check for new client connections and add them to the queue.
+ *
+ * This function accepts new client connections on the server socket,
+ * sets the client sockets to non-blocking mode, and enqueues them
+ * into the provided queue.
+ *
+ * RUN requests are handed to the scheduler, BLOCK requests go to the blocked queue.
+ * The pcb of a multiplexed connection stays in the command queue and reads the
+ * requests of all its virtual processes.
+ *
+ * The requests of a script are read in the same tick, until the whole script arrived.
+ *
+ * @param queues The command queue, to which new pcb will be added, the blocked queue and the scheduler
+ * @param server_fd The server socket file descriptor
+ * @param current_time_ns The current time in nanoseconds
+ */
+void check_new_commands(const ossim_queues_t *queues, int server_fd, uint64_t current_time_ns) {
+    queue_t *command_queue = queues->command_queue;
+    // Collect what arrived since the last tick
+    if (uring) {
+        uring_poll(uring);
+    }
+    // The requests that wait for admission go first
+    admit_deferred(queues, current_time_ns);
+    // Accept new client connections, unless admission control holds them in the listen backlog
+    int client_fd;
+    uint32_t accepted = 0;
+    while (admission_accept(&admission, accepted, queues->scheduler->ready, num_deferred) &&
+           (client_fd = accept_client(server_fd)) >= 0) {
+        accepted++;
         DBG("[Scheduler] New client connected: fd=%d\n", client_fd);
+        if (recorder) {
+            msglog_write(recorder, current_time_ns, client_fd, MSGLOG_CONNECT, NULL);
+        }
         // New PCBs do not have a time yet, will be set when we receive a RUN message
-        pcb_t *pcb = new_pcb(++PID, client_fd, 0);
+        // The id is not a pid, the pcb is indexed once its first request tells the pid (see set_pid)
+        pcb_t *pcb = new_pcb(&pcbs, ++PID, client_fd, 0);
+        if (realproc) {
+            realproc_connect(realproc, pcb, client_fd);
+        }
+        admission_connect(&admission, pcb, current_time_ns);
         enqueue_pcb(command_queue, pcb);
-    } while (client_fd > 0);
+    }
 
     // Check queue for new commands in the command queue
     queue_elem_t * elem = command_queue->head;
     while (elem != NULL) {
         pcb_t *current_pcb = elem->pcb;
+        // Virtual processes only get here to be freed, after their connection closed or they were killed
+        int is_virtual = current_pcb->cold->mux && current_pcb->cold->mux->owner != current_pcb;
         msg_t msg;
-        int n = read(current_pcb->sockfd, &msg, sizeof(msg_t));
+        int n;
+        if (is_virtual || (current_pcb->flags & PCB_KILLED)) {
+            // Handled like a closed connection
+            n = 0;
+        } else if (current_pcb->cold->mux) {
+            n = read_mux(current_pcb, queues, current_time_ns);
+        } else {
+            n = read_client(current_pcb, &msg, current_time_ns);
+        }
         if (n <= 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
                 // No data available right now, move to next
                 elem = elem->next;
             } else {
@@ -130,191 +889,543 @@ void check_new_commands(queue_t *command_queue, queue_t *blocked_queue, queue_t
                 } else {
                     DBG("Connection closed by remote host\n");
                 }
+                if (recorder && !is_virtual) {
+                    msglog_write(recorder, current_time_ns, (int32_t) current_pcb->cold->sockfd, MSGLOG_CLOSE, NULL);
+                }
                 // Remove from queue
+                remove_queue_elem(command_queue, elem);
                 queue_elem_t *tmp = elem;
                 elem = elem->next;
-                free(current_pcb);
                 free(tmp);
+                scheduler_exit(queues->scheduler, current_pcb);
+                if (is_virtual && !current_pcb->cold->mux->closed) {
+                    // Killed, the load generator is told the virtual process is gone
+                    send_msg(current_pcb, PROCESS_REQUEST_NACK, current_time_ns);
+                    mux_remove(current_pcb->cold->mux, current_pcb);
+                } else if (is_virtual) {
+                    // The last virtual process of a closed connection frees it
+                    if (--current_pcb->cold->mux->count == 0) {
+                        mux_destroy(current_pcb->cold->mux);
+                    }
+                } else {
+                    if (uring) {
+                        uring_close(uring, (int) current_pcb->cold->sockfd);
+                    }
+                    if (!replay) {
+                        close(current_pcb->cold->sockfd);
+                    } else if (current_pcb->flags & PCB_KILLED) {
+                        replay_drop(replay, (int32_t) current_pcb->cold->sockfd);
+                    }
+                    shm_channel_detach(current_pcb->cold->channel);
+                    if (current_pcb->cold->mux) {
+                        close_mux(current_pcb->cold->mux, command_queue);
+                    }
+                }
+                release_pcb(current_pcb, current_time_ns);
             }
             continue;
         }
         // We have received a message
-        if (msg.request == PROCESS_REQUEST_RUN) {
-            current_pcb->pid = msg.pid; // Set the pid from the message
-            current_pcb->time_ms = msg.time_ms;
-            current_pcb->status = TASK_RUNNING;
-            enqueue_pcb(ready_queue, current_pcb);
-            DBG("Process %d requested RUN for %d ms\n", current_pcb->pid, current_pcb->time_ms);
-        } else if (msg.request == PROCESS_REQUEST_BLOCK) {
-            current_pcb->pid = msg.pid; // Set the pid from the message
-            current_pcb->time_ms = msg.time_ms;
-            current_pcb->status = TASK_BLOCKED;
-            enqueue_pcb(blocked_queue, current_pcb);
-            DBG("Process %d requested BLOCK for %d ms\n", current_pcb->pid);
-        } else {
+        if (recorder) {
+            msglog_write(recorder, current_time_ns, (int32_t) current_pcb->cold->sockfd, MSGLOG_RECV, &msg);
+        }
+        if (msg.request == PROCESS_REQUEST_MUX && !current_pcb->cold->channel) {
+            // From now on the connection carries the messages of many virtual processes
+            current_pcb->cold->mux = mux_create(current_pcb);
+            if (!current_pcb->cold->mux) {
+                fprintf(stderr, "No memory for a multiplexed connection\n");
+            } else {
+                num_mux_owners++;
+            }
+            DBG("[Scheduler] Connection fd=%d is multiplexed\n", current_pcb->cold->sockfd);
+            elem = elem->next;
+            continue;
+        }
+        if (msg.request >= PROCESS_REQUEST_KILL && msg.request <= PROCESS_REQUEST_RESUME &&
+            !current_pcb->cold->script) {
+            // The connection stays in the command queue, for more control requests
+            handle_control(current_pcb, &msg, queues, current_time_ns);
+            elem = elem->next;
+            continue;
+        }
+        int status = handle_command(current_pcb, &msg, queues, current_time_ns);
+        if (status < 0) {
             printf("Unexpected message received from client\n");
+            elem = elem->next;
             continue;
         }
-        // Remove from command queue
+        if (status == 0) {
+            // Read the rest of the script
+            continue;
+        }
+        // Remove from command queue (started, or waiting in the deferred queue)
         remove_queue_elem(command_queue, elem);
         queue_elem_t *tmp = elem;
         elem = elem->next;
         free(tmp);
-
-        // Send ack message
-        msg_t ack_msg = {
-            .pid = current_pcb->pid,
-            .request = PROCESS_REQUEST_ACK,
-            .time_ms = current_time_ms
-        };
-        if (write(current_pcb->sockfd, &ack_msg, sizeof(msg_t)) != sizeof(msg_t)) {
-            perror("write");
-        }
-        DBG("Send ACK message to process %d with time %d\n", current_pcb->pid, current_time_ms);
     }
 
 }
 
 /**
- * @brief Check the blocked queue for messages from clients.
+ * @brief Called when a task finished its BLOCK request
  *
- * This function iterates through the blocked queue, checking each client
- * socket for incoming messages. If a RUN message is received, the corresponding
- * pcb is moved to the command queue and an ACK message is sent back to the client.
- * If a client disconnects or an error occurs, the client is removed from the blocked queue.
+ * @param ctx The queues (ossim_queues_t)
+ * @param pcb The pcb of the task that finished blocking
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void block_done(void *ctx, pcb_t *pcb, uint64_t current_time_ns) {
+    trace_event(&tracer, current_time_ns, TRACE_WAKE, TRACE_NO_CPU, pcb->pid, 0);
+    DBG("Process %d finished BLOCK\n", pcb->pid);
+    request_done(ctx, pcb, current_time_ns);
+}
+
+/**
+ * @brief Advance the tasks blocked on a timer by one tick
+ *
+ * The tasks whose BLOCK request is over are handed to the command queue, or to the
+ * next request of their script.
  *
- * @param blocked_queue The queue containing PCBs in I/O wait stated (blocked) from CPU
- * @param command_queue The queue where PCBs ready for new instructions will be moved
- * @param current_time_ms The current time in milliseconds
+ * @param queues The blocked timers, and where the woken tasks go next
+ * @param current_time_ns The current time in nanoseconds
  */
-void check_blocked_queue(queue_t * blocked_queue, queue_t * command_queue, uint32_t current_time_ms) {
-    // Check all elements of the blocked queue for new messages
-    queue_elem_t * elem = blocked_queue->head;
-    while (elem != NULL) {
-        pcb_t *pcb = elem->pcb;
-        if (pcb->time_ms > TICKS_MS) {
-            pcb->time_ms -= TICKS_MS;
-        } else {
-            pcb->time_ms = 0;
-        }
-        if (pcb->time_ms == 0) {
-            // Send DONE message to the application
-            msg_t msg = {
-                .pid = pcb->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write(pcb->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
-            }
-            DBG("Process %d finished BLOCK, sending DONE\n", pcb->pid);
-            pcb->status = TASK_COMMAND;
-            enqueue_pcb(command_queue, pcb);
+void check_blocked_queue(const ossim_queues_t *queues, uint64_t current_time_ns) {
+    // Woken after the tick, the next request of a script may block again
+    queue_t done_queue = {.head = NULL, .tail = NULL};
+    timer_set_tick(queues->blocked_timers, tick_ns, &done_queue);
+    pcb_t *pcb;
+    while ((pcb = dequeue_pcb(&done_queue)) != NULL) {
+        block_done((void *) queues, pcb, current_time_ns);
+    }
+}
 
-            // Remove from blocked queue
-            remove_queue_elem(blocked_queue, elem);
-            queue_elem_t *tmp = elem;
-            elem = elem->next;
-            free(tmp);
-        } else {
-            elem = elem->next;
+/**
+ * @brief Finish the LOCK and UNLOCK requests that got their mutex
+ *
+ * The tasks go to the next request of their script (which may be another LOCK or
+ * UNLOCK, finished in the same call), or get their DONE.
+ *
+ * @param queues Where the tasks go next
+ * @param current_time_ns The current time in nanoseconds
+ */
+void check_lock_queue(const ossim_queues_t *queues, uint64_t current_time_ns) {
+    pcb_t *pcb;
+    while ((pcb = dequeue_pcb(&lock_done_queue)) != NULL) {
+        DBG("Process %d finished its mutex request\n", pcb->pid);
+        request_done(queues, pcb, current_time_ns);
+    }
+}
+
+/**
+ * @brief Print the cycle of tasks that wait for mutexes held by each other
+ *
+ * @param current_time_ns The current time in nanoseconds
+ */
+static void report_deadlock(uint64_t current_time_ns) {
+    fprintf(stderr, "Deadlock at %.3f s, every task waits for a mutex: ", (double) current_time_ns / NS_PER_S);
+    for (uint32_t i = 0; i < locks.count; i++) {
+        if (locks.mutexes[i].waiters.head) {
+            locks_print_deadlock(&locks, locks.mutexes[i].waiters.head->pcb, stderr);
+            return;
         }
     }
 }
 
-static const char *SCHEDULER_NAMES[] = {
-    "FIFO",
-    "SJF",
-    "RR",
-    "MLFQ",
-    NULL
-};
-
-typedef enum  {
-    NULL_SCHEDULER = -1,
-    SCHED_FIFO = 0,
-    SCHED_SJF,
-    SCHED_RR,
-    SCHED_MLFQ
-} scheduler_en;
-
-scheduler_en get_scheduler(const char *name) {
-    for (int i = 0; SCHEDULER_NAMES[i] != NULL; i++) {
-        if (strcmp(name, SCHEDULER_NAMES[i]) == 0) {
-            return (scheduler_en)i;
-        }
-    }
-    printf("Scheduler %s not recognized. Available options are:\n", name);
-    for (int i = 0; SCHEDULER_NAMES[i] != NULL; i++) {
-        printf(" - %s\n", SCHEDULER_NAMES[i]);
-    }
-    return NULL_SCHEDULER;
+static void usage(const char *prog) {
+    printf("Usage: %s [-c cpus] [-P host_threads] [-T tick_us] [-s switch_cost_us] [-m migration_cost_us] [-v memory] [-k caches]\n"
+           "          [-S swap] [-d device ...] [-A admission] [-I] [-r record.log] [-t trace.bin] [-M metrics.sock] [-Q series.bin] [-U]\n"
+           "          [-X all|core,...] <scheduler>[:params]\n"
+           "       %s [-P host_threads] [-t trace.bin] [-M metrics.sock] [-Q series.bin] -R record.log\n"
+           "Scheduler options: FIFO, SJF, RR[:slice_ms], MLFQ[:slice_ms,slice_ms,...]\n"
+           "Memory: frames[,FIFO|LRU|CLOCK|WS[,fault_ms[,ws_window_ms]]]\n"
+           "Caches: tlb_entries,tlb_ways,llc_pages,llc_ways[,tlb_miss_us[,llc_miss_us[,ASID]]]\n"
+           "Swap: LARGEST|LRU|OLDEST[,page_ms] (needs -v)\n"
+           "Device: name[,FCFS|SSTF|SCAN|C-LOOK[,servers[,seek_ms_per_1000_blocks]]] (device ids in order)\n"
+           "Admission: max_ready[,max_work_ms[,rate[,burst[,max_accepts]]]] (0: no limit; rate in requests/s per client)\n"
+           "-I: priority inheritance on the mutexes of LOCK/UNLOCK (MLFQ)\n"
+           "-P: give every CPU its own run queue, and advance the CPUs on this many host threads (same results for any number)\n"
+           "-T: length of a tick in microseconds (default %llu, min %llu)\n"
+           "-U: io_uring for the client sockets (falls back to the POSIX calls if not available)\n"
+           "-M: serve live metrics in the Prometheus text format on this Unix socket\n"
+           "-Q: series.bin[,interval_ms] sample the queue lengths and the CPUs every interval (default %d ms), see series2csv\n"
+           "-X: enforce the decisions on the real processes of the applications (app -X, app-io -X) with SIGSTOP/SIGCONT,\n"
+           "    simulated CPU i pinned to the i-th of these host cores (all: the cores ossim may run on)\n",
+           prog, prog, DEFAULT_TICK_NS / NS_PER_US, MIN_TICK_NS / NS_PER_US, SAMPLER_DEFAULT_INTERVAL_MS);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <scheduler>\nScheduler options: FIFO", argv[0]);
-        exit(EXIT_FAILURE);
+    cswitch_config_t cswitch_config = {.switch_cost_us = 0, .migration_cost_us = 0};
+    uint32_t ncpus = 1;
+    uint32_t host_threads = 0;
+    uint32_t tick_us = (uint32_t) (DEFAULT_TICK_NS / NS_PER_US);
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *trace_path = NULL;
+    const char *metrics_path = NULL;
+    const char *series_path = NULL;
+    realproc_t realproc_state;
+    uint32_t series_interval_ms = SAMPLER_DEFAULT_INTERVAL_MS;
+    int use_uring = 0;
+    uint32_t priority_inheritance = 0;
+    vm_config_t vm_config = {0};
+    cache_config_t cache_config = {0};
+    swap_config_t swap_config = {0};
+    uint32_t swap_enabled = 0;
+    io_device_config_t devices[IO_MAX_DEVICES];
+    uint32_t num_devices = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:P:T:s:m:v:k:S:d:A:Ir:R:t:M:Q:UX:")) != -1) {
+        switch (opt) {
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'U':
+                use_uring = 1;
+                break;
+            case 'X':
+                if (realproc_init(&realproc_state, optarg) < 0) exit(EXIT_FAILURE);
+                realproc = &realproc_state;
+                break;
+            case 'M':
+                metrics_path = optarg;
+                break;
+            case 'Q':
+                if (sampler_parse_config(optarg, &series_interval_ms) < 0) exit(EXIT_FAILURE);
+                series_path = optarg;
+                break;
+            case 'r':
+                record_path = optarg;
+                break;
+            case 'R':
+                replay_path = optarg;
+                break;
+            case 'c':
+                if (parse_uint_option(optarg, &ncpus) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'P':
+                if (parse_uint_option(optarg, &host_threads) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'T':
+                if (parse_uint_option(optarg, &tick_us) < 0) exit(EXIT_FAILURE);
+                if (tick_us < MIN_TICK_NS / NS_PER_US) {
+                    fprintf(stderr, "Tick too short: %u us (min %llu us)\n", tick_us, MIN_TICK_NS / NS_PER_US);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 's':
+                if (parse_uint_option(optarg, &cswitch_config.switch_cost_us) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'm':
+                if (parse_uint_option(optarg, &cswitch_config.migration_cost_us) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'v':
+                if (vm_parse_config(optarg, &vm_config) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'k':
+                if (cache_parse_config(optarg, &cache_config) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'S':
+                if (swap_parse_config(optarg, &swap_config) < 0) exit(EXIT_FAILURE);
+                swap_enabled = 1;
+                break;
+            case 'd':
+                if (num_devices == IO_MAX_DEVICES) {
+                    fprintf(stderr, "Too many devices (max %d)\n", IO_MAX_DEVICES);
+                    exit(EXIT_FAILURE);
+                }
+                if (io_parse_device(optarg, &devices[num_devices++]) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'A':
+                if (admission_parse_config(optarg, &admission.config) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'I':
+                priority_inheritance = 1;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
     }
-
-    // Parse arguments
-    scheduler_en scheduler_type = get_scheduler(argv[1]);
-    if (scheduler_type == NULL_SCHEDULER) {
-        return EXIT_FAILURE;
+    const char *scheduler_name = NULL;
+    replay_t replay_state;
+    if (replay_path) {
+        // The configuration is the one of the recorded run, and there are no processes to enforce it on
+        if (optind != argc || record_path || realproc) {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (replay_open(&replay_state, replay_path) < 0) {
+            return EXIT_FAILURE;
+        }
+        replay = &replay_state;
+        scheduler_name = replay->log.header.scheduler;
+        ncpus = replay->log.header.ncpus;
+        tick_us = (uint32_t) (replay->log.header.tick_ns / NS_PER_US);
+        cswitch_config.switch_cost_us = replay->log.header.switch_cost_us;
+        cswitch_config.migration_cost_us = replay->log.header.migration_cost_us;
+        vm_config = replay->log.header.vm;
+        cache_config = replay->log.header.caches;
+        swap_enabled = replay->log.header.swap_enabled;
+        swap_config = replay->log.header.swap;
+        num_devices = replay->log.header.num_devices < IO_MAX_DEVICES ? replay->log.header.num_devices : IO_MAX_DEVICES;
+        memcpy(devices, replay->log.header.devices, sizeof(devices));
+        admission.config = replay->log.header.admission;
+        priority_inheritance = replay->log.header.priority_inheritance;
+        // The run queues are the recorded ones, -P only chooses the number of threads
+        if (!replay->log.header.per_cpu_queues) {
+            host_threads = 0;
+        } else if (host_threads == 0) {
+            host_threads = 1;
+        }
+    } else {
+        if (optind != argc - 1) {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        scheduler_name = argv[optind];
     }
 
-    // We set up 3 queues: 1 for the simulator and 2 for scheduling
+    tick_ns = tick_us * NS_PER_US;
+
+    // We set up 2 queues for the simulator, the READY queue(s) belong to the scheduler
     // - COMMAND queue: for PCBs that are waiting for (new) instructions from the app
-    // - READY queue: for PCBs that are ready to run on the CPU
-    // - BLOCKED queue: for PCBs that are blocked waiting for I/O
+    // - BLOCKED timers: for PCBs that are blocked waiting for I/O (not on a device)
     queue_t command_queue = {.head = NULL, .tail = NULL};
-    queue_t ready_queue = {.head = NULL, .tail = NULL};
-    queue_t blocked_queue = {.head = NULL, .tail = NULL};
+    timer_set_t blocked_timers = {0};
+
+    // The scheduler owns the ready queue(s) and the CPUs
+    // Finished requests hand the task to the next request of its script or back to the command queue
+    ossim_queues_t queues = {.command_queue = &command_queue, .blocked_timers = &blocked_timers};
+    scheduler_t *scheduler = scheduler_create(scheduler_name, ncpus, tick_ns, &cswitch_config, burst_done, &queues);
+    if (!scheduler) {
+        return EXIT_FAILURE;
+    }
+    queues.scheduler = scheduler;
+    if (vm_config.num_frames > 0 && scheduler_set_memory(scheduler, &vm_config) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (cache_config.tlb_entries > 0 && scheduler_set_caches(scheduler, &cache_config) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (swap_enabled && scheduler_set_swap(scheduler, &swap_config) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (host_threads > 0 && scheduler_set_threads(scheduler, host_threads) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (io_init(&io_devices, devices, num_devices) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (locks_init(&locks, scheduler, (int) priority_inheritance) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (realproc) {
+        scheduler_set_cpu_hook(scheduler, realproc_on_cpu, realproc);
+    }
 
-    // We only have a single CPU that is a pointer to the actively running PCB on the CPU
-    pcb_t *CPU = NULL;
+    if (trace_init(&tracer, TRACE_DEFAULT_CAPACITY) < 0) {
+        return EXIT_FAILURE;
+    }
+    scheduler->trace = &tracer;
+    io_devices.trace = &tracer;
 
-    int server_fd = setup_server_socket(SOCKET_PATH);
-    if (server_fd < 0) {
-        fprintf(stderr, "Failed to set up server socket\n");
-        return 1;
+    msglog_t recorder_log;
+    if (record_path) {
+        msglog_header_t header = {
+            .tick_ns = tick_ns,
+            .ncpus = ncpus,
+            .switch_cost_us = cswitch_config.switch_cost_us,
+            .migration_cost_us = cswitch_config.migration_cost_us,
+            .vm = vm_config,
+            .caches = cache_config,
+            .swap_enabled = swap_enabled,
+            .swap = swap_config,
+            .num_devices = num_devices,
+            .admission = admission.config,
+            .priority_inheritance = priority_inheritance,
+            .per_cpu_queues = host_threads > 0,
+        };
+        memcpy(header.devices, devices, num_devices * sizeof(io_device_config_t));
+        strncpy(header.scheduler, scheduler_name, sizeof(header.scheduler) - 1);
+        if (msglog_create(&recorder_log, record_path, &header) < 0) {
+            return EXIT_FAILURE;
+        }
+        recorder = &recorder_log;
     }
-    printf("Scheduler server listening on %s...\n", SOCKET_PATH);
-    uint32_t current_time_ms = 0;
-    while (1) {
+
+    metrics_t metrics_state;
+    if (metrics_path) {
+        if (metrics_start(&metrics_state, metrics_path) < 0) {
+            return EXIT_FAILURE;
+        }
+        metrics = &metrics_state;
+        printf("Serving metrics on %s\n", metrics_path);
+    }
+    sampler_t sampler_state;
+    sampler_t *sampler = NULL;
+    if (series_path) {
+        if (sampler_start(&sampler_state, series_path, ncpus, tick_ns, series_interval_ms) < 0) {
+            return EXIT_FAILURE;
+        }
+        sampler = &sampler_state;
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = handle_report_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    int server_fd = -1;
+    uring_t uring_state;
+    if (replay) {
+        printf("Replaying %s...\n", replay_path);
+    } else {
+        server_fd = setup_server_socket(SOCKET_PATH);
+        if (server_fd < 0) {
+            fprintf(stderr, "Failed to set up server socket\n");
+            return 1;
+        }
+        printf("Scheduler server listening on %s...\n", SOCKET_PATH);
+        if (use_uring) {
+            if (uring_init(&uring_state, server_fd) == 0) {
+                uring = &uring_state;
+            } else {
+                fprintf(stderr, "io_uring is not available, using the POSIX socket calls\n");
+            }
+        }
+    }
+    printf("Scheduler %s on %u CPU(s), tick: %u us, context switch cost: %u us, migration cost: %u us\n",
+           scheduler->label, ncpus, tick_us, cswitch_config.switch_cost_us, cswitch_config.migration_cost_us);
+    // A replay runs as fast as possible, a live simulation is paced by the tick clock
+    tickclock_t tick_clock = {.fd = -1};
+    if (!replay && tickclock_start(&tick_clock, tick_ns) < 0) {
+        return EXIT_FAILURE;
+    }
+    uint64_t current_time_ns = 0;
+    int deadlock = 0;
+    tickstat_init(&tick_stats, tick_ns);
+    while (keep_running) {
+        tickstat_begin(&tick_stats);
+        if (replay) {
+            // Everything recorded has been replayed
+            if (replay_finished(replay)) break;
+            replay_advance(replay, current_time_ns);
+        }
         // Check for new connections and/or instructions
-        check_new_commands(&command_queue, &blocked_queue, &ready_queue, server_fd, current_time_ms);
+        check_new_commands(&queues, server_fd, current_time_ns);
 
-        if (current_time_ms%1000 == 0) {
-            printf("Current time: %d s\n", current_time_ms/1000);
+        if (current_time_ns % NS_PER_S < tick_ns) {
+            printf("Current time: %llu s\n", (unsigned long long) (current_time_ns / NS_PER_S));
         }
+        tickstat_phase(&tick_stats, TICK_PHASE_COMMANDS);
         // Check the status of the PCBs in the blocked queue
-        check_blocked_queue(&blocked_queue, &command_queue, current_time_ms);
+        check_blocked_queue(&queues, current_time_ns);
+        io_tick(&io_devices, current_time_ns, block_done, &queues);
+        check_lock_queue(&queues, current_time_ns);
+        tickstat_phase(&tick_stats, TICK_PHASE_BLOCKED);
 
-        // The scheduler handles the READY queue
-        switch (scheduler_type) {
-            case SCHED_FIFO:
-                fifo_scheduler(current_time_ms, &ready_queue, &CPU);
-                break;
-            case SCHED_SJF:
-                sjf_scheduler(current_time_ms, &ready_queue, &CPU);
-            break;
-            case SCHED_RR:
-                rr_scheduler(current_time_ms, &ready_queue, &CPU);
+        // The scheduler handles the READY queue and the CPUs
+        scheduler_tick(scheduler, current_time_ns);
+        // Scripts whose RUN finished may have given a mutex back
+        check_lock_queue(&queues, current_time_ns);
+        locks_check_inversions(&locks, current_time_ns);
+        if (locks.num_waiting > 0 && locks.num_waiting + num_mux_owners == pcbs.count) {
+            // Every task left waits for a mutex held by another one left, none can ever go on
+            report_deadlock(current_time_ns);
+            deadlock = 1;
             break;
-            case SCHED_MLFQ:
-                mlfq_scheduler(current_time_ms, &ready_queue, &CPU, &command_queue);
-            break;
-            default:
-                printf("Unknown scheduler type\n");
-                break;
+        }
+        tickstat_phase(&tick_stats, TICK_PHASE_SCHEDULER);
+
+        // Send the replies of this tick
+        if (uring) {
+            uring_submit(uring);
+        }
+        if (metrics) {
+            metrics_update(metrics, scheduler, &command_queue, &blocked_timers, &io_devices, current_time_ns);
+        }
+        if (sampler) {
+            sampler_tick(sampler, scheduler, &command_queue, &blocked_timers, &io_devices, current_time_ns);
+        }
+        tickstat_phase(&tick_stats, TICK_PHASE_REPLIES);
+        tickstat_end_work(&tick_stats);
+
+        if (report_requested) {
+            report_requested = 0;
+            tickstat_print(&tick_stats, stdout, current_time_ns);
+            fflush(stdout);
         }
 
-        // Simulate a tick
-        usleep(TICKS_MS * 1000);
-        current_time_ms += TICKS_MS;
+        // Wait for the end of the tick
+        if (!replay) {
+            if (tickclock_wait(&tick_clock) < 0) break;
+            tickstat_slept(&tick_stats, &tick_clock.deadline);
+        }
+        current_time_ns += tick_ns;
     }
+    tickclock_stop(&tick_clock);
 
-    // Unreachable, because of the infinite loop
-    return 0;
+    // Stopped by a signal (or the replay ended, or the tasks deadlocked), report how much CPU went into switching
+    printf("Simulation stopped at %.3f ms\n", (double) current_time_ns / NS_PER_MS);
+    scheduler_print_stats(scheduler, stdout);
+    io_print_stats(&io_devices, stdout, current_time_ns);
+    admission_print_stats(&admission, stdout);
+    locks_print_stats(&locks, stdout, current_time_ns);
+    if (realproc) {
+        // No process is left stopped
+        realproc_free(realproc);
+        realproc_print_stats(realproc, stdout);
+    }
+    tickstat_print(&tick_stats, stdout, current_time_ns);
+    if (!replay) {
+        printf("Tick clock: %llu ticks run late to catch up\n", (unsigned long long) tick_clock.caught_up);
+        uint64_t syscalls = socket_syscalls + (uring ? uring->stats.enters : 0);
+        printf("Socket I/O (%s): %llu syscalls, %.1f per simulated second\n",
+               uring ? "io_uring" : "POSIX", (unsigned long long) syscalls,
+               current_time_ns ? (double) syscalls * NS_PER_S / (double) current_time_ns : 0.0);
+    }
+    if (uring) {
+        printf("io_uring: %llu accepts, %llu recv completions, %llu sends, %llu re-armed requests\n",
+               (unsigned long long) uring->stats.accepts, (unsigned long long) uring->stats.recvs,
+               (unsigned long long) uring->stats.sends, (unsigned long long) uring->stats.rearms);
+        uring_free(uring);
+    }
+    if (metrics) {
+        metrics_stop(metrics);
+    }
+    if (sampler && sampler_stop(sampler) == 0) {
+        printf("Saved %llu samples (every %u ms, %llu dropped) to %s\n",
+               (unsigned long long) sampler->header.count, series_interval_ms,
+               (unsigned long long) sampler->header.dropped, series_path);
+    }
+    scheduler_destroy(scheduler);
+    io_free(&io_devices);
+    locks_free(&locks);
+    timer_set_free(&blocked_timers);
+    pid_index_free(&pids);
+    pcb_table_free(&pcbs);
+
+    if (trace_path && trace_save(&tracer, trace_path, ncpus, tick_ns) == 0) {
+        printf("Saved %llu trace events to %s\n",
+               (unsigned long long) (tracer.head < (uint64_t) tracer.mask + 1 ? tracer.head : (uint64_t) tracer.mask + 1),
+               trace_path);
+    }
+    trace_free(&tracer);
+
+    if (recorder) {
+        printf("Recorded %llu events to %s\n", (unsigned long long) recorder->records, record_path);
+        msglog_close(recorder);
+    }
+    if (replay) {
+        replay_report(replay, stdout);
+        int diverged = replay->mismatched > 0 || replay->expected_head != replay->num_expected;
+        replay_close(replay);
+        return diverged ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    close(server_fd);
+    unlink(SOCKET_PATH);
+    return deadlock ? EXIT_FAILURE : 0;
 }
\ No newline at end of file
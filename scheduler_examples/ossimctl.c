@@ -0,0 +1,109 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "msg.h"
+
+/*
+ * Run like: ./ossimctl kill <pid>
+ *           ./ossimctl renice <pid> <level>
+ *           ./ossimctl suspend <pid>
+ *           ./ossimctl resume <pid>
+ *
+ * Sends a control request to the simulator for the task with the given pid (the
+ * pid the application sends its requests with, or the virtual pid of a load
+ * generator) and prints whether it was done.
+ */
+
+// Define a control command of the tool
+typedef struct {
+    const char *name;
+    process_request_t request;
+    int has_level;              // Takes the priority level after the pid
+} ctl_command_t;
+
+static const ctl_command_t COMMANDS[] = {
+    {"kill", PROCESS_REQUEST_KILL, 0},
+    {"renice", PROCESS_REQUEST_RENICE, 1},
+    {"suspend", PROCESS_REQUEST_SUSPEND, 0},
+    {"resume", PROCESS_REQUEST_RESUME, 0},
+};
+
+static int parse_long(const char *arg, long min, long max, long *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val < min || val > max) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = val;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s kill|suspend|resume <pid>\n"
+           "       %s renice <pid> <level>\n", prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const ctl_command_t *command = NULL;
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++) {
+        if (strcasecmp(argv[1], COMMANDS[i].name) == 0) command = &COMMANDS[i];
+    }
+    if (!command || argc != (command->has_level ? 4 : 3)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    long pid;
+    long level = 0;
+    if (parse_long(argv[2], 1, INT32_MAX, &pid) < 0 ||
+        (command->has_level && parse_long(argv[3], 0, UINT32_MAX, &level) < 0)) {
+        exit(EXIT_FAILURE);
+    }
+
+    int sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    if (connect(sockfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(sockfd);
+        return EXIT_FAILURE;
+    }
+
+    msg_t msg = {
+        .pid = (pid_t) pid,
+        .request = command->request,
+        .time_ns = (uint64_t) level,
+        .block = BLOCK_ADDRESS_NONE
+    };
+    if (write(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
+        perror("write");
+        close(sockfd);
+        return EXIT_FAILURE;
+    }
+    if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
+        perror("read");
+        close(sockfd);
+        return EXIT_FAILURE;
+    }
+    close(sockfd);
+    int ok = msg.request == PROCESS_REQUEST_ACK;
+    printf("%s %ld: %s at %.3f ms\n", PROCESS_REQUEST_STRINGS[command->request], pid,
+           ok ? "done" : "failed (unknown pid, or not possible)", (double) msg.time_ns / NS_PER_MS);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
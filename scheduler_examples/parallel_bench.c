@@ -0,0 +1,176 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scheduler.h"
+#include "sim.h"
+
+/*
+ * Run like: ./parallel_bench [-c cpus] [-n processes] [-b bursts] [-P host_threads] [scheduler]
+ *
+ * Simulates a synthetic workload of many processes on many CPUs, every CPU with its own
+ * run queue (see scheduler_set_threads), once on a single host thread and once with the
+ * CPUs split over host threads, first without caches and then with the TLB and LLC model.
+ * Both runs must give the same results, bit for bit; the host time of each run and the
+ * speedup are printed.
+ */
+
+// Define the outcome of one run
+typedef struct {
+    sim_result_t result;
+    double host_s;
+} bench_run_t;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+// Same sequence on every run, so the workload is the same for every thread count
+static uint32_t next_random(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t) (*state >> 33);
+}
+
+/**
+ * @brief Build a workload of CPU bursts referencing many pages, with short blocks in between
+ */
+static int make_workload(sim_workload_t *wl, uint32_t num_procs, uint32_t num_bursts) {
+    uint64_t seed = 42;
+    wl->num_procs = 0;
+    wl->procs = calloc(num_procs, sizeof(sim_process_t));
+    if (!wl->procs) return -1;
+    for (uint32_t p = 0; p < num_procs; p++) {
+        sim_process_t *proc = &wl->procs[p];
+        char name[32];
+        snprintf(name, sizeof(name), "proc-%u", p);
+        proc->name = strdup(name);
+        proc->bursts = calloc(num_bursts, sizeof(burst_t));
+        if (!proc->name || !proc->bursts) {
+            free(proc->name);
+            free(proc->bursts);
+            sim_free_workload(wl);
+            return -1;
+        }
+        proc->num_bursts = num_bursts;
+        wl->num_procs++;
+        for (uint32_t b = 0; b < num_bursts; b++) {
+            burst_t *burst = &proc->bursts[b];
+            burst->burst_time_ms = 10 + next_random(&seed) % 90;
+            burst->block_time_ms = next_random(&seed) % 50;
+            burst->block = BLOCK_ADDRESS_NONE;
+            burst->pages.count = MAX_PAGES;
+            for (uint32_t i = 0; i < MAX_PAGES; i++) {
+                burst->pages.ids[i] = next_random(&seed) % 256;
+            }
+        }
+    }
+    return 0;
+}
+
+static int same_results(const sim_result_t *a, const sim_result_t *b) {
+    return a->num_procs == b->num_procs && a->end_time_ns == b->end_time_ns &&
+           memcmp(a->procs, b->procs, a->num_procs * sizeof(sim_proc_result_t)) == 0 &&
+           memcmp(&a->cswitch, &b->cswitch, sizeof(cswitch_stats_t)) == 0 &&
+           memcmp(&a->caches, &b->caches, sizeof(cache_stats_t)) == 0 &&
+           a->stats && b->stats && strcmp(a->stats, b->stats) == 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-c cpus] [-n processes] [-b bursts] [-P host_threads] [scheduler]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t ncpus = MAX_CPUS;
+    uint32_t num_procs = 2000;
+    uint32_t num_bursts = 20;
+    uint32_t host_threads = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:b:P:")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (parse_uint(optarg, &ncpus) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'n':
+                if (parse_uint(optarg, &num_procs) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'b':
+                if (parse_uint(optarg, &num_bursts) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'P':
+                if (parse_uint(optarg, &host_threads) < 0) exit(EXIT_FAILURE);
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind < argc - 1) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *scheduler = optind < argc ? argv[optind] : "RR:20";
+    if (host_threads < 2) host_threads = 2;
+
+    sim_workload_t wl;
+    if (make_workload(&wl, num_procs, num_bursts) < 0) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    cache_config_t caches = {
+        .tlb_entries = 64, .tlb_ways = 4, .llc_pages = 1024, .llc_ways = 16,
+        .tlb_miss_us = 1, .llc_miss_us = 20, .asid = 0
+    };
+    printf("%u processes of %u bursts (%u pages each) on %u CPUs with %s, a run queue per CPU\n",
+           num_procs, num_bursts, MAX_PAGES, ncpus, scheduler);
+
+    int identical = 1;
+    const cache_config_t *const models[2] = {NULL, &caches};
+    for (int m = 0; m < 2; m++) {
+        printf("%s:\n", models[m] ? "TLB and LLC model" : "Without caches");
+        const uint32_t threads[2] = {1, host_threads};
+        bench_run_t runs[2];
+        for (int r = 0; r < 2; r++) {
+            sim_config_t config = {
+                .scheduler = scheduler,
+                .ncpus = ncpus,
+                .host_threads = threads[r],
+                .caches = models[m],
+            };
+            double start = monotonic_s();
+            if (sim_run(&wl, &config, &runs[r].result) < 0) {
+                fprintf(stderr, "Simulation failed\n");
+                return EXIT_FAILURE;
+            }
+            runs[r].host_s = monotonic_s() - start;
+            printf("%2u host thread(s): %.3f s for %.3f simulated s\n",
+                   threads[r], runs[r].host_s, (double) runs[r].result.end_time_ns / 1e9);
+        }
+
+        int same = same_results(&runs[0].result, &runs[1].result);
+        printf("Results: %s\n", same ? "identical" : "DIFFERENT");
+        printf("Speedup with %u host threads: %.2fx\n", host_threads,
+               runs[1].host_s > 0 ? runs[0].host_s / runs[1].host_s : 0.0);
+        identical &= same;
+        sim_free_result(&runs[0].result);
+        sim_free_result(&runs[1].result);
+    }
+    sim_free_workload(&wl);
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
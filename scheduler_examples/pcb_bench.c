@@ -0,0 +1,164 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+/*
+ * Run like: ./pcb_bench [-n processes] [-r rounds]
+ *
+ * Puts every process in a ready queue and dispatches them for a number of rounds,
+ * like Round Robin: each dispatch takes the next task, accounts a tick to it and
+ * puts it back, like a preemption. The cost per dispatch is printed for the PCB
+ * table with the ready ring of the schedulers, and for the layout it replaced: one
+ * allocation per PCB with its cold data, in a linked queue with one allocated
+ * element per hop.
+ */
+
+#define BENCH_TICK_NS (10 * NS_PER_MS)
+
+// Define the outcome of one layout
+typedef struct {
+    double ns_per_dispatch;
+    uint64_t checksum;          // Keeps the accounting from being optimized away
+} bench_result_t;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+/**
+ * @brief Shuffle the tasks, a ready queue is never in allocation order for long
+ */
+static void shuffle(pcb_t **tasks, uint32_t n) {
+    uint64_t state = 42;
+    for (uint32_t i = n - 1; i > 0; i--) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t j = (uint32_t) ((state >> 33) % (i + 1));
+        pcb_t *tmp = tasks[i];
+        tasks[i] = tasks[j];
+        tasks[j] = tmp;
+    }
+}
+
+// Define the ready queue under test
+typedef struct {
+    int (*push)(void *q, pcb_t *task);
+    pcb_t *(*pop)(void *q);
+} bench_queue_t;
+
+static int ring_push_q(void *q, pcb_t *task) { return ring_push(q, task); }
+static pcb_t *ring_pop_q(void *q) { return ring_pop(q); }
+static int list_push_q(void *q, pcb_t *task) { return enqueue_pcb(q, task); }
+static pcb_t *list_pop_q(void *q) { return dequeue_pcb(q); }
+
+static bench_result_t run(const bench_queue_t *bq, void *q, pcb_t **tasks, uint32_t n, uint32_t rounds) {
+    for (uint32_t i = 0; i < n; i++) {
+        bq->push(q, tasks[i]);
+    }
+    bench_result_t result = {0};
+    uint64_t now = 0;
+    double start = monotonic_s();
+    for (uint64_t d = 0; d < (uint64_t) n * rounds; d++) {
+        pcb_t *task = bq->pop(q);
+        task->slice_start_ns = now;
+        task->ellapsed_time_ns += BENCH_TICK_NS;
+        now += BENCH_TICK_NS;
+        result.checksum += task->ellapsed_time_ns + (uint64_t) task->pid;
+        bq->push(q, task);
+    }
+    result.ns_per_dispatch = (monotonic_s() - start) * 1e9 / ((double) n * rounds);
+    while (bq->pop(q) != NULL) { }
+    return result;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n processes] [-r rounds]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 1000000;
+    uint32_t rounds = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (parse_uint(optarg, &n) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'r':
+                if (parse_uint(optarg, &rounds) < 0) exit(EXIT_FAILURE);
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    pcb_t **tasks = malloc(n * sizeof(pcb_t *));
+    if (!tasks) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    printf("%u processes, %u rounds of dispatches, pcb %zu bytes + cold part %zu bytes\n",
+           n, rounds, sizeof(pcb_t), sizeof(pcb_cold_t));
+
+    // PCB table
+    pcb_table_t table = {0};
+    for (uint32_t i = 0; i < n; i++) {
+        tasks[i] = new_pcb(&table, (int32_t) i + 1, 0, UINT64_MAX);
+        if (!tasks[i]) {
+            perror("new_pcb");
+            return EXIT_FAILURE;
+        }
+    }
+    shuffle(tasks, n);
+    pcb_ring_t ring = {0};
+    const bench_queue_t ring_ops = {ring_push_q, ring_pop_q};
+    bench_result_t table_result = run(&ring_ops, &ring, tasks, n, rounds);
+    ring_free(&ring);
+    pcb_table_free(&table);
+
+    // One allocation per PCB (with its cold data, like before the split), linked queue
+    for (uint32_t i = 0; i < n; i++) {
+        tasks[i] = malloc(sizeof(pcb_t) + sizeof(pcb_cold_t));
+        if (!tasks[i]) {
+            perror("malloc");
+            return EXIT_FAILURE;
+        }
+        memset(tasks[i], 0, sizeof(pcb_t) + sizeof(pcb_cold_t));
+        tasks[i]->pid = (int32_t) i + 1;
+        tasks[i]->time_ns = UINT64_MAX;
+        tasks[i]->cold = (pcb_cold_t *) (tasks[i] + 1);
+    }
+    shuffle(tasks, n);
+    queue_t list = {0};
+    const bench_queue_t list_ops = {list_push_q, list_pop_q};
+    bench_result_t malloc_result = run(&list_ops, &list, tasks, n, rounds);
+    for (uint32_t i = 0; i < n; i++) {
+        free(tasks[i]);
+    }
+    free(tasks);
+
+    printf("PCB table, ring:           %7.1f ns per dispatch\n", table_result.ns_per_dispatch);
+    printf("Allocated pcb, linked:     %7.1f ns per dispatch\n", malloc_result.ns_per_dispatch);
+    printf("Speedup: %.2fx (checksums %llu %llu)\n",
+           table_result.ns_per_dispatch > 0 ? malloc_result.ns_per_dispatch / table_result.ns_per_dispatch : 0.0,
+           (unsigned long long) table_result.checksum, (unsigned long long) malloc_result.checksum);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include "pidindex.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PID_INDEX_INITIAL_CAPACITY 1024
+
+static uint32_t pid_hash(int32_t pid) {
+    return (uint32_t) pid * 0x9E3779B1u;
+}
+
+pcb_t *pid_index_find(const pid_index_t *index, int32_t pid) {
+    if (index->capacity == 0) return NULL;
+    uint32_t mask = index->capacity - 1;
+    for (uint32_t i = pid_hash(pid) & mask; index->slots[i].handle_plus_one != 0; i = (i + 1) & mask) {
+        if (index->slots[i].pid == pid) return pcb_from_handle(index->table, index->slots[i].handle_plus_one - 1);
+    }
+    return NULL;
+}
+
+static void insert(pid_slot_t *slots, uint32_t capacity, pid_slot_t slot) {
+    uint32_t i = pid_hash(slot.pid) & (capacity - 1);
+    while (slots[i].handle_plus_one != 0) i = (i + 1) & (capacity - 1);
+    slots[i] = slot;
+}
+
+int pid_index_add(pid_index_t *index, const pcb_t *task) {
+    if (pid_index_find(index, task->pid) != NULL) {
+        errno = EEXIST;
+        return -1;
+    }
+    // Keep the table at most half full
+    if (2 * (index->count + 1) > index->capacity) {
+        uint32_t capacity = index->capacity ? 2 * index->capacity : PID_INDEX_INITIAL_CAPACITY;
+        pid_slot_t *slots = calloc(capacity, sizeof(pid_slot_t));
+        if (!slots) {
+            errno = ENOMEM;
+            return -1;
+        }
+        for (uint32_t i = 0; i < index->capacity; i++) {
+            if (index->slots[i].handle_plus_one != 0) insert(slots, capacity, index->slots[i]);
+        }
+        free(index->slots);
+        index->slots = slots;
+        index->capacity = capacity;
+    }
+    insert(index->slots, index->capacity, (pid_slot_t) {.pid = task->pid, .handle_plus_one = task->handle + 1});
+    index->count++;
+    return 0;
+}
+
+void pid_index_remove(pid_index_t *index, const pcb_t *task) {
+    if (index->capacity == 0) return;
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = pid_hash(task->pid) & mask;
+    while (index->slots[i].handle_plus_one != 0 && index->slots[i].handle_plus_one != task->handle + 1) {
+        i = (i + 1) & mask;
+    }
+    if (index->slots[i].handle_plus_one == 0) return;
+    index->slots[i].handle_plus_one = 0;
+    index->count--;
+    // Move back the entries of the cluster that would not be found past the hole (as in mux.c)
+    for (uint32_t j = (i + 1) & mask; index->slots[j].handle_plus_one != 0; j = (j + 1) & mask) {
+        uint32_t home = pid_hash(index->slots[j].pid) & mask;
+        // The entry stays if its home lies cyclically in (i, j]
+        if (i <= j ? (home > i && home <= j) : (home > i || home <= j)) continue;
+        index->slots[i] = index->slots[j];
+        index->slots[j].handle_plus_one = 0;
+        i = j;
+    }
+}
+
+void pid_index_free(pid_index_t *index) {
+    free(index->slots);
+    const pcb_table_t *table = index->table;
+    memset(index, 0, sizeof(pid_index_t));
+    index->table = table;
+}
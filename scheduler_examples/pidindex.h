@@ -0,0 +1,63 @@
+#ifndef PIDINDEX_H
+#define PIDINDEX_H
+
+#include <stdint.h>
+
+#include "queue.h"
+
+/*
+ * Index of the tasks by pid.
+ *
+ * A task can be in the command queue, a ready queue, on a CPU, blocked on a timer
+ * or a device, or swapped out; finding it by walking those would take time in the
+ * number of tasks. The index maps a pid to the handle of its pcb in a hash table
+ * (open addressing, linear probing), so the control requests (KILL, RENICE,
+ * SUSPEND, RESUME) find any task in O(1). Where the task is is told by its status
+ * and flags, kept up to date by every transition.
+ *
+ * The slots only hold the pid and the handle, 8 bytes, so a lookup reads the
+ * slots of a cluster without visiting the pcbs on the way.
+ */
+
+// Define a slot of the index
+typedef struct {
+    int32_t pid;
+    uint32_t handle_plus_one;   // 0: empty slot
+} pid_slot_t;
+
+// Define the index
+typedef struct {
+    const pcb_table_t *table;   // Table the handles refer to
+    pid_slot_t *slots;
+    uint32_t capacity;          // Power of two (0 until the first add)
+    uint32_t count;
+} pid_index_t;
+
+/**
+ * @brief Find the pcb of a pid
+ *
+ * @return The pcb, or NULL if no task has the pid
+ */
+pcb_t *pid_index_find(const pid_index_t *index, int32_t pid);
+
+/**
+ * @brief Index a pcb by its pid
+ *
+ * @param index The index
+ * @param task The pcb
+ * @return 0 on success, -1 if the pcb is not indexed: errno EEXIST if the pid belongs to another task, ENOMEM if
+ *         there is no memory
+ */
+int pid_index_add(pid_index_t *index, const pcb_t *task);
+
+/**
+ * @brief Remove a pcb from the index, nothing is done if it is not indexed
+ */
+void pid_index_remove(pid_index_t *index, const pcb_t *task);
+
+/**
+ * @brief Free the memory of the index
+ */
+void pid_index_free(pid_index_t *index);
+
+#endif //PIDINDEX_H
@@ -2,20 +2,104 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-pcb_t *new_pcb(pid_t pid, uint32_t sockfd, uint32_t time_ms) {
-    pcb_t * new_task = malloc(sizeof(pcb_t));
-    if (!new_task) return NULL;
+/**
+ * @brief Add a chunk of PCBs to a table
+ */
+static int table_grow(pcb_table_t *table) {
+    pcb_t **hot = realloc(table->hot, (table->num_chunks + 1) * sizeof(pcb_t *));
+    if (!hot) return -1;
+    table->hot = hot;
+    pcb_cold_t **cold = realloc(table->cold, (table->num_chunks + 1) * sizeof(pcb_cold_t *));
+    if (!cold) return -1;
+    table->cold = cold;
+    uint32_t *free_handles = realloc(table->free_handles, (table->num_chunks + 1) * PCB_TABLE_CHUNK * sizeof(uint32_t));
+    if (!free_handles) return -1;
+    table->free_handles = free_handles;
+    // A pcb is 64 bytes: aligned, it takes a single cache line
+    hot[table->num_chunks] = aligned_alloc(64, PCB_TABLE_CHUNK * sizeof(pcb_t));
+    cold[table->num_chunks] = malloc(PCB_TABLE_CHUNK * sizeof(pcb_cold_t));
+    if (!hot[table->num_chunks] || !cold[table->num_chunks]) {
+        free(hot[table->num_chunks]);
+        free(cold[table->num_chunks]);
+        return -1;
+    }
+    table->num_chunks++;
+    return 0;
+}
+
+pcb_t *new_pcb(pcb_table_t *table, pid_t pid, uint32_t sockfd, uint64_t time_ns) {
+    uint32_t handle;
+    if (table->num_free > 0) {
+        handle = table->free_handles[--table->num_free];
+    } else {
+        if (table->used == table->num_chunks * PCB_TABLE_CHUNK && table_grow(table) < 0) {
+            return NULL;
+        }
+        handle = table->used++;
+    }
+    table->count++;
+    pcb_t *new_task = pcb_from_handle(table, handle);
+    pcb_cold_t *cold = &table->cold[handle / PCB_TABLE_CHUNK][handle % PCB_TABLE_CHUNK];
 
     new_task->pid = pid;
     new_task->status = TASK_COMMAND;
-    new_task->slice_start_ms = 0;
-    new_task->sockfd = sockfd;
-    new_task->time_ms = time_ms;
-    new_task->ellapsed_time_ms = 0;
+    new_task->slice_start_ns = 0;
+    new_task->time_ns = time_ns;
+    new_task->ellapsed_time_ns = 0;
+    new_task->last_cpu = -1;
+    new_task->queue_level = 0;
+    new_task->wait_until_ns = 0;
+    new_task->paged_in = 0;
+    new_task->flags = 0;
+    new_task->handle = handle;
+    new_task->cold = cold;
+    cold->sockfd = sockfd;
+    cold->channel = NULL;
+    cold->mux = NULL;
+    cold->script = NULL;
+    cold->last_update_time_ns = 0;
+    cold->pages.count = 0;
+    cold->mm = NULL;
+    cold->swapped_out_ns = 0;
+    cold->io_device = 0;
+    cold->io_block = BLOCK_ADDRESS_NONE;
+    cold->io_queued_ns = 0;
+    cold->request_ns = 0;
+    cold->nice = 0;
+    cold->admitted_ns = 0;
+    cold->tokens = 0;
+    cold->tokens_ns = 0;
+    cold->deferred_ns = 0;
+    cold->deferred = NULL;
+    cold->inherited = UINT32_MAX;
+    cold->waiting_mutex = 0;
+    cold->mutex_wait_ns = 0;
+    cold->real = NULL;
+    cold->level_start_ns = 0;
+    cold->own_level = UINT32_MAX;
+    cold->run_queue = 0;
     return new_task;
 }
 
+void free_pcb(pcb_table_t *table, pcb_t *task) {
+    if (!task) return;
+    table->free_handles[table->num_free++] = task->handle;
+    table->count--;
+}
+
+void pcb_table_free(pcb_table_t *table) {
+    for (uint32_t i = 0; i < table->num_chunks; i++) {
+        free(table->hot[i]);
+        free(table->cold[i]);
+    }
+    free(table->hot);
+    free(table->cold);
+    free(table->free_handles);
+    memset(table, 0, sizeof(pcb_table_t));
+}
+
 int enqueue_pcb(queue_t* q, pcb_t* task) {
     queue_elem_t* elem = malloc(sizeof(queue_elem_t));
     if (!elem) return 0;
@@ -67,4 +151,83 @@ queue_elem_t *remove_queue_elem(queue_t* q, queue_elem_t* elem) {
     }
     printf("Queue element not found in queue\n");
     return NULL;
-}
\ No newline at end of file
+}
+
+int remove_pcb(queue_t* q, pcb_t* task) {
+    queue_elem_t* prev = NULL;
+    for (queue_elem_t* it = q->head; it != NULL; prev = it, it = it->next) {
+        if (it->pcb == task) {
+            if (prev) {
+                prev->next = it->next;
+            } else {
+                q->head = it->next;
+            }
+            if (it == q->tail) {
+                q->tail = prev;
+            }
+            free(it);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int ring_push(pcb_ring_t *r, pcb_t *task) {
+    if (r->count == r->capacity) {
+        uint32_t capacity = r->capacity ? r->capacity * 2 : 64;
+        pcb_t **slots = malloc(capacity * sizeof(pcb_t *));
+        if (!slots) return 0;
+        // Unwrap the old array at the start of the new one
+        for (uint32_t i = 0; i < r->count; i++) {
+            slots[i] = ring_at(r, i);
+        }
+        free(r->slots);
+        r->slots = slots;
+        r->capacity = capacity;
+        r->head = 0;
+    }
+    r->slots[(r->head + r->count) & (r->capacity - 1)] = task;
+    r->count++;
+    return 1;
+}
+
+pcb_t *ring_pop(pcb_ring_t *r) {
+    if (r->count == 0) return NULL;
+    pcb_t *task = r->slots[r->head];
+    r->head = (r->head + 1) & (r->capacity - 1);
+    r->count--;
+    return task;
+}
+
+pcb_t *ring_take(pcb_ring_t *r, uint32_t index) {
+    uint32_t mask = r->capacity - 1;
+    pcb_t *task = ring_at(r, index);
+    // Close the gap from the nearest end
+    if (index < r->count / 2) {
+        for (uint32_t i = index; i > 0; i--) {
+            r->slots[(r->head + i) & mask] = r->slots[(r->head + i - 1) & mask];
+        }
+        r->head = (r->head + 1) & mask;
+    } else {
+        for (uint32_t i = index; i + 1 < r->count; i++) {
+            r->slots[(r->head + i) & mask] = r->slots[(r->head + i + 1) & mask];
+        }
+    }
+    r->count--;
+    return task;
+}
+
+int ring_remove(pcb_ring_t *r, pcb_t *task) {
+    for (uint32_t i = 0; i < r->count; i++) {
+        if (ring_at(r, i) == task) {
+            ring_take(r, i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void ring_free(pcb_ring_t *r) {
+    free(r->slots);
+    memset(r, 0, sizeof(pcb_ring_t));
+}
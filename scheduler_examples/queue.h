@@ -2,6 +2,8 @@
 #define QUEUE_H
 #include <stdint.h>
 
+#include "msg.h"
+
 typedef enum  {
     TASK_COMMAND = 0,   // Task has connected and is waiting for instructions
     TASK_BLOCKED,       // Task is blocked (waiting/IO wait)
@@ -10,16 +12,7 @@ typedef enum  {
     TASK_TERMINATED,    // Task has been terminated and will be removed
 } task_status_en;
 
-// Define the Process Control Block (PCB) structure
-typedef struct pcb_st{
-    int32_t pid;                   // Process ID
-    task_status_en status;         // Current status of the task defined by the pcb
-    uint32_t time_ms;              // Time requested by application in milliseconds
-    uint32_t ellapsed_time_ms;     // Time ellapsed since start in milliseconds
-    uint32_t slice_start_ms;       // Time when the current time slice started
-    uint32_t sockfd;               // Socket file descriptor for communication with the application
-    uint32_t last_update_time_ms;  // Last time the PCB was updataed
-} pcb_t;
+typedef struct pcb_st pcb_t;
 
 // Define singly linked list elements
 typedef struct queue_elem_st queue_elem_t;
@@ -28,6 +21,75 @@ typedef struct queue_elem_st {
     queue_elem_t *next;
 } queue_elem_t;
 
+// Flags of a pcb, set by the control requests and acted on at the next transition of the task
+#define PCB_KILLED 0x1             // Leaves the simulation (KILL)
+#define PCB_SUSPENDED 0x2          // Is not given a CPU until resumed (SUSPEND)
+#define PCB_PARKED 0x4             // Suspended while runnable, waits in the suspended queue of the scheduler
+#define PCB_DEFERRED 0x8           // Its request waits for admission (admission.h), the ACK is not sent yet
+#define PCB_INDEXED 0x10           // Found by its pid in the pid index of ossim (pidindex.h)
+
+// Define the cold part of a PCB: connection and request data, not read when scheduling
+typedef struct pcb_cold_st {
+    uint32_t sockfd;               // Socket file descriptor for communication with the application
+    uint32_t io_device;            // Device of the current BLOCK request
+    uint32_t io_block;             // Block address of the current BLOCK request
+    struct shm_channel_st *channel; // Shared-memory rings of the application (NULL if it uses the socket)
+    struct mux_st *mux;            // Multiplexed connection of the task (NULL if the connection is its own)
+    struct script_st *script;      // Script being uploaded or run (NULL if the requests come one by one)
+    struct vm_space_st *mm;        // Page table (NULL until the task references pages)
+    uint64_t last_update_time_ns;  // Last time the PCB was updataed
+    uint64_t swapped_out_ns;       // Time the task was swapped out
+    uint64_t io_queued_ns;         // Time the BLOCK request was queued on the device
+    uint64_t request_ns;           // Time the current RUN or BLOCK request started
+    uint32_t nice;                 // Priority level set by RENICE (0 is the highest)
+    uint64_t admitted_ns;          // CPU work admitted and not done yet (admission.h)
+    uint64_t tokens;               // Token bucket of the connection, NS_PER_S per token
+    uint64_t tokens_ns;            // Last time the bucket was refilled
+    uint64_t deferred_ns;          // Time the request waiting for admission arrived
+    msg_t *deferred;               // Request waiting for admission (NULL for a script, or if none)
+    uint32_t inherited;            // Priority level inherited from the waiters of its mutexes (UINT32_MAX if none)
+    uint32_t waiting_mutex;        // Mutex the task waits for, index + 1 in the mutexes (0 if none, see locks.h)
+    uint64_t mutex_wait_ns;        // Since when it waits for the mutex
+    struct real_task_st *real;     // Real process at the other end of the connection (NULL if not enforced, see realproc.h)
+    uint64_t level_start_ns;       // CPU time of its burst when it reached its queue level (MLFQ)
+    uint32_t own_level;            // Its own queue level while it inherits a higher one (UINT32_MAX if it does not, MLFQ)
+    uint32_t run_queue;            // CPU whose run queue holds it, or last held it (per-CPU run queues, see scheduler.h)
+    page_info_t pages;             // Pages referenced by the current burst
+} pcb_cold_t;
+
+// Define the Process Control Block (PCB) structure
+// Only the fields the scheduler reads every tick are here, 64 bytes (a cache line), the rest is in the cold part
+typedef struct pcb_st {
+    int32_t pid;                   // Process ID
+    task_status_en status;         // Current status of the task defined by the pcb
+    uint64_t time_ns;              // Time requested by application in nanoseconds
+    uint64_t ellapsed_time_ns;     // Time ellapsed since start in nanoseconds
+    uint64_t slice_start_ns;       // Time when the current time slice started
+    uint64_t wait_until_ns;        // Time when a page fault, swap in or I/O request is serviced
+    int32_t last_cpu;              // CPU the task last ran on (-1 if it never ran)
+    uint32_t queue_level;          // Priority level of the task (used by MLFQ)
+    uint16_t paged_in;             // The page faults were serviced, the next dispatch runs without faulting
+    uint16_t flags;                // PCB_KILLED, PCB_SUSPENDED, PCB_PARKED, PCB_DEFERRED, PCB_INDEXED
+    uint32_t handle;               // Index of the pcb in its table
+    pcb_cold_t *cold;
+} pcb_t;
+
+// Number of PCBs allocated at once by a table
+#define PCB_TABLE_CHUNK 4096
+
+// Define a table of PCBs, indexed by 32-bit handles
+// The PCBs (hot) and their cold parts are kept in separate dense arrays, allocated a chunk at a
+// time so a pcb never moves, and the handles of freed PCBs are reused first
+typedef struct {
+    pcb_t **hot;                   // Chunks of PCB_TABLE_CHUNK PCBs
+    pcb_cold_t **cold;             // Chunks of PCB_TABLE_CHUNK cold parts, same index
+    uint32_t num_chunks;
+    uint32_t used;                 // Handles handed out at least once
+    uint32_t *free_handles;        // Stack of freed handles
+    uint32_t num_free;
+    uint32_t count;                // PCBs in use
+} pcb_table_t;
+
 // Define the queue structure
 // We define the head and the tail to make it easier to enqueue and dequeue
 typedef struct queue_st  {
@@ -35,17 +97,57 @@ typedef struct queue_st  {
     queue_elem_t* tail;
 } queue_t;
 
+// Define a ring of PCBs, used for the ready queues
+// The PCBs are in a growing array rather than a linked list: walking the queue reads the
+// array in order, so the PCBs can be fetched ahead instead of one pointer hop at a time
+typedef struct {
+    pcb_t **slots;
+    uint32_t capacity;             // Power of two (0 until the first push)
+    uint32_t head;                 // Slot of the first pcb
+    uint32_t count;
+} pcb_ring_t;
+
 /**
  * @brief Create a new pcb (process control block)
  *
- * This function allocates memory for a new pcb and initializes its fields.
+ * This function takes a pcb from the table and initializes its fields.
  *
+ * @param table The table of PCBs
  * @param pid The process ID of the task
  * @param sockfd The socket file descriptor for communication with the application
- * @param time_ms a time field (either for run or block)
- * @return
+ * @param time_ns a time field (either for run or block)
+ * @return The new pcb, or NULL if there is no memory
+ */
+pcb_t *new_pcb(pcb_table_t *table, int32_t pid, uint32_t sockfd, uint64_t time_ns);
+
+/**
+ * @brief Return a pcb to its table
+ *
+ * The pcb must not be in any queue anymore. Nothing is done if the pcb is NULL.
+ *
+ * @param table The table of PCBs
+ * @param task The pcb to free
+ */
+void free_pcb(pcb_table_t *table, pcb_t *task);
+
+/**
+ * @brief Get the priority level of a task: its nice level, or the level it inherited if that is higher (lower number)
+ */
+static inline uint32_t pcb_priority(const pcb_t *task) {
+    return task->cold->inherited < task->cold->nice ? task->cold->inherited : task->cold->nice;
+}
+
+/**
+ * @brief Get the pcb of a handle
+ */
+static inline pcb_t *pcb_from_handle(const pcb_table_t *table, uint32_t handle) {
+    return &table->hot[handle / PCB_TABLE_CHUNK][handle % PCB_TABLE_CHUNK];
+}
+
+/**
+ * @brief Free the memory of a table, and of the PCBs still in it
  */
-pcb_t *new_pcb(int32_t pid, uint32_t sockfd, uint32_t time_ms);
+void pcb_table_free(pcb_table_t *table);
 
 /**
  * @brief Enqueue a pcb into the queue
@@ -80,5 +182,60 @@ pcb_t* dequeue_pcb(queue_t* q);
  */
 queue_elem_t *remove_queue_elem(queue_t* q, queue_elem_t* elem);
 
+/**
+ * @brief Remove a pcb from anywhere in the queue
+ *
+ * The element holding the pcb is freed, the pcb is not.
+ *
+ * @param q The queue from which the pcb will be removed
+ * @param task The pcb to be removed
+ * @return 1 if the pcb was removed, 0 if it was not in the queue
+ */
+int remove_pcb(queue_t* q, pcb_t* task);
+
+/**
+ * @brief Add a pcb at the end of a ring, growing it if needed
+ *
+ * @param r The ring
+ * @param task The pcb to add
+ * @return The number of pcb added (0 on failure)
+ */
+int ring_push(pcb_ring_t *r, pcb_t *task);
+
+/**
+ * @brief Remove and return the pcb at the front of a ring
+ *
+ * @return The pcb, or NULL if the ring is empty
+ */
+pcb_t *ring_pop(pcb_ring_t *r);
+
+/**
+ * @brief Get the pcb at a position of a ring (0 is the front)
+ */
+static inline pcb_t *ring_at(const pcb_ring_t *r, uint32_t index) {
+    return r->slots[(r->head + index) & (r->capacity - 1)];
+}
+
+/**
+ * @brief Remove the pcb at a position of a ring, keeping the order of the others
+ *
+ * @param r The ring
+ * @param index The position (0 is the front), must be below the count
+ * @return The removed pcb
+ */
+pcb_t *ring_take(pcb_ring_t *r, uint32_t index);
+
+/**
+ * @brief Remove a pcb from anywhere in a ring
+ *
+ * @return 1 if the pcb was removed, 0 if it was not in the ring
+ */
+int ring_remove(pcb_ring_t *r, pcb_t *task);
+
+/**
+ * @brief Free the array of a ring (the PCBs are not freed)
+ */
+void ring_free(pcb_ring_t *r);
+
 
 #endif //QUEUE_H
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include "realproc.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "msg.h"
+
+int realproc_init(realproc_t *rp, const char *spec) {
+    memset(rp, 0, sizeof(realproc_t));
+    if (strcmp(spec, "all") == 0) {
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+            perror("sched_getaffinity");
+            return -1;
+        }
+        for (int core = 0; core < CPU_SETSIZE && rp->num_cores < MAX_CPUS; core++) {
+            if (CPU_ISSET(core, &set)) rp->cores[rp->num_cores++] = core;
+        }
+        return 0;
+    }
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    int status = 0;
+    char *endptr;
+    for (char *token = strtok(copy, ","); token && status == 0; token = strtok(NULL, ",")) {
+        long core = strtol(token, &endptr, 10);
+        if (*endptr != '\0' || core < 0 || core >= CPU_SETSIZE || rp->num_cores == MAX_CPUS) {
+            status = -1;
+        } else {
+            rp->cores[rp->num_cores++] = (int) core;
+        }
+    }
+    if (rp->num_cores == 0) status = -1;
+    if (status < 0) {
+        fprintf(stderr, "Invalid host cores: %s (expected all or core[,core...])\n", spec);
+    }
+    free(copy);
+    return status;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_S + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t cpu_time_ns(const real_task_t *task) {
+    struct timespec ts;
+    if (clock_gettime(task->clock, &ts) < 0) return 0;
+    return (uint64_t) ts.tv_sec * NS_PER_S + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Get the process of a task, if its scheduling is enforced
+ *
+ * The pid of the requests must be the one of the peer, which is not the case of
+ * the virtual processes of a load generator, or before the first request.
+ */
+static real_task_t *enforced(const pcb_t *pcb) {
+    real_task_t *task = pcb->cold->real;
+    return task && task->pid == pcb->pid ? task : NULL;
+}
+
+static void send_signal(realproc_t *rp, real_task_t *task, int sig) {
+    if (kill(task->pid, sig) < 0) {
+        rp->stats.failures++;
+        return;
+    }
+    if (sig == SIGSTOP) {
+        task->stopped = 1;
+        rp->stats.stops++;
+    } else {
+        task->stopped = 0;
+        rp->stats.conts++;
+    }
+}
+
+void realproc_connect(realproc_t *rp, pcb_t *pcb, int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+        perror("getsockopt: SO_PEERCRED");
+        return;
+    }
+    real_task_t *task = calloc(1, sizeof(real_task_t));
+    if (!task) {
+        perror("calloc");
+        return;
+    }
+    task->pid = cred.pid;
+    task->core = -1;
+    if (clock_getcpuclockid(cred.pid, &task->clock) != 0) {
+        // Not measured, still enforced
+        task->clock = (clockid_t) -1;
+    }
+    task->next = rp->tasks;
+    if (rp->tasks) rp->tasks->prev = task;
+    rp->tasks = task;
+    pcb->cold->real = task;
+    rp->stats.processes++;
+}
+
+void realproc_stop(realproc_t *rp, pcb_t *pcb) {
+    real_task_t *task = enforced(pcb);
+    if (task && !task->stopped) send_signal(rp, task, SIGSTOP);
+}
+
+void realproc_continue(realproc_t *rp, pcb_t *pcb) {
+    real_task_t *task = enforced(pcb);
+    if (task && task->stopped) send_signal(rp, task, SIGCONT);
+}
+
+/**
+ * @brief Account the time a process spent on a simulated CPU
+ */
+static void leave_cpu(realproc_t *rp, real_task_t *task) {
+    if (!task->on_cpu) return;
+    uint64_t given_ns = monotonic_ns() - task->on_cpu_ns;
+    uint64_t cpu_ns = cpu_time_ns(task);
+    uint64_t used_ns = cpu_ns > task->on_cpu_cpu_ns ? cpu_ns - task->on_cpu_cpu_ns : 0;
+    task->on_cpu = 0;
+    task->given_ns += given_ns;
+    task->used_ns += used_ns;
+    rp->stats.given_ns += given_ns;
+    rp->stats.used_ns += used_ns;
+}
+
+void realproc_free(realproc_t *rp) {
+    real_task_t *task = rp->tasks;
+    while (task != NULL) {
+        real_task_t *next = task->next;
+        // Still on a simulated CPU when ossim stops, its time counts too
+        leave_cpu(rp, task);
+        if (task->stopped) send_signal(rp, task, SIGCONT);
+        free(task);
+        task = next;
+    }
+    rp->tasks = NULL;
+}
+
+void realproc_on_cpu(void *ctx, pcb_t *pcb, uint32_t cpu, sched_cpu_event_en event) {
+    realproc_t *rp = ctx;
+    real_task_t *task = enforced(pcb);
+    if (!task) return;
+    if (event != SCHED_CPU_DISPATCH) {
+        leave_cpu(rp, task);
+        if (event == SCHED_CPU_PREEMPT && !task->stopped) send_signal(rp, task, SIGSTOP);
+        return;
+    }
+    int core = rp->cores[cpu % rp->num_cores];
+    if (core != task->core) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        if (sched_setaffinity(task->pid, sizeof(set), &set) < 0) {
+            rp->stats.failures++;
+        } else {
+            task->core = core;
+            rp->stats.pins++;
+        }
+    }
+    task->on_cpu = 1;
+    task->on_cpu_ns = monotonic_ns();
+    task->on_cpu_cpu_ns = cpu_time_ns(task);
+    if (task->stopped) send_signal(rp, task, SIGCONT);
+}
+
+void realproc_release(realproc_t *rp, pcb_t *pcb) {
+    real_task_t *task = pcb->cold->real;
+    if (!task) return;
+    leave_cpu(rp, task);
+    if (task->stopped) send_signal(rp, task, SIGCONT);
+    if (task->given_ns > 0) {
+        printf("Process %d: %.3f s on a CPU, %.3f s of CPU time measured (%.1f%%)\n", task->pid,
+               (double) task->given_ns / 1e9, (double) task->used_ns / 1e9,
+               100.0 * (double) task->used_ns / (double) task->given_ns);
+    }
+    if (task->prev) task->prev->next = task->next;
+    else rp->tasks = task->next;
+    if (task->next) task->next->prev = task->prev;
+    free(task);
+    pcb->cold->real = NULL;
+}
+
+void realproc_print_stats(const realproc_t *rp, FILE *out) {
+    const realproc_stats_t *stats = &rp->stats;
+    fprintf(out, "Real processes: %llu connected, %u host core(s), SIGSTOP=%llu, SIGCONT=%llu, pinned=%llu, failed=%llu\n",
+            (unsigned long long) stats->processes, rp->num_cores, (unsigned long long) stats->stops,
+            (unsigned long long) stats->conts, (unsigned long long) stats->pins, (unsigned long long) stats->failures);
+    fprintf(out, "Real processes: %.3f s on a CPU, %.3f s of CPU time measured (%.1f%%)\n",
+            (double) stats->given_ns / 1e9, (double) stats->used_ns / 1e9,
+            stats->given_ns ? 100.0 * (double) stats->used_ns / (double) stats->given_ns : 0.0);
+}
@@ -0,0 +1,120 @@
+#ifndef REALPROC_H
+#define REALPROC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "queue.h"
+#include "scheduler.h"
+
+/*
+ * Real-process mode.
+ *
+ * Normally the applications trust the clock of the simulator and never use a
+ * real CPU. In real-process mode the applications burn CPU while their requests
+ * run (app -X, app-io -X), and ossim enforces its decisions on them: a process
+ * is stopped (SIGSTOP) while its request is in progress and it is not on a
+ * simulated CPU (ready, blocked, waiting for a mutex, suspended), and continued
+ * (SIGCONT) when it is dispatched, pinned to the host core of that CPU with
+ * sched_setaffinity, or when its DONE is sent. The policies then schedule real
+ * workloads on a Linux machine, and the CPU time the processes really got while
+ * on a simulated CPU is measured (through their CPU-time clocks) against the time
+ * they were given.
+ *
+ * Only the process at the other end of the connection is ever signalled: its pid
+ * is taken from the socket (SO_PEERCRED) and must be the pid of the requests.
+ * The virtual processes of a load generator keep being simulated only. A process
+ * is always continued when its connection closes or ossim stops.
+ *
+ * Simulated CPU i runs on host core cores[i % num_cores]. The simulated clock is
+ * still the tick clock: a task given a 10 ms tick gets at most 10 ms of wall time.
+ */
+
+// Define a process whose scheduling is enforced
+typedef struct real_task_st {
+    pid_t pid;                  // Pid of the peer of the connection
+    clockid_t clock;            // CPU-time clock of the process
+    int stopped;                // SIGSTOP sent and not continued yet
+    int32_t core;               // Host core it is pinned to (-1 if not pinned yet)
+    int on_cpu;                 // On a simulated CPU since on_cpu_ns
+    uint64_t on_cpu_ns;         // Wall time it was dispatched (CLOCK_MONOTONIC)
+    uint64_t on_cpu_cpu_ns;     // Its CPU time when it was dispatched
+    uint64_t given_ns;          // Wall time spent on a simulated CPU
+    uint64_t used_ns;           // CPU time used meanwhile
+    struct real_task_st *prev, *next;
+} real_task_t;
+
+// Define the counters of the real-process mode
+typedef struct {
+    uint64_t processes;         // Connections whose peer process is known
+    uint64_t stops;             // SIGSTOP sent
+    uint64_t conts;             // SIGCONT sent
+    uint64_t pins;              // sched_setaffinity calls that moved a process
+    uint64_t failures;          // Signals or pinnings that failed (process gone, permissions)
+    uint64_t given_ns;          // Wall time the processes spent on a simulated CPU
+    uint64_t used_ns;           // CPU time they used meanwhile
+} realproc_stats_t;
+
+// Define the real-process mode
+typedef struct {
+    int cores[MAX_CPUS];        // Host core of every simulated CPU
+    uint32_t num_cores;
+    real_task_t *tasks;         // Processes connected, to continue them when ossim stops
+    realproc_stats_t stats;
+} realproc_t;
+
+/**
+ * @brief Parse the host cores, like "all" (the cores ossim may run on) or "2,3"
+ *
+ * @param spec The cores
+ * @param rp The real-process mode to initialize
+ * @return 0 on success, -1 if the cores are invalid
+ */
+int realproc_init(realproc_t *rp, const char *spec);
+
+/**
+ * @brief Account the time of the processes still on a simulated CPU, continue every process still stopped and free the mode
+ */
+void realproc_free(realproc_t *rp);
+
+/**
+ * @brief Take the pid of the process at the other end of a new connection
+ *
+ * @param rp The real-process mode
+ * @param pcb The pcb of the connection
+ * @param fd The socket of the connection
+ */
+void realproc_connect(realproc_t *rp, pcb_t *pcb, int fd);
+
+/**
+ * @brief Stop the process of a task whose request starts (nothing if it is not enforced or already stopped)
+ */
+void realproc_stop(realproc_t *rp, pcb_t *pcb);
+
+/**
+ * @brief Continue the process of a task whose request is done (nothing if it is not enforced or not stopped)
+ */
+void realproc_continue(realproc_t *rp, pcb_t *pcb);
+
+/**
+ * @brief The CPU hook of the scheduler (sched_cpu_fn), ctx is the realproc_t
+ *
+ * A dispatched process is pinned and continued; a preempted one is stopped. A
+ * process whose burst is over stays running until its next request starts or
+ * its DONE is sent, in the same tick.
+ */
+void realproc_on_cpu(void *ctx, pcb_t *pcb, uint32_t cpu, sched_cpu_event_en event);
+
+/**
+ * @brief Continue the process of a connection that closed and forget it
+ */
+void realproc_release(realproc_t *rp, pcb_t *pcb);
+
+/**
+ * @brief Print the counters
+ */
+void realproc_print_stats(const realproc_t *rp, FILE *out);
+
+#endif //REALPROC_H
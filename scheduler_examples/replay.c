@@ -0,0 +1,162 @@
+#include "replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Only the first few divergences are printed, the rest are only counted
+#define MAX_REPORTED_MISMATCHES 10
+
+static int push_record(msglog_record_t **array, size_t *count, size_t *cap, const msglog_record_t *record) {
+    if (*count == *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 64;
+        msglog_record_t *tmp = realloc(*array, new_cap * sizeof(msglog_record_t));
+        if (!tmp) {
+            perror("realloc");
+            return -1;
+        }
+        *array = tmp;
+        *cap = new_cap;
+    }
+    (*array)[(*count)++] = *record;
+    return 0;
+}
+
+static int push_inbound(replay_t *replay, const replay_inbound_t *inbound) {
+    if (replay->num_due == replay->cap_due) {
+        size_t new_cap = replay->cap_due ? replay->cap_due * 2 : 64;
+        replay_inbound_t *tmp = realloc(replay->due, new_cap * sizeof(replay_inbound_t));
+        if (!tmp) {
+            perror("realloc");
+            return -1;
+        }
+        replay->due = tmp;
+        replay->cap_due = new_cap;
+    }
+    replay->due[replay->num_due++] = *inbound;
+    return 0;
+}
+
+static void remove_due(replay_t *replay, size_t i) {
+    memmove(&replay->due[i], &replay->due[i + 1], (replay->num_due - i - 1) * sizeof(replay_inbound_t));
+    replay->num_due--;
+}
+
+int replay_open(replay_t *replay, const char *path) {
+    memset(replay, 0, sizeof(replay_t));
+    if (msglog_open(&replay->log, path) < 0) {
+        return -1;
+    }
+    if (replay->log.header.tick_ns < MIN_TICK_NS) {
+        fprintf(stderr, "Log was recorded with an invalid tick of %llu ns\n",
+                (unsigned long long) replay->log.header.tick_ns);
+        msglog_close(&replay->log);
+        return -1;
+    }
+    replay->has_next = msglog_read(&replay->log, &replay->next.record, &replay->next.pages) == 1;
+    return 0;
+}
+
+void replay_advance(replay_t *replay, uint64_t current_time_ns) {
+    while (replay->has_next && replay->next.record.time_ns <= current_time_ns) {
+        if (replay->next.record.event == MSGLOG_SEND) {
+            // Compact the expected queue before it grows
+            if (replay->expected_head > 0 && replay->num_expected == replay->cap_expected) {
+                memmove(replay->expected, &replay->expected[replay->expected_head],
+                        (replay->num_expected - replay->expected_head) * sizeof(msglog_record_t));
+                replay->num_expected -= replay->expected_head;
+                replay->expected_head = 0;
+            }
+            push_record(&replay->expected, &replay->num_expected, &replay->cap_expected, &replay->next.record);
+        } else {
+            push_inbound(replay, &replay->next);
+        }
+        replay->has_next = msglog_read(&replay->log, &replay->next.record, &replay->next.pages) == 1;
+    }
+}
+
+int32_t replay_accept(replay_t *replay) {
+    for (size_t i = 0; i < replay->num_due; i++) {
+        if (replay->due[i].record.event == MSGLOG_CONNECT) {
+            int32_t conn = replay->due[i].record.conn;
+            remove_due(replay, i);
+            return conn;
+        }
+    }
+    return -1;
+}
+
+int replay_read(replay_t *replay, int32_t conn, msg_t *msg) {
+    for (size_t i = 0; i < replay->num_due; i++) {
+        msglog_record_t *record = &replay->due[i].record;
+        if (record->conn != conn) continue;
+        if (record->event == MSGLOG_CONNECT) {
+            // The connection was closed and the descriptor reused, the close comes first
+            continue;
+        }
+        int n = 0;
+        if (record->event == MSGLOG_RECV) {
+            msg->pid = record->pid;
+            msg->request = (process_request_t) record->request;
+            msg->time_ns = record->msg_time_ns;
+            if (msg->request == PROCESS_REQUEST_LOCK || msg->request == PROCESS_REQUEST_UNLOCK) {
+                memcpy(msg->mutex, replay->due[i].pages.ids, MUTEX_NAME_LEN);
+            } else {
+                msg->pages = replay->due[i].pages;
+            }
+            msg->device = record->device;
+            msg->block = record->block;
+            msg->nice = record->nice;
+            n = sizeof(msg_t);
+        }
+        remove_due(replay, i);
+        return n;
+    }
+    return -1;
+}
+
+void replay_drop(replay_t *replay, int32_t conn) {
+    msg_t msg;
+    while (replay_read(replay, conn, &msg) > 0) { }
+}
+
+void replay_check_send(replay_t *replay, uint64_t current_time_ns, int32_t conn, const msg_t *msg) {
+    if (replay->expected_head == replay->num_expected) {
+        if (replay->mismatched++ < MAX_REPORTED_MISMATCHES) {
+            printf("Replay: unexpected %s to connection %d (pid %d) at %.3f ms\n",
+                   PROCESS_REQUEST_STRINGS[msg->request], conn, msg->pid, (double) current_time_ns / NS_PER_MS);
+        }
+        return;
+    }
+    const msglog_record_t *expected = &replay->expected[replay->expected_head++];
+    if (expected->time_ns == current_time_ns && expected->conn == conn && expected->pid == msg->pid &&
+        expected->request == (uint8_t) msg->request && expected->msg_time_ns == msg->time_ns) {
+        replay->matched++;
+        return;
+    }
+    if (replay->mismatched++ < MAX_REPORTED_MISMATCHES) {
+        printf("Replay: sent %s to connection %d (pid %d) at %.3f ms, recorded %s to connection %d (pid %d) at %.3f ms\n",
+               PROCESS_REQUEST_STRINGS[msg->request], conn, msg->pid, (double) current_time_ns / NS_PER_MS,
+               PROCESS_REQUEST_STRINGS[expected->request], expected->conn, expected->pid,
+               (double) expected->time_ns / NS_PER_MS);
+    }
+}
+
+int replay_finished(const replay_t *replay) {
+    return !replay->has_next && replay->num_due == 0;
+}
+
+void replay_report(const replay_t *replay, FILE *out) {
+    uint64_t missing = replay->num_expected - replay->expected_head;
+    fprintf(out, "Replay: %llu messages matched the recording, %llu differed, %llu recorded but not sent\n",
+            (unsigned long long) replay->matched,
+            (unsigned long long) replay->mismatched,
+            (unsigned long long) missing);
+    fprintf(out, "Replay: %s\n", (replay->mismatched == 0 && missing == 0) ? "identical to the recording" : "DIVERGED");
+}
+
+void replay_close(replay_t *replay) {
+    msglog_close(&replay->log);
+    free(replay->due);
+    free(replay->expected);
+    memset(replay, 0, sizeof(replay_t));
+}
@@ -0,0 +1,109 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "msg.h"
+#include "msglog.h"
+
+/*
+ * Replays a message log recorded by ossim.
+ *
+ * Instead of accepting connections and reading from sockets, ossim asks the
+ * replayer for the connections and messages that arrived at the current
+ * simulated time in the recorded run. Every message ossim sends is compared
+ * with the one sent in the recorded run, so any divergence is reported.
+ */
+
+// Define an inbound event with the pages of its message
+typedef struct {
+    msglog_record_t record;
+    page_info_t pages;
+} replay_inbound_t;
+
+// Define the replay state
+typedef struct {
+    msglog_t log;
+    replay_inbound_t next;          // Next record not yet due
+    int has_next;
+    replay_inbound_t *due;          // Inbound events due at the current time (or earlier)
+    size_t num_due, cap_due;
+    msglog_record_t *expected;      // Outbound messages not yet sent by the replay
+    size_t expected_head, num_expected, cap_expected;
+    uint64_t matched;               // Outbound messages equal to the recorded ones
+    uint64_t mismatched;            // Outbound messages different from the recorded ones
+} replay_t;
+
+/**
+ * @brief Open a log for replay
+ *
+ * @param replay The replay state
+ * @param path The log file
+ * @return 0 on success, -1 on failure
+ */
+int replay_open(replay_t *replay, const char *path);
+
+/**
+ * @brief Load all the events recorded up to the current time
+ *
+ * @param replay The replay state
+ * @param current_time_ns The current time in nanoseconds
+ */
+void replay_advance(replay_t *replay, uint64_t current_time_ns);
+
+/**
+ * @brief Get the next connection due at the current time
+ *
+ * @return The recorded connection id, or -1 if there is none
+ */
+int32_t replay_accept(replay_t *replay);
+
+/**
+ * @brief Get the next message from a connection due at the current time
+ *
+ * Works like read on a non-blocking socket.
+ *
+ * @param replay The replay state
+ * @param conn The connection
+ * @param msg Where to store the message
+ * @return sizeof(msg_t) if there is a message, 0 if the connection was closed, -1 if there is nothing due
+ */
+int replay_read(replay_t *replay, int32_t conn, msg_t *msg);
+
+/**
+ * @brief Forget what is due on a connection the simulator closed itself (e.g. KILL)
+ *
+ * The close was recorded when it happened, it is not read from the connection.
+ *
+ * @param replay The replay state
+ * @param conn The connection
+ */
+void replay_drop(replay_t *replay, int32_t conn);
+
+/**
+ * @brief Compare a message sent by ossim with the recorded one
+ *
+ * @param replay The replay state
+ * @param current_time_ns The current time in nanoseconds
+ * @param conn The connection the message is sent to
+ * @param msg The message
+ */
+void replay_check_send(replay_t *replay, uint64_t current_time_ns, int32_t conn, const msg_t *msg);
+
+/**
+ * @brief Check if every recorded inbound event has been replayed
+ */
+int replay_finished(const replay_t *replay);
+
+/**
+ * @brief Print how many outbound messages matched the recording
+ */
+void replay_report(const replay_t *replay, FILE *out);
+
+/**
+ * @brief Close the log and free the replay state
+ */
+void replay_close(replay_t *replay);
+
+#endif //REPLAY_H
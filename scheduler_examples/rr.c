@@ -2,53 +2,81 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "msg.h"
-#include <unistd.h>
 
 #define TIME_SLICE 500  // 500ms conforme especificado
 
-// Global variable to track current slice time
-static uint32_t current_slice_remaining = 0;
+typedef struct {
+    pcb_ring_t rq;
+    uint32_t time_slice_ms;
+    uint64_t time_slice_ns;
+} rr_t;
+
+/*
+ * Params: optional time slice in ms (e.g. "RR:250")
+ */
+static void *rr_init(const char *params) {
+    rr_t *rr = calloc(1, sizeof(rr_t));
+    if (!rr) return NULL;
+    rr->time_slice_ms = TIME_SLICE;
+    if (params) {
+        char *endptr;
+        long slice = strtol(params, &endptr, 10);
+        if (*endptr != '\0' || slice <= 0 || slice > UINT32_MAX) {
+            free(rr);
+            return NULL;
+        }
+        rr->time_slice_ms = (uint32_t) slice;
+    }
+    rr->time_slice_ns = rr->time_slice_ms * NS_PER_MS;
+    return rr;
+}
+
+static void rr_destroy(void *state) {
+    rr_t *rr = state;
+    ring_free(&rr->rq);
+    free(rr);
+}
+
+static void rr_enqueue(void *state, pcb_t *task, sched_enqueue_reason_en reason, uint64_t current_time_ns) {
+    (void) reason;
+    (void) current_time_ns;
+    rr_t *rr = state;
+    ring_push(&rr->rq, task);     // Preempted tasks go to the back of the queue
+}
+
+static int rr_remove(void *state, pcb_t *task) {
+    rr_t *rr = state;
+    return ring_remove(&rr->rq, task);
+}
+
+static pcb_t *rr_pick_next(void *state, uint64_t current_time_ns) {
+    (void) current_time_ns;
+    rr_t *rr = state;
+    return ring_pop(&rr->rq);
+}
 
 /**
  * @brief Round Robin (RR) scheduling algorithm.
  * Executes tasks for a fixed time slice, then preempts if not finished.
  */
-void rr_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task) {
-    if (*cpu_task) {
-        (*cpu_task)->ellapsed_time_ms += TICKS_MS;
-        if (current_slice_remaining >= TICKS_MS) {
-            current_slice_remaining -= TICKS_MS;
-        } else {
-            current_slice_remaining = 0;
-        }
-
-        // Task finished
-        if ((*cpu_task)->ellapsed_time_ms >= (*cpu_task)->time_ms) {
-            msg_t msg = {
-                .pid = (*cpu_task)->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write((*cpu_task)->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
-            }
-            free(*cpu_task);
-            *cpu_task = NULL;
-            current_slice_remaining = 0;
-        }
-        // Fatiamento expirou
-        else if (current_slice_remaining == 0) {
-            enqueue_pcb(rq, *cpu_task);
-            *cpu_task = NULL;
-            current_slice_remaining = 0;
-        }
-    }
+static int rr_tick(void *state, pcb_t *task, uint64_t current_time_ns) {
+    rr_t *rr = state;
+    // Fatiamento expirou
+    return current_time_ns - task->slice_start_ns >= rr->time_slice_ns;
+}
 
-    // Se CPU está livre, pega próximo da fila
-    if (*cpu_task == NULL && rq->head != NULL) {
-        *cpu_task = dequeue_pcb(rq);
-        if (*cpu_task) {
-            current_slice_remaining = TIME_SLICE;
-        }
-    }
+static void rr_stats(void *state, FILE *out) {
+    rr_t *rr = state;
+    fprintf(out, "RR time slice: %u ms\n", rr->time_slice_ms);
 }
+
+const scheduler_ops_t rr_ops = {
+    .name = "RR",
+    .init = rr_init,
+    .destroy = rr_destroy,
+    .enqueue = rr_enqueue,
+    .pick_next = rr_pick_next,
+    .remove = rr_remove,
+    .tick = rr_tick,
+    .stats = rr_stats,
+};
@@ -0,0 +1,190 @@
+#include "sampler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "msg.h"
+
+#define SAMPLER_MASK (SAMPLER_CAPACITY - 1)
+
+// How long the writer sleeps when less than a block is waiting
+#define SAMPLER_WRITER_SLEEP_NS (5 * NS_PER_MS)
+
+int sampler_parse_config(char *spec, uint32_t *interval_ms) {
+    *interval_ms = SAMPLER_DEFAULT_INTERVAL_MS;
+    char *comma = strrchr(spec, ',');
+    if (!comma) return 0;
+    *comma = '\0';
+    char *endptr;
+    long value = strtol(comma + 1, &endptr, 10);
+    if (*endptr != '\0' || value <= 0 || value > INT32_MAX || spec[0] == '\0') {
+        fprintf(stderr, "Invalid sampler configuration: %s,%s (expected file[,interval_ms])\n", spec, comma + 1);
+        return -1;
+    }
+    *interval_ms = (uint32_t) value;
+    return 0;
+}
+
+/**
+ * @brief Write rows [first, first + count) of a column, in (at most) two parts if they wrap around the ring
+ */
+static int write_column(FILE *file, const void *column, size_t size, uint64_t first, uint32_t count) {
+    uint32_t start = (uint32_t) (first & SAMPLER_MASK);
+    uint32_t first_part = count < SAMPLER_CAPACITY - start ? count : SAMPLER_CAPACITY - start;
+    const char *base = column;
+    if (fwrite(base + (size_t) start * size, size, first_part, file) != first_part) return -1;
+    uint32_t second_part = count - first_part;
+    if (second_part > 0 && fwrite(base, size, second_part, file) != second_part) return -1;
+    return 0;
+}
+
+static int write_block(sampler_t *sampler, uint64_t first, uint32_t count) {
+    const sampler_columns_t *ring = &sampler->ring;
+    FILE *file = sampler->file;
+    if (fwrite(&count, sizeof(count), 1, file) != 1 ||
+        write_column(file, ring->time_ms, sizeof(uint64_t), first, count) < 0 ||
+        write_column(file, ring->command, sizeof(uint32_t), first, count) < 0 ||
+        write_column(file, ring->ready, sizeof(uint32_t), first, count) < 0 ||
+        write_column(file, ring->blocked, sizeof(uint32_t), first, count) < 0 ||
+        write_column(file, ring->busy, sizeof(uint64_t), first, count) < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < sampler->ncpus; i++) {
+        if (write_column(file, &ring->dispatches[i * SAMPLER_CAPACITY], sizeof(uint32_t), first, count) < 0) return -1;
+    }
+    for (uint32_t i = 0; i < sampler->ncpus; i++) {
+        if (write_column(file, &ring->busy_us[i * SAMPLER_CAPACITY], sizeof(uint32_t), first, count) < 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Drain the ring to the file in blocks, until stopped and empty
+ */
+static void *sampler_thread(void *arg) {
+    sampler_t *sampler = arg;
+    const struct timespec pause = {.tv_sec = 0, .tv_nsec = SAMPLER_WRITER_SLEEP_NS};
+    for (;;) {
+        int stop = atomic_load(&sampler->stop);
+        uint64_t tail = atomic_load_explicit(&sampler->tail, memory_order_relaxed);
+        uint64_t available = atomic_load_explicit(&sampler->head, memory_order_acquire) - tail;
+        if (available >= SAMPLER_BLOCK || (stop && available > 0)) {
+            uint32_t count = available < SAMPLER_BLOCK ? (uint32_t) available : SAMPLER_BLOCK;
+            if (sampler->status == 0 && write_block(sampler, tail, count) < 0) {
+                // The rest is discarded, so that the tick loop keeps going
+                perror("sampler: fwrite");
+                sampler->status = -1;
+            }
+            atomic_store_explicit(&sampler->tail, tail + count, memory_order_release);
+        } else if (stop) {
+            break;
+        } else {
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+int sampler_start(sampler_t *sampler, const char *path, uint32_t ncpus, uint64_t tick_ns, uint32_t interval_ms) {
+    memset(sampler, 0, sizeof(sampler_t));
+    sampler->ncpus = ncpus;
+    sampler->interval_ns = (uint64_t) interval_ms * NS_PER_MS;
+
+    // The 64-bit columns first, so that every column is aligned
+    size_t size = (size_t) SAMPLER_CAPACITY * (2 * sizeof(uint64_t) + (3 + 2 * ncpus) * sizeof(uint32_t));
+    char *memory = calloc(1, size);
+    if (!memory) {
+        perror("calloc");
+        return -1;
+    }
+    sampler->memory = memory;
+    sampler_columns_t *ring = &sampler->ring;
+    ring->time_ms = (uint64_t *) memory;
+    ring->busy = ring->time_ms + SAMPLER_CAPACITY;
+    ring->command = (uint32_t *) (ring->busy + SAMPLER_CAPACITY);
+    ring->ready = ring->command + SAMPLER_CAPACITY;
+    ring->blocked = ring->ready + SAMPLER_CAPACITY;
+    ring->dispatches = ring->blocked + SAMPLER_CAPACITY;
+    ring->busy_us = ring->dispatches + (size_t) ncpus * SAMPLER_CAPACITY;
+
+    sampler->file = fopen(path, "wb");
+    if (!sampler->file) {
+        perror("fopen");
+        free(memory);
+        return -1;
+    }
+    sampler->header = (sampler_header_t) {
+        .version = SAMPLER_VERSION,
+        .ncpus = ncpus,
+        .interval_ms = interval_ms,
+        .tick_ns = tick_ns,
+    };
+    memcpy(sampler->header.magic, SAMPLER_MAGIC, sizeof(sampler->header.magic));
+    // The counts are filled in when the sampler stops
+    if (fwrite(&sampler->header, sizeof(sampler_header_t), 1, sampler->file) != 1) {
+        perror("fwrite");
+        fclose(sampler->file);
+        free(memory);
+        return -1;
+    }
+    if (pthread_create(&sampler->thread, NULL, sampler_thread, sampler) != 0) {
+        perror("pthread_create");
+        fclose(sampler->file);
+        free(memory);
+        return -1;
+    }
+    return 0;
+}
+
+void sampler_tick(sampler_t *sampler, const scheduler_t *s, const queue_t *command_queue,
+                  const timer_set_t *blocked_timers, const io_t *io, uint64_t current_time_ns) {
+    if (current_time_ns < sampler->next_ns) return;
+    sampler->next_ns = current_time_ns - current_time_ns % sampler->interval_ns + sampler->interval_ns;
+
+    uint64_t head = atomic_load_explicit(&sampler->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&sampler->tail, memory_order_acquire) == SAMPLER_CAPACITY) {
+        // The next sample counts the dispatches and the busy time of this one too
+        sampler->dropped++;
+        return;
+    }
+    sampler_columns_t *ring = &sampler->ring;
+    uint32_t slot = (uint32_t) (head & SAMPLER_MASK);
+    uint32_t command = 0;
+    for (const queue_elem_t *elem = command_queue->head; elem != NULL; elem = elem->next) command++;
+    ring->time_ms[slot] = current_time_ns / NS_PER_MS;
+    ring->command[slot] = command;
+    ring->ready[slot] = s->ready;
+    ring->blocked[slot] = blocked_timers->count + io_num_blocked(io);
+    uint64_t busy = 0;
+    for (uint32_t i = 0; i < sampler->ncpus; i++) {
+        const cswitch_stats_t *stats = &s->cpus[i].cswitch.stats;
+        if (s->cpus[i].task) busy |= 1ull << i;
+        ring->dispatches[i * SAMPLER_CAPACITY + slot] = (uint32_t) (stats->dispatches - sampler->last_dispatches[i]);
+        ring->busy_us[i * SAMPLER_CAPACITY + slot] = (uint32_t) ((stats->busy_ns - sampler->last_busy_ns[i]) / NS_PER_US);
+        sampler->last_dispatches[i] = stats->dispatches;
+        sampler->last_busy_ns[i] = stats->busy_ns;
+    }
+    ring->busy[slot] = busy;
+    atomic_store_explicit(&sampler->head, head + 1, memory_order_release);
+}
+
+int sampler_stop(sampler_t *sampler) {
+    atomic_store(&sampler->stop, 1);
+    pthread_join(sampler->thread, NULL);
+    sampler->header.count = atomic_load(&sampler->tail);
+    sampler->header.dropped = sampler->dropped;
+    if (sampler->status == 0 &&
+        (fseek(sampler->file, 0, SEEK_SET) != 0 ||
+         fwrite(&sampler->header, sizeof(sampler_header_t), 1, sampler->file) != 1)) {
+        perror("sampler: header");
+        sampler->status = -1;
+    }
+    if (fclose(sampler->file) != 0 && sampler->status == 0) {
+        perror("sampler: fclose");
+        sampler->status = -1;
+    }
+    free(sampler->memory);
+    sampler->memory = NULL;
+    return sampler->status;
+}
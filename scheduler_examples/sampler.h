@@ -0,0 +1,127 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "io.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "timerset.h"
+
+/*
+ * Time-series sampler.
+ *
+ * End-of-run averages hide the phases of a run (e.g. I/O bound tasks blocking
+ * while CPU bound ones fill the ready queue). Every interval of simulated time
+ * the tick loop takes a sample of the queue lengths and of every CPU into a ring
+ * that is allocated once: a store per column, no system call and no lock. A
+ * writer thread drains the ring to a file in blocks, so the tick loop never waits
+ * for the disk. If the writer falls a whole ring behind, new samples are dropped
+ * and counted (the time column shows the gap).
+ *
+ * The ring and the file are columnar: a block holds a column after the other, so
+ * a reader that wants one series reads it contiguously, and the narrow columns
+ * (32-bit counts) stay small. The file is a sampler_header_t followed by blocks;
+ * a block is a uint32_t row count followed by the columns, in this order:
+ *   time_ms (uint64_t)      Simulated time of the sample
+ *   command (uint32_t)      Tasks waiting for a request from their application
+ *   ready (uint32_t)        Tasks in the ready queue(s)
+ *   blocked (uint32_t)      Tasks blocked on a timer or a device
+ *   busy (uint64_t)         Bit i set if CPU i was running a task
+ *   dispatches (uint32_t)   One column per CPU: tasks put on the CPU since the previous sample
+ *   busy_us (uint32_t)      One column per CPU: CPU time used by tasks since the previous sample
+ * series2csv converts a file to CSV.
+ */
+
+#define SAMPLER_MAGIC "OSTS"
+#define SAMPLER_VERSION 1
+#define SAMPLER_DEFAULT_INTERVAL_MS 10
+#define SAMPLER_CAPACITY 4096       // Samples in the ring (a power of 2)
+#define SAMPLER_BLOCK 512           // Samples per block in the file (the last block may be shorter)
+
+// Define the header of a sample file
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t ncpus;
+    uint32_t interval_ms;
+    uint64_t tick_ns;
+    uint64_t count;             // Number of samples in the file
+    uint64_t dropped;           // Number of samples dropped because the ring was full
+} sampler_header_t;
+
+// Define the columns of the ring, one array of SAMPLER_CAPACITY per column
+typedef struct {
+    uint64_t *time_ms;
+    uint32_t *command;
+    uint32_t *ready;
+    uint32_t *blocked;
+    uint64_t *busy;
+    uint32_t *dispatches;       // ncpus columns, CPU i at [i * SAMPLER_CAPACITY]
+    uint32_t *busy_us;          // ncpus columns, CPU i at [i * SAMPLER_CAPACITY]
+} sampler_columns_t;
+
+// Define the sampler
+typedef struct {
+    sampler_columns_t ring;
+    void *memory;               // All the columns, in one allocation
+    uint32_t ncpus;
+    uint64_t interval_ns;
+    uint64_t next_ns;           // Time of the next sample
+    uint64_t last_dispatches[MAX_CPUS];
+    uint64_t last_busy_ns[MAX_CPUS];
+    _Atomic uint64_t head;      // Samples taken (written by the tick loop)
+    _Atomic uint64_t tail;      // Samples written (written by the writer thread)
+    uint64_t dropped;
+    FILE *file;
+    sampler_header_t header;
+    pthread_t thread;
+    _Atomic int stop;
+    int status;                 // -1 if the writer failed
+} sampler_t;
+
+/**
+ * @brief Parse a configuration like "series.bin" or "series.bin,100"
+ *
+ * @param spec The configuration string, modified in place (the path is cut at the comma)
+ * @param interval_ms Where to store the interval (SAMPLER_DEFAULT_INTERVAL_MS if not given)
+ * @return 0 on success, -1 if the interval is invalid
+ */
+int sampler_parse_config(char *spec, uint32_t *interval_ms);
+
+/**
+ * @brief Allocate the ring, create the file and start the writer thread
+ *
+ * @param sampler The sampler to initialize
+ * @param path The file to write
+ * @param ncpus Number of simulated CPUs
+ * @param tick_ns Length of a tick (stored in the header)
+ * @param interval_ms Simulated time between samples
+ * @return 0 on success, -1 on failure
+ */
+int sampler_start(sampler_t *sampler, const char *path, uint32_t ncpus, uint64_t tick_ns, uint32_t interval_ms);
+
+/**
+ * @brief Take a sample if the interval is over, at the end of a tick
+ *
+ * @param sampler The sampler
+ * @param s The scheduler
+ * @param command_queue Tasks waiting for a request
+ * @param blocked_timers Tasks blocked on a timer
+ * @param io The I/O devices
+ * @param current_time_ns The current time in nanoseconds
+ */
+void sampler_tick(sampler_t *sampler, const scheduler_t *s, const queue_t *command_queue,
+                  const timer_set_t *blocked_timers, const io_t *io, uint64_t current_time_ns);
+
+/**
+ * @brief Write the samples left, stop the writer thread and close the file
+ *
+ * @return 0 on success, -1 if the file could not be written
+ */
+int sampler_stop(sampler_t *sampler);
+
+#endif //SAMPLER_H
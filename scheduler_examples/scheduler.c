@@ -0,0 +1,775 @@
+#include "scheduler.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fifo.h"
+
+// Define the per-CPU phases of a tick, run by the host threads between two barriers
+typedef enum {
+    SCHED_PHASE_RUN = 0,        // Account the tick, take off and preempt tasks, pick from the run queue (per-CPU run queues)
+    SCHED_PHASE_REFILL,         // Simulate the caches of the tasks dispatched this tick
+    SCHED_PHASE_STOP            // Terminate the threads
+} sched_phase_en;
+
+// Define the host threads of a scheduler
+typedef struct sched_pool_st {
+    scheduler_t *s;
+    uint32_t nthreads;          // Including the thread calling scheduler_tick
+    pthread_t *threads;         // nthreads - 1 workers
+    pthread_mutex_t lock;       // Protects ready, while the workers are being started
+    pthread_cond_t ready_cond;
+    int ready;                  // The barriers are set up for nthreads
+    pthread_barrier_t start;    // Phase set, the threads can run it
+    pthread_barrier_t done;     // Phase finished on every thread
+    sched_phase_en phase;
+    uint64_t current_time_ns;   // Time of the tick the phase belongs to
+} sched_pool_t;
+
+// Define the block of CPUs of a host thread
+typedef struct {
+    sched_pool_t *pool;
+    uint32_t index;
+} sched_worker_t;
+
+// Available scheduling policies
+static const scheduler_ops_t *const SCHEDULERS[] = {
+    &fifo_ops,
+    &sjf_ops,
+    &rr_ops,
+    &mlfq_ops,
+    NULL
+};
+
+const scheduler_ops_t *scheduler_find(const char *name) {
+    const char *colon = strchr(name, ':');
+    size_t len = colon ? (size_t)(colon - name) : strlen(name);
+    for (int i = 0; SCHEDULERS[i] != NULL; i++) {
+        if (strlen(SCHEDULERS[i]->name) == len && strncmp(name, SCHEDULERS[i]->name, len) == 0) {
+            return SCHEDULERS[i];
+        }
+    }
+    return NULL;
+}
+
+void scheduler_list(FILE *out) {
+    for (int i = 0; SCHEDULERS[i] != NULL; i++) {
+        fprintf(out, " - %s\n", SCHEDULERS[i]->name);
+    }
+}
+
+scheduler_t *scheduler_create(const char *name, uint32_t ncpus, uint64_t tick_ns,
+                              const cswitch_config_t *cswitch_config, sched_burst_done_fn burst_done, void *ctx) {
+    const scheduler_ops_t *ops = scheduler_find(name);
+    if (!ops) {
+        fprintf(stderr, "Scheduler %s not recognized. Available options are:\n", name);
+        scheduler_list(stderr);
+        return NULL;
+    }
+    if (ncpus == 0 || ncpus > MAX_CPUS) {
+        fprintf(stderr, "Invalid number of CPUs: %u (1 to %d)\n", ncpus, MAX_CPUS);
+        return NULL;
+    }
+    scheduler_t *s = calloc(1, sizeof(scheduler_t));
+    if (!s) return NULL;
+
+    const char *colon = strchr(name, ':');
+    s->state = ops->init(colon ? colon + 1 : NULL);
+    if (!s->state) {
+        fprintf(stderr, "Invalid parameters for scheduler %s\n", name);
+        free(s);
+        return NULL;
+    }
+    s->ops = ops;
+    strncpy(s->label, name, sizeof(s->label) - 1);
+    if (colon) {
+        s->params = strdup(colon + 1);
+        if (!s->params) {
+            ops->destroy(s->state);
+            free(s);
+            return NULL;
+        }
+    }
+    s->ncpus = ncpus;
+    s->tick_ns = tick_ns;
+    for (uint32_t i = 0; i < ncpus; i++) {
+        s->cpus[i].task = NULL;
+        s->run_time_ns[i] = UINT64_MAX;
+        cswitch_init(&s->cpus[i].cswitch, cswitch_config);
+    }
+    s->burst_done = burst_done;
+    s->burst_done_ctx = ctx;
+    return s;
+}
+
+int scheduler_set_memory(scheduler_t *s, const vm_config_t *config) {
+    vm_destroy(s->vm);
+    s->vm = vm_create(config);
+    return s->vm ? 0 : -1;
+}
+
+int scheduler_set_caches(scheduler_t *s, const cache_config_t *config) {
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        cache_destroy(s->cpus[i].cache);
+        s->cpus[i].cache = cache_create(config);
+        if (!s->cpus[i].cache) return -1;
+    }
+    return 0;
+}
+
+int scheduler_set_swap(scheduler_t *s, const swap_config_t *config) {
+    if (!s->vm || !s->ops->remove) {
+        fprintf(stderr, "Swapping needs virtual memory and a scheduler that can remove queued tasks\n");
+        return -1;
+    }
+    swap_destroy(s->swap);
+    s->swap = swap_create(config);
+    return s->swap ? 0 : -1;
+}
+
+void scheduler_set_cpu_hook(scheduler_t *s, sched_cpu_fn on_cpu, void *ctx) {
+    s->on_cpu = on_cpu;
+    s->on_cpu_ctx = ctx;
+}
+
+/**
+ * @brief Take the task off a CPU, without telling the host
+ */
+static void cpu_vacate(scheduler_t *s, uint32_t cpu, int voluntary) {
+    cswitch_release(&s->cpus[cpu].cswitch, voluntary);
+    s->cpus[cpu].task = NULL;
+    s->run_elapsed_ns[cpu] = 0;
+    s->run_time_ns[cpu] = UINT64_MAX;
+}
+
+/**
+ * @brief Account the tick that just passed to the running tasks of a block of CPUs
+ *
+ * @param finished Bitmask of the CPUs whose task reached the end of its burst, bit i - first for CPU i
+ */
+static void account_tick(scheduler_t *s, uint32_t first, uint32_t last, uint64_t *finished) {
+    for (uint32_t i = first; i < last; i++) {
+        sched_cpu_t *cpu = &s->cpus[i];
+        if (cpu->task) {
+            s->run_add_ns[i] = cswitch_run_tick(&cpu->cswitch, s->tick_ns);
+        } else {
+            cswitch_idle_tick(&cpu->cswitch, s->tick_ns);
+            s->run_add_ns[i] = 0;
+        }
+    }
+    tickvec_advance(s->run_elapsed_ns + first, s->run_add_ns + first, s->run_time_ns + first, last - first, finished);
+}
+
+/**
+ * @brief Advance the CPUs of a block, each with its own run queue, leaving the rest in their mailboxes
+ *
+ * Only touches these CPUs, their run queues and their tasks.
+ */
+static void run_cpus(scheduler_t *s, uint32_t first, uint32_t last, uint64_t current_time_ns) {
+    uint64_t finished[TICKVEC_MASK_WORDS(MAX_CPUS)];
+    account_tick(s, first, last, finished);
+    for (uint32_t i = first; i < last; i++) {
+        sched_cpu_t *cpu = &s->cpus[i];
+        sched_mailbox_t *box = &cpu->mailbox;
+        pcb_t *task = cpu->task;
+        if (task) {
+            task->ellapsed_time_ns = s->run_elapsed_ns[i];
+            uint32_t bit = i - first;
+            if (task->flags & (PCB_KILLED | PCB_SUSPENDED)) {
+                box->left = task;
+                box->voluntary = 0;
+                cpu_vacate(s, i, 0);
+            } else if (finished[bit / 64] & (1ULL << (bit % 64))) {
+                box->left = task;
+                box->voluntary = 1;
+                cpu_vacate(s, i, 1);
+            } else if (s->ops->tick && s->ops->tick(cpu->state, task, current_time_ns)) {
+                box->left = task;
+                box->voluntary = 0;
+                cpu_vacate(s, i, 0);
+                s->ops->enqueue(cpu->state, task, SCHED_ENQUEUE_PREEMPTED, current_time_ns);
+                cpu->ready++;
+            }
+        }
+        if (!cpu->task && cpu->ready > 0) {
+            box->picked = s->ops->pick_next(cpu->state, current_time_ns);
+            if (box->picked) cpu->ready--;
+        }
+    }
+}
+
+/**
+ * @brief Run a phase on the CPUs of a block
+ */
+static void run_phase(scheduler_t *s, sched_phase_en phase, uint32_t first, uint32_t last, uint64_t current_time_ns) {
+    if (phase == SCHED_PHASE_RUN) {
+        run_cpus(s, first, last, current_time_ns);
+        return;
+    }
+    for (uint32_t i = first; i < last; i++) {
+        sched_cpu_t *cpu = &s->cpus[i];
+        if (phase == SCHED_PHASE_REFILL && cpu->refill_pending) {
+            cswitch_charge_refill(&cpu->cswitch, cache_dispatch(cpu->cache, cpu->task));
+            cpu->refill_pending = 0;
+        }
+    }
+}
+
+static uint32_t block_start(const scheduler_t *s, uint32_t nthreads, uint32_t index) {
+    return index * s->ncpus / nthreads;
+}
+
+static void *worker_main(void *arg) {
+    sched_worker_t *worker = arg;
+    sched_pool_t *pool = worker->pool;
+    scheduler_t *s = pool->s;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->ready) {
+        pthread_cond_wait(&pool->ready_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    uint32_t first = block_start(s, pool->nthreads, worker->index);
+    uint32_t last = block_start(s, pool->nthreads, worker->index + 1);
+    for (;;) {
+        pthread_barrier_wait(&pool->start);
+        if (pool->phase == SCHED_PHASE_STOP) break;
+        run_phase(s, pool->phase, first, last, pool->current_time_ns);
+        pthread_barrier_wait(&pool->done);
+    }
+    free(worker);
+    return NULL;
+}
+
+/**
+ * @brief Run a phase on every CPU, on the host threads if there are any
+ */
+static void run_phase_all(scheduler_t *s, sched_phase_en phase, uint64_t current_time_ns) {
+    sched_pool_t *pool = s->pool;
+    if (!pool) {
+        run_phase(s, phase, 0, s->ncpus, current_time_ns);
+        return;
+    }
+    // The barriers order the memory accesses: the workers see the state left by
+    // this thread, and this thread sees their CPUs once they are all done
+    pool->phase = phase;
+    pool->current_time_ns = current_time_ns;
+    pthread_barrier_wait(&pool->start);
+    run_phase(s, phase, 0, block_start(s, pool->nthreads, 1), current_time_ns);
+    pthread_barrier_wait(&pool->done);
+}
+
+static void stop_threads(scheduler_t *s) {
+    sched_pool_t *pool = s->pool;
+    if (!pool) return;
+    pool->phase = SCHED_PHASE_STOP;
+    pthread_barrier_wait(&pool->start);
+    for (uint32_t i = 0; i < pool->nthreads - 1; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_barrier_destroy(&pool->start);
+    pthread_barrier_destroy(&pool->done);
+    pthread_cond_destroy(&pool->ready_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+    s->pool = NULL;
+}
+
+/**
+ * @brief Give every CPU a run queue of its own, or take them away
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int set_per_cpu(scheduler_t *s, int per_cpu) {
+    if (per_cpu == s->per_cpu) return 0;
+    if (s->ready > 0) {
+        fprintf(stderr, "The run queues cannot change while tasks are queued\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        if (per_cpu) {
+            s->cpus[i].state = s->ops->init(s->params);
+            if (!s->cpus[i].state) {
+                while (i-- > 0) {
+                    s->ops->destroy(s->cpus[i].state);
+                    s->cpus[i].state = NULL;
+                }
+                return -1;
+            }
+        } else if (s->cpus[i].state) {
+            s->ops->destroy(s->cpus[i].state);
+            s->cpus[i].state = NULL;
+        }
+    }
+    s->per_cpu = per_cpu;
+    return 0;
+}
+
+int scheduler_set_threads(scheduler_t *s, uint32_t nthreads) {
+    stop_threads(s);
+    if (set_per_cpu(s, nthreads > 0) < 0) return -1;
+    if (nthreads > s->ncpus) nthreads = s->ncpus;
+    if (nthreads <= 1) return 0;
+
+    sched_pool_t *pool = calloc(1, sizeof(sched_pool_t));
+    if (!pool) return -1;
+    pool->threads = calloc(nthreads - 1, sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return -1;
+    }
+    pool->s = s;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready_cond, NULL);
+    uint32_t started = 0;
+    for (; started < nthreads - 1; started++) {
+        sched_worker_t *worker = malloc(sizeof(sched_worker_t));
+        if (!worker) break;
+        worker->pool = pool;
+        worker->index = started + 1;
+        int err = pthread_create(&pool->threads[started], NULL, worker_main, worker);
+        if (err != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            free(worker);
+            break;
+        }
+    }
+    // The barriers wait for every thread, so they are set up once the threads are known
+    pool->nthreads = started + 1;
+    pthread_barrier_init(&pool->start, NULL, pool->nthreads);
+    pthread_barrier_init(&pool->done, NULL, pool->nthreads);
+    pthread_mutex_lock(&pool->lock);
+    pool->ready = 1;
+    pthread_cond_broadcast(&pool->ready_cond);
+    pthread_mutex_unlock(&pool->lock);
+    s->pool = pool;
+    if (started < nthreads - 1) {
+        stop_threads(s);
+        return -1;
+    }
+    return 0;
+}
+
+void scheduler_destroy(scheduler_t *s) {
+    if (!s) return;
+    stop_threads(s);
+    s->ops->destroy(s->state);
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        if (s->cpus[i].state) {
+            s->ops->destroy(s->cpus[i].state);
+        }
+        cache_destroy(s->cpus[i].cache);
+    }
+    while (dequeue_pcb(&s->paging_queue) != NULL) { }
+    while (dequeue_pcb(&s->suspended) != NULL) { }
+    swap_destroy(s->swap);
+    vm_destroy(s->vm);
+    free(s->params);
+    free(s);
+}
+
+/**
+ * @brief Get the instance of the policy whose run queue holds the task, or last held it
+ */
+static void *state_of(const scheduler_t *s, const pcb_t *task) {
+    return s->per_cpu ? s->cpus[task->cold->run_queue].state : s->state;
+}
+
+/**
+ * @brief Get the CPU with the fewest tasks, running and queued (the first one on a tie)
+ */
+static uint32_t least_loaded(const scheduler_t *s) {
+    uint32_t best = 0;
+    uint32_t best_load = UINT32_MAX;
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        uint32_t load = s->cpus[i].ready + (s->cpus[i].task != NULL);
+        if (load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Put a task in the ready queue(s)
+ *
+ * With per-CPU run queues, in the one of the CPU it last ran on (its pages may
+ * still be in its caches), or of the least loaded CPU if it never ran.
+ */
+static void queue_task(scheduler_t *s, pcb_t *task, sched_enqueue_reason_en reason, uint64_t current_time_ns) {
+    if (s->per_cpu) {
+        task->cold->run_queue = task->last_cpu >= 0 ? (uint32_t) task->last_cpu : least_loaded(s);
+        s->cpus[task->cold->run_queue].ready++;
+    }
+    s->ops->enqueue(state_of(s, task), task, reason, current_time_ns);
+    s->ready++;
+}
+
+void scheduler_enqueue(scheduler_t *s, pcb_t *task, uint64_t current_time_ns) {
+    if (s->swap) {
+        swap_track(s->swap, task);
+    }
+    queue_task(s, task, SCHED_ENQUEUE_NEW, current_time_ns);
+}
+
+int scheduler_remove(scheduler_t *s, pcb_t *task) {
+    if (!s->ops->remove(state_of(s, task), task)) return 0;
+    if (s->per_cpu) {
+        s->cpus[task->cold->run_queue].ready--;
+    }
+    s->ready--;
+    return 1;
+}
+
+void scheduler_exit(scheduler_t *s, pcb_t *task) {
+    if (s->ops->on_exit) {
+        s->ops->on_exit(state_of(s, task), task);
+    }
+    if (s->vm) {
+        vm_release(s->vm, task);
+    }
+}
+
+/**
+ * @brief Hand a task whose burst is over (finished or killed) to the host
+ */
+static void burst_over(scheduler_t *s, pcb_t *task, uint64_t current_time_ns) {
+    if (s->ops->on_block) {
+        s->ops->on_block(state_of(s, task), task, current_time_ns);
+    }
+    if (s->swap) {
+        swap_untrack(s->swap, task);
+    }
+    s->burst_done(s->burst_done_ctx, task, current_time_ns);
+}
+
+/**
+ * @brief Put a suspended task aside, out of the ready queue(s), until it is resumed
+ */
+static void park(scheduler_t *s, pcb_t *task) {
+    task->flags |= PCB_PARKED;
+    // Not competing for memory either, swapping would bring it back to the ready queue(s)
+    if (s->swap) {
+        swap_untrack(s->swap, task);
+    }
+    enqueue_pcb(&s->suspended, task);
+}
+
+static void unpark(scheduler_t *s, pcb_t *task) {
+    remove_pcb(&s->suspended, task);
+    task->flags &= (uint16_t) ~PCB_PARKED;
+    if (s->swap) {
+        swap_track(s->swap, task);
+    }
+}
+
+void scheduler_kill(scheduler_t *s, pcb_t *task, uint64_t current_time_ns) {
+    task->flags |= PCB_KILLED;
+    if (task->flags & PCB_PARKED) {
+        unpark(s, task);
+        burst_over(s, task, current_time_ns);
+    }
+}
+
+void scheduler_suspend(scheduler_t *s, pcb_t *task) {
+    (void) s;
+    task->flags |= PCB_SUSPENDED;
+}
+
+void scheduler_resume(scheduler_t *s, pcb_t *task, uint64_t current_time_ns) {
+    task->flags &= (uint16_t) ~PCB_SUSPENDED;
+    if (task->flags & PCB_PARKED) {
+        unpark(s, task);
+        queue_task(s, task, SCHED_ENQUEUE_WAKEUP, current_time_ns);
+    }
+}
+
+int scheduler_renice(scheduler_t *s, pcb_t *task, uint32_t level) {
+    if (!s->ops->renice) return -1;
+    task->cold->nice = level;
+    s->ops->renice(state_of(s, task), task);
+    return 0;
+}
+
+uint32_t scheduler_priority(const scheduler_t *s, const pcb_t *task) {
+    return s->ops->renice ? task->queue_level : 0;
+}
+
+int scheduler_inherit(scheduler_t *s, pcb_t *task, uint32_t level) {
+    if (!s->ops->renice) return -1;
+    task->cold->inherited = level;
+    if (s->ops->inherit) {
+        s->ops->inherit(state_of(s, task), task);
+    } else {
+        s->ops->renice(state_of(s, task), task);
+    }
+    return 0;
+}
+
+/**
+ * @brief Take the task off a CPU
+ */
+static void cpu_release(scheduler_t *s, uint32_t cpu, int voluntary) {
+    if (s->on_cpu) {
+        s->on_cpu(s->on_cpu_ctx, s->cpus[cpu].task, cpu, voluntary ? SCHED_CPU_FINISH : SCHED_CPU_PREEMPT);
+    }
+    cpu_vacate(s, cpu, voluntary);
+}
+
+/**
+ * @brief Return the tasks whose page faults have been serviced to the scheduler
+ */
+static void check_paging_queue(scheduler_t *s, uint64_t current_time_ns) {
+    queue_elem_t *elem = s->paging_queue.head;
+    while (elem != NULL) {
+        pcb_t *task = elem->pcb;
+        if (task->wait_until_ns <= current_time_ns) {
+            remove_queue_elem(&s->paging_queue, elem);
+            queue_elem_t *tmp = elem;
+            elem = elem->next;
+            free(tmp);
+            task->paged_in = 1;
+            queue_task(s, task, SCHED_ENQUEUE_WAKEUP, current_time_ns);
+        } else {
+            elem = elem->next;
+        }
+    }
+}
+
+/**
+ * @brief Take a task from a run queue
+ */
+static pcb_t *take_ready(scheduler_t *s, uint32_t cpu, uint64_t current_time_ns) {
+    pcb_t *task = s->ops->pick_next(s->cpus[cpu].state, current_time_ns);
+    if (task) {
+        s->cpus[cpu].ready--;
+        s->ready--;
+    }
+    return task;
+}
+
+/**
+ * @brief Get the next task from the ready queue(s) for a CPU
+ *
+ * With per-CPU run queues, the task picked on the thread of the CPU, then the next one of its
+ * run queue, and else one of the fullest run queue (the first one on a tie).
+ */
+static pcb_t *next_ready(scheduler_t *s, uint32_t cpu, uint64_t current_time_ns) {
+    if (!s->per_cpu) {
+        pcb_t *task = s->ops->pick_next(s->state, current_time_ns);
+        if (task) s->ready--;
+        return task;
+    }
+    sched_mailbox_t *box = &s->cpus[cpu].mailbox;
+    if (box->picked) {
+        pcb_t *task = box->picked;
+        box->picked = NULL;
+        return task;
+    }
+    if (s->cpus[cpu].ready > 0) {
+        return take_ready(s, cpu, current_time_ns);
+    }
+    uint32_t fullest = cpu;
+    for (uint32_t i = 0; i < s->ncpus && s->ready > 0; i++) {
+        if (s->cpus[i].ready > s->cpus[fullest].ready) fullest = i;
+    }
+    return s->cpus[fullest].ready > 0 ? take_ready(s, fullest, current_time_ns) : NULL;
+}
+
+/**
+ * @brief Get the next task that can run, sending tasks that page fault to the paging queue
+ */
+static pcb_t *pick_runnable(scheduler_t *s, uint32_t cpu, uint64_t current_time_ns) {
+    pcb_t *task;
+    while ((task = next_ready(s, cpu, current_time_ns)) != NULL) {
+        if (task->flags & PCB_KILLED) {
+            burst_over(s, task, current_time_ns);
+            continue;
+        }
+        if (task->flags & PCB_SUSPENDED) {
+            park(s, task);
+            continue;
+        }
+        // The pages loaded by the fault are used right away, even if other faults
+        // evicted some of them meanwhile, so thrashing tasks still make progress
+        uint64_t stall_ns = (s->vm && !task->paged_in) ? vm_access(s->vm, task, current_time_ns) : 0;
+        task->paged_in = 0;
+        if (stall_ns == 0) {
+            return task;
+        }
+        // The task blocks until its pages are loaded, and then competes for the CPU again
+        task->wait_until_ns = current_time_ns + stall_ns;
+        enqueue_pcb(&s->paging_queue, task);
+        trace_event(s->trace, current_time_ns, TRACE_PAGE_FAULT, (uint8_t) cpu, task->pid, stall_ns);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Put a task on an idle CPU
+ *
+ * @return Non-zero if its cache accesses have to be simulated
+ */
+static int dispatch(scheduler_t *s, uint32_t i, pcb_t *task, uint64_t current_time_ns) {
+    sched_cpu_t *cpu = &s->cpus[i];
+    task->slice_start_ns = current_time_ns;
+    cswitch_dispatch(&cpu->cswitch, task, (int32_t) i);
+    if (s->per_cpu) {
+        task->cold->run_queue = i;
+    }
+    // The caches of a CPU only see its own tasks, they are simulated after the dispatches
+    cpu->refill_pending = cpu->cache != NULL;
+    cpu->task = task;
+    s->run_elapsed_ns[i] = task->ellapsed_time_ns;
+    s->run_time_ns[i] = task->time_ns;
+    s->dispatches++;
+    if (s->on_cpu) {
+        s->on_cpu(s->on_cpu_ctx, task, i, SCHED_CPU_DISPATCH);
+    }
+    trace_event(s->trace, current_time_ns, TRACE_DISPATCH, (uint8_t) i, task->pid, task->time_ns - task->ellapsed_time_ns);
+    return cpu->refill_pending;
+}
+
+/**
+ * @brief Advance the CPUs by one tick, every CPU with its own run queue
+ *
+ * The threads advance their CPUs, then this thread hands on what they left in
+ * the mailboxes and dispatches, in CPU order.
+ */
+static void tick_per_cpu(scheduler_t *s, uint64_t current_time_ns) {
+    run_phase_all(s, SCHED_PHASE_RUN, current_time_ns);
+    s->ready = 0;
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        s->ready += s->cpus[i].ready;
+    }
+
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        sched_mailbox_t *box = &s->cpus[i].mailbox;
+        pcb_t *task = box->left;
+        if (!task) continue;
+        box->left = NULL;
+        if (s->on_cpu) {
+            s->on_cpu(s->on_cpu_ctx, task, i, box->voluntary ? SCHED_CPU_FINISH : SCHED_CPU_PREEMPT);
+        }
+        trace_event(s->trace, current_time_ns, box->voluntary ? TRACE_BURST_END : TRACE_PREEMPT, (uint8_t) i,
+                    task->pid, task->ellapsed_time_ns);
+        // A preempted task is back in the run queue of the CPU already
+        if (box->voluntary || (task->flags & PCB_KILLED)) {
+            burst_over(s, task, current_time_ns);
+        } else if (task->flags & PCB_SUSPENDED) {
+            park(s, task);
+        }
+    }
+
+    if (s->swap) {
+        swap_balance(s, current_time_ns);
+    }
+
+    int refills = 0;
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        if (s->cpus[i].task) continue;
+        pcb_t *task = pick_runnable(s, i, current_time_ns);
+        if (task) {
+            refills |= dispatch(s, i, task, current_time_ns);
+        }
+    }
+    if (refills) {
+        run_phase_all(s, SCHED_PHASE_REFILL, current_time_ns);
+    }
+}
+
+void scheduler_tick(scheduler_t *s, uint64_t current_time_ns) {
+    if (s->paging_queue.head) {
+        check_paging_queue(s, current_time_ns);
+    }
+    if (s->per_cpu) {
+        tick_per_cpu(s, current_time_ns);
+        return;
+    }
+
+    // Account the tick that just passed to the running tasks (a few additions per CPU, cheaper than a barrier)
+    account_tick(s, 0, s->ncpus, s->run_finished);
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        sched_cpu_t *cpu = &s->cpus[i];
+        pcb_t *task = cpu->task;
+        if (!task) continue;
+        task->ellapsed_time_ns = s->run_elapsed_ns[i];
+        if (task->flags & (PCB_KILLED | PCB_SUSPENDED)) {
+            // Taken off the CPU by a control request
+            cpu_release(s, i, 0);
+            trace_event(s->trace, current_time_ns, TRACE_PREEMPT, (uint8_t) i, task->pid, task->ellapsed_time_ns);
+            if (task->flags & PCB_KILLED) {
+                burst_over(s, task, current_time_ns);
+            } else {
+                park(s, task);
+            }
+        } else if (s->run_finished[i / 64] & (1ULL << (i % 64))) {
+            // Burst finished, the task leaves the CPU on its own
+            cpu_release(s, i, 1);
+            trace_event(s->trace, current_time_ns, TRACE_BURST_END, (uint8_t) i, task->pid, task->ellapsed_time_ns);
+            burst_over(s, task, current_time_ns);
+        } else if (s->ops->tick && s->ops->tick(s->state, task, current_time_ns)) {
+            // Preempted by the policy
+            cpu_release(s, i, 0);
+            trace_event(s->trace, current_time_ns, TRACE_PREEMPT, (uint8_t) i, task->pid, task->ellapsed_time_ns);
+            s->ops->enqueue(s->state, task, SCHED_ENQUEUE_PREEMPTED, current_time_ns);
+            s->ready++;
+        }
+    }
+
+    if (s->swap) {
+        swap_balance(s, current_time_ns);
+    }
+
+    // Dispatch new tasks on the idle CPUs
+    int refills = 0;
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        if (s->cpus[i].task) continue;
+        pcb_t *task = pick_runnable(s, i, current_time_ns);
+        if (!task) break;
+        refills |= dispatch(s, i, task, current_time_ns);
+    }
+    if (refills) {
+        run_phase_all(s, SCHED_PHASE_REFILL, current_time_ns);
+    }
+}
+
+void scheduler_print_stats(scheduler_t *s, FILE *out) {
+    cswitch_stats_t total = {0};
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        cswitch_stats_add(&total, &s->cpus[i].cswitch.stats);
+    }
+    fprintf(out, "%s dispatches: %llu on %u CPU(s)\n", s->label, (unsigned long long) s->dispatches, s->ncpus);
+    cswitch_print_stats(out, s->label, &total);
+    if (s->cpus[0].cache) {
+        cache_stats_t cache_total = {0};
+        for (uint32_t i = 0; i < s->ncpus; i++) {
+            cache_stats_add(&cache_total, &s->cpus[i].cache->stats);
+        }
+        cache_print_stats(out, s->label, &s->cpus[0].cache->config, &cache_total);
+    }
+    if (s->vm) {
+        vm_print_stats(s->vm, out, s->label);
+    }
+    if (s->swap) {
+        swap_print_stats(s->swap, out, s->label);
+    }
+    if (s->ops->stats) {
+        // The counters of the per-CPU run queues are added up in a new instance
+        void *state = s->state;
+        if (s->per_cpu && s->ops->stats_add) {
+            state = s->ops->init(s->params);
+            for (uint32_t i = 0; state && i < s->ncpus; i++) {
+                s->ops->stats_add(state, s->cpus[i].state);
+            }
+        }
+        if (state) {
+            s->ops->stats(state, out);
+        }
+        if (state && state != s->state) {
+            s->ops->destroy(state);
+        }
+    }
+}
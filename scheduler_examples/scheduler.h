@@ -0,0 +1,367 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache.h"
+#include "cswitch.h"
+#include "queue.h"
+#include "swap.h"
+#include "tickvec.h"
+#include "trace.h"
+#include "vm.h"
+
+#define MAX_CPUS 64
+
+// Define why a task is handed to the scheduler
+typedef enum {
+    SCHED_ENQUEUE_NEW = 0,      // Task requested the CPU (RUN)
+    SCHED_ENQUEUE_PREEMPTED,    // Task was taken off the CPU before finishing its burst
+    SCHED_ENQUEUE_WAKEUP,       // Task finished waiting in the middle of its burst (page fault)
+} sched_enqueue_reason_en;
+
+/*
+ * Define the operations a scheduling policy implements.
+ *
+ * All the state of a policy lives in the instance returned by init, so several
+ * instances (of the same or of different policies) can run in the same process.
+ * The simulator core (scheduler.c) owns the CPUs: it accounts the running time,
+ * detects finished bursts and asks the policy what to do next. With per-CPU run
+ * queues (scheduler_set_threads) every CPU has an instance of its own, and a
+ * task may move from one to another between two calls, so what a policy keeps
+ * about a task is in its pcb.
+ */
+typedef struct scheduler_ops_st {
+    const char *name;
+
+    // Create an instance. params is the text after ':' in the scheduler name (may be NULL).
+    // Returns NULL if the parameters are invalid.
+    void *(*init)(const char *params);
+    // Free an instance. Tasks still queued are not freed.
+    void (*destroy)(void *state);
+    // Add a task to the ready queue(s)
+    void (*enqueue)(void *state, pcb_t *task, sched_enqueue_reason_en reason, uint64_t current_time_ns);
+    // Remove and return the next task to run on an idle CPU, or NULL if there is none
+    pcb_t *(*pick_next)(void *state, uint64_t current_time_ns);
+    // Remove a queued task that has to leave the ready queue(s) (e.g. swapped out).
+    // Returns non-zero if the task was queued. Optional, needed for swapping.
+    int (*remove)(void *state, pcb_t *task);
+    // Called every tick for every running task. Returns non-zero to preempt the task. Optional.
+    int (*tick)(void *state, pcb_t *task, uint64_t current_time_ns);
+    // Called when the burst of a task is over (finished, or killed) and the scheduler hands it back to the host,
+    // e.g. to decide the level its next request starts at. Optional.
+    void (*on_block)(void *state, pcb_t *task, uint64_t current_time_ns);
+    // Called when a task leaves the simulation (it is not queued), to drop what the policy keeps about it
+    // (its pcb handle is reused). Optional.
+    void (*on_exit)(void *state, pcb_t *task);
+    // Called when the nice level of a task changed, whether it is queued, running or elsewhere.
+    // Optional, a policy without it has no priorities.
+    void (*renice)(void *state, pcb_t *task);
+    // Called when the level a task inherited from the waiters of its mutexes changed (UINT32_MAX once it
+    // inherits nothing), whether it is queued, running or elsewhere. Optional, renice is called instead.
+    void (*inherit)(void *state, pcb_t *task);
+    // Print policy specific statistics. Optional.
+    void (*stats)(void *state, FILE *out);
+    // Add the statistics of another instance to those of this one, to print the total of the per-CPU
+    // run queues. Optional, needed if stats prints counters.
+    void (*stats_add)(void *state, const void *other);
+} scheduler_ops_t;
+
+/*
+ * Called by the simulator core when a task finished its CPU burst. The host
+ * (ossim or a simulated workload) decides what happens to the task next.
+ */
+typedef void (*sched_burst_done_fn)(void *ctx, pcb_t *task, uint64_t current_time_ns);
+
+// Define what happened to a task on a CPU
+typedef enum {
+    SCHED_CPU_DISPATCH = 0,     // Put on the CPU
+    SCHED_CPU_PREEMPT,          // Taken off the CPU before its burst is over (preempted, suspended or killed)
+    SCHED_CPU_FINISH,           // Left the CPU because its burst is over
+} sched_cpu_event_en;
+
+/*
+ * Called by the simulator core when a task is put on a CPU or taken off it, so
+ * the host can mirror the decisions on real processes (see realproc.h). Called on
+ * the thread calling scheduler_tick, in CPU order.
+ */
+typedef void (*sched_cpu_fn)(void *ctx, pcb_t *task, uint32_t cpu, sched_cpu_event_en event);
+
+// Define what the host thread of a CPU leaves to the thread calling scheduler_tick, which
+// hands it on after the barrier, in CPU order (per-CPU run queues)
+typedef struct {
+    pcb_t *left;                // Task taken off the CPU this tick (NULL if none)
+    int voluntary;              // It left because its burst is over
+    pcb_t *picked;              // Task taken from the run queue of the CPU, to be dispatched (NULL if none)
+} sched_mailbox_t;
+
+// Define a simulated CPU
+typedef struct {
+    pcb_t *task;                // Task running on this CPU (NULL if idle)
+    cswitch_t cswitch;          // Context switch state and counters
+    cache_t *cache;             // TLB and LLC of this CPU (NULL if caches are not simulated)
+    int refill_pending;         // Task dispatched this tick, its cache accesses are not simulated yet
+    void *state;                // Instance of the policy holding the run queue of this CPU (NULL: shared queue)
+    uint32_t ready;             // Tasks in that run queue
+    sched_mailbox_t mailbox;
+} sched_cpu_t;
+
+// Define a scheduler instance: a policy, its state and the CPUs it manages
+typedef struct scheduler_st {
+    const scheduler_ops_t *ops;
+    void *state;
+    char label[64];             // Name the instance was created with (e.g. "RR:250")
+    char *params;               // Text after ':' in that name (NULL if none), to create the per-CPU run queues
+    uint32_t ncpus;
+    uint64_t tick_ns;           // Length of a tick
+    sched_cpu_t cpus[MAX_CPUS];
+    // Times of the tasks on the CPUs, one array per field (index = CPU) for tickvec_advance.
+    // They are written back to the PCBs at the end of every tick.
+    uint64_t run_elapsed_ns[MAX_CPUS];      // Time the task on the CPU has run
+    uint64_t run_time_ns[MAX_CPUS];         // Time it requested (UINT64_MAX if the CPU is idle)
+    uint64_t run_add_ns[MAX_CPUS];          // Time it ran in the last tick
+    uint64_t run_finished[TICKVEC_MASK_WORDS(MAX_CPUS)];
+    sched_burst_done_fn burst_done;
+    void *burst_done_ctx;
+    sched_cpu_fn on_cpu;        // NULL if nothing mirrors the CPUs
+    void *on_cpu_ctx;
+    uint64_t dispatches;        // Number of times a task was put on a CPU
+    uint32_t ready;             // Tasks in the ready queue(s) of the policy, of every CPU
+    trace_t *trace;             // Event tracer (NULL if not tracing)
+    vm_t *vm;                   // Virtual memory (NULL if memory is not simulated)
+    queue_t paging_queue;       // Tasks blocked servicing page faults or swap ins
+    queue_t suspended;          // Runnable tasks that are suspended, out of the ready queue(s)
+    swap_t *swap;               // Medium-term scheduler (NULL if processes are not swapped)
+    int per_cpu;                // Every CPU has its own run queue (see scheduler_set_threads)
+    struct sched_pool_st *pool; // Host threads advancing the CPUs (NULL: all done by the caller)
+} scheduler_t;
+
+/**
+ * @brief Find a scheduling policy by name
+ *
+ * The name may be followed by ':' and policy parameters (e.g. "RR:250"), these are ignored here.
+ *
+ * @param name The scheduler name
+ * @return The policy operations, or NULL if there is no policy with that name
+ */
+const scheduler_ops_t *scheduler_find(const char *name);
+
+/**
+ * @brief Print the names of the available scheduling policies
+ *
+ * @param out The stream to print to
+ */
+void scheduler_list(FILE *out);
+
+/**
+ * @brief Create a scheduler instance
+ *
+ * @param name The scheduler name, optionally followed by ':' and parameters (e.g. "MLFQ:500,1000,2000")
+ * @param ncpus The number of simulated CPUs (1 to MAX_CPUS)
+ * @param tick_ns The length of a tick (the time scheduler_tick advances)
+ * @param cswitch_config The context switch cost model
+ * @param burst_done Callback for tasks that finished their CPU burst
+ * @param ctx Context passed to the callback
+ * @return The new instance, or NULL on failure
+ */
+scheduler_t *scheduler_create(const char *name, uint32_t ncpus, uint64_t tick_ns,
+                              const cswitch_config_t *cswitch_config, sched_burst_done_fn burst_done, void *ctx);
+
+/**
+ * @brief Simulate virtual memory for the tasks of this scheduler
+ *
+ * Tasks reference the pages of their burst when they are put on a CPU, and block
+ * while their page faults are serviced.
+ *
+ * @param s The scheduler instance
+ * @param config The virtual memory configuration
+ * @return 0 on success, -1 on failure
+ */
+int scheduler_set_memory(scheduler_t *s, const vm_config_t *config);
+
+/**
+ * @brief Simulate a TLB and an LLC on every CPU of this scheduler
+ *
+ * The misses of the pages referenced by a dispatched task extend its burst.
+ *
+ * @param s The scheduler instance
+ * @param config The cache configuration
+ * @return 0 on success, -1 on failure
+ */
+int scheduler_set_caches(scheduler_t *s, const cache_config_t *config);
+
+/**
+ * @brief Swap whole processes out when their pages do not fit in memory
+ *
+ * Needs virtual memory (scheduler_set_memory) and a policy that can remove queued tasks.
+ *
+ * @param s The scheduler instance
+ * @param config The swapping configuration
+ * @return 0 on success, -1 on failure
+ */
+int scheduler_set_swap(scheduler_t *s, const swap_config_t *config);
+
+/**
+ * @brief Call a hook whenever a task is put on a CPU or taken off it
+ *
+ * @param s The scheduler instance
+ * @param on_cpu The hook (NULL to remove it)
+ * @param ctx Context passed to the hook
+ */
+void scheduler_set_cpu_hook(scheduler_t *s, sched_cpu_fn on_cpu, void *ctx);
+
+/**
+ * @brief Give every CPU its own run queue, and advance the CPUs on several host threads
+ *
+ * Every CPU gets an instance of the policy of its own. The CPUs are split in
+ * contiguous blocks, one per host thread (the thread calling scheduler_tick takes
+ * the first block), and every tick each thread advances its CPUs: it accounts the
+ * tick, takes off the tasks whose burst is over, preempts as the policy of the CPU
+ * decides, putting the task back in that run queue, and picks the next task of
+ * the run queue of an idle CPU. What reaches beyond a CPU is left in its mailbox:
+ * after the barrier the calling thread hands the tasks that left over to the host
+ * and dispatches the picked ones, in CPU order, checking their pages, and an idle
+ * CPU with an empty run queue takes a task from the fullest one (a migration).
+ * New tasks and wakeups go to the run queue of the CPU the task last ran on, or
+ * of the least loaded CPU. The TLB and LLC accesses of the dispatched tasks are
+ * simulated by the threads of their CPUs. No thread touches the CPUs of another,
+ * so the results are the same for any number of threads, bit for bit.
+ *
+ * Call it before any task is queued.
+ *
+ * @param s The scheduler instance
+ * @param nthreads Number of host threads, capped to the number of CPUs (0 for a single ready
+ *                 queue shared by all the CPUs, the default, advanced by the calling thread)
+ * @return 0 on success, -1 on failure
+ */
+int scheduler_set_threads(scheduler_t *s, uint32_t nthreads);
+
+/**
+ * @brief Destroy a scheduler instance
+ *
+ * Tasks still owned by the instance are not freed.
+ *
+ * @param s The instance to destroy
+ */
+void scheduler_destroy(scheduler_t *s);
+
+/**
+ * @brief Hand a task that requested the CPU to the scheduler
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ * @param current_time_ns The current time in nanoseconds
+ */
+void scheduler_enqueue(scheduler_t *s, pcb_t *task, uint64_t current_time_ns);
+
+/**
+ * @brief Take a task out of the ready queue(s), e.g. to swap it out
+ *
+ * @param s The scheduler instance (its policy must be able to remove queued tasks)
+ * @param task The task
+ * @return Non-zero if the task was queued
+ */
+int scheduler_remove(scheduler_t *s, pcb_t *task);
+
+/**
+ * @brief Notify the scheduler that a task left the simulation
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ */
+void scheduler_exit(scheduler_t *s, pcb_t *task);
+
+/**
+ * @brief Kill a task
+ *
+ * The task is flagged PCB_KILLED. A task the scheduler holds (running, ready,
+ * waiting for pages or suspended) is handed to the burst_done callback at the next
+ * tick, or now if it is suspended, without running any further; the host then
+ * sees the flag and removes it. A task the scheduler does not hold is only flagged,
+ * the host removes it at its next transition.
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ * @param current_time_ns The current time in nanoseconds
+ */
+void scheduler_kill(scheduler_t *s, pcb_t *task, uint64_t current_time_ns);
+
+/**
+ * @brief Suspend a task
+ *
+ * The task is not given a CPU until it is resumed: a running task is taken off its
+ * CPU at the next tick, and a runnable task is put aside when the policy picks it.
+ * A blocked task finishes its wait, and is put aside when it requests the CPU again.
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ */
+void scheduler_suspend(scheduler_t *s, pcb_t *task);
+
+/**
+ * @brief Resume a suspended task, a task that was put aside goes back to the ready queue(s)
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ * @param current_time_ns The current time in nanoseconds
+ */
+void scheduler_resume(scheduler_t *s, pcb_t *task, uint64_t current_time_ns);
+
+/**
+ * @brief Change the priority level of a task
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ * @param level The new level (0 is the highest)
+ * @return 0 on success, -1 if the policy has no priorities
+ */
+int scheduler_renice(scheduler_t *s, pcb_t *task, uint32_t level);
+
+/**
+ * @brief Get the priority level a task runs at (0 is the highest)
+ *
+ * With MLFQ this is its queue level: the higher of its own level (the level of its
+ * nice, lowered while the task uses up its time slices) and the level it inherited.
+ * The policies without priorities run every task at level 0.
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ * @return The level
+ */
+uint32_t scheduler_priority(const scheduler_t *s, const pcb_t *task);
+
+/**
+ * @brief Set the priority level a task inherited from the waiters of its mutexes (see locks.h)
+ *
+ * The task runs at the higher of its own level and the inherited one, and gets
+ * its own level back (demotions included) once it inherits nothing.
+ *
+ * @param s The scheduler instance
+ * @param task The task
+ * @param level The inherited level (UINT32_MAX for none)
+ * @return 0 on success, -1 if the policy has no priorities
+ */
+int scheduler_inherit(scheduler_t *s, pcb_t *task, uint32_t level);
+
+/**
+ * @brief Advance the CPUs by one tick
+ *
+ * Accounts the tick to the running tasks, reports finished bursts through the
+ * burst_done callback, preempts tasks as the policy decides, and dispatches
+ * new tasks on idle CPUs.
+ *
+ * @param s The scheduler instance
+ * @param current_time_ns The current time in nanoseconds
+ */
+void scheduler_tick(scheduler_t *s, uint64_t current_time_ns);
+
+/**
+ * @brief Print the statistics of a scheduler instance
+ *
+ * @param s The scheduler instance
+ * @param out The stream to print to
+ */
+void scheduler_print_stats(scheduler_t *s, FILE *out);
+
+#endif //SCHEDULER_H
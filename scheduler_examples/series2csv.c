@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sampler.h"
+
+/*
+ * Run like: ./series2csv <series.bin> [series.csv]
+ *
+ * Converts the samples saved by ossim (-Q) to CSV, a row per sample: the time,
+ * the queue lengths, the number of busy CPUs, and per CPU whether it was busy,
+ * its dispatches since the previous sample, and its utilization (%) since the
+ * previous sample.
+ */
+
+// Define the columns of a block, read from the file
+typedef struct {
+    uint64_t time_ms[SAMPLER_BLOCK];
+    uint32_t command[SAMPLER_BLOCK];
+    uint32_t ready[SAMPLER_BLOCK];
+    uint32_t blocked[SAMPLER_BLOCK];
+    uint64_t busy[SAMPLER_BLOCK];
+    uint32_t dispatches[MAX_CPUS][SAMPLER_BLOCK];
+    uint32_t busy_us[MAX_CPUS][SAMPLER_BLOCK];
+} block_t;
+
+static int read_block(FILE *in, block_t *block, uint32_t ncpus, uint32_t count) {
+    if (fread(block->time_ms, sizeof(uint64_t), count, in) != count ||
+        fread(block->command, sizeof(uint32_t), count, in) != count ||
+        fread(block->ready, sizeof(uint32_t), count, in) != count ||
+        fread(block->blocked, sizeof(uint32_t), count, in) != count ||
+        fread(block->busy, sizeof(uint64_t), count, in) != count) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < ncpus; i++) {
+        if (fread(block->dispatches[i], sizeof(uint32_t), count, in) != count) return -1;
+    }
+    for (uint32_t i = 0; i < ncpus; i++) {
+        if (fread(block->busy_us[i], sizeof(uint32_t), count, in) != count) return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <series.bin> [series.csv]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    sampler_header_t header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, SAMPLER_MAGIC, 4) != 0 ||
+        header.version != SAMPLER_VERSION || header.ncpus == 0 || header.ncpus > MAX_CPUS) {
+        fprintf(stderr, "%s is not a sample file of this version\n", argv[1]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror("fopen");
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    block_t *block = malloc(sizeof(block_t));
+    if (!block) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    fputs("time_ms,command,ready,blocked,running", out);
+    for (uint32_t i = 0; i < header.ncpus; i++) {
+        fprintf(out, ",cpu%u_busy,cpu%u_dispatches,cpu%u_util", i, i, i);
+    }
+    fputc('\n', out);
+
+    int status = EXIT_SUCCESS;
+    uint64_t rows = 0;
+    uint64_t prev_ms = 0;
+    uint32_t count;
+    while (rows < header.count && fread(&count, sizeof(count), 1, in) == 1) {
+        if (count == 0 || count > SAMPLER_BLOCK || read_block(in, block, header.ncpus, count) < 0) {
+            fprintf(stderr, "Truncated or corrupt block after %llu samples\n", (unsigned long long) rows);
+            status = EXIT_FAILURE;
+            break;
+        }
+        for (uint32_t r = 0; r < count; r++, rows++) {
+            // The utilization is over the time since the previous sample (longer after dropped samples)
+            uint64_t elapsed_ms = rows > 0 ? block->time_ms[r] - prev_ms : header.interval_ms;
+            prev_ms = block->time_ms[r];
+            fprintf(out, "%llu,%u,%u,%u,%d", (unsigned long long) block->time_ms[r], block->command[r],
+                    block->ready[r], block->blocked[r], __builtin_popcountll(block->busy[r]));
+            for (uint32_t i = 0; i < header.ncpus; i++) {
+                fprintf(out, ",%d,%u,%.1f", (int) ((block->busy[r] >> i) & 1), block->dispatches[i][r],
+                        elapsed_ms ? 100.0 * block->busy_us[i][r] / 1000.0 / (double) elapsed_ms : 0.0);
+            }
+            fputc('\n', out);
+        }
+    }
+    if (status == EXIT_SUCCESS && rows != header.count) {
+        fprintf(stderr, "Expected %llu samples, found %llu\n", (unsigned long long) header.count,
+                (unsigned long long) rows);
+        status = EXIT_FAILURE;
+    }
+    fprintf(stderr, "%llu samples every %u ms on %u CPU(s), %llu dropped\n", (unsigned long long) rows,
+            header.interval_ms, header.ncpus, (unsigned long long) header.dropped);
+    free(block);
+    fclose(in);
+    if (out != stdout) fclose(out);
+    return status;
+}
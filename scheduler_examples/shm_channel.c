@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include "shm_channel.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Polls of an empty ring before the consumer parks
+#define SHM_SPIN_LIMIT 4096
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() atomic_signal_fence(memory_order_seq_cst)
+#endif
+
+// The region is shared between processes, so the futex operations are not private
+static void futex_wake(_Atomic uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void futex_wait(_Atomic uint32_t *word, uint32_t expected, uint32_t timeout_ms) {
+    struct timespec timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (long) (timeout_ms % 1000) * 1000000L
+    };
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+int shm_ring_push(shm_ring_t *ring, const msg_t *msg) {
+    return shm_ring_push_payload(ring, msg, NULL, 0);
+}
+
+int shm_ring_push_payload(shm_ring_t *ring, const msg_t *msg, const void *payload, uint32_t len) {
+    uint32_t slots = 1 + (uint32_t) SHM_PAYLOAD_SLOTS(len);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (SHM_RING_SLOTS - (tail - head) < slots) return -1;
+    ring->slots[tail % SHM_RING_SLOTS] = *msg;
+    // The payload is cut in slot-sized pieces, the last one may be partial
+    for (uint32_t i = 1, offset = 0; i < slots; i++, offset += sizeof(msg_t)) {
+        uint32_t piece = len - offset < sizeof(msg_t) ? len - offset : (uint32_t) sizeof(msg_t);
+        memcpy(&ring->slots[(tail + i) % SHM_RING_SLOTS], (const uint8_t *) payload + offset, piece);
+    }
+    atomic_store_explicit(&ring->tail, tail + slots, memory_order_release);
+    // Either the consumer sees the new tail before it sleeps, or we see that it parked
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->parked, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&ring->wakes, 1, memory_order_relaxed);
+        futex_wake(&ring->tail);
+    }
+    return 0;
+}
+
+int shm_ring_pop(shm_ring_t *ring, msg_t *msg) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) return 0;
+    *msg = ring->slots[head % SHM_RING_SLOTS];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+int shm_ring_pop_payload(shm_ring_t *ring, void *payload, uint32_t len) {
+    uint32_t slots = (uint32_t) SHM_PAYLOAD_SLOTS(len);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (tail - head < slots) return 0;
+    for (uint32_t i = 0, offset = 0; i < slots; i++, offset += sizeof(msg_t)) {
+        uint32_t piece = len - offset < sizeof(msg_t) ? len - offset : (uint32_t) sizeof(msg_t);
+        memcpy((uint8_t *) payload + offset, &ring->slots[(head + i) % SHM_RING_SLOTS], piece);
+    }
+    atomic_store_explicit(&ring->head, head + slots, memory_order_release);
+    return 1;
+}
+
+// With a single CPU the producer cannot run while we spin
+static uint32_t spin_limit(void) {
+    static long cpus = 0;
+    if (cpus == 0) cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 1 ? SHM_SPIN_LIMIT : 0;
+}
+
+int shm_ring_wait(shm_ring_t *ring, msg_t *msg, uint32_t timeout_ms) {
+    uint32_t limit = spin_limit();
+    for (uint32_t spins = 0; spins < limit; spins++) {
+        if (shm_ring_pop(ring, msg)) return 1;
+        cpu_relax();
+    }
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->parked, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->tail, memory_order_relaxed) == head) {
+        atomic_fetch_add_explicit(&ring->parks, 1, memory_order_relaxed);
+        futex_wait(&ring->tail, head, timeout_ms);
+    }
+    atomic_store_explicit(&ring->parked, 0, memory_order_relaxed);
+    return shm_ring_pop(ring, msg);
+}
+
+shm_channel_t *shm_channel_create(int *fd) {
+    *fd = memfd_create("ossim-channel", MFD_CLOEXEC);
+    if (*fd < 0) {
+        perror("memfd_create");
+        return NULL;
+    }
+    if (ftruncate(*fd, sizeof(shm_channel_t)) < 0) {
+        perror("ftruncate");
+        close(*fd);
+        return NULL;
+    }
+    shm_channel_t *channel = mmap(NULL, sizeof(shm_channel_t), PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    if (channel == MAP_FAILED) {
+        perror("mmap");
+        close(*fd);
+        return NULL;
+    }
+    // The region starts zeroed: both rings are empty
+    channel->magic = SHM_CHANNEL_MAGIC;
+    return channel;
+}
+
+shm_channel_t *shm_channel_attach(int fd) {
+    shm_channel_t *channel = mmap(NULL, sizeof(shm_channel_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (channel == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    if (channel->magic != SHM_CHANNEL_MAGIC) {
+        fprintf(stderr, "Invalid shared-memory channel\n");
+        munmap(channel, sizeof(shm_channel_t));
+        return NULL;
+    }
+    return channel;
+}
+
+void shm_channel_detach(shm_channel_t *channel) {
+    if (channel) munmap(channel, sizeof(shm_channel_t));
+}
+
+int shm_channel_send(int sockfd, pid_t pid, int fd) {
+    msg_t msg = {
+        .pid = pid,
+        .request = PROCESS_REQUEST_ATTACH,
+        .block = BLOCK_ADDRESS_NONE
+    };
+    struct iovec iov = {.iov_base = &msg, .iov_len = sizeof(msg_t)};
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    struct msghdr hdr = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control)
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    if (sendmsg(sockfd, &hdr, 0) != sizeof(msg_t)) {
+        perror("sendmsg");
+        return -1;
+    }
+    return 0;
+}
+
+int shm_channel_recv(int sockfd, msg_t *msg, int *fd) {
+    struct iovec iov = {.iov_base = msg, .iov_len = sizeof(msg_t)};
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr hdr = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control)
+    };
+    *fd = -1;
+    ssize_t n = recvmsg(sockfd, &hdr, MSG_CMSG_CLOEXEC);
+    if (n <= 0) return (int) n;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    // A descriptor that came with any other message is not ours to keep
+    if (*fd >= 0 && msg->request != PROCESS_REQUEST_ATTACH) {
+        close(*fd);
+        *fd = -1;
+    }
+    return (int) n;
+}
@@ -0,0 +1,135 @@
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "msg.h"
+
+/*
+ * Shared-memory transport.
+ *
+ * Over the socket, every message is a write by one side and a read by the other.
+ * With this transport the application creates a shared-memory region with two
+ * single-producer single-consumer rings of messages, one for its requests and
+ * one for the replies of the simulator, and hands the region to the simulator
+ * over the socket with an ATTACH message. From then on the messages go through
+ * the rings.
+ *
+ * Pushing and popping a message are plain loads and stores. The simulator polls
+ * the request rings every tick, so it never sleeps on a ring. An application
+ * waiting for a reply spins for a while and then parks on a futex; only then
+ * does the simulator need a syscall to wake it up. The socket stays open and is
+ * used only to notice that the other side went away.
+ */
+
+#define SHM_RING_SLOTS 64           // Power of two, room for a whole script and its SCRIPT message
+
+// Slots taken by a payload of len bytes after a message
+#define SHM_PAYLOAD_SLOTS(len) (((len) + sizeof(msg_t) - 1) / sizeof(msg_t))
+#define SHM_CHANNEL_MAGIC 0x53484D32u
+
+// Define a ring; head and tail live on their own cache lines
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;     // Next slot to pop, written by the consumer
+    _Alignas(64) _Atomic uint32_t tail;     // Next slot to push, written by the producer (futex word)
+    _Alignas(64) _Atomic uint32_t parked;   // Set while the consumer sleeps on tail
+    _Atomic uint32_t parks;                 // Times the consumer went to sleep
+    _Atomic uint32_t wakes;                 // Times the producer had to wake it up
+    _Alignas(64) msg_t slots[SHM_RING_SLOTS];
+} shm_ring_t;
+
+// Define the shared-memory region of an application
+typedef struct shm_channel_st {
+    uint32_t magic;
+    _Atomic uint32_t closed;        // Set by the application before it disconnects
+    shm_ring_t requests;            // Application to simulator
+    shm_ring_t responses;           // Simulator to application
+} shm_channel_t;
+
+/**
+ * @brief Push a message, waking up the consumer if it is parked
+ *
+ * @return 0 on success, -1 if the ring is full
+ */
+int shm_ring_push(shm_ring_t *ring, const msg_t *msg);
+
+/**
+ * @brief Push a message followed by a payload in the next slots, both published at once
+ *
+ * @param ring The ring
+ * @param msg The message
+ * @param payload The bytes that follow the message (NULL if none)
+ * @param len Length of the payload
+ * @return 0 on success, -1 if the ring has no room for both
+ */
+int shm_ring_push_payload(shm_ring_t *ring, const msg_t *msg, const void *payload, uint32_t len);
+
+/**
+ * @brief Pop a message without waiting
+ *
+ * @return 1 if a message was popped, 0 if the ring is empty
+ */
+int shm_ring_pop(shm_ring_t *ring, msg_t *msg);
+
+/**
+ * @brief Pop the payload pushed with the message that was just popped
+ *
+ * @param ring The ring
+ * @param payload Where to store the payload
+ * @param len Length of the payload
+ * @return 1 if the payload was popped, 0 if the ring does not hold it
+ */
+int shm_ring_pop_payload(shm_ring_t *ring, void *payload, uint32_t len);
+
+/**
+ * @brief Pop a message, spinning and then parking until one arrives
+ *
+ * @param ring The ring
+ * @param msg Where to store the message
+ * @param timeout_ms Longest time to sleep
+ * @return 1 if a message was popped, 0 on timeout
+ */
+int shm_ring_wait(shm_ring_t *ring, msg_t *msg, uint32_t timeout_ms);
+
+/**
+ * @brief Create a shared-memory region for a new connection
+ *
+ * @param fd Where to store the file descriptor of the region, to be sent with shm_channel_send
+ * @return The mapped region, or NULL on failure
+ */
+shm_channel_t *shm_channel_create(int *fd);
+
+/**
+ * @brief Map the region received from an application
+ *
+ * @param fd The file descriptor of the region (closed by this function)
+ * @return The mapped region, or NULL if it is not a valid region
+ */
+shm_channel_t *shm_channel_attach(int fd);
+
+/**
+ * @brief Unmap a region
+ */
+void shm_channel_detach(shm_channel_t *channel);
+
+/**
+ * @brief Send an ATTACH message with the region over the socket
+ *
+ * @return 0 on success, -1 on failure
+ */
+int shm_channel_send(int sockfd, pid_t pid, int fd);
+
+/**
+ * @brief Read a message from a socket, receiving the region if it is an ATTACH message
+ *
+ * Works like read on the socket.
+ *
+ * @param sockfd The socket
+ * @param msg Where to store the message
+ * @param fd Where to store the received file descriptor (-1 if there is none)
+ * @return The number of bytes read, 0 if the connection was closed, -1 on error (errno set)
+ */
+int shm_channel_recv(int sockfd, msg_t *msg, int *fd);
+
+#endif //SHM_CHANNEL_H
@@ -0,0 +1,309 @@
+#include "sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "msg.h"
+#include "io.h"
+#include "locks.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "timerset.h"
+
+// Define the state of a simulated process during a simulation
+typedef struct {
+    pcb_t *pcb;
+    uint32_t next_burst;        // Index of the burst to request next
+    int block_pending;          // The block of the current burst still has to be requested
+} sim_proc_state_t;
+
+// Define the state of a running simulation
+typedef struct {
+    const sim_workload_t *wl;
+    sim_proc_state_t *procs;
+    sim_proc_result_t *results;
+    queue_t command_queue;
+    timer_set_t blocked_timers;
+    io_t io;
+    locks_t locks;
+    queue_t lock_done;          // Processes whose LOCK or UNLOCK finished
+    pcb_table_t pcbs;
+    scheduler_t *scheduler;
+    uint32_t finished;
+} sim_state_t;
+
+int sim_load_workload(sim_workload_t *wl, char *const files[], uint32_t num_files) {
+    wl->procs = calloc(num_files, sizeof(sim_process_t));
+    wl->num_procs = 0;
+    if (!wl->procs) return -1;
+
+    for (uint32_t i = 0; i < num_files; i++) {
+        burst_queue_t bursts = {.head = NULL, .tail = NULL};
+        int count = read_queue_from_file(&bursts, files[i]);
+        if (count <= 0) {
+            fprintf(stderr, "Failed to read burst file %s\n", files[i]);
+            sim_free_workload(wl);
+            return -1;
+        }
+        sim_process_t *proc = &wl->procs[wl->num_procs++];
+        proc->name = get_basename_no_ext(files[i]);
+        proc->bursts = malloc(count * sizeof(burst_t));
+        proc->num_bursts = 0;
+        burst_t *burst;
+        while ((burst = dequeue_burst(&bursts)) != NULL) {
+            if (proc->bursts) {
+                proc->bursts[proc->num_bursts++] = *burst;
+            }
+            free(burst);
+        }
+        if (!proc->name || !proc->bursts) {
+            sim_free_workload(wl);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void sim_free_workload(sim_workload_t *wl) {
+    for (uint32_t i = 0; i < wl->num_procs; i++) {
+        free(wl->procs[i].name);
+        free(wl->procs[i].bursts);
+    }
+    free(wl->procs);
+    wl->procs = NULL;
+    wl->num_procs = 0;
+}
+
+/**
+ * @brief Called by the scheduler when a simulated process finished its CPU burst.
+ *
+ * This is the DONE message: the process goes back to the command queue and sends
+ * its next request on the next tick.
+ */
+static void sim_burst_done(void *ctx, pcb_t *pcb, uint64_t current_time_ns) {
+    sim_state_t *sim = ctx;
+    sim_proc_state_t *proc = &sim->procs[pcb->pid - 1];
+    const burst_t *burst = &sim->wl->procs[pcb->pid - 1].bursts[proc->next_burst];
+
+    sim->results[pcb->pid - 1].finish_time_ns = current_time_ns;
+    if (burst->block_time_ms > 0) {
+        proc->block_pending = 1;
+    } else {
+        proc->next_burst++;
+    }
+    pcb->status = TASK_COMMAND;
+    pcb->time_ns = 0;
+    pcb->ellapsed_time_ns = 0;
+    enqueue_pcb(&sim->command_queue, pcb);
+}
+
+/**
+ * @brief Disconnect a process that has no more requests (or whose request was refused, like app-io).
+ */
+static void sim_exit(sim_state_t *sim, pcb_t *pcb, uint64_t current_time_ns) {
+    scheduler_exit(sim->scheduler, pcb);
+    locks_exit(&sim->locks, pcb, current_time_ns, &sim->lock_done);
+    sim->procs[pcb->pid - 1].pcb = NULL;
+    free_pcb(&sim->pcbs, pcb);
+    sim->finished++;
+}
+
+/**
+ * @brief Let every process in the command queue send its next request.
+ *
+ * Same as check_new_commands in ossim, but the requests come from the bursts
+ * of the workload instead of the socket.
+ */
+static void sim_check_commands(sim_state_t *sim, uint64_t current_time_ns) {
+    pcb_t *pcb;
+    while ((pcb = dequeue_pcb(&sim->command_queue)) != NULL) {
+        uint32_t idx = pcb->pid - 1;
+        sim_proc_state_t *proc = &sim->procs[idx];
+        const sim_process_t *desc = &sim->wl->procs[idx];
+        sim_proc_result_t *result = &sim->results[idx];
+
+        if (proc->block_pending) {
+            const burst_t *burst = &desc->bursts[proc->next_burst];
+            pcb->time_ns = burst->block_time_ms * NS_PER_MS;
+            pcb->status = TASK_BLOCKED;
+            pcb->cold->io_device = burst->device;
+            pcb->cold->io_block = burst->block;
+            result->blocked_ns += pcb->time_ns;
+            proc->block_pending = 0;
+            proc->next_burst++;
+            if (io_submit(&sim->io, pcb, current_time_ns) < 0) {
+                timer_set_add(&sim->blocked_timers, pcb, pcb->time_ns);
+            }
+        } else if (proc->next_burst < desc->num_bursts && desc->bursts[proc->next_burst].request != PROCESS_REQUEST_RUN) {
+            // LOCK or UNLOCK, DONE once the process holds the mutex (or gave it back)
+            const burst_t *burst = &desc->bursts[proc->next_burst];
+            pcb->time_ns = 0;
+            pcb->status = TASK_BLOCKED;
+            proc->next_burst++;
+            int status = burst->request == PROCESS_REQUEST_LOCK ?
+                         locks_lock(&sim->locks, pcb, burst->mutex, current_time_ns, &sim->lock_done) :
+                         locks_unlock(&sim->locks, pcb, burst->mutex, current_time_ns, &sim->lock_done);
+            if (status < 0) {
+                sim_exit(sim, pcb, current_time_ns);
+                continue;
+            }
+        } else if (proc->next_burst < desc->num_bursts) {
+            const burst_t *burst = &desc->bursts[proc->next_burst];
+            pcb->time_ns = burst->burst_time_ms * NS_PER_MS;
+            pcb->ellapsed_time_ns = 0;
+            pcb->cold->pages = burst->pages;
+            if (burst->nice > 0 && burst->nice - 1 != pcb->cold->nice) {
+                scheduler_renice(sim->scheduler, pcb, burst->nice - 1);
+            }
+            pcb->status = TASK_RUNNING;
+            result->cpu_ns += pcb->time_ns;
+            scheduler_enqueue(sim->scheduler, pcb, current_time_ns);
+        } else {
+            // No more bursts, the process disconnects
+            sim_exit(sim, pcb, current_time_ns);
+            continue;
+        }
+        // Every request is acknowledged with the current time
+        if (result->start_time_ns == UINT64_MAX) {
+            result->start_time_ns = current_time_ns;
+        }
+    }
+}
+
+/**
+ * @brief Called when a simulated process finished its BLOCK request (DONE).
+ */
+static void sim_block_done(void *ctx, pcb_t *pcb, uint64_t current_time_ns) {
+    sim_state_t *sim = ctx;
+    sim->results[pcb->pid - 1].finish_time_ns = current_time_ns;
+    pcb->status = TASK_COMMAND;
+    enqueue_pcb(&sim->command_queue, pcb);
+}
+
+/**
+ * @brief Advance the blocked processes by one tick, and finish the LOCK and UNLOCK requests.
+ *
+ * Same as check_blocked_queue and check_lock_queue in ossim.
+ */
+static void sim_check_blocked(sim_state_t *sim, uint64_t current_time_ns) {
+    queue_t woken = {.head = NULL, .tail = NULL};
+    timer_set_tick(&sim->blocked_timers, sim->scheduler->tick_ns, &woken);
+    pcb_t *pcb;
+    while ((pcb = dequeue_pcb(&woken)) != NULL) {
+        sim_block_done(sim, pcb, current_time_ns);
+    }
+    while ((pcb = dequeue_pcb(&sim->lock_done)) != NULL) {
+        sim_block_done(sim, pcb, current_time_ns);
+    }
+}
+
+/**
+ * @brief Gather the results and statistics of a finished simulation
+ */
+static void sim_collect_result(sim_state_t *sim, sim_result_t *result) {
+    result->procs = sim->results;
+    result->num_procs = sim->wl->num_procs;
+    for (uint32_t i = 0; i < sim->wl->num_procs; i++) {
+        if (sim->results[i].finish_time_ns > result->end_time_ns) {
+            result->end_time_ns = sim->results[i].finish_time_ns;
+        }
+    }
+    for (uint32_t i = 0; i < sim->scheduler->ncpus; i++) {
+        cswitch_stats_add(&result->cswitch, &sim->scheduler->cpus[i].cswitch.stats);
+        if (sim->scheduler->cpus[i].cache) {
+            cache_stats_add(&result->caches, &sim->scheduler->cpus[i].cache->stats);
+        }
+    }
+    if (sim->scheduler->vm) {
+        result->vm = sim->scheduler->vm->stats;
+    }
+    if (sim->scheduler->swap) {
+        result->swap = sim->scheduler->swap->stats;
+    }
+
+    size_t stats_len = 0;
+    FILE *stats = open_memstream(&result->stats, &stats_len);
+    if (stats) {
+        scheduler_print_stats(sim->scheduler, stats);
+        io_print_stats(&sim->io, stats, result->end_time_ns);
+        locks_print_stats(&sim->locks, stats, result->end_time_ns);
+        fclose(stats);
+    }
+}
+
+int sim_run(const sim_workload_t *wl, const sim_config_t *config, sim_result_t *result) {
+    memset(result, 0, sizeof(sim_result_t));
+    sim_state_t sim = {
+        .wl = wl,
+        .command_queue = {.head = NULL, .tail = NULL},
+    };
+    sim.procs = calloc(wl->num_procs, sizeof(sim_proc_state_t));
+    sim.results = calloc(wl->num_procs, sizeof(sim_proc_result_t));
+    uint64_t tick_ns = config->tick_ns ? config->tick_ns : DEFAULT_TICK_NS;
+    sim.scheduler = scheduler_create(config->scheduler, config->ncpus, tick_ns, &config->cswitch, sim_burst_done, &sim);
+    if (!sim.procs || !sim.results || !sim.scheduler ||
+        (config->vm && scheduler_set_memory(sim.scheduler, config->vm) < 0) ||
+        (config->caches && scheduler_set_caches(sim.scheduler, config->caches) < 0) ||
+        (config->swap && scheduler_set_swap(sim.scheduler, config->swap) < 0) ||
+        (config->host_threads > 0 && scheduler_set_threads(sim.scheduler, config->host_threads) < 0) ||
+        io_init(&sim.io, config->devices, config->num_devices) < 0 ||
+        // Priority inheritance only applies to the policies with priorities
+        locks_init(&sim.locks, sim.scheduler, config->priority_inheritance && sim.scheduler->ops->renice) < 0) {
+        free(sim.procs);
+        free(sim.results);
+        scheduler_destroy(sim.scheduler);
+        return -1;
+    }
+
+    // All processes connect at time 0, in the order of the workload
+    for (uint32_t i = 0; i < wl->num_procs; i++) {
+        sim.procs[i].pcb = new_pcb(&sim.pcbs, (int32_t) i + 1, 0, 0);
+        sim.results[i].start_time_ns = UINT64_MAX;
+        enqueue_pcb(&sim.command_queue, sim.procs[i].pcb);
+    }
+
+    uint64_t current_time_ns = 0;
+    int deadlock = 0;
+    while (sim.finished < wl->num_procs) {
+        sim_check_commands(&sim, current_time_ns);
+        sim_check_blocked(&sim, current_time_ns);
+        io_tick(&sim.io, current_time_ns, sim_block_done, &sim);
+        scheduler_tick(sim.scheduler, current_time_ns);
+        locks_check_inversions(&sim.locks, current_time_ns);
+        // Every process left waits for a mutex held by another one left, none can ever finish
+        if (sim.finished < wl->num_procs && sim.locks.num_waiting == wl->num_procs - sim.finished) {
+            deadlock = 1;
+            break;
+        }
+        current_time_ns += tick_ns;
+    }
+
+    if (deadlock) {
+        fprintf(stderr, "Deadlock with %s at %.3f s (processes are numbered from 1 in workload order): ",
+                config->scheduler, current_time_ns / 1e9);
+        for (uint32_t i = 0; i < wl->num_procs; i++) {
+            if (sim.procs[i].pcb) {
+                locks_print_deadlock(&sim.locks, sim.procs[i].pcb, stderr);
+                break;
+            }
+        }
+        free(sim.results);
+        sim.results = NULL;
+    } else {
+        sim_collect_result(&sim, result);
+    }
+
+    scheduler_destroy(sim.scheduler);
+    io_free(&sim.io);
+    locks_free(&sim.locks);
+    timer_set_free(&sim.blocked_timers);
+    pcb_table_free(&sim.pcbs);
+    free(sim.procs);
+    return deadlock ? -1 : 0;
+}
+
+void sim_free_result(sim_result_t *result) {
+    free(result->procs);
+    free(result->stats);
+    memset(result, 0, sizeof(sim_result_t));
+}
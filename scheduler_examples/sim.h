@@ -0,0 +1,104 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "burst_queue.h"
+#include "cache.h"
+#include "cswitch.h"
+#include "io.h"
+#include "swap.h"
+#include "vm.h"
+
+/*
+ * Offline simulation of a workload.
+ *
+ * Instead of real applications talking to ossim over the socket, each process of
+ * the workload is simulated inside the same program: it requests the CPU for each
+ * burst, blocks for the block time, and so on, exactly like app-io does. The
+ * simulation keeps the timing of ossim (a request sent after a DONE is seen by the
+ * simulator on the next tick), but runs as fast as the host allows.
+ *
+ * A simulation has no global state, so several simulations can run in parallel threads.
+ */
+
+// Define a process of the workload (read only during the simulation)
+typedef struct {
+    char *name;                 // Name of the process (burst file basename)
+    burst_t *bursts;            // Array of bursts
+    uint32_t num_bursts;
+} sim_process_t;
+
+// Define a workload: the set of processes that start together
+typedef struct {
+    sim_process_t *procs;
+    uint32_t num_procs;
+} sim_workload_t;
+
+// Define the results of one process
+typedef struct {
+    uint64_t start_time_ns;     // Time of the first ACK
+    uint64_t finish_time_ns;    // Time of the last DONE
+    uint64_t cpu_ns;            // Requested CPU time
+    uint64_t blocked_ns;        // Requested block time
+} sim_proc_result_t;
+
+// Define the configuration of one simulation
+typedef struct {
+    const char *scheduler;      // Scheduler name and parameters (e.g. "RR:500")
+    uint32_t ncpus;
+    uint64_t tick_ns;           // Length of a tick (0 for DEFAULT_TICK_NS)
+    uint32_t host_threads;      // Host threads advancing the CPUs, each with its own run queue (0 for one shared queue)
+    cswitch_config_t cswitch;
+    const vm_config_t *vm;      // Virtual memory (NULL if memory is not simulated)
+    const cache_config_t *caches; // TLB and LLC of every CPU (NULL if caches are not simulated)
+    const swap_config_t *swap;  // Medium-term scheduler (NULL if processes are not swapped, needs vm)
+    const io_device_config_t *devices; // I/O devices (the device id is the index)
+    uint32_t num_devices;       // 0 for independent I/O timers
+    int priority_inheritance;   // Priority inheritance on the mutexes (policies with priorities only)
+} sim_config_t;
+
+// Define the results of one simulation
+typedef struct {
+    sim_proc_result_t *procs;   // One per process of the workload
+    uint32_t num_procs;
+    uint64_t end_time_ns;       // Time when the last process finished
+    cswitch_stats_t cswitch;    // Context switch counters of all CPUs
+    vm_stats_t vm;              // Virtual memory counters (zero if memory is not simulated)
+    cache_stats_t caches;       // Cache counters of all CPUs (zero if caches are not simulated)
+    swap_stats_t swap;          // Swapping counters (zero if processes are not swapped)
+    char *stats;                // Scheduler statistics, as printed by scheduler_print_stats
+} sim_result_t;
+
+/**
+ * @brief Load a workload from burst files
+ *
+ * @param wl The workload to fill
+ * @param files The burst files, one per process
+ * @param num_files The number of files
+ * @return 0 on success, -1 on failure
+ */
+int sim_load_workload(sim_workload_t *wl, char *const files[], uint32_t num_files);
+
+/**
+ * @brief Free the memory of a workload
+ */
+void sim_free_workload(sim_workload_t *wl);
+
+/**
+ * @brief Run a workload to completion with a scheduler
+ *
+ * @param wl The workload
+ * @param config The scheduler and CPU configuration
+ * @param result Where to store the results (free with sim_free_result)
+ * @return 0 on success, -1 on failure
+ */
+int sim_run(const sim_workload_t *wl, const sim_config_t *config, sim_result_t *result);
+
+/**
+ * @brief Free the memory of a simulation result
+ */
+void sim_free_result(sim_result_t *result);
+
+#endif //SIM_H
@@ -2,49 +2,66 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "msg.h"
-#include <unistd.h>
+
+typedef struct {
+    pcb_ring_t rq;
+} sjf_t;
+
+static void *sjf_init(const char *params) {
+    (void) params;
+    return calloc(1, sizeof(sjf_t));
+}
+
+static void sjf_destroy(void *state) {
+    sjf_t *sjf = state;
+    ring_free(&sjf->rq);
+    free(sjf);
+}
+
+static void sjf_enqueue(void *state, pcb_t *task, sched_enqueue_reason_en reason, uint64_t current_time_ns) {
+    (void) reason;
+    (void) current_time_ns;
+    sjf_t *sjf = state;
+    ring_push(&sjf->rq, task);
+}
+
+static int sjf_remove(void *state, pcb_t *task) {
+    sjf_t *sjf = state;
+    return ring_remove(&sjf->rq, task);
+}
 
 /**
  * @brief Shortest Job First (SJF) scheduling algorithm.
  * Selects the task with the shortest execution time from the ready queue.
  */
-void sjf_scheduler(uint32_t current_time_ms, queue_t *rq, pcb_t **cpu_task) {
-    // Atualiza tarefa em execução
-    if (*cpu_task) {
-        (*cpu_task)->ellapsed_time_ms += TICKS_MS;
-
-        // Se terminou
-        if ((*cpu_task)->ellapsed_time_ms >= (*cpu_task)->time_ms) {
-            msg_t msg = {
-                .pid = (*cpu_task)->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write((*cpu_task)->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
-            }
-            free(*cpu_task);
-            *cpu_task = NULL;
-        }
-    }
+static pcb_t *sjf_pick_next(void *state, uint64_t current_time_ns) {
+    (void) current_time_ns;
+    sjf_t *sjf = state;
+    pcb_ring_t *rq = &sjf->rq;
+    if (rq->count == 0) return NULL;
 
-    // Se CPU está ociosa, escolhe o job mais curto
-    if (*cpu_task == NULL && rq->head != NULL) {
-        // Encontrar menor tempo na fila
-        queue_elem_t *shortest = rq->head;
-        for (queue_elem_t *current = rq->head->next; current != NULL; current = current->next) {
-            uint32_t current_remaining = current->pcb->time_ms - current->pcb->ellapsed_time_ms;
-            uint32_t shortest_remaining = shortest->pcb->time_ms - shortest->pcb->ellapsed_time_ms;
-            if (current_remaining < shortest_remaining) {
-                shortest = current;
-            }
-        }
-
-        // Escalonar o mais curto
-        *cpu_task = shortest->pcb;
-        queue_elem_t *removed = remove_queue_elem(rq, shortest);
-        if (removed) {
-            free(removed);  // Libera o elemento da fila (NÃO o PCB!)
+    // Encontrar menor tempo na fila
+    uint32_t shortest = 0;
+    uint64_t shortest_remaining = ring_at(rq, 0)->time_ns - ring_at(rq, 0)->ellapsed_time_ns;
+    for (uint32_t i = 1; i < rq->count; i++) {
+        pcb_t *current = ring_at(rq, i);
+        uint64_t current_remaining = current->time_ns - current->ellapsed_time_ns;
+        if (current_remaining < shortest_remaining) {
+            shortest = i;
+            shortest_remaining = current_remaining;
         }
     }
+
+    // Escalonar o mais curto (tirado da fila, o PCB continua vivo)
+    pcb_t *task = ring_take(rq, shortest);
+    return task;
 }
+
+const scheduler_ops_t sjf_ops = {
+    .name = "SJF",
+    .init = sjf_init,
+    .destroy = sjf_destroy,
+    .enqueue = sjf_enqueue,
+    .pick_next = sjf_pick_next,
+    .remove = sjf_remove,
+};
@@ -0,0 +1,252 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msg.h"
+
+/*
+ * Run like: ./socket_bench [-n clients] [-t seconds] [-a path/to/scheduler]
+ *
+ * Starts the simulator twice, once with the POSIX socket calls and once with -U
+ * (io_uring), connects thousands of clients to it from this single process and
+ * lets them alternate short RUN and BLOCK requests for a while. The simulator
+ * counts the syscalls it makes for the client sockets; this prints its report
+ * next to the number of messages the clients exchanged.
+ */
+
+#define BENCH_RUN_MS 10
+#define BENCH_BLOCK_MS 200
+
+// Define a simulated application
+typedef struct {
+    int fd;
+    process_request_t next;     // Request to send after the next DONE
+    int replies;                // Replies still expected for the current request
+} bench_client_t;
+
+// Define the outcome of one run
+typedef struct {
+    uint64_t messages;          // Requests and replies
+    char report[512];           // Socket I/O report of the simulator
+} bench_result_t;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int send_request(bench_client_t *client) {
+    msg_t msg = {
+        .pid = client->fd,
+        .request = client->next,
+        .time_ns = (client->next == PROCESS_REQUEST_RUN ? BENCH_RUN_MS : BENCH_BLOCK_MS) * NS_PER_MS,
+        .block = BLOCK_ADDRESS_NONE
+    };
+    if (write(client->fd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
+        perror("write");
+        return -1;
+    }
+    client->next = client->next == PROCESS_REQUEST_RUN ? PROCESS_REQUEST_BLOCK : PROCESS_REQUEST_RUN;
+    client->replies = 2;
+    return 0;
+}
+
+static int connect_client(void) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    // The simulator accepts once per tick, connect waits while the backlog is full
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Start the simulator with its output in a temporary file
+static pid_t start_scheduler(const char *path, int use_uring, FILE *out) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(fileno(out), STDOUT_FILENO);
+        if (use_uring) {
+            execl(path, path, "-U", "-c", "8", "RR:20", (char *) NULL);
+        } else {
+            execl(path, path, "-c", "8", "RR:20", (char *) NULL);
+        }
+        perror("execl");
+        _exit(EXIT_FAILURE);
+    }
+    // Wait for the server socket
+    for (int i = 0; i < 200; i++) {
+        if (access(SOCKET_PATH, F_OK) == 0) return pid;
+        usleep(10000);
+    }
+    fprintf(stderr, "The scheduler did not start\n");
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+static int run(const char *path, int use_uring, uint32_t num_clients, uint32_t seconds, bench_result_t *result) {
+    memset(result, 0, sizeof(bench_result_t));
+    FILE *out = tmpfile();
+    if (!out) {
+        perror("tmpfile");
+        return -1;
+    }
+    unlink(SOCKET_PATH);
+    pid_t pid = start_scheduler(path, use_uring, out);
+    if (pid < 0) {
+        fclose(out);
+        return -1;
+    }
+
+    int status = 0;
+    bench_client_t *clients = calloc(num_clients, sizeof(bench_client_t));
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    uint32_t connected = 0;
+    if (!clients || epfd < 0) {
+        perror("epoll/calloc");
+        status = -1;
+    }
+    for (; status == 0 && connected < num_clients; connected++) {
+        bench_client_t *client = &clients[connected];
+        client->fd = connect_client();
+        client->next = PROCESS_REQUEST_RUN;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = client};
+        if (client->fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, client->fd, &ev) < 0 || send_request(client) < 0) {
+            status = -1;
+        }
+        result->messages++;
+    }
+
+    double end = monotonic_s() + seconds;
+    struct epoll_event events[256];
+    while (status == 0 && monotonic_s() < end) {
+        int n = epoll_wait(epfd, events, 256, 100);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            status = -1;
+        }
+        for (int i = 0; i < n; i++) {
+            bench_client_t *client = events[i].data.ptr;
+            msg_t msg;
+            if (read(client->fd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
+                fprintf(stderr, "Lost the connection to the scheduler\n");
+                status = -1;
+                break;
+            }
+            result->messages++;
+            if (--client->replies == 0) {
+                if (send_request(client) < 0) {
+                    status = -1;
+                    break;
+                }
+                result->messages++;
+            }
+        }
+    }
+
+    // Stop the simulator and keep its report
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+    for (uint32_t i = 0; i < connected; i++) {
+        close(clients[i].fd);
+    }
+    if (epfd >= 0) close(epfd);
+    free(clients);
+
+    char line[512];
+    rewind(out);
+    while (fgets(line, sizeof(line), out)) {
+        if (strncmp(line, "Socket I/O", 10) == 0 || strncmp(line, "Simulation stopped", 18) == 0) {
+            strncat(result->report, "  ", sizeof(result->report) - strlen(result->report) - 1);
+            strncat(result->report, line, sizeof(result->report) - strlen(result->report) - 1);
+        }
+    }
+    fclose(out);
+    return status;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n clients] [-t seconds] [-a path/to/scheduler]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t num_clients = 2000;
+    uint32_t seconds = 5;
+    const char *path = "./scheduler";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:a:")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (parse_uint(optarg, &num_clients) < 0) exit(EXIT_FAILURE);
+                break;
+            case 't':
+                if (parse_uint(optarg, &seconds) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'a':
+                path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Every client and its server side need a descriptor
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    printf("%u clients, %u s per run, RUN %u ms / BLOCK %u ms on 8 CPUs with RR:20\n",
+           num_clients, seconds, BENCH_RUN_MS, BENCH_BLOCK_MS);
+    const char *labels[] = {"POSIX", "io_uring"};
+    for (int use_uring = 0; use_uring < 2; use_uring++) {
+        bench_result_t result;
+        if (run(path, use_uring, num_clients, seconds, &result) < 0) {
+            return EXIT_FAILURE;
+        }
+        printf("%s: %llu messages\n%s", labels[use_uring], (unsigned long long) result.messages, result.report);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include "swap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scheduler.h"
+
+int swap_parse_config(const char *spec, swap_config_t *config) {
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    config->policy = SWAP_POLICY_LARGEST;
+    config->page_ms = 2;
+
+    int status = -1;
+    char *token = strtok(copy, ",");
+    for (int i = 0; token && i < (int) (sizeof(SWAP_POLICY_STRINGS) / sizeof(SWAP_POLICY_STRINGS[0])); i++) {
+        if (strcmp(token, SWAP_POLICY_STRINGS[i]) == 0) {
+            config->policy = (swap_policy_en) i;
+            status = 0;
+        }
+    }
+    token = strtok(NULL, ",");
+    if (status == 0 && token) {
+        char *endptr;
+        long value = strtol(token, &endptr, 10);
+        if (*endptr != '\0' || value < 0 || value > INT32_MAX) {
+            status = -1;
+        } else {
+            config->page_ms = (uint32_t) value;
+        }
+        token = strtok(NULL, ",");
+    }
+    if (token) status = -1;
+    if (status < 0) {
+        fprintf(stderr, "Invalid swap configuration: %s (expected LARGEST|LRU|OLDEST[,page_ms])\n", spec);
+    }
+    free(copy);
+    return status;
+}
+
+swap_t *swap_create(const swap_config_t *config) {
+    swap_t *swap = calloc(1, sizeof(swap_t));
+    if (!swap) return NULL;
+    swap->config = *config;
+    return swap;
+}
+
+void swap_destroy(swap_t *swap) {
+    if (!swap) return;
+    while (dequeue_pcb(&swap->active) != NULL) { }
+    while (dequeue_pcb(&swap->swapped) != NULL) { }
+    free(swap);
+}
+
+void swap_track(swap_t *swap, pcb_t *task) {
+    enqueue_pcb(&swap->active, task);
+}
+
+void swap_untrack(swap_t *swap, pcb_t *task) {
+    remove_pcb(&swap->active, task);
+}
+
+static int is_running(const scheduler_t *s, const pcb_t *task) {
+    for (uint32_t i = 0; i < s->ncpus; i++) {
+        // A task picked from a per-CPU run queue is about to run
+        if (s->cpus[i].task == task || s->cpus[i].mailbox.picked == task) return 1;
+    }
+    return 0;
+}
+
+static int is_paging(const scheduler_t *s, const pcb_t *task) {
+    for (queue_elem_t *elem = s->paging_queue.head; elem != NULL; elem = elem->next) {
+        if (elem->pcb == task) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Choose the process to swap out among the ones waiting in the ready queue(s)
+ *
+ * @return The victim, or NULL if no process can be swapped out
+ */
+static pcb_t *choose_victim(const scheduler_t *s) {
+    const swap_t *swap = s->swap;
+    pcb_t *victim = NULL;
+    for (queue_elem_t *elem = swap->active.head; elem != NULL; elem = elem->next) {
+        pcb_t *task = elem->pcb;
+        // Running tasks and tasks waiting for pages are left alone
+        if (task->cold->pages.count == 0 || is_running(s, task) || is_paging(s, task)) continue;
+        if (!victim) {
+            victim = task;
+            continue;
+        }
+        switch (swap->config.policy) {
+            case SWAP_POLICY_LARGEST:
+                if (task->cold->pages.count > victim->cold->pages.count) victim = task;
+                break;
+            case SWAP_POLICY_LRU:
+                if (task->slice_start_ns < victim->slice_start_ns) victim = task;
+                break;
+            case SWAP_POLICY_OLDEST:
+                // A task that never ran has no pages in memory yet, it is the youngest
+                if (task->cold->mm && (!victim->cold->mm || task->cold->mm->created_ns < victim->cold->mm->created_ns)) victim = task;
+                break;
+        }
+    }
+    return victim;
+}
+
+/**
+ * @brief Queue a transfer on the swap device
+ *
+ * @return The time when the transfer finishes
+ */
+static uint64_t device_transfer(swap_t *swap, uint32_t pages, uint64_t current_time_ns) {
+    uint64_t start_ns = swap->device_free_ns > current_time_ns ? swap->device_free_ns : current_time_ns;
+    uint64_t transfer_ns = pages * swap->config.page_ms * NS_PER_MS;
+    swap->device_free_ns = start_ns + transfer_ns;
+    swap->stats.device_busy_ns += transfer_ns;
+    return swap->device_free_ns;
+}
+
+static void swap_out(scheduler_t *s, pcb_t *task, uint64_t current_time_ns) {
+    swap_t *swap = s->swap;
+    scheduler_remove(s, task);
+    remove_pcb(&swap->active, task);
+
+    // The frames are free as soon as the pages are queued for writing
+    uint32_t pages = vm_resident_pages(task);
+    device_transfer(swap, pages, current_time_ns);
+    vm_release(s->vm, task);
+    task->cold->swapped_out_ns = current_time_ns;
+    enqueue_pcb(&swap->swapped, task);
+    swap->stats.swap_outs++;
+    swap->stats.pages_out += pages;
+    trace_event(s->trace, current_time_ns, TRACE_SWAP_OUT, TRACE_NO_CPU, task->pid, pages);
+}
+
+static void swap_in(scheduler_t *s, pcb_t *task, uint64_t current_time_ns) {
+    swap_t *swap = s->swap;
+    uint32_t pages = vm_prefetch(s->vm, task, current_time_ns);
+    task->wait_until_ns = device_transfer(swap, pages, current_time_ns);
+    enqueue_pcb(&swap->active, task);
+    // The task waits for the transfer in the paging queue, and then runs without faulting
+    enqueue_pcb(&s->paging_queue, task);
+    swap->stats.swap_ins++;
+    swap->stats.pages_in += pages;
+    swap->stats.swapped_ns += task->wait_until_ns - task->cold->swapped_out_ns;
+    trace_event(s->trace, current_time_ns, TRACE_SWAP_IN, TRACE_NO_CPU, task->pid, pages);
+}
+
+void swap_balance(scheduler_t *s, uint64_t current_time_ns) {
+    swap_t *swap = s->swap;
+    uint32_t num_frames = s->vm->config.num_frames;
+
+    // The pages needed by the tasks in memory
+    uint32_t demand = 0;
+    uint32_t num_active = 0;
+    for (queue_elem_t *elem = swap->active.head; elem != NULL; elem = elem->next) {
+        demand += elem->pcb->cold->pages.count;
+        num_active++;
+    }
+
+    // A single process is never swapped out, even if it does not fit alone
+    while (demand > num_frames && num_active > 1) {
+        pcb_t *victim = choose_victim(s);
+        if (!victim) break;
+        demand -= victim->cold->pages.count;
+        num_active--;
+        swap_out(s, victim, current_time_ns);
+    }
+
+    // Swapped out processes come back in order, while they fit (or memory is empty)
+    while (swap->swapped.head) {
+        pcb_t *task = swap->swapped.head->pcb;
+        if (num_active > 0 && demand + task->cold->pages.count > num_frames) break;
+        dequeue_pcb(&swap->swapped);
+        demand += task->cold->pages.count;
+        num_active++;
+        swap_in(s, task, current_time_ns);
+    }
+}
+
+void swap_print_stats(const swap_t *swap, FILE *out, const char *label) {
+    fprintf(out, "%s swapping: %s victims, %u ms per page\n",
+            label, SWAP_POLICY_STRINGS[swap->config.policy], swap->config.page_ms);
+    fprintf(out, "%s swap outs: %llu (%llu pages), swap ins: %llu (%llu pages), "
+                 "time swapped out: %.3fs, swap device busy: %.3fs\n",
+            label,
+            (unsigned long long) swap->stats.swap_outs,
+            (unsigned long long) swap->stats.pages_out,
+            (unsigned long long) swap->stats.swap_ins,
+            (unsigned long long) swap->stats.pages_in,
+            swap->stats.swapped_ns / 1e9,
+            swap->stats.device_busy_ns / 1e9);
+}
@@ -0,0 +1,110 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+
+struct scheduler_st;
+
+/*
+ * Medium-term scheduler.
+ *
+ * The tasks handed to the scheduler need the pages of their current burst in
+ * memory. When the pages they need add up to more than the physical memory, the
+ * tasks would keep evicting each other's pages (thrashing). Instead, whole
+ * processes are swapped out: their frames are written to a swap device and freed,
+ * and they wait out of the ready queue(s). A swapped out process is swapped back
+ * in, in the order it was swapped out, when its pages fit in memory again.
+ *
+ * The swap device transfers one page at a time, so transfers queue behind each
+ * other. A task being swapped in waits for its transfer to finish before it can
+ * run, like a page fault.
+ */
+
+// Define the swap out victim policies
+typedef enum {
+    SWAP_POLICY_LARGEST = 0,    // Process that needs the most pages
+    SWAP_POLICY_LRU,            // Process that ran least recently
+    SWAP_POLICY_OLDEST,         // Process that has been in memory the longest
+} swap_policy_en;
+
+static const char SWAP_POLICY_STRINGS[][8] = {
+    "LARGEST",
+    "LRU",
+    "OLDEST"
+};
+
+// Define the swapping configuration
+typedef struct {
+    swap_policy_en policy;
+    uint32_t page_ms;           // Swap device transfer time per page
+} swap_config_t;
+
+// Define the swapping counters
+typedef struct {
+    uint64_t swap_outs;
+    uint64_t swap_ins;
+    uint64_t pages_out;
+    uint64_t pages_in;
+    uint64_t swapped_ns;        // Time processes spent swapped out
+    uint64_t device_busy_ns;    // Time the swap device spent transferring
+} swap_stats_t;
+
+// Define the medium-term scheduler state
+typedef struct swap_st {
+    swap_config_t config;
+    queue_t active;             // Tasks in memory that were handed to the scheduler
+    queue_t swapped;            // Tasks swapped out, in the order they were swapped out
+    uint64_t device_free_ns;    // Time when the swap device finishes its queued transfers
+    swap_stats_t stats;
+} swap_t;
+
+/**
+ * @brief Parse a configuration like "LARGEST" or "LRU,2"
+ *
+ * The fields are: victim policy and swap transfer time per page in ms.
+ *
+ * @param spec The configuration string
+ * @param config Where to store the configuration
+ * @return 0 on success, -1 if the configuration is invalid
+ */
+int swap_parse_config(const char *spec, swap_config_t *config);
+
+/**
+ * @brief Create the medium-term scheduler state
+ *
+ * @return The state, or NULL on failure
+ */
+swap_t *swap_create(const swap_config_t *config);
+
+/**
+ * @brief Free the medium-term scheduler state (the tasks are not freed)
+ */
+void swap_destroy(swap_t *swap);
+
+/**
+ * @brief Track a task that was handed to the scheduler
+ */
+void swap_track(swap_t *swap, pcb_t *task);
+
+/**
+ * @brief Stop tracking a task that finished its burst
+ */
+void swap_untrack(swap_t *swap, pcb_t *task);
+
+/**
+ * @brief Swap processes out while memory is overcommitted, and back in when they fit
+ *
+ * @param s The scheduler, with virtual memory
+ * @param current_time_ns The current time in nanoseconds
+ */
+void swap_balance(struct scheduler_st *s, uint64_t current_time_ns);
+
+/**
+ * @brief Print the configuration and the counters
+ */
+void swap_print_stats(const swap_t *swap, FILE *out, const char *label);
+
+#endif //SWAP_H
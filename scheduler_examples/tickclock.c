@@ -0,0 +1,65 @@
+#include "tickclock.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "msg.h"
+
+static void add_ns(struct timespec *ts, uint64_t ns) {
+    ns += (uint64_t) ts->tv_nsec;
+    ts->tv_sec += (time_t) (ns / NS_PER_S);
+    ts->tv_nsec = (long) (ns % NS_PER_S);
+}
+
+int tickclock_start(tickclock_t *clock, uint64_t tick_ns) {
+    clock->tick_ns = tick_ns;
+    clock->owed = 0;
+    clock->caught_up = 0;
+    clock->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (clock->fd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &clock->deadline);
+    struct itimerspec spec = {
+        .it_interval = {.tv_sec = (time_t) (tick_ns / NS_PER_S), .tv_nsec = (long) (tick_ns % NS_PER_S)},
+        .it_value = clock->deadline
+    };
+    add_ns(&spec.it_value, tick_ns);
+    if (timerfd_settime(clock->fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        perror("timerfd_settime");
+        close(clock->fd);
+        clock->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int tickclock_wait(tickclock_t *clock) {
+    add_ns(&clock->deadline, clock->tick_ns);
+    if (clock->owed > 0) {
+        clock->owed--;
+        clock->caught_up++;
+    } else {
+        uint64_t expirations;
+        ssize_t n;
+        while ((n = read(clock->fd, &expirations, sizeof(expirations))) < 0 && errno == EINTR) {
+            // Interrupted by a signal (SIGUSR1), wait again
+        }
+        if (n != sizeof(expirations)) {
+            perror("read timerfd");
+            return -1;
+        }
+        clock->owed = expirations - 1;
+    }
+    return 0;
+}
+
+void tickclock_stop(tickclock_t *clock) {
+    if (clock->fd >= 0) {
+        close(clock->fd);
+        clock->fd = -1;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef TICKCLOCK_H
+#define TICKCLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Wall-clock pacing of the simulation.
+ *
+ * A periodic timerfd on CLOCK_MONOTONIC expires at absolute deadlines, start + k
+ * * tick, so the time spent working in a tick (or a late wake-up) is never added
+ * to the period: the simulation does not drift behind real time. When a tick
+ * overruns, the expirations missed are counted by the kernel and the following
+ * ticks run without waiting until the simulation caught up.
+ */
+
+// Define the tick clock
+typedef struct {
+    int fd;                     // timerfd
+    uint64_t tick_ns;
+    uint64_t owed;              // Expirations not yet turned into ticks
+    uint64_t caught_up;         // Ticks run without waiting
+    struct timespec deadline;   // Deadline of the last tick waited for
+} tickclock_t;
+
+/**
+ * @brief Arm the timer, the first tick ends one tick from now
+ *
+ * @param clock The clock to initialize
+ * @param tick_ns Length of a tick
+ * @return 0 on success, -1 on failure
+ */
+int tickclock_start(tickclock_t *clock, uint64_t tick_ns);
+
+/**
+ * @brief Wait for the deadline of the next tick (return at once if it already passed)
+ *
+ * @param clock The clock, its deadline is the one waited for on return
+ * @return 0 on success, -1 on failure
+ */
+int tickclock_wait(tickclock_t *clock);
+
+/**
+ * @brief Disarm and close the timer
+ */
+void tickclock_stop(tickclock_t *clock);
+
+#endif //TICKCLOCK_H
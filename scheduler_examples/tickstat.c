@@ -0,0 +1,63 @@
+#include "tickstat.h"
+
+#include <string.h>
+
+static uint64_t elapsed_ns(const struct timespec *from, const struct timespec *to) {
+    return (uint64_t) ((int64_t) (to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec));
+}
+
+void tickstat_init(tickstat_t *ts, uint64_t budget_ns) {
+    memset(ts, 0, sizeof(tickstat_t));
+    ts->budget_ns = budget_ns;
+    clock_gettime(CLOCK_MONOTONIC, &ts->start);
+}
+
+void tickstat_begin(tickstat_t *ts) {
+    clock_gettime(CLOCK_MONOTONIC, &ts->tick_start);
+    ts->mark = ts->tick_start;
+}
+
+void tickstat_phase(tickstat_t *ts, tick_phase_en phase) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    histogram_record(&ts->phases[phase], elapsed_ns(&ts->mark, &now));
+    ts->mark = now;
+}
+
+void tickstat_end_work(tickstat_t *ts) {
+    uint64_t work_ns = elapsed_ns(&ts->tick_start, &ts->mark);
+    histogram_record(&ts->phases[TICK_PHASE_WORK], work_ns);
+    if (work_ns > ts->budget_ns) {
+        ts->overruns++;
+    }
+}
+
+void tickstat_slept(tickstat_t *ts, const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t late_ns = (int64_t) elapsed_ns(deadline, &now);
+    histogram_record(&ts->phases[TICK_PHASE_SLEEP], late_ns > 0 ? (uint64_t) late_ns : 0);
+}
+
+void tickstat_print(const tickstat_t *ts, FILE *out, uint64_t simulated_ns) {
+    fprintf(out, "Tick phases (us)      mean        p50        p90        p99      p99.9        max\n");
+    for (int p = 0; p < TICK_NUM_PHASES; p++) {
+        const histogram_t *h = &ts->phases[p];
+        if (h->total == 0) continue;
+        fprintf(out, "  %-10s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", TICK_PHASE_STRINGS[p],
+                histogram_mean(h) / 1000.0,
+                (double) histogram_percentile(h, 50.0) / 1000.0,
+                (double) histogram_percentile(h, 90.0) / 1000.0,
+                (double) histogram_percentile(h, 99.0) / 1000.0,
+                (double) histogram_percentile(h, 99.9) / 1000.0,
+                (double) h->max / 1000.0);
+    }
+    uint64_t ticks = ts->phases[TICK_PHASE_WORK].total;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall_ms = (double) elapsed_ns(&ts->start, &now) / 1e6;
+    fprintf(out, "Ticks: %llu, overruns (work > %.1f us): %llu (%.2f%%), wall clock %.0f ms for %.0f simulated ms\n",
+            (unsigned long long) ticks, (double) ts->budget_ns / 1000.0,
+            (unsigned long long) ts->overruns, ticks ? 100.0 * (double) ts->overruns / (double) ticks : 0.0,
+            wall_ms, (double) simulated_ns / 1e6);
+}
@@ -0,0 +1,90 @@
+#ifndef TICKSTAT_H
+#define TICKSTAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "histogram.h"
+
+/*
+ * Main loop instrumentation.
+ *
+ * Every tick of the simulator has a budget of one tick of wall-clock time. The
+ * phases of the main loop are timed with the monotonic clock into histograms,
+ * and a tick whose work does not fit in the budget is counted as an overrun:
+ * the simulation then runs slower than real time. This shows which part of the
+ * simulator stops scaling first when the number of processes grows.
+ */
+
+// Define the timed phases of a tick
+typedef enum {
+    TICK_PHASE_COMMANDS = 0,    // Accept connections and read the requests
+    TICK_PHASE_BLOCKED,         // Timers and I/O devices
+    TICK_PHASE_SCHEDULER,       // Ready queue(s) and CPUs
+    TICK_PHASE_REPLIES,         // Submit the replies and publish the metrics
+    TICK_PHASE_WORK,            // All of the above
+    TICK_PHASE_SLEEP,           // Wake-up time past the deadline of the tick
+    TICK_NUM_PHASES
+} tick_phase_en;
+
+static const char TICK_PHASE_STRINGS[][10] = {
+    "commands",
+    "blocked",
+    "scheduler",
+    "replies",
+    "work",
+    "lateness"
+};
+
+// Define the instrumentation of the main loop
+typedef struct {
+    histogram_t phases[TICK_NUM_PHASES];    // Durations in ns
+    uint64_t budget_ns;                     // Wall-clock time of a tick
+    uint64_t overruns;                      // Ticks whose work exceeded the budget
+    struct timespec start;                  // First tick
+    struct timespec tick_start;             // Current tick
+    struct timespec mark;                   // End of the last timed phase
+} tickstat_t;
+
+/**
+ * @brief Initialize the instrumentation
+ *
+ * @param ts The instrumentation
+ * @param budget_ns Wall-clock time of a tick
+ */
+void tickstat_init(tickstat_t *ts, uint64_t budget_ns);
+
+/**
+ * @brief Mark the start of a tick
+ */
+void tickstat_begin(tickstat_t *ts);
+
+/**
+ * @brief Record the duration of a phase, from the end of the previous one (or the start of the tick)
+ */
+void tickstat_phase(tickstat_t *ts, tick_phase_en phase);
+
+/**
+ * @brief Record the work of the tick, once its last phase ended, and count an overrun
+ */
+void tickstat_end_work(tickstat_t *ts);
+
+/**
+ * @brief Record how late past its deadline the sleep at the end of the tick woke up
+ *
+ * @param ts The instrumentation
+ * @param deadline The absolute (CLOCK_MONOTONIC) deadline of the tick
+ */
+void tickstat_slept(tickstat_t *ts, const struct timespec *deadline);
+
+/**
+ * @brief Print the histograms, the overruns and how far the simulation is behind real time
+ *
+ * @param ts The instrumentation
+ * @param out The stream to print to
+ * @param simulated_ns The simulated time
+ */
+void tickstat_print(const tickstat_t *ts, FILE *out, uint64_t simulated_ns);
+
+#endif //TICKSTAT_H
@@ -0,0 +1,166 @@
+#include "tickvec.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TICKVEC_X86 1
+#endif
+
+typedef void (*advance_fn)(uint64_t *, const uint64_t *, const uint64_t *, uint32_t, uint64_t *);
+typedef uint32_t (*countdown_fn)(uint64_t *, uint32_t, uint64_t, uint64_t *);
+
+static uint32_t word_end(uint32_t w, uint32_t n) {
+    return n - w * 64 < 64 ? n : (w + 1) * 64;
+}
+
+static void advance_scalar(uint64_t *elapsed, const uint64_t *add, const uint64_t *limit, uint32_t n, uint64_t *finished) {
+    uint32_t i = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(n); w++) {
+        uint64_t bits = 0;
+        for (uint32_t end = word_end(w, n); i < end; i++) {
+            elapsed[i] += add[i];
+            bits |= (uint64_t) (elapsed[i] >= limit[i]) << (i % 64);
+        }
+        finished[w] = bits;
+    }
+}
+
+static uint32_t countdown_scalar(uint64_t *remaining, uint32_t n, uint64_t tick, uint64_t *finished) {
+    uint32_t done = 0;
+    uint32_t i = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(n); w++) {
+        uint64_t bits = 0;
+        for (uint32_t end = word_end(w, n); i < end; i++) {
+            remaining[i] = remaining[i] > tick ? remaining[i] - tick : 0;
+            bits |= (uint64_t) (remaining[i] == 0) << (i % 64);
+        }
+        finished[w] = bits;
+        done += (uint32_t) __builtin_popcountll(bits);
+    }
+    return done;
+}
+
+#ifdef TICKVEC_X86
+// There is no unsigned 64-bit compare: flipping the sign bits makes the signed one give the same order
+
+__attribute__((target("sse4.2,popcnt")))
+static uint32_t countdown_sse42(uint64_t *remaining, uint32_t n, uint64_t tick, uint64_t *finished) {
+    const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+    const __m128i t = _mm_set1_epi64x((int64_t) tick);
+    const __m128i t_signed = _mm_xor_si128(t, sign);
+    uint32_t done = 0;
+    uint32_t i = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(n); w++) {
+        uint64_t bits = 0;
+        uint32_t end = word_end(w, n);
+        for (; i + 2 <= end; i += 2) {
+            __m128i r = _mm_loadu_si128((const __m128i *) (remaining + i));
+            __m128i above = _mm_cmpgt_epi64(_mm_xor_si128(r, sign), t_signed);
+            _mm_storeu_si128((__m128i *) (remaining + i), _mm_and_si128(_mm_sub_epi64(r, t), above));
+            bits |= (uint64_t) (~_mm_movemask_pd(_mm_castsi128_pd(above)) & 0x3) << (i % 64);
+        }
+        for (; i < end; i++) {
+            remaining[i] = remaining[i] > tick ? remaining[i] - tick : 0;
+            bits |= (uint64_t) (remaining[i] == 0) << (i % 64);
+        }
+        finished[w] = bits;
+        done += (uint32_t) __builtin_popcountll(bits);
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static void advance_avx2(uint64_t *elapsed, const uint64_t *add, const uint64_t *limit, uint32_t n, uint64_t *finished) {
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    uint32_t i = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(n); w++) {
+        uint64_t bits = 0;
+        uint32_t end = word_end(w, n);
+        for (; i + 4 <= end; i += 4) {
+            __m256i e = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *) (elapsed + i)),
+                                         _mm256_loadu_si256((const __m256i *) (add + i)));
+            _mm256_storeu_si256((__m256i *) (elapsed + i), e);
+            __m256i l = _mm256_loadu_si256((const __m256i *) (limit + i));
+            __m256i below = _mm256_cmpgt_epi64(_mm256_xor_si256(l, sign), _mm256_xor_si256(e, sign));
+            bits |= (uint64_t) (~_mm256_movemask_pd(_mm256_castsi256_pd(below)) & 0xf) << (i % 64);
+        }
+        for (; i < end; i++) {
+            elapsed[i] += add[i];
+            bits |= (uint64_t) (elapsed[i] >= limit[i]) << (i % 64);
+        }
+        finished[w] = bits;
+    }
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint32_t countdown_avx2(uint64_t *remaining, uint32_t n, uint64_t tick, uint64_t *finished) {
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i t = _mm256_set1_epi64x((int64_t) tick);
+    const __m256i t_signed = _mm256_xor_si256(t, sign);
+    uint32_t done = 0;
+    uint32_t i = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(n); w++) {
+        uint64_t bits = 0;
+        uint32_t end = word_end(w, n);
+        for (; i + 4 <= end; i += 4) {
+            __m256i r = _mm256_loadu_si256((const __m256i *) (remaining + i));
+            __m256i above = _mm256_cmpgt_epi64(_mm256_xor_si256(r, sign), t_signed);
+            _mm256_storeu_si256((__m256i *) (remaining + i), _mm256_and_si256(_mm256_sub_epi64(r, t), above));
+            bits |= (uint64_t) (~_mm256_movemask_pd(_mm256_castsi256_pd(above)) & 0xf) << (i % 64);
+        }
+        for (; i < end; i++) {
+            remaining[i] = remaining[i] > tick ? remaining[i] - tick : 0;
+            bits |= (uint64_t) (remaining[i] == 0) << (i % 64);
+        }
+        finished[w] = bits;
+        done += (uint32_t) __builtin_popcountll(bits);
+    }
+    return done;
+}
+#endif
+
+static advance_fn advance_impl = advance_scalar;
+static countdown_fn countdown_impl = countdown_scalar;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static tickvec_isa_en apply_isa(tickvec_isa_en max) {
+    tickvec_isa_en isa = TICKVEC_SCALAR;
+    advance_impl = advance_scalar;
+    countdown_impl = countdown_scalar;
+#ifdef TICKVEC_X86
+    __builtin_cpu_init();
+    if (max >= TICKVEC_AVX2 && __builtin_cpu_supports("avx2")) {
+        isa = TICKVEC_AVX2;
+        advance_impl = advance_avx2;
+        countdown_impl = countdown_avx2;
+    } else if (max >= TICKVEC_SSE42 && __builtin_cpu_supports("sse4.2")) {
+        // advance stays scalar: two tasks per compare do not pay for the sign flips and the
+        // mask, and it only runs over the CPUs, the sleepers are where the time goes
+        isa = TICKVEC_SSE42;
+        countdown_impl = countdown_sse42;
+    }
+#else
+    (void) max;
+#endif
+    return isa;
+}
+
+static void select_best(void) {
+    apply_isa(TICKVEC_AVX2);
+}
+
+tickvec_isa_en tickvec_select(tickvec_isa_en max) {
+    pthread_once(&select_once, select_best);
+    return apply_isa(max);
+}
+
+void tickvec_advance(uint64_t *elapsed, const uint64_t *add, const uint64_t *limit, uint32_t n, uint64_t *finished) {
+    pthread_once(&select_once, select_best);
+    advance_impl(elapsed, add, limit, n, finished);
+}
+
+uint32_t tickvec_countdown(uint64_t *remaining, uint32_t n, uint64_t tick, uint64_t *finished) {
+    pthread_once(&select_once, select_best);
+    return countdown_impl(remaining, n, tick, finished);
+}
@@ -0,0 +1,71 @@
+#ifndef TICKVEC_H
+#define TICKVEC_H
+
+#include <stdint.h>
+
+/*
+ * Per-tick accounting kernels.
+ *
+ * Every tick, time is added to each running task and taken from each sleeping
+ * task, and the ones that reached the end of their burst or of their wait are
+ * picked out. With the times in arrays (one array per field, the same index for
+ * the same task) this is a loop the CPU can do 2 or 4 tasks at a time: the
+ * kernels below use AVX2 or SSE4.2 when the host has them, chosen once at run
+ * time, and plain C otherwise. The advance kernel has no SSE4.2 version, it is
+ * slower than plain C there. The tasks that finished are returned as a bitmask,
+ * bit i of word i / 64 for task i, so the caller only visits those.
+ */
+
+// Define the instruction sets of the kernels
+typedef enum {
+    TICKVEC_SCALAR = 0,
+    TICKVEC_SSE42,
+    TICKVEC_AVX2,
+} tickvec_isa_en;
+
+static const char TICKVEC_ISA_STRINGS[][8] = {
+    "scalar",
+    "SSE4.2",
+    "AVX2"
+};
+
+// Number of mask words for n tasks
+#define TICKVEC_MASK_WORDS(n) (((n) + 63) / 64)
+
+/**
+ * @brief Choose the best instruction set the host supports, up to a limit
+ *
+ * Called implicitly by the kernels the first time; call it to compare the kernels.
+ *
+ * @param max The best instruction set allowed
+ * @return The instruction set in use
+ */
+tickvec_isa_en tickvec_select(tickvec_isa_en max);
+
+/**
+ * @brief Add time to running tasks and find those at the end of their burst
+ *
+ * elapsed[i] += add[i], and bit i of finished is set if elapsed[i] >= limit[i].
+ *
+ * @param elapsed Time used by each task
+ * @param add Time to add to each task
+ * @param limit Time requested by each task (UINT64_MAX for a slot without a task)
+ * @param n Number of tasks
+ * @param finished Bitmask of TICKVEC_MASK_WORDS(n) words, overwritten
+ */
+void tickvec_advance(uint64_t *elapsed, const uint64_t *add, const uint64_t *limit, uint32_t n, uint64_t *finished);
+
+/**
+ * @brief Take a tick from sleeping tasks and find those whose wait is over
+ *
+ * remaining[i] -= tick, stopping at 0, and bit i of finished is set if it reached 0.
+ *
+ * @param remaining Time left to wait by each task
+ * @param n Number of tasks
+ * @param tick Time to take from each task
+ * @param finished Bitmask of TICKVEC_MASK_WORDS(n) words, overwritten
+ * @return The number of tasks whose wait is over
+ */
+uint32_t tickvec_countdown(uint64_t *remaining, uint32_t n, uint64_t tick, uint64_t *finished);
+
+#endif //TICKVEC_H
@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msg.h"
+#include "queue.h"
+#include "tickvec.h"
+
+/*
+ * Run like: ./tickvec_bench [-n tasks] [-t ticks]
+ *
+ * Times the per-tick accounting kernels on every instruction set the host has:
+ * taking a tick from many sleeping tasks (tickvec_countdown) and adding a tick to
+ * many running tasks (tickvec_advance). For reference, the countdown is also done
+ * the way the blocked queue did it before, one PCB of a linked queue at a time.
+ * The waits are long enough that few tasks wake, as in a large population. All
+ * the kernels must give the same times and masks.
+ */
+
+#define BENCH_TICK_NS (10 * NS_PER_MS)
+
+// Define the outcome of one kernel
+typedef struct {
+    double ns_per_task;         // Per task and per tick
+    uint64_t checksum;          // Of the times and masks, must be the same for every kernel
+} bench_result_t;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+static void fill_times(uint64_t *times, uint32_t n, uint64_t max_ns) {
+    uint64_t seed = 42;
+    for (uint32_t i = 0; i < n; i++) {
+        times[i] = next_random(&seed) % max_ns;
+    }
+}
+
+static uint64_t checksum(const uint64_t *times, uint32_t n, uint64_t mask_sum) {
+    uint64_t sum = mask_sum;
+    for (uint32_t i = 0; i < n; i++) {
+        sum = sum * 31 + times[i];
+    }
+    return sum;
+}
+
+static uint64_t sum_mask(const uint64_t *mask, uint32_t n) {
+    uint64_t sum = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(n); w++) {
+        sum += mask[w] * (w + 1);
+    }
+    return sum;
+}
+
+static bench_result_t run_countdown(uint64_t *remaining, uint64_t *mask, uint32_t n, uint32_t ticks) {
+    fill_times(remaining, n, (uint64_t) ticks * 100 * BENCH_TICK_NS);
+    bench_result_t result = {0};
+    uint64_t mask_sum = 0;
+    double start = monotonic_s();
+    for (uint32_t t = 0; t < ticks; t++) {
+        mask_sum += tickvec_countdown(remaining, n, BENCH_TICK_NS, mask);
+        mask_sum += sum_mask(mask, n);
+    }
+    result.ns_per_task = (monotonic_s() - start) * 1e9 / ((double) n * ticks);
+    result.checksum = checksum(remaining, n, mask_sum);
+    return result;
+}
+
+static bench_result_t run_advance(uint64_t *elapsed, uint64_t *add, uint64_t *limit, uint64_t *mask,
+                                  uint32_t n, uint32_t ticks) {
+    memset(elapsed, 0, n * sizeof(uint64_t));
+    fill_times(limit, n, (uint64_t) ticks * 100 * BENCH_TICK_NS);
+    for (uint32_t i = 0; i < n; i++) {
+        add[i] = BENCH_TICK_NS - i % 3;
+    }
+    bench_result_t result = {0};
+    uint64_t mask_sum = 0;
+    double start = monotonic_s();
+    for (uint32_t t = 0; t < ticks; t++) {
+        tickvec_advance(elapsed, add, limit, n, mask);
+        mask_sum += sum_mask(mask, n);
+    }
+    result.ns_per_task = (monotonic_s() - start) * 1e9 / ((double) n * ticks);
+    result.checksum = checksum(elapsed, n, mask_sum);
+    return result;
+}
+
+/**
+ * @brief The countdown as the linked blocked queue did it, a PCB at a time
+ */
+static bench_result_t run_linked(pcb_t **tasks, uint32_t n, uint32_t ticks) {
+    uint64_t *times = malloc(n * sizeof(uint64_t));
+    if (!times) return (bench_result_t) {0};
+    fill_times(times, n, (uint64_t) ticks * 100 * BENCH_TICK_NS);
+    queue_t q = {.head = NULL, .tail = NULL};
+    for (uint32_t i = 0; i < n; i++) {
+        tasks[i]->time_ns = times[i];
+        enqueue_pcb(&q, tasks[i]);
+    }
+    bench_result_t result = {0};
+    double start = monotonic_s();
+    for (uint32_t t = 0; t < ticks; t++) {
+        for (queue_elem_t *elem = q.head; elem != NULL; elem = elem->next) {
+            pcb_t *pcb = elem->pcb;
+            pcb->time_ns = pcb->time_ns > BENCH_TICK_NS ? pcb->time_ns - BENCH_TICK_NS : 0;
+            result.checksum += pcb->time_ns == 0;
+        }
+    }
+    result.ns_per_task = (monotonic_s() - start) * 1e9 / ((double) n * ticks);
+    while (dequeue_pcb(&q) != NULL) { }
+    free(times);
+    return result;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n tasks] [-t ticks]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 1000000;
+    uint32_t ticks = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (parse_uint(optarg, &n) < 0) exit(EXIT_FAILURE);
+                break;
+            case 't':
+                if (parse_uint(optarg, &ticks) < 0) exit(EXIT_FAILURE);
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t *elapsed = malloc(n * sizeof(uint64_t));
+    uint64_t *add = malloc(n * sizeof(uint64_t));
+    uint64_t *limit = malloc(n * sizeof(uint64_t));
+    uint64_t *mask = malloc(TICKVEC_MASK_WORDS(n) * sizeof(uint64_t));
+    pcb_t **tasks = malloc(n * sizeof(pcb_t *));
+    pcb_table_t table = {0};
+    if (!elapsed || !add || !limit || !mask || !tasks) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        tasks[i] = new_pcb(&table, (int32_t) i + 1, 0, 0);
+        if (!tasks[i]) {
+            perror("new_pcb");
+            return EXIT_FAILURE;
+        }
+    }
+    printf("%u tasks, %u ticks, ns per task and tick\n", n, ticks);
+    printf("%-8s %10s %10s\n", "", "countdown", "advance");
+
+    bench_result_t linked = run_linked(tasks, n, ticks);
+    printf("%-8s %10.3f %10s\n", "linked", linked.ns_per_task, "-");
+
+    int consistent = 1;
+    bench_result_t first_countdown = {0};
+    bench_result_t first_advance = {0};
+    for (int isa = TICKVEC_SCALAR; isa <= TICKVEC_AVX2; isa++) {
+        if (tickvec_select((tickvec_isa_en) isa) != (tickvec_isa_en) isa) continue;
+        bench_result_t countdown = run_countdown(elapsed, mask, n, ticks);
+        if (isa == TICKVEC_SSE42) {
+            // advance has no SSE4.2 kernel, it runs the scalar one already timed
+            printf("%-8s %10.3f %10s\n", TICKVEC_ISA_STRINGS[isa], countdown.ns_per_task, "-");
+            if (countdown.checksum != first_countdown.checksum) consistent = 0;
+            continue;
+        }
+        bench_result_t advance = run_advance(elapsed, add, limit, mask, n, ticks);
+        printf("%-8s %10.3f %10.3f\n", TICKVEC_ISA_STRINGS[isa], countdown.ns_per_task, advance.ns_per_task);
+        if (isa == TICKVEC_SCALAR) {
+            first_countdown = countdown;
+            first_advance = advance;
+        } else if (countdown.checksum != first_countdown.checksum || advance.checksum != first_advance.checksum) {
+            consistent = 0;
+        }
+    }
+    printf("Kernels: %s\n", consistent ? "identical" : "DIFFERENT");
+
+    pcb_table_free(&table);
+    free(tasks);
+    free(elapsed);
+    free(add);
+    free(limit);
+    free(mask);
+    return consistent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,67 @@
+#include "timerset.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tickvec.h"
+
+int timer_set_add(timer_set_t *ts, pcb_t *task, uint64_t wait_ns) {
+    if (ts->count == ts->capacity) {
+        uint32_t capacity = ts->capacity ? ts->capacity * 2 : 64;
+        uint64_t *remaining_ns = realloc(ts->remaining_ns, capacity * sizeof(uint64_t));
+        if (!remaining_ns) return -1;
+        ts->remaining_ns = remaining_ns;
+        pcb_t **tasks = realloc(ts->tasks, capacity * sizeof(pcb_t *));
+        if (!tasks) return -1;
+        ts->tasks = tasks;
+        uint64_t *finished = realloc(ts->finished, TICKVEC_MASK_WORDS(capacity) * sizeof(uint64_t));
+        if (!finished) return -1;
+        ts->finished = finished;
+        ts->capacity = capacity;
+    }
+    ts->remaining_ns[ts->count] = wait_ns;
+    ts->tasks[ts->count] = task;
+    ts->count++;
+    return 0;
+}
+
+uint32_t timer_set_tick(timer_set_t *ts, uint64_t tick_ns, queue_t *woken) {
+    if (ts->count == 0) return 0;
+    uint32_t done = tickvec_countdown(ts->remaining_ns, ts->count, tick_ns, ts->finished);
+    if (done == 0) return 0;
+    // Close the gaps in place, keeping the order of the tasks still sleeping
+    uint32_t kept = 0;
+    for (uint32_t w = 0; w < TICKVEC_MASK_WORDS(ts->count); w++) {
+        uint32_t base = w * 64;
+        uint32_t len = ts->count - base < 64 ? ts->count - base : 64;
+        uint64_t bits = ts->finished[w];
+        if (bits == 0) {
+            // Nobody woke in these 64 tasks, they move as a block
+            if (kept != base) {
+                memmove(&ts->remaining_ns[kept], &ts->remaining_ns[base], len * sizeof(uint64_t));
+                memmove(&ts->tasks[kept], &ts->tasks[base], len * sizeof(pcb_t *));
+            }
+            kept += len;
+            continue;
+        }
+        for (uint32_t i = base; i < base + len; i++) {
+            if (bits & (1ULL << (i % 64))) {
+                ts->tasks[i]->time_ns = 0;
+                enqueue_pcb(woken, ts->tasks[i]);
+            } else {
+                ts->remaining_ns[kept] = ts->remaining_ns[i];
+                ts->tasks[kept] = ts->tasks[i];
+                kept++;
+            }
+        }
+    }
+    ts->count = kept;
+    return done;
+}
+
+void timer_set_free(timer_set_t *ts) {
+    free(ts->remaining_ns);
+    free(ts->tasks);
+    free(ts->finished);
+    memset(ts, 0, sizeof(timer_set_t));
+}
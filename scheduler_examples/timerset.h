@@ -0,0 +1,54 @@
+#ifndef TIMERSET_H
+#define TIMERSET_H
+
+#include <stdint.h>
+
+#include "queue.h"
+
+/*
+ * Tasks blocked on a timer (BLOCK requests that are not for an I/O device).
+ *
+ * Every tick takes a tick from the time left to every sleeping task. The times
+ * are kept in an array of their own, apart from the PCBs, so the tick is a single
+ * vectorized pass over contiguous memory (tickvec_countdown) instead of a visit
+ * to every PCB; only the tasks whose wait is over are then looked at.
+ */
+
+// Define a set of sleeping tasks, the same index in both arrays is the same task
+typedef struct {
+    uint64_t *remaining_ns;     // Time left to wait
+    pcb_t **tasks;
+    uint64_t *finished;         // Mask of the tasks woken by the last tick
+    uint32_t count;
+    uint32_t capacity;
+} timer_set_t;
+
+/**
+ * @brief Put a task to sleep
+ *
+ * @param ts The timer set
+ * @param task The task
+ * @param wait_ns How long the task sleeps (a task sleeping 0 wakes on the next tick)
+ * @return 0 on success, -1 if there is no memory
+ */
+int timer_set_add(timer_set_t *ts, pcb_t *task, uint64_t wait_ns);
+
+/**
+ * @brief Advance the sleeping tasks by one tick
+ *
+ * The tasks whose wait is over leave the set and are appended to a queue, in the
+ * order they were put to sleep, with their time_ns set to 0.
+ *
+ * @param ts The timer set
+ * @param tick_ns The length of the tick
+ * @param woken The queue the woken tasks are appended to
+ * @return The number of tasks woken
+ */
+uint32_t timer_set_tick(timer_set_t *ts, uint64_t tick_ns, queue_t *woken);
+
+/**
+ * @brief Free the arrays of a timer set (the PCBs are not freed)
+ */
+void timer_set_free(timer_set_t *ts);
+
+#endif //TIMERSET_H
@@ -0,0 +1,66 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msg.h"
+
+int trace_init(trace_t *trace, uint32_t capacity) {
+    uint32_t size = 1;
+    while (size < capacity && size < (1u << 31)) {
+        size <<= 1;
+    }
+    trace->records = calloc(size, sizeof(trace_record_t));
+    if (!trace->records) {
+        perror("calloc");
+        return -1;
+    }
+    trace->mask = size - 1;
+    trace->head = 0;
+    return 0;
+}
+
+void trace_free(trace_t *trace) {
+    free(trace->records);
+    trace->records = NULL;
+}
+
+int trace_save(const trace_t *trace, const char *path, uint32_t ncpus, uint64_t tick_ns) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror("fopen");
+        return -1;
+    }
+    uint64_t capacity = (uint64_t) trace->mask + 1;
+    uint64_t first = trace->head > capacity ? trace->head - capacity : 0;
+    trace_header_t header = {
+        .version = TRACE_VERSION,
+        .ncpus = ncpus,
+        .tick_ns = tick_ns,
+        .count = trace->head - first,
+        .dropped = first,
+    };
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+
+    int status = 0;
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        status = -1;
+    }
+    // The ring is written in (at most) two parts: from the oldest record to the end, then from the start
+    uint64_t start = first & trace->mask;
+    uint64_t first_part = header.count < capacity - start ? header.count : capacity - start;
+    if (status == 0 && fwrite(&trace->records[start], sizeof(trace_record_t), first_part, file) != first_part) {
+        status = -1;
+    }
+    uint64_t second_part = header.count - first_part;
+    if (status == 0 && second_part > 0 &&
+        fwrite(trace->records, sizeof(trace_record_t), second_part, file) != second_part) {
+        status = -1;
+    }
+    if (status < 0) {
+        perror("fwrite");
+    }
+    fclose(file);
+    return status;
+}
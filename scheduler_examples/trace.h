@@ -0,0 +1,120 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Low-overhead event tracer.
+ *
+ * Scheduling events are written as fixed-size binary records into a ring buffer
+ * that is allocated once. Recording an event is a handful of stores, so the
+ * tracer stays on in release builds (unlike DBG). When the ring is full the
+ * oldest events are overwritten. The ring can be saved to a file and converted
+ * to the Chrome trace format with trace2json.
+ */
+
+#define TRACE_MAGIC "OSTR"
+#define TRACE_VERSION 2
+#define TRACE_DEFAULT_CAPACITY (1u << 16)
+#define TRACE_NO_CPU 0xFF
+
+// Define the traced events
+typedef enum {
+    TRACE_DISPATCH = 0,         // Task put on a CPU
+    TRACE_PREEMPT,              // Task taken off a CPU before finishing its burst
+    TRACE_BURST_END,            // Task left a CPU because its burst finished
+    TRACE_BLOCK,                // Task requested to block for arg ms
+    TRACE_WAKE,                 // Task finished blocking
+    TRACE_ACK,                  // ACK sent to the application
+    TRACE_DONE,                 // DONE sent to the application
+    TRACE_PAGE_FAULT,           // Task blocked arg ms for page faults when put on a CPU
+    TRACE_SWAP_OUT,             // Process swapped out, writing arg pages
+    TRACE_SWAP_IN,              // Process swapped in, reading arg pages
+    TRACE_IO_START,             // Device arg started serving the BLOCK request of the task
+    TRACE_NUM_EVENTS
+} trace_event_en;
+
+static const char TRACE_EVENT_STRINGS[][12] = {
+    "DISPATCH",
+    "PREEMPT",
+    "BURST_END",
+    "BLOCK",
+    "WAKE",
+    "ACK",
+    "DONE",
+    "PAGE_FAULT",
+    "SWAP_OUT",
+    "SWAP_IN",
+    "IO_START"
+};
+
+// Define a trace record (24 bytes)
+typedef struct {
+    uint64_t time_ns;           // Simulated time of the event
+    uint64_t arg;               // Event specific argument (e.g. requested time in ns)
+    int32_t pid;                // Task the event refers to
+    uint8_t event;              // trace_event_en
+    uint8_t cpu;                // CPU of the event (TRACE_NO_CPU if none)
+    uint16_t reserved;
+} trace_record_t;
+
+// Define the header of a saved trace
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t ncpus;
+    uint64_t tick_ns;
+    uint64_t count;             // Number of records in the file
+    uint64_t dropped;           // Number of older records overwritten in the ring
+} trace_header_t;
+
+// Define the ring buffer
+typedef struct {
+    trace_record_t *records;
+    uint32_t mask;              // Capacity - 1 (capacity is a power of 2)
+    uint64_t head;              // Number of events recorded since the start
+} trace_t;
+
+/**
+ * @brief Allocate the ring buffer
+ *
+ * @param trace The tracer
+ * @param capacity Number of records, rounded up to a power of 2
+ * @return 0 on success, -1 on failure
+ */
+int trace_init(trace_t *trace, uint32_t capacity);
+
+/**
+ * @brief Free the ring buffer
+ */
+void trace_free(trace_t *trace);
+
+/**
+ * @brief Save the events in the ring, oldest first, to a file
+ *
+ * @param trace The tracer
+ * @param path The file to write
+ * @param ncpus Number of simulated CPUs (stored in the header)
+ * @param tick_ns Length of a tick (stored in the header)
+ * @return 0 on success, -1 on failure
+ */
+int trace_save(const trace_t *trace, const char *path, uint32_t ncpus, uint64_t tick_ns);
+
+/**
+ * @brief Record an event
+ *
+ * Does nothing if the tracer is NULL.
+ */
+static inline void trace_event(trace_t *trace, uint64_t time_ns, trace_event_en event, uint8_t cpu,
+                               int32_t pid, uint64_t arg) {
+    if (!trace) return;
+    trace_record_t *record = &trace->records[trace->head++ & trace->mask];
+    record->time_ns = time_ns;
+    record->pid = pid;
+    record->arg = arg;
+    record->event = (uint8_t) event;
+    record->cpu = cpu;
+    record->reserved = 0;
+}
+
+#endif //TRACE_H
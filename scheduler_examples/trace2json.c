@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/*
+ * Run like: ./trace2json <trace.bin> [trace.json]
+ *
+ * Converts a trace saved by ossim (-t) to the Chrome trace event format, which
+ * can be opened in chrome://tracing or https://ui.perfetto.dev. Every simulated
+ * CPU is a track with a slice per task run, every task is a track with its blocked
+ * periods and its ACK/DONE messages.
+ */
+
+// Track ids in the trace viewer
+#define CPU_TRACK 0
+#define TASK_TRACK 1
+
+// Define the open interval of a CPU or a task
+typedef struct {
+    int32_t pid;
+    uint64_t start_ns;
+    uint64_t arg;
+    int open;
+    int named;                  // Track name already emitted (tasks only)
+} interval_t;
+
+// Define the tasks seen in the trace, with their open block interval
+typedef struct {
+    interval_t *items;
+    size_t count, cap;
+} task_list_t;
+
+static interval_t *find_task(task_list_t *tasks, int32_t pid) {
+    for (size_t i = 0; i < tasks->count; i++) {
+        if (tasks->items[i].pid == pid) return &tasks->items[i];
+    }
+    if (tasks->count == tasks->cap) {
+        size_t new_cap = tasks->cap ? tasks->cap * 2 : 64;
+        interval_t *tmp = realloc(tasks->items, new_cap * sizeof(interval_t));
+        if (!tmp) return NULL;
+        tasks->items = tmp;
+        tasks->cap = new_cap;
+    }
+    interval_t *task = &tasks->items[tasks->count++];
+    memset(task, 0, sizeof(interval_t));
+    task->pid = pid;
+    return task;
+}
+
+static int first_event = 1;
+
+static void begin_event(FILE *out) {
+    fputs(first_event ? "\n" : ",\n", out);
+    first_event = 0;
+}
+
+// The trace event format counts in microseconds, with decimals
+static void emit_slice(FILE *out, const char *name, int32_t name_pid, int track, int tid,
+                       uint64_t start_ns, uint64_t end_ns, const char *arg_name, uint64_t arg) {
+    begin_event(out);
+    fprintf(out, "{\"name\":\"%s %d\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                 "\"args\":{\"%s\":%llu}}",
+            name, name_pid, (double) start_ns / 1000.0, (double) (end_ns - start_ns) / 1000.0,
+            track, tid, arg_name, (unsigned long long) arg);
+}
+
+static void emit_instant(FILE *out, const trace_record_t *record) {
+    begin_event(out);
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%llu}}",
+            TRACE_EVENT_STRINGS[record->event], (double) record->time_ns / 1000.0,
+            TASK_TRACK, record->pid, (unsigned long long) record->arg);
+}
+
+static void emit_name(FILE *out, const char *kind, int track, int tid, const char *name) {
+    begin_event(out);
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,", kind, track);
+    if (tid >= 0) fprintf(out, "\"tid\":%d,", tid);
+    fprintf(out, "\"args\":{\"name\":\"%s\"}}", name);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        printf("Usage: %s <trace.bin> [trace.json]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    trace_header_t header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_VERSION) {
+        fprintf(stderr, "%s is not a trace file (or has an unsupported version)\n", argv[1]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    if (header.ncpus > 255) header.ncpus = 255;
+    FILE *out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (!out) {
+            perror("fopen");
+            fclose(in);
+            return EXIT_FAILURE;
+        }
+    }
+    if (header.dropped > 0) {
+        fprintf(stderr, "Warning: the ring overflowed, the first %llu events are missing\n",
+                (unsigned long long) header.dropped);
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+    char name[32];
+    emit_name(out, "process_name", CPU_TRACK, -1, "CPUs");
+    emit_name(out, "process_name", TASK_TRACK, -1, "Tasks");
+    for (uint32_t cpu = 0; cpu < header.ncpus; cpu++) {
+        snprintf(name, sizeof(name), "CPU %u", cpu);
+        emit_name(out, "thread_name", CPU_TRACK, (int) cpu, name);
+    }
+
+    interval_t cpus[256] = {0};
+    task_list_t tasks = {0};
+    trace_record_t record;
+    uint64_t last_time_ns = 0;
+    uint64_t count = 0;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        count++;
+        last_time_ns = record.time_ns;
+        if (record.event >= TRACE_NUM_EVENTS) continue;
+        interval_t *task = find_task(&tasks, record.pid);
+        if (task && !task->named) {
+            snprintf(name, sizeof(name), "pid %d", record.pid);
+            emit_name(out, "thread_name", TASK_TRACK, record.pid, name);
+            task->named = 1;
+        }
+        switch (record.event) {
+            case TRACE_DISPATCH:
+                if (record.cpu < header.ncpus) {
+                    cpus[record.cpu] = (interval_t) {.pid = record.pid, .start_ns = record.time_ns, .arg = record.arg, .open = 1};
+                }
+                break;
+            case TRACE_PREEMPT:
+            case TRACE_BURST_END:
+                if (record.cpu < header.ncpus && cpus[record.cpu].open) {
+                    emit_slice(out, "pid", cpus[record.cpu].pid, CPU_TRACK, record.cpu,
+                               cpus[record.cpu].start_ns, record.time_ns, "remaining_ns", cpus[record.cpu].arg);
+                    cpus[record.cpu].open = 0;
+                }
+                break;
+            case TRACE_BLOCK:
+                emit_instant(out, &record);
+                if (task) {
+                    task->start_ns = record.time_ns;
+                    task->open = 1;
+                }
+                break;
+            case TRACE_WAKE:
+                emit_instant(out, &record);
+                if (task && task->open) {
+                    emit_slice(out, "blocked", record.pid, TASK_TRACK, record.pid, task->start_ns, record.time_ns,
+                               "ns", record.time_ns - task->start_ns);
+                    task->open = 0;
+                }
+                break;
+            default:
+                emit_instant(out, &record);
+                break;
+        }
+    }
+    // Close what is still running at the end of the trace
+    for (uint32_t cpu = 0; cpu < header.ncpus; cpu++) {
+        if (cpus[cpu].open) {
+            emit_slice(out, "pid", cpus[cpu].pid, CPU_TRACK, (int) cpu, cpus[cpu].start_ns, last_time_ns,
+                       "remaining_ns", cpus[cpu].arg);
+        }
+    }
+    fputs("\n]}\n", out);
+
+    fprintf(stderr, "Converted %llu events\n", (unsigned long long) count);
+    free(tasks.items);
+    fclose(in);
+    if (out != stdout) fclose(out);
+    return EXIT_SUCCESS;
+}
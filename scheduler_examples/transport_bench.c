@@ -0,0 +1,284 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msg.h"
+#include "shm_channel.h"
+
+#define MAX_BENCH_CLIENTS 128
+
+/*
+ * Run like: ./transport_bench [-n clients] [-b bursts] [-a path/to/app-io]
+ *
+ * Measures how many messages per second the transports between the applications
+ * and the simulator can carry. The benchmark stands in for the simulator at
+ * SOCKET_PATH (so the scheduler must not be running) and answers every request
+ * at once with ACK and DONE, so the time is spent in the transport only. The same
+ * app-io clients run once with -T socket and once with -T shm.
+ */
+
+// Define a connected client
+typedef struct {
+    int fd;
+    shm_channel_t *channel;     // NULL for the socket transport
+    int open;
+} bench_client_t;
+
+// Define the outcome of one run
+typedef struct {
+    uint64_t messages;          // Requests and replies
+    double seconds;
+    uint64_t parks;             // Futex waits of the clients (shared memory only)
+    uint64_t wakes;             // Futex wakes of the server (shared memory only)
+} bench_result_t;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int write_burst_file(char *path, uint32_t bursts) {
+    int fd = mkstemps(path, 4);
+    if (fd < 0) {
+        perror("mkstemps");
+        return -1;
+    }
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        perror("fdopen");
+        close(fd);
+        return -1;
+    }
+    // Every burst is a RUN and a BLOCK request
+    fprintf(f, "#cpu(ms),io(ms) transport benchmark\n");
+    for (uint32_t i = 0; i < bursts; i++) {
+        fprintf(f, "1,1\n");
+    }
+    fclose(f);
+    return 0;
+}
+
+static int listen_socket(void) {
+    unlink(SOCKET_PATH);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, MAX_BENCH_CLIENTS) < 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reply to a request like the simulator would if the request took no time
+static int reply(bench_client_t *client, msg_t *msg, uint64_t *messages) {
+    process_request_t replies[] = {PROCESS_REQUEST_ACK, PROCESS_REQUEST_DONE};
+    for (int i = 0; i < 2; i++) {
+        msg->request = replies[i];
+        if (client->channel) {
+            if (shm_ring_push(&client->channel->responses, msg) < 0) return -1;
+        } else if (write(client->fd, msg, sizeof(msg_t)) != sizeof(msg_t)) {
+            perror("write");
+            return -1;
+        }
+    }
+    *messages += 3;
+    return 0;
+}
+
+static int serve_socket(bench_client_t *clients, uint32_t n, uint64_t *messages) {
+    struct pollfd fds[MAX_BENCH_CLIENTS];
+    uint32_t num_open = n;
+    while (num_open > 0) {
+        for (uint32_t i = 0; i < n; i++) {
+            fds[i].fd = clients[i].open ? clients[i].fd : -1;
+            fds[i].events = POLLIN;
+        }
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return -1;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (!clients[i].open || !(fds[i].revents & (POLLIN | POLLHUP))) continue;
+            msg_t msg;
+            if (read(clients[i].fd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
+                clients[i].open = 0;
+                num_open--;
+            } else if (reply(&clients[i], &msg, messages) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int serve_shm(bench_client_t *clients, uint32_t n, uint64_t *messages) {
+    uint32_t num_open = n;
+    while (num_open > 0) {
+        int idle = 1;
+        for (uint32_t i = 0; i < n; i++) {
+            if (!clients[i].open) continue;
+            msg_t msg;
+            if (shm_ring_pop(&clients[i].channel->requests, &msg)) {
+                idle = 0;
+                if (reply(&clients[i], &msg, messages) < 0) return -1;
+            } else if (atomic_load(&clients[i].channel->closed)) {
+                clients[i].open = 0;
+                num_open--;
+            }
+        }
+        // Let the clients run when there is nothing to do
+        if (idle) sched_yield();
+    }
+    return 0;
+}
+
+static int run(const char *app_path, const char *transport, const char *burst_path, uint32_t n,
+               bench_result_t *result) {
+    memset(result, 0, sizeof(bench_result_t));
+    int server_fd = listen_socket();
+    if (server_fd < 0) return -1;
+
+    double start = monotonic_s();
+    pid_t pids[MAX_BENCH_CLIENTS];
+    for (uint32_t i = 0; i < n; i++) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            perror("fork");
+            return -1;
+        }
+        if (pids[i] == 0) {
+            // The clients report to the terminal (and debug builds log every message)
+            int null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd >= 0) {
+                dup2(null_fd, STDOUT_FILENO);
+                dup2(null_fd, STDERR_FILENO);
+            }
+            execl(app_path, app_path, "-T", transport, burst_path, (char *) NULL);
+            perror("execl");
+            _exit(EXIT_FAILURE);
+        }
+    }
+
+    bench_client_t clients[MAX_BENCH_CLIENTS];
+    int status = 0;
+    for (uint32_t i = 0; i < n && status == 0; i++) {
+        clients[i] = (bench_client_t) {.fd = accept(server_fd, NULL, NULL), .channel = NULL, .open = 1};
+        if (clients[i].fd < 0) {
+            perror("accept");
+            status = -1;
+        } else if (strcmp(transport, "shm") == 0) {
+            msg_t msg;
+            int shm_fd;
+            if (shm_channel_recv(clients[i].fd, &msg, &shm_fd) != sizeof(msg_t) || shm_fd < 0 ||
+                (clients[i].channel = shm_channel_attach(shm_fd)) == NULL) {
+                fprintf(stderr, "Client %u did not attach a channel\n", i);
+                status = -1;
+            }
+        }
+    }
+    if (status == 0) {
+        if (strcmp(transport, "shm") == 0) {
+            status = serve_shm(clients, n, &result->messages);
+        } else {
+            status = serve_socket(clients, n, &result->messages);
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+    result->seconds = monotonic_s() - start;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (clients[i].channel) {
+            result->parks += clients[i].channel->responses.parks;
+            result->wakes += clients[i].channel->responses.wakes;
+            shm_channel_detach(clients[i].channel);
+        }
+        close(clients[i].fd);
+    }
+    close(server_fd);
+    unlink(SOCKET_PATH);
+    return status;
+}
+
+static int parse_uint(const char *arg, uint32_t *value) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val <= 0 || val > INT32_MAX) {
+        fprintf(stderr, "Invalid value: %s\n", arg);
+        return -1;
+    }
+    *value = (uint32_t) val;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n clients] [-b bursts] [-a path/to/app-io]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t num_clients = 4;
+    uint32_t bursts = 20000;
+    const char *app_path = "./app-io";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:a:")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (parse_uint(optarg, &num_clients) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'b':
+                if (parse_uint(optarg, &bursts) < 0) exit(EXIT_FAILURE);
+                break;
+            case 'a':
+                app_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc || num_clients > MAX_BENCH_CLIENTS) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    char burst_path[] = "/tmp/transport-benchXXXXXX.csv";
+    if (write_burst_file(burst_path, bursts) < 0) return EXIT_FAILURE;
+
+    printf("%u app-io clients, %u bursts each\n", num_clients, bursts);
+    printf("%-10s %12s %10s %14s %12s %12s\n", "Transport", "Messages", "Time (s)", "Messages/s", "Futex waits", "Futex wakes");
+    const char *transports[] = {"socket", "shm"};
+    int status = EXIT_SUCCESS;
+    for (int i = 0; i < 2; i++) {
+        bench_result_t result;
+        if (run(app_path, transports[i], burst_path, num_clients, &result) < 0) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        printf("%-10s %12llu %10.3f %14.0f %12llu %12llu\n", transports[i],
+               (unsigned long long) result.messages, result.seconds,
+               result.seconds > 0 ? (double) result.messages / result.seconds : 0.0,
+               (unsigned long long) result.parks, (unsigned long long) result.wakes);
+    }
+    unlink(burst_path);
+    return status;
+}
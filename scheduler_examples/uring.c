@@ -0,0 +1,489 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define URING_SQ_ENTRIES 256
+#define URING_CQ_ENTRIES 4096
+#define URING_NUM_BUFFERS 1024              // Power of two
+#define URING_BUFFER_SIZE (4 * sizeof(msg_t))
+#define URING_BUFFER_GROUP 0
+
+// Kind of request, in the low bits of the user data (the rest is the connection pointer)
+#define URING_OP_ACCEPT 1
+#define URING_OP_RECVMSG 2
+#define URING_OP_RECV 3
+#define URING_OP_SEND 4
+#define URING_OP_CANCEL 5
+#define URING_OP_MASK 0xFull
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int buf_reserve(uring_buf_t *buf, uint32_t extra) {
+    if (buf->len + extra <= buf->capacity) return 0;
+    uint32_t capacity = buf->capacity ? buf->capacity : URING_BUFFER_SIZE;
+    while (capacity < buf->len + extra) capacity *= 2;
+    uint8_t *data = realloc(buf->data, capacity);
+    if (!data) return -1;
+    buf->data = data;
+    buf->capacity = capacity;
+    return 0;
+}
+
+static int buf_append(uring_buf_t *buf, const void *data, uint32_t len) {
+    if (buf_reserve(buf, len) < 0) return -1;
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+static void buf_consume(uring_buf_t *buf, uint32_t len) {
+    memmove(buf->data, buf->data + len, buf->len - len);
+    buf->len -= len;
+}
+
+/**
+ * @brief Take a free submission queue entry, submitting the queued ones if the queue is full
+ */
+static struct io_uring_sqe *get_sqe(uring_t *u) {
+    uint32_t tail = *u->sq_tail;
+    if (tail - atomic_load_explicit((_Atomic uint32_t *) u->sq_head, memory_order_acquire) == u->sq_entries) {
+        int ret = sys_io_uring_enter(u->ring_fd, u->to_submit, 0, 0);
+        u->stats.enters++;
+        if (ret < 0) {
+            perror("io_uring_enter");
+            return NULL;
+        }
+        u->to_submit -= (uint32_t) ret;
+    }
+    struct io_uring_sqe *sqe = &u->sqes[tail & *u->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    u->sq_array[tail & *u->sq_mask] = tail & *u->sq_mask;
+    atomic_store_explicit((_Atomic uint32_t *) u->sq_tail, tail + 1, memory_order_release);
+    u->to_submit++;
+    return sqe;
+}
+
+static void add_buffer(uring_t *u, uint16_t bid) {
+    struct io_uring_buf *buf = &u->buf_ring->bufs[u->buf_tail & (URING_NUM_BUFFERS - 1)];
+    buf->addr = (uint64_t) (uintptr_t) (u->buffers + (size_t) bid * URING_BUFFER_SIZE);
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = bid;
+    u->buf_tail++;
+    atomic_store_explicit((_Atomic uint16_t *) &u->buf_ring->tail, u->buf_tail, memory_order_release);
+}
+
+static void arm_accept(uring_t *u) {
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = u->server_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = URING_OP_ACCEPT;
+}
+
+static void arm_recv(uring_t *u, uring_conn_t *conn, int first) {
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (!sqe) return;
+    sqe->fd = conn->fd;
+    if (first) {
+        // A single recvmsg, to receive the descriptor an ATTACH message may carry
+        conn->iov = (struct iovec) {.iov_base = &conn->first, .iov_len = sizeof(msg_t)};
+        conn->hdr = (struct msghdr) {
+            .msg_iov = &conn->iov,
+            .msg_iovlen = 1,
+            .msg_control = conn->control,
+            .msg_controllen = sizeof(conn->control)
+        };
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (uint64_t) (uintptr_t) &conn->hdr;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_CMSG_CLOEXEC;
+        conn->recv_user_data = (uint64_t) (uintptr_t) conn | URING_OP_RECVMSG;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BUFFER_GROUP;
+        conn->recv_user_data = (uint64_t) (uintptr_t) conn | URING_OP_RECV;
+    }
+    sqe->user_data = conn->recv_user_data;
+    conn->recv_armed = 1;
+}
+
+static void arm_send(uring_t *u, uring_conn_t *conn) {
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t) (uintptr_t) conn->flight.data;
+    sqe->len = conn->flight.len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t) (uintptr_t) conn | URING_OP_SEND;
+    conn->sending = 1;
+    u->stats.sends++;
+}
+
+static void mark_pending(uring_t *u, uring_conn_t *conn) {
+    if (conn->pending) return;
+    if (u->num_pending == u->pending_capacity) {
+        uint32_t capacity = u->pending_capacity ? 2 * u->pending_capacity : 64;
+        uring_conn_t **pending = realloc(u->pending, capacity * sizeof(uring_conn_t *));
+        if (!pending) return;
+        u->pending = pending;
+        u->pending_capacity = capacity;
+    }
+    u->pending[u->num_pending++] = conn;
+    conn->pending = 1;
+}
+
+// A closed connection is freed once the kernel is done with its buffers
+static void release_conn(uring_conn_t *conn) {
+    if (conn->open || conn->recv_armed || conn->sending || conn->pending) return;
+    if (conn->passed_fd >= 0) close(conn->passed_fd);
+    free(conn->in.data);
+    free(conn->out.data);
+    free(conn->flight.data);
+    free(conn);
+}
+
+static uring_conn_t *find_conn(const uring_t *u, int fd) {
+    return fd >= 0 && (uint32_t) fd < u->num_conns ? u->conns[fd] : NULL;
+}
+
+static void new_connection(uring_t *u, int fd) {
+    if ((uint32_t) fd >= u->num_conns) {
+        uint32_t num_conns = u->num_conns ? u->num_conns : 64;
+        while (num_conns <= (uint32_t) fd) num_conns *= 2;
+        uring_conn_t **conns = realloc(u->conns, num_conns * sizeof(uring_conn_t *));
+        if (!conns) {
+            close(fd);
+            return;
+        }
+        memset(conns + u->num_conns, 0, (num_conns - u->num_conns) * sizeof(uring_conn_t *));
+        u->conns = conns;
+        u->num_conns = num_conns;
+    }
+    if (u->num_accepted == u->accepted_capacity) {
+        uint32_t capacity = u->accepted_capacity ? 2 * u->accepted_capacity : 64;
+        int *accepted = realloc(u->accepted, capacity * sizeof(int));
+        if (!accepted) {
+            close(fd);
+            return;
+        }
+        u->accepted = accepted;
+        u->accepted_capacity = capacity;
+    }
+    uring_conn_t *conn = calloc(1, sizeof(uring_conn_t));
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    conn->open = 1;
+    conn->passed_fd = -1;
+    u->conns[fd] = conn;
+    u->accepted[u->num_accepted++] = fd;
+    arm_recv(u, conn, 1);
+}
+
+static void recv_done(uring_t *u, uring_conn_t *conn, const struct io_uring_cqe *cqe, int first) {
+    const uint8_t *data = (const uint8_t *) &conn->first;
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        data = u->buffers + (size_t) bid * URING_BUFFER_SIZE;
+        // The bytes are copied out below, the buffer can go back to the kernel right away
+        add_buffer(u, bid);
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        conn->recv_armed = 0;
+    }
+    if (!conn->open) {
+        release_conn(conn);
+        return;
+    }
+    if (cqe->res > 0) {
+        u->stats.recvs++;
+        if (buf_append(&conn->in, data, (uint32_t) cqe->res) < 0) conn->eof = 1;
+        if (first) {
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&conn->hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&conn->hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                    memcpy(&conn->passed_fd, CMSG_DATA(cmsg), sizeof(int));
+                }
+            }
+        }
+    } else if (cqe->res == 0 || cqe->res != -ENOBUFS) {
+        // End of stream, or an error: the connection is closed once its messages are read
+        conn->eof = 1;
+    }
+    if (!conn->recv_armed && !conn->eof) {
+        // Out of provided buffers, or the recvmsg that started the connection finished
+        if (!first) u->stats.rearms++;
+        arm_recv(u, conn, 0);
+    }
+}
+
+static void send_done(uring_t *u, uring_conn_t *conn, const struct io_uring_cqe *cqe) {
+    conn->sending = 0;
+    if (cqe->res < 0) {
+        // The peer is gone, the recv reports the end of the connection
+        if (conn->open) fprintf(stderr, "send: %s\n", strerror(-cqe->res));
+        conn->flight.len = 0;
+        conn->out.len = 0;
+    } else {
+        buf_consume(&conn->flight, (uint32_t) cqe->res);
+    }
+    if (conn->flight.len > 0 || conn->out.len > 0) {
+        mark_pending(u, conn);
+    }
+    release_conn(conn);
+}
+
+void uring_poll(uring_t *u) {
+    uint32_t head = *u->cq_head;
+    while (head != atomic_load_explicit((_Atomic uint32_t *) u->cq_tail, memory_order_acquire)) {
+        struct io_uring_cqe cqe = u->cqes[head & *u->cq_mask];
+        head++;
+        atomic_store_explicit((_Atomic uint32_t *) u->cq_head, head, memory_order_release);
+
+        uring_conn_t *conn = (uring_conn_t *) (uintptr_t) (cqe.user_data & ~URING_OP_MASK);
+        switch (cqe.user_data & URING_OP_MASK) {
+            case URING_OP_ACCEPT:
+                if (cqe.res >= 0) {
+                    u->stats.accepts++;
+                    new_connection(u, cqe.res);
+                } else if (cqe.res != -EAGAIN && cqe.res != -EINTR && cqe.res != -ECONNABORTED) {
+                    fprintf(stderr, "accept: %s\n", strerror(-cqe.res));
+                }
+                if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                    u->stats.rearms++;
+                    arm_accept(u);
+                }
+                break;
+            case URING_OP_RECVMSG:
+                recv_done(u, conn, &cqe, 1);
+                break;
+            case URING_OP_RECV:
+                recv_done(u, conn, &cqe, 0);
+                break;
+            case URING_OP_SEND:
+                send_done(u, conn, &cqe);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int uring_init(uring_t *u, int server_fd) {
+    memset(u, 0, sizeof(uring_t));
+    u->server_fd = server_fd;
+    struct io_uring_params params = {0};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_CQ_ENTRIES;
+    u->ring_fd = sys_io_uring_setup(URING_SQ_ENTRIES, &params);
+    if (u->ring_fd < 0) {
+        perror("io_uring_setup");
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        fprintf(stderr, "io_uring: kernel too old\n");
+        close(u->ring_fd);
+        return -1;
+    }
+
+    // With a single mmap the submission and completion rings share the mapping
+    u->sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    u->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (u->cq_size > u->sq_size) u->sq_size = u->cq_size;
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                     IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED) {
+        perror("mmap");
+        close(u->ring_fd);
+        return -1;
+    }
+    u->cq_ptr = u->sq_ptr;
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                   IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        perror("mmap");
+        munmap(u->sq_ptr, u->sq_size);
+        close(u->ring_fd);
+        return -1;
+    }
+    uint8_t *sq = u->sq_ptr;
+    u->sq_head = (uint32_t *) (sq + params.sq_off.head);
+    u->sq_tail = (uint32_t *) (sq + params.sq_off.tail);
+    u->sq_mask = (uint32_t *) (sq + params.sq_off.ring_mask);
+    u->sq_array = (uint32_t *) (sq + params.sq_off.array);
+    u->sq_flags = (uint32_t *) (sq + params.sq_off.flags);
+    u->sq_entries = params.sq_entries;
+    uint8_t *cq = u->cq_ptr;
+    u->cq_head = (uint32_t *) (cq + params.cq_off.head);
+    u->cq_tail = (uint32_t *) (cq + params.cq_off.tail);
+    u->cq_mask = (uint32_t *) (cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    // The buffer ring must be page aligned
+    u->buf_ring_size = URING_NUM_BUFFERS * sizeof(struct io_uring_buf);
+    u->buf_ring = mmap(NULL, u->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->buffers = malloc((size_t) URING_NUM_BUFFERS * URING_BUFFER_SIZE);
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (uint64_t) (uintptr_t) u->buf_ring,
+        .ring_entries = URING_NUM_BUFFERS,
+        .bgid = URING_BUFFER_GROUP
+    };
+    if (u->buf_ring == MAP_FAILED || !u->buffers ||
+        sys_io_uring_register(u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("io_uring: provided buffers");
+        if (u->buf_ring == MAP_FAILED) u->buf_ring = NULL;
+        uring_free(u);
+        return -1;
+    }
+    for (uint16_t bid = 0; bid < URING_NUM_BUFFERS; bid++) {
+        add_buffer(u, bid);
+    }
+
+    arm_accept(u);
+    uring_submit(u);
+    return 0;
+}
+
+void uring_free(uring_t *u) {
+    // Closing the ring cancels the requests in flight
+    if (u->sqes) munmap(u->sqes, u->sqes_size);
+    if (u->sq_ptr) munmap(u->sq_ptr, u->sq_size);
+    if (u->ring_fd >= 0) close(u->ring_fd);
+    if (u->buf_ring) munmap(u->buf_ring, u->buf_ring_size);
+    free(u->buffers);
+    for (uint32_t fd = 0; fd < u->num_conns; fd++) {
+        uring_conn_t *conn = u->conns[fd];
+        if (!conn) continue;
+        if (conn->passed_fd >= 0) close(conn->passed_fd);
+        free(conn->in.data);
+        free(conn->out.data);
+        free(conn->flight.data);
+        free(conn);
+    }
+    free(u->conns);
+    free(u->accepted);
+    free(u->pending);
+    memset(u, 0, sizeof(uring_t));
+    u->ring_fd = -1;
+}
+
+int uring_accept(uring_t *u) {
+    if (u->num_accepted == 0) return -1;
+    int fd = u->accepted[0];
+    u->num_accepted--;
+    memmove(u->accepted, u->accepted + 1, u->num_accepted * sizeof(int));
+    return fd;
+}
+
+int uring_read(uring_t *u, int fd, msg_t *msg, int *passed_fd) {
+    uring_conn_t *conn = find_conn(u, fd);
+    *passed_fd = -1;
+    if (!conn) {
+        errno = EBADF;
+        return -1;
+    }
+    if (conn->in.len >= sizeof(msg_t)) {
+        memcpy(msg, conn->in.data, sizeof(msg_t));
+        buf_consume(&conn->in, sizeof(msg_t));
+        // Only the first message can come with a descriptor, and only an ATTACH message may
+        if (conn->passed_fd >= 0) {
+            if (msg->request == PROCESS_REQUEST_ATTACH) {
+                *passed_fd = conn->passed_fd;
+            } else {
+                close(conn->passed_fd);
+            }
+            conn->passed_fd = -1;
+        }
+        return sizeof(msg_t);
+    }
+    if (conn->eof) return 0;
+    errno = EAGAIN;
+    return -1;
+}
+
+int uring_send(uring_t *u, int fd, const msg_t *msg, const void *payload, uint32_t len) {
+    uring_conn_t *conn = find_conn(u, fd);
+    if (!conn || buf_append(&conn->out, msg, sizeof(msg_t)) < 0) return -1;
+    if (len > 0 && buf_append(&conn->out, payload, len) < 0) return -1;
+    mark_pending(u, conn);
+    return 0;
+}
+
+void uring_close(uring_t *u, int fd) {
+    uring_conn_t *conn = find_conn(u, fd);
+    if (!conn) return;
+    u->conns[fd] = NULL;
+    conn->open = 0;
+    if (conn->recv_armed) {
+        struct io_uring_sqe *sqe = get_sqe(u);
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = conn->recv_user_data;
+            sqe->user_data = URING_OP_CANCEL;
+        }
+    }
+    release_conn(conn);
+}
+
+void uring_submit(uring_t *u) {
+    // One send per connection, with every message queued for it since the last one
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < u->num_pending; i++) {
+        uring_conn_t *conn = u->pending[i];
+        if (conn->sending) {
+            // The previous send is still in flight, keep the messages for the next tick
+            u->pending[kept++] = conn;
+            continue;
+        }
+        conn->pending = 0;
+        if (!conn->open) {
+            release_conn(conn);
+            continue;
+        }
+        if (conn->flight.len == 0) {
+            uring_buf_t swap = conn->flight;
+            conn->flight = conn->out;
+            conn->out = swap;
+        }
+        if (conn->flight.len > 0) arm_send(u, conn);
+    }
+    u->num_pending = kept;
+
+    // Overflowed completions are only flushed by entering the kernel
+    int overflow = atomic_load_explicit((_Atomic uint32_t *) u->sq_flags, memory_order_relaxed) & IORING_SQ_CQ_OVERFLOW;
+    if (u->to_submit > 0 || overflow) {
+        int ret = sys_io_uring_enter(u->ring_fd, u->to_submit, 0, IORING_ENTER_GETEVENTS);
+        u->stats.enters++;
+        if (ret < 0) {
+            if (errno != EINTR && errno != EBUSY) perror("io_uring_enter");
+        } else {
+            u->to_submit -= (uint32_t) ret;
+        }
+    }
+    uring_poll(u);
+}
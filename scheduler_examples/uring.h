@@ -0,0 +1,159 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "msg.h"
+
+/*
+ * io_uring backend for the client sockets of the simulator.
+ *
+ * The POSIX path makes a syscall for every accept, read and write, and polls
+ * every idle client with a read that fails with EAGAIN. With this backend one
+ * multishot accept delivers the new connections, and one multishot recv per
+ * connection delivers its bytes into buffers provided to the kernel up front,
+ * so incoming data shows up in the completion queue without any syscall. The
+ * replies are appended to an output buffer per connection, and once per tick a
+ * send request per connection is submitted with a single io_uring_enter, however
+ * many clients there are.
+ *
+ * The ring is set up with raw syscalls (no liburing). The first read of every
+ * connection is a recvmsg, so that the shared-memory region of an ATTACH message
+ * (see shm_channel.h) can still be received.
+ */
+
+// Define a growable byte buffer
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t capacity;
+} uring_buf_t;
+
+// Define the state of a connection
+typedef struct uring_conn_st {
+    int fd;
+    int open;                   // Cleared by uring_close, freed once nothing is in flight
+    int eof;                    // The peer closed the connection (or reading failed)
+    int recv_armed;             // A recv or recvmsg is in flight
+    uint64_t recv_user_data;    // To cancel it
+    int passed_fd;              // Descriptor received with the first message (-1 if none)
+    int pending;                // In the list of connections with output to send
+    int sending;                // A send is in flight (from flight)
+    uring_buf_t in;             // Bytes received and not yet read
+    uring_buf_t out;            // Messages queued since the last submit
+    uring_buf_t flight;         // Messages being sent (not touched until the send completes)
+    msg_t first;                // Target of the first recvmsg
+    struct iovec iov;
+    struct msghdr hdr;
+    char control[CMSG_SPACE(sizeof(int))];
+} uring_conn_t;
+
+// Define the counters of the backend
+typedef struct {
+    uint64_t enters;            // io_uring_enter syscalls
+    uint64_t accepts;
+    uint64_t recvs;             // Recv completions with data
+    uint64_t sends;             // Send requests (each carries every message queued for a connection)
+    uint64_t rearms;            // Multishot requests that had to be armed again
+} uring_stats_t;
+
+// Define the io_uring backend
+typedef struct {
+    int ring_fd;
+    int server_fd;
+    // Submission queue
+    void *sq_ptr;
+    size_t sq_size;
+    uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array, *sq_flags;
+    uint32_t sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    uint32_t to_submit;
+    // Completion queue
+    void *cq_ptr;
+    size_t cq_size;
+    uint32_t *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Provided buffers for the multishot recvs
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint8_t *buffers;
+    uint16_t buf_tail;
+    // Accepted connections not handed out yet
+    int *accepted;
+    uint32_t num_accepted;
+    uint32_t accepted_capacity;
+    // Connections by fd
+    uring_conn_t **conns;
+    uint32_t num_conns;
+    // Connections with output to send at the next submit
+    uring_conn_t **pending;
+    uint32_t num_pending;
+    uint32_t pending_capacity;
+    uring_stats_t stats;
+} uring_t;
+
+/**
+ * @brief Set up the ring and start accepting connections on the server socket
+ *
+ * @param u The backend
+ * @param server_fd The listening socket
+ * @return 0 on success, -1 if io_uring (or one of the features used) is not available
+ */
+int uring_init(uring_t *u, int server_fd);
+
+/**
+ * @brief Tear down the ring (the connections are not closed)
+ */
+void uring_free(uring_t *u);
+
+/**
+ * @brief Process the completions posted since the last call (no syscall)
+ */
+void uring_poll(uring_t *u);
+
+/**
+ * @brief Take the next accepted connection
+ *
+ * @return The client file descriptor, or -1 if there are no more
+ */
+int uring_accept(uring_t *u);
+
+/**
+ * @brief Read a message from the input buffered for a connection
+ *
+ * Works like shm_channel_recv on a non-blocking socket.
+ *
+ * @param u The backend
+ * @param fd The client file descriptor
+ * @param msg Where to store the message
+ * @param passed_fd Where to store a descriptor received with an ATTACH message (-1 if none)
+ * @return sizeof(msg_t), 0 if the connection was closed, -1 with errno EAGAIN if no message is buffered
+ */
+int uring_read(uring_t *u, int fd, msg_t *msg, int *passed_fd);
+
+/**
+ * @brief Queue a message to be sent at the next uring_submit
+ *
+ * @param u The backend
+ * @param fd The client file descriptor
+ * @param msg The message
+ * @param payload Bytes sent right after the message (NULL if none)
+ * @param len Length of the payload
+ * @return 0 on success, -1 on failure
+ */
+int uring_send(uring_t *u, int fd, const msg_t *msg, const void *payload, uint32_t len);
+
+/**
+ * @brief Forget a connection, cancelling its recv (call before closing the fd)
+ */
+void uring_close(uring_t *u, int fd);
+
+/**
+ * @brief Submit the queued requests and process the completions, with one syscall
+ */
+void uring_submit(uring_t *u);
+
+#endif //URING_H
@@ -0,0 +1,312 @@
+#include "vm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VM_SPACE_MIN_CAPACITY 16
+
+static uint32_t page_hash(uint32_t page, uint32_t capacity) {
+    return (page * 2654435761u) & (capacity - 1);
+}
+
+static vm_space_t *space_create(void) {
+    vm_space_t *space = calloc(1, sizeof(vm_space_t));
+    if (!space) return NULL;
+    space->capacity = VM_SPACE_MIN_CAPACITY;
+    space->pages = malloc(space->capacity * sizeof(uint32_t));
+    space->frames = malloc(space->capacity * sizeof(int32_t));
+    if (!space->pages || !space->frames) {
+        free(space->pages);
+        free(space->frames);
+        free(space);
+        return NULL;
+    }
+    memset(space->frames, 0xFF, space->capacity * sizeof(int32_t));
+    return space;
+}
+
+static void space_free(vm_space_t *space) {
+    free(space->pages);
+    free(space->frames);
+    free(space);
+}
+
+// Returns the slot of the page, or the empty slot where it would be inserted
+static uint32_t space_slot(const vm_space_t *space, uint32_t page) {
+    uint32_t slot = page_hash(page, space->capacity);
+    while (space->frames[slot] >= 0 && space->pages[slot] != page) {
+        slot = (slot + 1) & (space->capacity - 1);
+    }
+    return slot;
+}
+
+static int space_insert(vm_space_t *space, uint32_t page, int32_t frame) {
+    if ((space->count + 1) * 4 > space->capacity * 3) {
+        // Keep the load factor under 3/4
+        vm_space_t bigger = *space;
+        bigger.capacity = space->capacity * 2;
+        bigger.count = 0;
+        bigger.pages = malloc(bigger.capacity * sizeof(uint32_t));
+        bigger.frames = malloc(bigger.capacity * sizeof(int32_t));
+        if (!bigger.pages || !bigger.frames) {
+            free(bigger.pages);
+            free(bigger.frames);
+            return -1;
+        }
+        memset(bigger.frames, 0xFF, bigger.capacity * sizeof(int32_t));
+        for (uint32_t i = 0; i < space->capacity; i++) {
+            if (space->frames[i] >= 0) {
+                uint32_t slot = space_slot(&bigger, space->pages[i]);
+                bigger.pages[slot] = space->pages[i];
+                bigger.frames[slot] = space->frames[i];
+                bigger.count++;
+            }
+        }
+        free(space->pages);
+        free(space->frames);
+        *space = bigger;
+    }
+    uint32_t slot = space_slot(space, page);
+    space->pages[slot] = page;
+    space->frames[slot] = frame;
+    space->count++;
+    return 0;
+}
+
+static void space_remove(vm_space_t *space, uint32_t page) {
+    uint32_t mask = space->capacity - 1;
+    uint32_t slot = space_slot(space, page);
+    if (space->frames[slot] < 0) return;
+    space->frames[slot] = -1;
+    space->count--;
+    // Backward shift the entries that follow, so lookups never stop at the hole
+    uint32_t next = (slot + 1) & mask;
+    while (space->frames[next] >= 0) {
+        uint32_t home = page_hash(space->pages[next], space->capacity);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            space->pages[slot] = space->pages[next];
+            space->frames[slot] = space->frames[next];
+            space->frames[next] = -1;
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+}
+
+int vm_parse_config(const char *spec, vm_config_t *config) {
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    memset(config, 0, sizeof(vm_config_t));
+    config->policy = VM_POLICY_LRU;
+    config->fault_ms = 10;
+    config->ws_window_ms = 1000;
+
+    int status = 0;
+    char *endptr;
+    char *token = strtok(copy, ",");
+    long value = token ? strtol(token, &endptr, 10) : -1;
+    if (!token || *endptr != '\0' || value <= 0 || value > INT32_MAX) {
+        status = -1;
+    } else {
+        config->num_frames = (uint32_t) value;
+    }
+    token = strtok(NULL, ",");
+    if (status == 0 && token) {
+        status = -1;
+        for (int i = 0; i < (int) (sizeof(VM_POLICY_STRINGS) / sizeof(VM_POLICY_STRINGS[0])); i++) {
+            if (strcmp(token, VM_POLICY_STRINGS[i]) == 0) {
+                config->policy = (vm_policy_en) i;
+                status = 0;
+            }
+        }
+        token = strtok(NULL, ",");
+    }
+    if (status == 0 && token) {
+        value = strtol(token, &endptr, 10);
+        if (*endptr != '\0' || value < 0 || value > INT32_MAX) {
+            status = -1;
+        } else {
+            config->fault_ms = (uint32_t) value;
+        }
+        token = strtok(NULL, ",");
+    }
+    if (status == 0 && token) {
+        value = strtol(token, &endptr, 10);
+        if (*endptr != '\0' || value <= 0 || value > INT32_MAX) {
+            status = -1;
+        } else {
+            config->ws_window_ms = (uint32_t) value;
+        }
+        token = strtok(NULL, ",");
+    }
+    if (token) status = -1;
+    if (status < 0) {
+        fprintf(stderr, "Invalid memory configuration: %s (expected frames[,FIFO|LRU|CLOCK|WS[,fault_ms[,ws_window_ms]]])\n", spec);
+    }
+    free(copy);
+    return status;
+}
+
+vm_t *vm_create(const vm_config_t *config) {
+    vm_t *vm = calloc(1, sizeof(vm_t));
+    if (!vm) return NULL;
+    vm->frames = calloc(config->num_frames, sizeof(vm_frame_t));
+    if (!vm->frames) {
+        free(vm);
+        return NULL;
+    }
+    vm->config = *config;
+    vm->free_frames = config->num_frames;
+    return vm;
+}
+
+void vm_destroy(vm_t *vm) {
+    if (!vm) return;
+    free(vm->frames);
+    free(vm);
+}
+
+/**
+ * @brief Choose the frame to be replaced when memory is full
+ */
+static uint32_t choose_victim(vm_t *vm, uint64_t current_time_ns) {
+    uint32_t n = vm->config.num_frames;
+    uint32_t victim = 0;
+    switch (vm->config.policy) {
+        case VM_POLICY_FIFO:
+            for (uint32_t i = 1; i < n; i++) {
+                if (vm->frames[i].loaded_ns < vm->frames[victim].loaded_ns) victim = i;
+            }
+            return victim;
+        case VM_POLICY_LRU:
+            for (uint32_t i = 1; i < n; i++) {
+                if (vm->frames[i].referenced_ns < vm->frames[victim].referenced_ns) victim = i;
+            }
+            return victim;
+        case VM_POLICY_CLOCK:
+            // Give referenced pages a second chance, at most one full turn
+            while (vm->frames[vm->hand].referenced) {
+                vm->frames[vm->hand].referenced = 0;
+                vm->hand = (vm->hand + 1) % n;
+            }
+            victim = vm->hand;
+            vm->hand = (vm->hand + 1) % n;
+            return victim;
+        case VM_POLICY_WS: {
+            // WSClock: evict the first page outside the working set window,
+            // or the least recently used one if all pages are in a working set
+            uint32_t oldest = vm->hand;
+            for (uint32_t scanned = 0; scanned < n; scanned++) {
+                vm_frame_t *frame = &vm->frames[vm->hand];
+                if (frame->referenced) {
+                    frame->referenced = 0;
+                } else if (current_time_ns - frame->referenced_ns > vm->config.ws_window_ms * NS_PER_MS) {
+                    victim = vm->hand;
+                    vm->hand = (vm->hand + 1) % n;
+                    return victim;
+                }
+                if (frame->referenced_ns < vm->frames[oldest].referenced_ns) oldest = vm->hand;
+                vm->hand = (vm->hand + 1) % n;
+            }
+            return oldest;
+        }
+    }
+    return victim;
+}
+
+/**
+ * @brief Reference the pages of a task, loading the missing ones
+ *
+ * @return The number of pages that were not resident
+ */
+static uint32_t reference_pages(vm_t *vm, pcb_t *task, uint64_t current_time_ns) {
+    if (!task->cold->mm) {
+        task->cold->mm = space_create();
+        if (!task->cold->mm) return 0;
+        task->cold->mm->created_ns = current_time_ns;
+    }
+    vm_space_t *space = task->cold->mm;
+    uint32_t loaded = 0;
+    for (uint32_t i = 0; i < task->cold->pages.count && i < MAX_PAGES; i++) {
+        uint32_t page = task->cold->pages.ids[i];
+        uint32_t slot = space_slot(space, page);
+        int32_t frame_idx = space->frames[slot];
+        if (frame_idx < 0) {
+            // Page not resident: find a frame for the page
+            loaded++;
+            if (vm->free_frames > 0) {
+                for (frame_idx = 0; vm->frames[frame_idx].owner != NULL; frame_idx++) { }
+                vm->free_frames--;
+            } else {
+                frame_idx = (int32_t) choose_victim(vm, current_time_ns);
+                vm_frame_t *victim = &vm->frames[frame_idx];
+                space_remove(victim->owner, victim->page);
+                vm->stats.evictions++;
+            }
+            if (space_insert(space, page, frame_idx) < 0) {
+                // Out of host memory: the frame stays free
+                vm->frames[frame_idx].owner = NULL;
+                vm->free_frames++;
+                continue;
+            }
+            vm->frames[frame_idx].owner = space;
+            vm->frames[frame_idx].page = page;
+            vm->frames[frame_idx].loaded_ns = current_time_ns;
+        }
+        vm->frames[frame_idx].referenced_ns = current_time_ns;
+        vm->frames[frame_idx].referenced = 1;
+    }
+    return loaded;
+}
+
+uint64_t vm_access(vm_t *vm, pcb_t *task, uint64_t current_time_ns) {
+    if (task->cold->pages.count == 0) return 0;
+    uint32_t faults = reference_pages(vm, task, current_time_ns);
+    uint32_t references = task->cold->pages.count < MAX_PAGES ? task->cold->pages.count : MAX_PAGES;
+    vm->stats.references += references;
+    vm->stats.faults += faults;
+    uint64_t stall_ns = faults * vm->config.fault_ms * NS_PER_MS;
+    vm->stats.stall_ns += stall_ns;
+    if (task->cold->mm) {
+        task->cold->mm->references += references;
+        task->cold->mm->faults += faults;
+    }
+    return stall_ns;
+}
+
+uint32_t vm_prefetch(vm_t *vm, pcb_t *task, uint64_t current_time_ns) {
+    if (task->cold->pages.count == 0) return 0;
+    return reference_pages(vm, task, current_time_ns);
+}
+
+uint32_t vm_resident_pages(const pcb_t *task) {
+    return task->cold->mm ? task->cold->mm->count : 0;
+}
+
+void vm_release(vm_t *vm, pcb_t *task) {
+    vm_space_t *space = task->cold->mm;
+    if (!space) return;
+    for (uint32_t i = 0; i < space->capacity; i++) {
+        if (space->frames[i] >= 0) {
+            vm->frames[space->frames[i]].owner = NULL;
+            vm->free_frames++;
+        }
+    }
+    space_free(space);
+    task->cold->mm = NULL;
+}
+
+void vm_print_stats(const vm_t *vm, FILE *out, const char *label) {
+    fprintf(out, "%s memory: %u frames, %s replacement, %u ms per fault",
+            label, vm->config.num_frames, VM_POLICY_STRINGS[vm->config.policy], vm->config.fault_ms);
+    if (vm->config.policy == VM_POLICY_WS) {
+        fprintf(out, ", %u ms working set window", vm->config.ws_window_ms);
+    }
+    fprintf(out, "\n%s page references: %llu, faults: %llu (%.2f%%), evictions: %llu, fault stall: %.3fs\n",
+            label,
+            (unsigned long long) vm->stats.references,
+            (unsigned long long) vm->stats.faults,
+            vm->stats.references ? 100.0 * (double) vm->stats.faults / (double) vm->stats.references : 0.0,
+            (unsigned long long) vm->stats.evictions,
+            vm->stats.stall_ns / 1e9);
+}
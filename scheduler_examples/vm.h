@@ -0,0 +1,143 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+
+/*
+ * Virtual memory model.
+ *
+ * Physical memory is a fixed number of frames shared by all processes. Every
+ * process has a page table mapping its pages to frames. When a task is put on a
+ * CPU it references the pages of its current burst (page_info_t sent with RUN).
+ * Pages that are not resident cause page faults: a frame is allocated (evicting
+ * a page chosen by the replacement policy if memory is full) and the task blocks
+ * for the fault service time of every fault before it can run.
+ */
+
+// Define the page replacement policies
+typedef enum {
+    VM_POLICY_FIFO = 0,         // Evict the page loaded first
+    VM_POLICY_LRU,              // Evict the page referenced least recently
+    VM_POLICY_CLOCK,            // Second chance with a reference bit
+    VM_POLICY_WS,               // Working set: evict a page outside the working set window (WSClock)
+} vm_policy_en;
+
+static const char VM_POLICY_STRINGS[][8] = {
+    "FIFO",
+    "LRU",
+    "CLOCK",
+    "WS"
+};
+
+// Define the virtual memory configuration
+typedef struct {
+    uint32_t num_frames;        // Physical memory size in frames
+    vm_policy_en policy;
+    uint32_t fault_ms;          // Block time per page fault
+    uint32_t ws_window_ms;      // Working set window (WS only)
+} vm_config_t;
+
+// Define the virtual memory counters
+typedef struct {
+    uint64_t references;        // Page references
+    uint64_t faults;            // References to pages that were not resident
+    uint64_t evictions;         // Faults that had to evict a resident page
+    uint64_t stall_ns;          // Block time caused by faults
+} vm_stats_t;
+
+// Define a physical frame
+typedef struct {
+    struct vm_space_st *owner;  // Page table of the owner (NULL if free)
+    uint32_t page;              // Page of the owner stored in the frame
+    uint64_t loaded_ns;         // Time the page was loaded
+    uint64_t referenced_ns;     // Time the page was last referenced
+    uint8_t referenced;         // Reference bit (CLOCK, WS)
+} vm_frame_t;
+
+// Define the page table of a process (open addressing hash from page to frame)
+typedef struct vm_space_st {
+    uint32_t *pages;
+    int32_t *frames;            // -1 for an empty slot
+    uint32_t capacity;          // Power of 2
+    uint32_t count;
+    uint64_t created_ns;        // Time the process got its first page (or was swapped in)
+    uint64_t references;
+    uint64_t faults;
+} vm_space_t;
+
+// Define the virtual memory of a simulation
+typedef struct {
+    vm_config_t config;
+    vm_frame_t *frames;
+    uint32_t free_frames;
+    uint32_t hand;              // Clock hand (CLOCK, WS)
+    vm_stats_t stats;
+} vm_t;
+
+/**
+ * @brief Parse a configuration like "64,LRU,20" or "64,WS,20,500"
+ *
+ * The fields are: number of frames, replacement policy, fault service time in ms,
+ * and (WS only) the working set window in ms.
+ *
+ * @param spec The configuration string
+ * @param config Where to store the configuration
+ * @return 0 on success, -1 if the configuration is invalid
+ */
+int vm_parse_config(const char *spec, vm_config_t *config);
+
+/**
+ * @brief Create the virtual memory of a simulation
+ *
+ * @return The virtual memory, or NULL on failure
+ */
+vm_t *vm_create(const vm_config_t *config);
+
+/**
+ * @brief Free the virtual memory (the page tables of live tasks are not freed)
+ */
+void vm_destroy(vm_t *vm);
+
+/**
+ * @brief Reference the pages of the current burst of a task
+ *
+ * Missing pages are loaded, evicting other pages if needed.
+ *
+ * @param vm The virtual memory
+ * @param task The task being put on the CPU
+ * @param current_time_ns The current time in nanoseconds
+ * @return The time in nanoseconds the task must block to service its page faults (0 if there were none)
+ */
+uint64_t vm_access(vm_t *vm, pcb_t *task, uint64_t current_time_ns);
+
+/**
+ * @brief Load the pages of the current burst of a task without counting page faults
+ *
+ * Used when a swapped out process is brought back into memory.
+ *
+ * @param vm The virtual memory
+ * @param task The task being swapped in
+ * @param current_time_ns The current time in nanoseconds
+ * @return The number of pages that were loaded
+ */
+uint32_t vm_prefetch(vm_t *vm, pcb_t *task, uint64_t current_time_ns);
+
+/**
+ * @brief Get the number of resident pages of a task
+ */
+uint32_t vm_resident_pages(const pcb_t *task);
+
+/**
+ * @brief Release the frames and the page table of a task that left the simulation
+ */
+void vm_release(vm_t *vm, pcb_t *task);
+
+/**
+ * @brief Print the configuration and the counters
+ */
+void vm_print_stats(const vm_t *vm, FILE *out, const char *label);
+
+#endif //VM_H